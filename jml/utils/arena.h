@@ -0,0 +1,113 @@
+/* arena.h                                                         -*- C++ -*-
+   Copyright (c) 2014 Datacratic Inc.  All rights reserved.
+
+   Monotonic allocator for objects that all die at the same time.  The
+   first InlineBytes come from storage embedded in the arena itself; past
+   that each allocation gets its own heap block.  Nothing is released
+   until the arena itself is destroyed.
+
+   Allocation is lock-free and may be done from several threads at once.
+*/
+
+#ifndef __jml__utils__arena_h__
+#define __jml__utils__arena_h__
+
+#include "jml/arch/cmp_xchg.h"
+#include "jml/compiler/compiler.h"
+#include <cstdlib>
+#include <new>
+#include <utility>
+
+namespace ML {
+
+template<size_t InlineBytes>
+struct Arena {
+
+    enum { Alignment = 16 };
+
+    Arena()
+        : used(0), overflow(nullptr)
+    {
+    }
+
+    ~Arena()
+    {
+        clear();
+    }
+
+    Arena(const Arena &) = delete;
+    Arena & operator = (const Arena &) = delete;
+
+    /** Allocate the given number of bytes, aligned to Alignment. */
+    void * allocate(size_t bytes)
+    {
+        size_t rounded = (bytes + Alignment - 1) & ~size_t(Alignment - 1);
+
+        if (JML_LIKELY(used < InlineBytes)) {
+            size_t start = __sync_fetch_and_add(&used, rounded);
+            if (start + rounded <= InlineBytes)
+                return storage + start;
+        }
+
+        Block * block = (Block *)malloc(sizeof(Block) + rounded);
+        if (!block)
+            throw std::bad_alloc();
+
+        Block * head = overflow;
+        do {
+            block->next = head;
+        } while (!cmp_xchg(overflow, head, block));
+
+        return block + 1;
+    }
+
+    /** Construct an object in the arena.  It will not be destroyed when
+        the arena is; call destroy() when its destructor matters.
+    */
+    template<typename T, typename... Args>
+    T * create(Args &&... args)
+    {
+        static_assert(alignof(T) <= Alignment, "over-aligned arena object");
+        return new (allocate(sizeof(T))) T(std::forward<Args>(args)...);
+    }
+
+    template<typename T>
+    static void destroy(T * obj)
+    {
+        obj->~T();
+    }
+
+    /** Number of bytes that were served from the inline storage. */
+    size_t inlineBytesUsed() const
+    {
+        return used < InlineBytes ? used : InlineBytes;
+    }
+
+    /** Release everything.  Only safe when no other thread is allocating
+        and nothing allocated from the arena is still in use.
+    */
+    void clear()
+    {
+        Block * block = overflow;
+        while (block) {
+            Block * next = block->next;
+            free(block);
+            block = next;
+        }
+        overflow = nullptr;
+        used = 0;
+    }
+
+private:
+    struct JML_ALIGNED(16) Block {
+        Block * next;
+    };
+
+    JML_ALIGNED(16) char storage[InlineBytes];
+    size_t used;
+    Block * overflow;
+};
+
+} // namespace ML
+
+#endif /* __jml__utils__arena_h__ */
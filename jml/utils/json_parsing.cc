@@ -556,6 +556,76 @@ matchJsonObject(Parse_Context & context,
     return true;
 }
 
+void
+skipJsonString(Parse_Context & context)
+{
+    skipJsonWhitespace(context);
+    context.expect_literal('"');
+
+    while (!context.match_literal('"')) {
+        if (context.eof())
+            context.exception("unterminated JSON string");
+        char c = *context++;
+        if (c != '\\')
+            continue;
+
+        c = *context++;
+        switch (c) {
+        case 't': case 'n': case 'r': case 'f': case 'b':
+        case '/': case '\\': case '"':
+            break;
+        case 'u':
+            context.expect_hex4();
+            break;
+        default:
+            context.exception("invalid escaped char");
+        }
+    }
+}
+
+void
+skipJson(Parse_Context & context)
+{
+    skipJsonWhitespace(context);
+
+    if (context.eof())
+        context.exception("expected JSON value");
+
+    char c = *context;
+    if (c == '"')
+        skipJsonString(context);
+    else if (c == '[') {
+        expectJsonArray(context,
+                        [] (int, Parse_Context & context)
+                        {
+                            skipJson(context);
+                        });
+    }
+    else if (c == '{') {
+        context.expect_literal('{');
+        skipJsonWhitespace(context);
+        if (context.match_literal('}')) return;
+
+        for (;;) {
+            skipJsonString(context);
+            skipJsonWhitespace(context);
+            context.expect_literal(':');
+            skipJson(context);
+            skipJsonWhitespace(context);
+            if (!context.match_literal(',')) break;
+            skipJsonWhitespace(context);
+        }
+
+        skipJsonWhitespace(context);
+        context.expect_literal('}');
+    }
+    else if (context.match_literal("null")
+             || context.match_literal("true")
+             || context.match_literal("false"))
+        return;
+    else expectJsonNumber(context);
+}
+
 JsonNumber expectJsonNumber(Parse_Context & context)
 {
     JsonNumber result;
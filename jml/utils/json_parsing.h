@@ -72,6 +72,14 @@ matchJsonObject(Parse_Context & context,
 
 void skipJsonWhitespace(Parse_Context & context);
 
+/** Step over a JSON string without decoding it. */
+void skipJsonString(Parse_Context & context);
+
+/** Step over any JSON value without building anything from it.  This is
+    much cheaper than calling expectJson() and throwing the result away.
+*/
+void skipJson(Parse_Context & context);
+
 inline bool expectJsonBool(Parse_Context & context)
 {
     if (context.match_literal("true"))
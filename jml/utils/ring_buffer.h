@@ -9,7 +9,12 @@
 #ifndef __jml_utils__ring_buffer_h__
 #define __jml_utils__ring_buffer_h__
 
+#include <atomic>
+#include <memory>
+#include <type_traits>
 #include <vector>
+#include <errno.h>
+#include <stdint.h>
 #include "jml/arch/futex.h"
 #include "jml/arch/spinlock.h"
 #include <mutex>
@@ -227,172 +232,312 @@ struct RingBufferSWMR : public RingBufferBase<Request> {
 /* RING BUFFER SINGLE READER MULTIPLE WRITERS                                */
 /*****************************************************************************/
 
+/** Bounded multiple writer, single reader ring buffer.
+
+    Writers claim a slot by bumping the write position with a
+    compare-and-swap and publish it by advancing the slot's sequence number,
+    so they never wait for each other; the reader owns the read position.
+    The requests live in the slots themselves, which means that they only
+    need to be movable.
+
+    Nobody makes a system call unless somebody is asleep: a reader blocked
+    in pop() raises a flag that the writers look at after publishing, and
+    writers blocked on a full ring are counted so that the reader knows it
+    has to wake them.
+
+    The size is rounded up to a power of two and all of the slots can be
+    used.  Only pop(), tryPop(), tryPopMulti() and the move operations are
+    restricted to one thread at a time.
+*/
 template<typename Request>
-struct RingBufferSRMW : public RingBufferBase<Request> {
-    using RingBufferBase<Request>::init;
-    using RingBufferBase<Request>::ring;
-    using RingBufferBase<Request>::bufferSize;
-    using RingBufferBase<Request>::readPosition;
-    using RingBufferBase<Request>::writePosition;
+struct RingBufferSRMW {
 
     RingBufferSRMW(size_t size)
-        : RingBufferBase<Request>(size)
     {
+        init(size);
+    }
+
+    ~RingBufferSRMW()
+    {
+        clear();
     }
 
     RingBufferSRMW(const RingBufferSRMW & other) = delete;
     RingBufferSRMW & operator = (const RingBufferSRMW & other) = delete;
 
+    /** The moves are not thread safe: nothing else may be using either
+        buffer while they happen.
+    */
     RingBufferSRMW(RingBufferSRMW && other)
         noexcept
-        : RingBufferBase<Request>(std::move(other))
+        : slots(nullptr), mask(0)
     {
+        *this = std::move(other);
     }
 
     RingBufferSRMW & operator = (RingBufferSRMW && other)
         noexcept
     {
-        Guard guard(other.mutex);
-
-        RingBufferBase<Request>::operator = (std::move(other));
+        if (&other == this)
+            return *this;
+
+        clear();
+        slots = std::move(other.slots);
+        mask = other.mask;
+        other.mask = 0;
+        writePosition.store(other.writePosition.load());
+        other.writePosition.store(0);
+        readPosition.store(other.readPosition.load());
+        other.readPosition.store(0);
+        readerWaiting.store(0);
+        writersWaiting.store(0);
+        popEpoch.store(0);
 
         return *this;
     }
 
-    typedef ML::Spinlock Mutex;
-    mutable Mutex mutex; // todo: get rid of...
-    typedef std::unique_lock<Mutex> Guard;
-    
+    size_t capacity() const
+    {
+        return slots ? mask + 1 : 0;
+    }
+
     void push(const Request & request)
     {
-        Guard guard(mutex);
+        pushImpl(request);
+    }
 
-        for (;;) {
-            // What position would the read position be in if the buffer was
-            // full?  
-            unsigned fullReadPosition = (writePosition + 1) % bufferSize;
-            if (readPosition == fullReadPosition)
-                ML::futex_wait(readPosition, fullReadPosition);
-            else break;
-        }
-                       
-        //ring[writePosition] = request;
-        ring[writePosition] = request;
-        writePosition = (writePosition + 1) % bufferSize;
-        ML::futex_wake(writePosition);
+    void push(Request && request)
+    {
+        pushImpl(std::move(request));
     }
 
+    /** Returns false without touching the request if the buffer is full. */
     bool tryPush(const Request & request)
     {
-        Guard guard(mutex);
+        return tryPushImpl(request);
+    }
 
-        // What position would the read position be in if the buffer was
-        // full?  
-        unsigned fullReadPosition = (writePosition + 1) % bufferSize;
-        if (readPosition == fullReadPosition)
-            return false;
+    bool tryPush(Request && request)
+    {
+        return tryPushImpl(std::move(request));
+    }
 
-        //ring[writePosition] = request;
-        ring[writePosition] = request;
-        writePosition = (writePosition + 1) % bufferSize;
-        ML::futex_wake(writePosition);
+    Request pop()
+    {
+        Request result;
+        waitForPop(result, -1.0);
+        return result;
+    }
 
+    bool tryPop(Request & result)
+    {
+        if (!take(result))
+            return false;
+        wakeWriters();
         return true;
     }
 
-    bool tryPush(Request && request)
+    bool tryPop(Request & result, double maxWaitTime)
     {
-        Guard guard(mutex);
+        return waitForPop(result, maxWaitTime);
+    }
 
-        // What position would the read position be in if the buffer was
-        // full?
-        unsigned fullReadPosition = (writePosition + 1) % bufferSize;
-        if (readPosition == fullReadPosition)
-            return false;
+    std::vector<Request> tryPopMulti(size_t nbrRequests)
+    {
+        std::vector<Request> result;
 
-        //ring[writePosition] = request;
-        ring[writePosition] = std::move(request);
-        writePosition = (writePosition + 1) % bufferSize;
-        ML::futex_wake(writePosition);
+        Request request;
+        while (result.size() < nbrRequests && take(request))
+            result.emplace_back(std::move(request));
+        if (!result.empty())
+            wakeWriters();
 
-        return true;
+        return result;
     }
 
-    Request pop()
+    /** Whether the next request is ready to be popped.  It may be called
+        from any thread.
+    */
+    bool couldPop() const
     {
-        Request result;
+        if (!slots)
+            return false;
+        uint64_t pos = readPosition.load(std::memory_order_relaxed);
+        return slots[pos & mask].sequence.load(std::memory_order_acquire)
+            == pos + 1;
+    }
 
-        {
-            // Wait until write position != read position, ie not full
-            for (;;) {
-                if (writePosition == readPosition)
-                    ML::futex_wait(writePosition, readPosition);
-                else break;
-            }
+private:
+    /* A slot holding a request has sequence position + 1, where position is
+       the write position that claimed it; a free one has sequence position
+       for the next writer that will claim it. */
+    struct Slot {
+        std::atomic<uint64_t> sequence;
+        typename std::aligned_storage<sizeof(Request),
+                                      alignof(Request)>::type storage;
 
-            result = ring[readPosition];
-            ring[readPosition] = Request();
-            readPosition = (readPosition + 1) % bufferSize;
+        Request * request()
+        {
+            return reinterpret_cast<Request *>(&storage);
         }
-        ML::futex_wake(readPosition);
+    };
 
-        return result;
+    enum { CacheLineSize = 64 };
+
+    std::unique_ptr<Slot[]> slots;
+    uint64_t mask;
+    char pad0[CacheLineSize];
+
+    /* Writers only */
+    std::atomic<uint64_t> writePosition;
+    char pad1[CacheLineSize];
+
+    /* Reader only, but couldPop() may look at it */
+    std::atomic<uint64_t> readPosition;
+    char pad2[CacheLineSize];
+
+    /* Futex words.  readerWaiting is 1 when the reader sleeps in pop();
+       writersWaiting counts writers asleep on a full buffer, who sleep on
+       popEpoch. */
+    std::atomic<int> readerWaiting;
+    std::atomic<int> writersWaiting;
+    std::atomic<int> popEpoch;
+
+    void init(size_t numEntries)
+    {
+        size_t size = 1;
+        while (size < numEntries)
+            size *= 2;
+
+        slots.reset(new Slot[size]);
+        mask = size - 1;
+        for (size_t i = 0;  i < size;  ++i)
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+
+        writePosition.store(0);
+        readPosition.store(0);
+        readerWaiting.store(0);
+        writersWaiting.store(0);
+        popEpoch.store(0);
     }
 
-    bool tryPop(Request & result)
+    void clear()
     {
-        if (writePosition == readPosition)
-            return false;
+        Request request;
+        while (take(request)) ;
+    }
 
-        result = ring[readPosition];
-        ring[readPosition] = Request();
-        readPosition = (readPosition + 1) % bufferSize;
-        ML::futex_wake(readPosition);
-        
-        return true;
+    template<typename RequestT>
+    void pushImpl(RequestT && request)
+    {
+        while (!tryPushImpl(std::forward<RequestT>(request))) {
+            int epoch = popEpoch.load();
+            writersWaiting.fetch_add(1);
+
+            // The reader may have made room before it saw us
+            if (!full())
+                writersWaiting.fetch_sub(1);
+            else {
+                ML::futex_wait(popEpoch, epoch);
+                writersWaiting.fetch_sub(1);
+            }
+        }
     }
 
-    bool tryPop(Request & result, double maxWaitTime)
+    /* The request is only moved from when a slot was claimed for it. */
+    template<typename RequestT>
+    bool tryPushImpl(RequestT && request)
     {
-        {
-            // Wait until write position != read position, ie not full
-            for (;;) {
-                if (writePosition == readPosition) {
-                    if (ML::futex_wait(writePosition, readPosition, maxWaitTime) == -1
-                        && errno == ETIMEDOUT)
-                        return false;
-                }
-                else break;
+        uint64_t pos = writePosition.load(std::memory_order_relaxed);
+        Slot * slot;
+
+        for (;;) {
+            slot = &slots[pos & mask];
+            uint64_t seq = slot->sequence.load(std::memory_order_acquire);
+            int64_t diff = int64_t(seq) - int64_t(pos);
+
+            if (diff == 0) {
+                if (writePosition.compare_exchange_weak
+                        (pos, pos + 1, std::memory_order_relaxed))
+                    break;
             }
-            
-            result = ring[readPosition];
-            ring[readPosition] = Request();
-            readPosition = (readPosition + 1) % bufferSize;
+            else if (diff < 0)
+                return false;
+            else pos = writePosition.load(std::memory_order_relaxed);
         }
-        ML::futex_wake(readPosition);
+
+        new (slot->request()) Request(std::forward<RequestT>(request));
+        slot->sequence.store(pos + 1, std::memory_order_release);
+
+        // Pairs with the fence in waitForPop: either we see the flag or
+        // the reader sees the request.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (readerWaiting.load(std::memory_order_relaxed)
+            && readerWaiting.exchange(0))
+            ML::futex_wake(readerWaiting, 1);
 
         return true;
     }
 
-    std::vector<Request> tryPopMulti(size_t nbrRequests)
+    bool full() const
     {
-        std::vector<Request> result;
+        uint64_t pos = writePosition.load(std::memory_order_relaxed);
+        uint64_t seq = slots[pos & mask].sequence.load(std::memory_order_acquire);
+        return int64_t(seq) - int64_t(pos) < 0;
+    }
 
-        for (size_t i = 0;
-             writePosition != readPosition && i < nbrRequests;
-             i++) {
-            result.emplace_back(std::move(ring[readPosition]));
-            ring[readPosition] = Request();
-            readPosition = (readPosition + 1) % bufferSize;
+    /* Moves the next request out without waking up anyone. */
+    bool take(Request & result)
+    {
+        if (!slots)
+            return false;
+
+        uint64_t pos = readPosition.load(std::memory_order_relaxed);
+        Slot & slot = slots[pos & mask];
+        if (slot.sequence.load(std::memory_order_acquire) != pos + 1)
+            return false;
+
+        result = std::move(*slot.request());
+        slot.request()->~Request();
+        slot.sequence.store(pos + mask + 1, std::memory_order_release);
+        readPosition.store(pos + 1, std::memory_order_relaxed);
+
+        return true;
+    }
+
+    void wakeWriters()
+    {
+        // Pairs with the fetch_add in pushImpl: either we see the writer or
+        // the writer sees the free slot.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (writersWaiting.load(std::memory_order_relaxed)) {
+            popEpoch.fetch_add(1);
+            ML::futex_wake(popEpoch);
         }
-        ML::futex_wake(readPosition);
-        
-        return result;
     }
 
-    bool couldPop() const
+    /* Waits forever if maxWaitTime is negative. */
+    bool waitForPop(Request & result, double maxWaitTime)
     {
-        return writePosition != readPosition;
+        for (;;) {
+            if (tryPop(result))
+                return true;
+
+            readerWaiting.store(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            if (!couldPop()) {
+                long res = maxWaitTime < 0
+                    ? ML::futex_wait(readerWaiting, 1)
+                    : ML::futex_wait(readerWaiting, 1, maxWaitTime);
+                if (res == -1 && errno == ETIMEDOUT) {
+                    readerWaiting.store(0);
+                    return tryPop(result);
+                }
+            }
+
+            readerWaiting.store(0);
+        }
     }
 };
 
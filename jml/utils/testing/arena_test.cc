@@ -0,0 +1,82 @@
+/* arena_test.cc
+   Copyright (c) 2014 Datacratic Inc.  All rights reserved.
+
+   Test for the Arena class.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "jml/utils/arena.h"
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/barrier.hpp>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+using namespace std;
+using namespace ML;
+
+BOOST_AUTO_TEST_CASE( test_arena_inline_and_overflow )
+{
+    Arena<64> arena;
+
+    vector<char *> ptrs;
+    for (unsigned i = 0;  i < 8;  ++i) {
+        char * p = (char *)arena.allocate(i + 1);
+        BOOST_CHECK_EQUAL((uintptr_t)p % 16, 0);
+        std::fill(p, p + i + 1, (char)i);
+        ptrs.push_back(p);
+    }
+
+    // Only the first four 16 byte slots fit inline
+    BOOST_CHECK_EQUAL(arena.inlineBytesUsed(), 64);
+
+    for (unsigned i = 0;  i < ptrs.size();  ++i)
+        for (unsigned j = 0;  j <= i;  ++j)
+            BOOST_CHECK_EQUAL(ptrs[i][j], (char)i);
+
+    arena.clear();
+    BOOST_CHECK_EQUAL(arena.inlineBytesUsed(), 0);
+}
+
+BOOST_AUTO_TEST_CASE( test_arena_create_destroy )
+{
+    Arena<256> arena;
+
+    string * s = arena.create<string>(100, 'x');
+    BOOST_CHECK_EQUAL(s->size(), 100);
+    BOOST_CHECK_EQUAL((*s)[99], 'x');
+    Arena<256>::destroy(s);
+}
+
+BOOST_AUTO_TEST_CASE( test_arena_multithreaded )
+{
+    enum { NumThreads = 8, PerThread = 1000 };
+
+    Arena<4096> arena;
+    vector<vector<uint64_t *> > allocated(NumThreads);
+    boost::barrier barrier(NumThreads);
+
+    auto doThread = [&] (int thread)
+        {
+            barrier.wait();
+            for (unsigned i = 0;  i < PerThread;  ++i) {
+                uint64_t * p = arena.create<uint64_t>(thread * PerThread + i);
+                allocated[thread].push_back(p);
+            }
+        };
+
+    boost::thread_group threads;
+    for (unsigned i = 0;  i < NumThreads;  ++i)
+        threads.create_thread(std::bind<void>(doThread, i));
+    threads.join_all();
+
+    // Nobody got handed memory that somebody else also got
+    for (unsigned t = 0;  t < NumThreads;  ++t)
+        for (unsigned i = 0;  i < PerThread;  ++i)
+            BOOST_CHECK_EQUAL(*allocated[t][i], t * PerThread + i);
+}
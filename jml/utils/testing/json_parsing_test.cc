@@ -86,3 +86,40 @@ BOOST_AUTO_TEST_CASE( test1 )
     BOOST_CHECK_THROW(testHex4("002G", 2), std::exception);
     BOOST_CHECK_THROW(testHex4("002.", 2), std::exception);
 }
+
+void testSkip(const std::string & str)
+{
+    Parse_Context context(str, str.c_str(), str.c_str() + str.size());
+    skipJson(context);
+    context.expect_eof();
+}
+
+BOOST_AUTO_TEST_CASE( test_skip_json )
+{
+    testSkip("null");
+    testSkip("true");
+    testSkip("false");
+    testSkip("-1.5e3");
+    testSkip("\"hello\"");
+    testSkip("\"esc\\\"aped \\u00e9 \\\\\"");
+    testSkip("[]");
+    testSkip("{}");
+    testSkip(" [ 1, \"two\", { \"three\" : [ 3 ] }, null ]");
+    testSkip("{ \"a\" : { \"b\" : [ true, false ] }, \"c\" : \"d\" }");
+
+    // Skipping must leave the context just after the value
+    std::string str = "{\"ext\":{\"x\":[1,2]},\"id\":\"abc\"}";
+    Parse_Context context(str, str.c_str(), str.c_str() + str.size());
+    context.expect_literal("{\"ext\":");
+    skipJson(context);
+    context.expect_literal(",\"id\":");
+    BOOST_CHECK_EQUAL(expectJsonStringAscii(context), "abc");
+
+    JML_TRACE_EXCEPTIONS(false);
+    BOOST_CHECK_THROW(testSkip(""), std::exception);
+    BOOST_CHECK_THROW(testSkip("\"unterminated"), std::exception);
+    BOOST_CHECK_THROW(testSkip("\"bad \\q escape\""), std::exception);
+    BOOST_CHECK_THROW(testSkip("[1, 2"), std::exception);
+    BOOST_CHECK_THROW(testSkip("{\"a\" 1}"), std::exception);
+    BOOST_CHECK_THROW(testSkip("nul"), std::exception);
+}
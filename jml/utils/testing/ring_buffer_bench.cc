@@ -0,0 +1,108 @@
+/* ring_buffer_bench.cc
+   Copyright (c) 2014 Datacratic.  All rights reserved.
+
+   Measures RingBufferSRMW under contention from a growing number of
+   writers.  A ring guarded by a spinlock that wakes the reader on every
+   push, like the previous implementation, serves as the baseline.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "jml/utils/ring_buffer.h"
+#include "jml/arch/timers.h"
+#include "jml/arch/format.h"
+#include <boost/test/unit_test.hpp>
+#include <iostream>
+#include <thread>
+
+using namespace ML;
+using namespace std;
+
+namespace {
+
+enum {
+    NumMessages = 4000000,
+    BufferSize = 4096
+};
+
+struct LockedRing {
+    LockedRing(size_t size)
+        : ring(size), readPosition(0), writePosition(0)
+    {
+    }
+
+    bool tryPush(int value)
+    {
+        std::unique_lock<Spinlock> guard(lock);
+        int next = (writePosition + 1) % ring.size();
+        if (next == readPosition)
+            return false;
+        ring[writePosition] = value;
+        writePosition = next;
+        futex_wake(writePosition);
+        return true;
+    }
+
+    bool tryPop(int & value)
+    {
+        if (readPosition == writePosition)
+            return false;
+        value = ring[readPosition];
+        readPosition = (readPosition + 1) % ring.size();
+        return true;
+    }
+
+    vector<int> ring;
+    volatile int readPosition;
+    volatile int writePosition;
+    Spinlock lock;
+};
+
+/** Returns the number of messages per second that went through the buffer
+    with numWriters spinning on tryPush and one reader spinning on tryPop.
+*/
+template<typename Buffer>
+double run(Buffer & buffer, int numWriters)
+{
+    int perWriter = NumMessages / numWriters;
+
+    auto writer = [&] () {
+        for (int i = 0;  i < perWriter;  ++i)
+            while (!buffer.tryPush(i)) ;
+    };
+
+    Timer timer;
+
+    vector<thread> writers;
+    for (int i = 0;  i < numWriters;  ++i)
+        writers.emplace_back(writer);
+
+    int value;
+    for (int i = 0;  i < perWriter * numWriters;  ++i)
+        while (!buffer.tryPop(value)) ;
+
+    double elapsed = timer.elapsed_wall();
+
+    for (auto & t: writers)
+        t.join();
+
+    return perWriter * numWriters / elapsed;
+}
+
+} // file scope
+
+BOOST_AUTO_TEST_CASE( ring_buffer_bench )
+{
+    for (int numWriters: { 1, 2, 4, 8, 16 }) {
+        LockedRing locked(BufferSize);
+        RingBufferSRMW<int> lockFree(BufferSize);
+
+        double lockedRate = run(locked, numWriters);
+        double lockFreeRate = run(lockFree, numWriters);
+
+        cerr << format("%2d writers: spinlock %12.0f/s  lock free %12.0f/s",
+                       numWriters, lockedRate, lockFreeRate)
+             << endl;
+    }
+}
@@ -0,0 +1,141 @@
+/* ring_buffer_test.cc
+   Copyright (c) 2014 Datacratic.  All rights reserved.
+
+   Test for the multiple writer, single reader ring buffer.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "jml/utils/ring_buffer.h"
+#include "jml/utils/testing/watchdog.h"
+#include "jml/arch/timers.h"
+#include <boost/test/unit_test.hpp>
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include "live_counting_obj.h"
+
+using namespace ML;
+using namespace std;
+
+BOOST_AUTO_TEST_CASE( test_srmw_basics )
+{
+    RingBufferSRMW<int> buf(5);
+
+    /* the size is rounded up to a power of two, all of which is usable */
+    BOOST_CHECK_EQUAL(buf.capacity(), 8);
+    BOOST_CHECK(!buf.couldPop());
+
+    for (int i = 0;  i < 8;  ++i)
+        BOOST_CHECK(buf.tryPush(i));
+    BOOST_CHECK(!buf.tryPush(8));
+    BOOST_CHECK(buf.couldPop());
+
+    int val;
+    BOOST_CHECK(buf.tryPop(val));
+    BOOST_CHECK_EQUAL(val, 0);
+    BOOST_CHECK(buf.tryPush(8));
+
+    auto vals = buf.tryPopMulti(3);
+    BOOST_CHECK_EQUAL(vals.size(), 3);
+    BOOST_CHECK_EQUAL(vals[0], 1);
+    BOOST_CHECK_EQUAL(vals[2], 3);
+
+    vals = buf.tryPopMulti(100);
+    BOOST_CHECK_EQUAL(vals.size(), 5);
+    BOOST_CHECK_EQUAL(vals.back(), 8);
+    BOOST_CHECK(!buf.tryPop(val));
+
+    /* nothing comes within the timeout */
+    Timer timer;
+    BOOST_CHECK(!buf.tryPop(val, 0.05));
+    BOOST_CHECK_GE(timer.elapsed_wall(), 0.04);
+
+    /* move keeps the contents */
+    buf.push(42);
+    RingBufferSRMW<int> moved(std::move(buf));
+    BOOST_CHECK_EQUAL(moved.capacity(), 8);
+    BOOST_CHECK_EQUAL(buf.capacity(), 0);
+    BOOST_CHECK_EQUAL(moved.pop(), 42);
+}
+
+BOOST_AUTO_TEST_CASE( test_srmw_move_only )
+{
+    RingBufferSRMW<unique_ptr<int> > buf(4);
+
+    unique_ptr<int> p(new int(1));
+    BOOST_CHECK(buf.tryPush(std::move(p)));
+    BOOST_CHECK(!p);
+    buf.push(unique_ptr<int>(new int(2)));
+    buf.push(unique_ptr<int>(new int(3)));
+    buf.push(unique_ptr<int>(new int(4)));
+
+    /* a failed push leaves the request alone */
+    p.reset(new int(5));
+    BOOST_CHECK(!buf.tryPush(std::move(p)));
+    BOOST_REQUIRE(p);
+    BOOST_CHECK_EQUAL(*p, 5);
+
+    BOOST_CHECK_EQUAL(*buf.pop(), 1);
+    BOOST_CHECK(buf.tryPop(p));
+    BOOST_CHECK_EQUAL(*p, 2);
+}
+
+BOOST_AUTO_TEST_CASE( test_srmw_destroys_contents )
+{
+    constructed = destroyed = 0;
+
+    {
+        RingBufferSRMW<Obj> buf(16);
+        for (int i = 0;  i < 10;  ++i)
+            buf.push(Obj(i));
+        Obj obj;
+        buf.tryPop(obj);
+        BOOST_CHECK_EQUAL(obj.val, 0);
+    }
+
+    BOOST_CHECK_EQUAL(constructed, destroyed);
+}
+
+BOOST_AUTO_TEST_CASE( test_srmw_multiple_writers )
+{
+    enum { NumThreads = 8, NumPerThread = 200000 };
+
+    Watchdog watchdog(60.0);
+
+    /* small enough for the writers to block on a full buffer all the
+       time, and the reader sleeps when it catches up with them */
+    RingBufferSRMW<pair<int, int> > buf(64);
+
+    auto writer = [&] (int thread) {
+        for (int i = 0;  i < NumPerThread;  ++i)
+            buf.push(make_pair(thread, i));
+    };
+
+    vector<thread> writers;
+    for (int i = 0;  i < NumThreads;  ++i)
+        writers.emplace_back(writer, i);
+
+    vector<int> next(NumThreads, 0);
+    int numErrors = 0;
+    for (int i = 0;  i < NumThreads * NumPerThread;  ++i) {
+        pair<int, int> val;
+        if (i % 2)
+            val = buf.pop();
+        else if (!buf.tryPop(val, 10.0)) {
+            ++numErrors;
+            break;
+        }
+
+        /* each writer's requests come out in order */
+        if (val.second != next[val.first]++)
+            ++numErrors;
+    }
+
+    for (auto & t: writers)
+        t.join();
+
+    BOOST_CHECK_EQUAL(numErrors, 0);
+    BOOST_CHECK(!buf.couldPop());
+}
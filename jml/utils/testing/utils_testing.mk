@@ -1,6 +1,7 @@
 $(eval $(call test,parse_context_test,utils arch,boost))
 $(eval $(call test,configuration_test,utils arch,boost))
 $(eval $(call test,compact_vector_test,arch,boost))
+$(eval $(call test,arena_test,boost_thread,boost))
 $(eval $(call test,circular_buffer_test,arch,boost))
 $(eval $(call test,lightweight_hash_test,arch utils,boost))
 $(eval $(call test,string_functions_test,arch utils,boost))
@@ -12,3 +13,5 @@ $(eval $(call test,csv_parsing_test,arch utils,boost))
 
 $(eval $(call test,worker_task_test,worker_task ACE arch boost_thread pthread,boost))
 $(eval $(call test,json_parsing_test,utils arch,boost))
+$(eval $(call test,ring_buffer_test,arch boost_thread,boost))
+$(eval $(call test,ring_buffer_bench,arch,boost manual))
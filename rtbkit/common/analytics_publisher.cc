@@ -11,18 +11,60 @@
 #include "analytics_publisher.h"
 #include "soa/jsoncpp/value.h"
 #include "soa/jsoncpp/reader.h"
+#include "soa/logger/compressor.h"
 
 using namespace std;
 using namespace Datacratic;
 
+namespace {
+
+/// Events sent in a single request
+const size_t MaxEventsPerRequest = 1000;
+
+} // file scope
+
 /********************************************************************************/
 /* ANALYTICS PUBLISHER                                                          */
 /********************************************************************************/
 
+AnalyticsPublisher::
+AnalyticsPublisher()
+    : initialized(false),
+      live(false),
+      channelFilter(new ChannelFilter()),
+      maxPendingPerThread(4096),
+      numSent(0),
+      numFailed(0),
+      lastReportedDropped(0)
+{
+}
+
+AnalyticsPublisher::
+~AnalyticsPublisher()
+{
+    MessageLoop::shutdown();
+    delete channelFilter.load();
+}
+
 void
 AnalyticsPublisher::
-init(const string & baseUrl, const int numConnections)
+init(const string & baseUrl, const int numConnections,
+     const string & compression, size_t maxPendingPerThread,
+     double flushPeriod)
 {
+    // Fail early rather than on the first flush
+    std::unique_ptr<Compressor> check(Compressor::create(compression, 1));
+
+    // Compressor takes a few aliases but Content-Encoding needs the
+    // registered name of the coding.
+    if (compression == "gz")
+        this->compression = "gzip";
+    else if (compression == "none")
+        this->compression = "";
+    else this->compression = compression;
+    this->maxPendingPerThread = maxPendingPerThread ? maxPendingPerThread : 1;
+    gc.reset(new EpochGc());
+
     client = make_shared<HttpClient>(baseUrl, numConnections);
     client->sendExpect100Continue(false);
     addSource("analytics::client", client);
@@ -38,6 +80,11 @@ init(const string & baseUrl, const int numConnections)
     };
     addPeriodic("analytics::syncFilters", 10.0, syncFilters);
 
+    auto flushEvents = [&] (uint64_t wakeups) {
+        flush();
+    };
+    addPeriodic("analytics::flush", flushPeriod, flushEvents);
+
     initialized = true;
 }
 
@@ -52,14 +99,80 @@ void
 AnalyticsPublisher::
 shutdown()
 {
+    if (initialized)
+        flush();
     MessageLoop::shutdown();
 }
 
+AnalyticsPublisher::Buffer *
+AnalyticsPublisher::
+acquireBuffer()
+{
+    std::lock_guard<std::mutex> guard(buffersLock);
+
+    for (auto & buffer: buffers) {
+        bool free = false;
+        if (buffer->inUse.compare_exchange_strong(free, true))
+            return buffer.get();
+    }
+
+    buffers.emplace_back(new Buffer(maxPendingPerThread));
+    return buffers.back().get();
+}
+
 void
 AnalyticsPublisher::
-sendEvent(const string & channel, const string & event)
+enqueue(const string & channel, string && event)
 {
-    auto onResponse = [] (const HttpRequest & rq,
+    ThreadEntry & entry = *bufferInfo.get();
+    if (JML_UNLIKELY(!entry.buffer))
+        entry.buffer = acquireBuffer();
+
+    Buffer & buffer = *entry.buffer;
+    uint64_t tail = buffer.tail.load(std::memory_order_relaxed);
+    uint64_t head = buffer.head.load(std::memory_order_acquire);
+
+    if (tail - head >= buffer.events.size()) {
+        buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Event & slot = buffer.events[tail % buffer.events.size()];
+    slot.channel = channel;
+    slot.event = std::move(event);
+
+    buffer.tail.store(tail + 1, std::memory_order_release);
+}
+
+void
+AnalyticsPublisher::
+flush()
+{
+    std::lock_guard<std::mutex> flushGuard(flushLock);
+
+    vector<Event> events;
+    {
+        std::lock_guard<std::mutex> guard(buffersLock);
+        for (auto & buffer: buffers) {
+            uint64_t head = buffer->head.load(std::memory_order_relaxed);
+            uint64_t tail = buffer->tail.load(std::memory_order_acquire);
+            for (;  head != tail;  ++head)
+                events.emplace_back(std::move(buffer->events[head % buffer->events.size()]));
+            buffer->head.store(tail, std::memory_order_release);
+        }
+    }
+
+    for (size_t first = 0;  first < events.size();  first += MaxEventsPerRequest)
+        sendEvents(events, first, std::min(events.size(), first + MaxEventsPerRequest));
+}
+
+void
+AnalyticsPublisher::
+sendEvents(vector<Event> & events, size_t first, size_t last)
+{
+    uint64_t numEvents = last - first;
+
+    auto onResponse = [=] (const HttpRequest & rq,
             HttpClientError error,
             int status,
             string && headers,
@@ -68,14 +181,57 @@ sendEvent(const string & channel, const string & event)
         if (status != 200) {
             cout << "status: " << status << endl
                  << "error: " << error << endl;
+            numFailed += numEvents;
         }
+        else numSent += numEvents;
     };
-    string ressource("/v1/event");
+
+    Json::Value payload(Json::arrayValue);
+    for (size_t i = first;  i < last;  ++i) {
+        Json::Value & entry = payload[(int)(i - first)];
+        entry["channel"] = std::move(events[i].channel);
+        entry["event"] = std::move(events[i].event);
+    }
+
+    HttpRequest::Content content(payload);
+    RestParams headers;
+
+    if (!compression.empty()) {
+        std::unique_ptr<Compressor> compressor(Compressor::create(compression, 1));
+        string compressed;
+        auto onData = [&] (const char * data, size_t len) {
+            compressed.append(data, len);
+            return len;
+        };
+        compressor->compress(content.str.data(), content.str.size(), onData);
+        compressor->finish(onData);
+
+        content.str = std::move(compressed);
+        headers.push_back({ "Content-Encoding", compression });
+    }
+
+    string ressource("/v1/events");
     auto const & cbs = make_shared<HttpClientSimpleCallbacks>(onResponse);
-    Json::Value payload(Json::objectValue);
-    payload["channel"] = channel;
-    payload["event"] = event;
-    client->post(ressource, cbs, payload);
+    if (!client->post(ressource, cbs, content, RestParams(), headers))
+        numFailed += numEvents;
+}
+
+AnalyticsPublisher::Stats
+AnalyticsPublisher::
+stats() const
+{
+    Stats result;
+    result.queued = 0;
+    result.sent = numSent.load();
+    result.dropped = numFailed.load();
+
+    std::lock_guard<std::mutex> guard(buffersLock);
+    for (auto & buffer: buffers) {
+        result.queued += buffer->tail.load();
+        result.dropped += buffer->dropped.load();
+    }
+
+    return result;
 }
 
 void
@@ -99,6 +255,13 @@ checkHeartbeat()
     string ressource("/heartbeat");
     auto cbs = make_shared<HttpClientSimpleCallbacks>(onResponse);
     client->get(ressource, cbs);
+
+    uint64_t dropped = stats().dropped;
+    if (dropped != lastReportedDropped) {
+        cout << "analytics: dropped " << dropped - lastReportedDropped
+             << " events" << endl;
+        lastReportedDropped = dropped;
+    }
 }
 
 void
@@ -113,16 +276,22 @@ syncChannelFilters()
     {
         if (status != 200) return;
         Json::Value filters = Json::parse(body);
-        if (filters.isObject()) {
-            std::lock_guard<std::mutex> lock(mu);
-            for ( auto it = filters.begin(); it != filters.end(); ++it) {
-                channelFilter[it.memberName()] = (*it).asBool();
-            }
+        if (!filters.isObject()) return;
+
+        // Only the message loop replaces the filter so there's no race
+        // between reading the current one and swapping it.
+        const ChannelFilter * current = channelFilter.load();
+        std::unique_ptr<ChannelFilter> newFilter(new ChannelFilter(*current));
+        for ( auto it = filters.begin(); it != filters.end(); ++it) {
+            (*newFilter)[it.memberName()] = (*it).asBool();
         }
+        if (*newFilter == *current) return;
+
+        channelFilter.store(newFilter.release(), std::memory_order_release);
+        gc->deferDelete(current);
     };
     if (!live) return;
     string ressource("/v1/channels");
     auto cbs = make_shared<HttpClientSimpleCallbacks>(onResponse);
     client->get(ressource, cbs);
 }
-
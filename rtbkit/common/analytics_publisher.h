@@ -6,14 +6,22 @@
 */
 #pragma once
 
-#include <string>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <mutex>
 #include <sstream>
+#include <string>
+#include <type_traits>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "soa/service/message_loop.h"
 #include "soa/service/http_client.h"
 #include "soa/service/service_utils.h"
+#include "soa/gc/epoch_gc.h"
+#include "jml/arch/thread_specific.h"
 
 typedef std::unordered_map< std::string, bool > ChannelFilter;
 
@@ -21,54 +29,214 @@ typedef std::unordered_map< std::string, bool > ChannelFilter;
 /* ANALYTICS PUBLISHER                                                          */
 /********************************************************************************/
 
+/** Publishing an event only formats it and hands it to a buffer that belongs to
+    the calling thread; a periodic task of the message loop picks up what every
+    thread buffered and sends it to the endpoint, many events per request.
+
+    Each thread can have at most maxPendingPerThread events waiting to be sent.
+    Events published while its buffer is full are dropped and counted, as are
+    those of a request that fails.
+
+    The channel filter is an immutable map that is replaced as a whole when the
+    endpoint sends a different one, so publishing never takes a lock.
+*/
+
 struct AnalyticsPublisher : public Datacratic::MessageLoop {
 
-    AnalyticsPublisher() : initialized(false) {}
+    AnalyticsPublisher();
 
-    void init(const std::string & baseUrl, const int numConnections);
+    ~AnalyticsPublisher();
+
+    /** compression is "" or "none" for no compression, or "gzip" (which
+        can also be spelled "gz"); it's applied to the body of the requests
+        that carry the events.  Anything else throws.
+    */
+    void init(const std::string & baseUrl, const int numConnections,
+              const std::string & compression = "",
+              size_t maxPendingPerThread = 4096,
+              double flushPeriod = 0.1);
     bool initialized;
 
     void start();
 
+    /** Hands what's buffered to the client and stops; requests that are
+        still in flight at that point are lost.
+    */
     void shutdown();
 
     void syncChannelFilters();
 
+    /** Whether events published on channel will be sent.  Can be used to
+        avoid building the arguments of publish() for nothing.
+    */
+    bool isEnabled(const std::string & channel) const
+    {
+        if (!live.load(std::memory_order_relaxed)) return false;
+
+        Datacratic::EpochGc::SharedGuard guard(*gc, Datacratic::EpochGc::RD_NO);
+        const ChannelFilter * filter = channelFilter.load(std::memory_order_acquire);
+        auto it = filter->find(channel);
+        return it != filter->end() && it->second;
+    }
+
     template<typename... Args>
     void publish(const std::string & channel, const Args & ... args)
     {
-        if (!live) return;
-
-        std::lock_guard<std::mutex> lock(mu);
-        auto it = channelFilter.find(channel);
-        if (it == channelFilter.end() || !it->second) return;
+        if (!isEnabled(channel)) return;
+        publishEnabled(channel, args...);
+    }
 
-        std::stringstream ss;
-        make_message(ss, args...);
-        sendEvent(channel, ss.str());
+    /** Same as publish() for callers that have just checked that the
+        channel is enabled, so that it's not looked up a second time.
+    */
+    template<typename... Args>
+    void publishEnabled(const std::string & channel, const Args & ... args)
+    {
+        std::string event;
+        make_message(event, args...);
+        enqueue(channel, std::move(event));
     }
 
+    /** Send all of the buffered events.  Called periodically by the message
+        loop.
+    */
+    void flush();
+
+    struct Stats {
+        uint64_t queued;   ///< Accepted by publish()
+        uint64_t sent;     ///< Acknowledged by the endpoint
+        uint64_t dropped;  ///< Buffer was full or the request failed
+    };
+
+    Stats stats() const;
+
 private:
-    std::mutex mu;
+    struct Event {
+        std::string channel;
+        std::string event;
+    };
+
+    /** Events of a thread waiting to be sent.  Only the thread that owns
+        the buffer pushes and only the flusher pops, so it's a single producer
+        single consumer ring.  Buffers are reused once their thread exits.
+    */
+    struct Buffer {
+        Buffer(size_t capacity)
+            : events(capacity), head(0), tail(0), dropped(0), inUse(true)
+        {
+        }
+
+        std::vector<Event> events;
+        std::atomic<uint64_t> head;      ///< Next event to pop
+        std::atomic<uint64_t> tail;      ///< Next event to push
+        std::atomic<uint64_t> dropped;   ///< Events that didn't fit
+        std::atomic<bool> inUse;
+    };
+
+    struct ThreadEntry {
+        ThreadEntry() : buffer(nullptr) {}
+
+        ~ThreadEntry()
+        {
+            if (buffer)
+                buffer->inUse.store(false, std::memory_order_release);
+        }
+
+        Buffer * buffer;
+    };
+
+    typedef ML::ThreadSpecificInstanceInfo<ThreadEntry, AnalyticsPublisher>
+        BufferInfo;
+
     std::shared_ptr<Datacratic::HttpClient> client;
-    bool live;
-    ChannelFilter channelFilter;
+    std::atomic<bool> live;
+
+    std::unique_ptr<Datacratic::EpochGc> gc;
+    std::atomic<const ChannelFilter *> channelFilter;
+
+    std::string compression;
+    size_t maxPendingPerThread;
+
+    mutable std::mutex buffersLock;
+    std::vector<std::unique_ptr<Buffer> > buffers;
+
+    /// Destroyed before buffers so that the threads' entries let go first
+    BufferInfo bufferInfo;
+
+    /// Only one thread pops from the buffers at a time
+    std::mutex flushLock;
 
-    void sendEvent(const std::string & channel, const std::string & event);
+    std::atomic<uint64_t> numSent;
+    std::atomic<uint64_t> numFailed;
+    uint64_t lastReportedDropped;
+
+    void enqueue(const std::string & channel, std::string && event);
+
+    Buffer * acquireBuffer();
+
+    void sendEvents(std::vector<Event> & events, size_t first, size_t last);
 
     void checkHeartbeat();
 
+    static void append(std::string & out, const std::string & value)
+    {
+        out += value;
+    }
+
+    static void append(std::string & out, const char * value)
+    {
+        out += value;
+    }
+
+    static void append(std::string & out, char value)
+    {
+        out += value;
+    }
+
+    /** Numbers are written the way an ostream would write them. */
+    template<typename T>
+    static void append(std::string & out, const T & value)
+    {
+        appendValue(out, value, std::is_integral<T>(), std::is_floating_point<T>());
+    }
+
+    template<typename T>
+    static void appendValue(std::string & out, const T & value,
+                            std::true_type, std::false_type)
+    {
+        out += std::to_string(value);
+    }
+
+    template<typename T>
+    static void appendValue(std::string & out, const T & value,
+                            std::false_type, std::true_type)
+    {
+        char buf[32];
+        int len = snprintf(buf, sizeof(buf), "%g", (double)value);
+        out.append(buf, len);
+    }
+
+    template<typename T>
+    static void appendValue(std::string & out, const T & value,
+                            std::false_type, std::false_type)
+    {
+        std::ostringstream stream;
+        stream << value;
+        out += stream.str();
+    }
+
     template<typename Head>
-    void make_message(std::stringstream & ss, const Head & head)
+    static void make_message(std::string & out, const Head & head)
     {
-        ss << head;
+        append(out, head);
     }
 
     template<typename Head, typename... Tail>
-    void make_message(std::stringstream & ss, const Head & head, const Tail & ... tail)
+    static void make_message(std::string & out, const Head & head, const Tail & ... tail)
     {
-        ss << head << " ";
-        make_message(ss, tail...);
+        append(out, head);
+        out += ' ';
+        make_message(out, tail...);
     }
 
 };
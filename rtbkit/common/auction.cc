@@ -218,7 +218,7 @@ createDescription(AuctionResponseDescription & d) {
 
 Auction::
 Auction()
-    : isZombie(false), exchangeConnector(nullptr), data(new Data())
+    : isZombie(false), exchangeConnector(nullptr), data(newData())
 {
 }
 
@@ -236,7 +236,7 @@ Auction(ExchangeConnector * exchangeConnector,
       requestStrFormat(requestStrFormat),
       exchangeConnector(exchangeConnector),
       handleAuction(handleAuction),
-      data(new Data(numSpots()))
+      data(newData(numSpots()))
 {
     ML::atomic_add(created, 1);
 
@@ -251,7 +251,7 @@ Auction::
     Data * d = data;
     while (d) {
         Data * d2 = d->oldData;
-        delete d;
+        DestroyData()(d);
         d = d2;
     }
 
@@ -295,21 +295,21 @@ setResponse(int spotNum, Response newResponse)
 
     WinLoss result;
 
-    auto_ptr<Data> newData(new Data());
+    DataPtr updated(newData());
 
     for (;;) {
         if (current->tooLate)
             return WinLoss::TOOLATE;
         
-        *newData = *current;
+        *updated = *current;
 
         bool hasExisting = current->hasValidResponse(spotNum);
 
         result = newResponse.localStatus = WinLoss::PENDING;
-        newData->responses[spotNum].push_back(newResponse);
+        updated->responses[spotNum].push_back(newResponse);
 
         if (hasExisting) {
-            auto & spot = newData->responses[spotNum];
+            auto & spot = updated->responses[spotNum];
             
             // Filter on priority first.
             if (newResponse.price.priority >
@@ -330,10 +330,10 @@ setResponse(int spotNum, Response newResponse)
             spot.back().localStatus = WinLoss::LOSS;
         }
 
-        newData->oldData = current;
+        updated->oldData = current;
 
-        if (!ML::cmp_xchg(this->data, current, newData.get())) continue;
-        newData.release();
+        if (!ML::cmp_xchg(this->data, current, updated.get())) continue;
+        updated.release();
         return result;
     }
 }
@@ -353,7 +353,7 @@ addDataSources(const std::set<std::string> & sources)
     if (sources.empty()) return;
 
     Data * current = this->data;
-    unique_ptr<Data> newData(new Data);
+    DataPtr updated;
 
     for (;;) {
 
@@ -363,12 +363,12 @@ addDataSources(const std::set<std::string> & sources)
         // Nothing new was added, just bail.
         if (newSources.size() == current->dataSources.size()) return;
 
-        if (!newData) newData.reset(new Data);
-        *newData = *current;
-        std::swap(newData->dataSources, newSources);
+        if (!updated) updated.reset(newData());
+        *updated = *current;
+        std::swap(updated->dataSources, newSources);
 
-        if (!ML::cmp_xchg(this->data, current, newData.get())) continue;
-        newData.release();
+        if (!ML::cmp_xchg(this->data, current, updated.get())) continue;
+        updated.release();
         return;
     }
 }
@@ -386,23 +386,29 @@ Auction::
 finish()
 {
     Data * current = this->data;
+    if (current->tooLate)
+        return false;
+
+    // Allocated once: the arena never reclaims, so a failed exchange
+    // reuses this copy rather than carving out a new one.
+    DataPtr updated(newData());
 
     for (;;) {
         if (current->tooLate)
             return false;
 
-        auto_ptr<Data> newData(new Data(*current));
+        *updated = *current;
 
         for (unsigned spotNum = 0;  spotNum < numSpots(); ++spotNum) {
-            if (newData->hasValidResponse(spotNum))
-                newData->responses[spotNum][0].localStatus = WinLoss::WIN;
+            if (updated->hasValidResponse(spotNum))
+                updated->responses[spotNum][0].localStatus = WinLoss::WIN;
         }
         
-        newData->oldData = current;
-        newData->tooLate = true;
+        updated->oldData = current;
+        updated->tooLate = true;
 
-        if (!ML::cmp_xchg(this->data, current, newData.get())) continue;
-        newData.release();
+        if (!ML::cmp_xchg(this->data, current, updated.get())) continue;
+        updated.release();
         break;
     }
 
@@ -416,26 +422,30 @@ Auction::
 setError(const std::string & error, const std::string & details)
 {
     Data * current = this->data;
+    if (current->tooLate)
+        return false;
+
+    DataPtr updated(newData());
 
     for (;;) {
         if (current->tooLate)
             return false;
 
-        auto_ptr<Data> newData(new Data(*current));
+        *updated = *current;
         
-        newData->error = error;
-        newData->details = details;
+        updated->error = error;
+        updated->details = details;
 
         for (unsigned spotNum = 0;  spotNum < numSpots();  ++spotNum) {
-            if (newData->hasValidResponse(spotNum)) {
-                newData->responses[spotNum][0].localStatus = WinLoss::LOSS;
+            if (updated->hasValidResponse(spotNum)) {
+                updated->responses[spotNum][0].localStatus = WinLoss::LOSS;
             }
         }
-        newData->oldData = current;
-        newData->tooLate = true;
+        updated->oldData = current;
+        updated->tooLate = true;
 
-        if (!ML::cmp_xchg(this->data, current, newData.get())) continue;
-        newData.release();
+        if (!ML::cmp_xchg(this->data, current, updated.get())) continue;
+        updated.release();
         break;
     }
 
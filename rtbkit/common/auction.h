@@ -21,6 +21,7 @@
 #include "jml/arch/atomic_ops.h"
 #include "jml/arch/exception.h"
 #include "jml/utils/compact_vector.h"
+#include "jml/utils/arena.h"
 #include "jml/db/persistent_fwd.h"
 
 namespace RTBKIT {
@@ -297,6 +298,28 @@ struct Auction : public std::enable_shared_from_this<Auction> {
     }
 
 private:
+    /** Every modification of the auction publishes a new copy of Data and
+        keeps the old ones around until the auction dies.  They are carved
+        out of an arena embedded in the auction so that the usual handful
+        of versions costs no heap allocation at all.
+    */
+    ML::Arena<1024> dataArena;
+
+    struct DestroyData {
+        void operator () (Data * data) const
+        {
+            ML::Arena<1024>::destroy(data);
+        }
+    };
+
+    typedef std::unique_ptr<Data, DestroyData> DataPtr;
+
+    template<typename... Args>
+    Data * newData(Args &&... args)
+    {
+        return dataArena.create<Data>(std::forward<Args>(args)...);
+    }
+
     Data * data;
 
 public:
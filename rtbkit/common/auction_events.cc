@@ -7,6 +7,7 @@
 
 #include <ostream>
 #include <string>
+#include <sstream>
 
 #include "jml/utils/pair_utils.h"
 
@@ -71,6 +72,46 @@ SubmittedAuctionEventDescription() {
     addField("bidRequestStrFormat", &SubmittedAuctionEvent::bidRequestStrFormat, "");
 }
 
+std::string
+RTBKIT::
+serializeAuctionBatch(
+        const std::vector<std::shared_ptr<SubmittedAuctionEvent> > & events)
+{
+    std::ostringstream stream;
+    ML::DB::Store_Writer store(stream);
+
+    store << (unsigned char)0 << ML::DB::compact_size_t(events.size());
+    for (auto & event: events)
+        event->serialize(store);
+
+    return stream.str();
+}
+
+std::vector<std::shared_ptr<SubmittedAuctionEvent> >
+RTBKIT::
+reconstituteAuctionBatch(const char * data, size_t size)
+{
+    ML::DB::Store_Reader store(data, size);
+
+    unsigned char version;
+    store >> version;
+    if (version != 0)
+        throw ML::Exception("unknown SubmittedAuctionEvent batch version %d",
+                            (int)version);
+
+    ML::DB::compact_size_t count(store);
+
+    std::vector<std::shared_ptr<SubmittedAuctionEvent> > result;
+    result.reserve(count);
+    for (size_t i = 0;  i < count;  ++i) {
+        auto event = std::make_shared<SubmittedAuctionEvent>();
+        event->reconstitute(store);
+        result.push_back(std::move(event));
+    }
+
+    return result;
+}
+
 /*****************************************************************************/
 /* POST AUCTION EVENT TYPE                                                   */
 /*****************************************************************************/
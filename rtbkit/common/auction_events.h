@@ -54,6 +54,22 @@ private:
 
 CREATE_STRUCTURE_DESCRIPTION(SubmittedAuctionEvent)
 
+/** Binary encoding of several submitted auctions in a single message, used
+    for the AUCTIONS message from the router to the post auction service.
+    The batch carries its own version byte; each event inside it keeps the
+    versioned encoding of SubmittedAuctionEvent::serialize().
+*/
+std::string
+serializeAuctionBatch(
+        const std::vector<std::shared_ptr<SubmittedAuctionEvent> > & events);
+
+/** Decodes a batch written by serializeAuctionBatch().  Reads directly from
+    the given buffer instead of copying it into a stream first.
+*/
+std::vector<std::shared_ptr<SubmittedAuctionEvent> >
+reconstituteAuctionBatch(const char * data, size_t size);
+
+
 /*****************************************************************************/
 /* POST AUCTION EVENT TYPE                                                   */
 /*****************************************************************************/
@@ -15,6 +15,7 @@
 #include "jml/db/persistent.h"
 #include "rtbkit/openrtb/openrtb_parsing.h"
 #include "soa/types/json_printing.h"
+#include "soa/jsoncpp/writer.h"
 #include "soa/service/json_codec.h"
 
 
@@ -791,7 +792,20 @@ std::string
 UserIds::
 toJsonStr() const
 {
-    return boost::trim_copy(toJson().toString());
+    // Written out directly as this is done for every win and loss.  A
+    // std::map iterates in the same order as FastWriter sorts members in, so
+    // the output is the same as going through toJson().
+    if (empty()) return "null";
+
+    std::string result = "{";
+    for (auto it = begin(), end = this->end();  it != end;  ++it) {
+        if (it != begin()) result += ',';
+        result += Json::valueToQuotedString(it->first.c_str());
+        result += ':';
+        result += Json::valueToQuotedString(it->second.toString().c_str());
+    }
+    result += '}';
+    return result;
 }
 
 Json::Value
@@ -977,7 +991,7 @@ toJsonStr() const
 {
     static const DefaultDescription<BidRequest> BidRequestDesc;
     
-    std::ostringstream stream;
+    JsonPrintingBuffer stream;
     StreamJsonPrintingContext context(stream);
     BidRequestDesc.printJson(this, context);
     return stream.str();
@@ -1155,7 +1169,7 @@ parse(const std::string & source, const std::string & bidRequest)
     {
         return CanonicalParser::parse(bidRequest);
     }
-    Parser parser = PluginInterface<BidRequest>::getPlugin(source);
+    const Parser & parser = PluginInterface<BidRequest>::getPlugin(source);
 
     //cerr << "got parser for source " << source << endl;
 
@@ -1290,5 +1304,179 @@ reconstitute(ML::DB::Store_Reader & store)
           >> restrictions >> segments >> meta >> winSurcharges;
 }
 
+namespace {
+
+const std::pair<const char *, uint32_t> fieldNames[] = {
+    { "imp", BRF_IMP },
+    { "location", BRF_LOCATION },
+    { "userAgent", BRF_USER_AGENT },
+    { "url", BRF_URL },
+    { "userIds", BRF_USER_IDS },
+    { "segments", BRF_SEGMENTS },
+    { "meta", BRF_META },
+    { "openrtb", BRF_OPENRTB }
+};
+
+template<typename T>
+void serializeOptional(ML::DB::Store_Writer & store,
+                       const OpenRTB::Optional<T> & val)
+{
+    bool present = val.get();
+    store << present;
+    if (present)
+        store << jsonEncodeStr(*val);
+}
+
+template<typename T>
+void reconstituteOptional(ML::DB::Store_Reader & store,
+                          OpenRTB::Optional<T> & val)
+{
+    bool present;
+    store >> present;
+    if (!present) {
+        val.reset();
+        return;
+    }
+
+    string s;
+    store >> s;
+    val.reset(new T(jsonDecodeStr<T>(s)));
+}
+
+} // file scope
+
+uint32_t
+parseBidRequestFields(const std::string & names)
+{
+    if (names.empty())
+        return BRF_ALL;
+
+    uint32_t result = 0;
+
+    vector<string> split;
+    boost::split(split, names, boost::is_any_of(","));
+
+    for (auto & name: split) {
+        boost::trim(name);
+        if (name == "all") {
+            result |= BRF_ALL;
+            continue;
+        }
+
+        auto it = std::find_if(std::begin(fieldNames), std::end(fieldNames),
+                               [&] (const std::pair<const char *, uint32_t> & f)
+                               {
+                                   return name == f.first;
+                               });
+        if (it == std::end(fieldNames))
+            throw ML::Exception("unknown bid request field group '%s'",
+                                name.c_str());
+        result |= it->second;
+    }
+
+    return result;
+}
+
+std::string
+printBidRequestFields(uint32_t fields)
+{
+    if ((fields & BRF_ALL) == BRF_ALL)
+        return "all";
+
+    string result;
+    for (auto & f: fieldNames) {
+        if (!(fields & f.second))
+            continue;
+        if (!result.empty())
+            result += ",";
+        result += f.first;
+    }
+    return result;
+}
+
+void
+BidRequest::
+serializeFields(ML::DB::Store_Writer & store, uint32_t fields) const
+{
+    using namespace ML::DB;
+
+    unsigned char version = 1;
+    store << version << compact_size_t(fields & BRF_ALL)
+          << auctionId << auctionType.val << timeAvailableMs << timestamp
+          << isTest << protocolVersion << exchange << provider;
+
+    if (fields & BRF_IMP)
+        store << imp;
+    if (fields & BRF_LOCATION)
+        store << location << ipAddress;
+    if (fields & BRF_USER_AGENT)
+        store << userAgent << language << userAgentIPHash;
+    if (fields & BRF_URL)
+        store << url;
+    if (fields & BRF_USER_IDS)
+        store << userIds;
+    if (fields & BRF_SEGMENTS)
+        store << segments << restrictions;
+    if (fields & BRF_META)
+        store << meta << winSurcharges;
+    if (fields & BRF_OPENRTB) {
+        serializeOptional(store, site);
+        serializeOptional(store, app);
+        serializeOptional(store, device);
+        serializeOptional(store, user);
+        serializeOptional(store, regs);
+        store << ext << unparseable << jsonEncodeStr(bidCurrency)
+              << jsonEncodeStr(blockedCategories) << badv;
+    }
+}
+
+void
+BidRequest::
+reconstituteFields(ML::DB::Store_Reader & store)
+{
+    using namespace ML::DB;
+
+    unsigned char version;
+    store >> version;
+
+    if (version != 1)
+        throw ML::Exception("problem reconstituting BidRequest fields: "
+                            "invalid version");
+
+    *this = BidRequest();
+
+    uint32_t fields = compact_size_t(store);
+    store >> auctionId >> auctionType.val >> timeAvailableMs >> timestamp
+          >> isTest >> protocolVersion >> exchange >> provider;
+
+    if (fields & BRF_IMP)
+        store >> imp;
+    if (fields & BRF_LOCATION)
+        store >> location >> ipAddress;
+    if (fields & BRF_USER_AGENT)
+        store >> userAgent >> language >> userAgentIPHash;
+    if (fields & BRF_URL)
+        store >> url;
+    if (fields & BRF_USER_IDS)
+        store >> userIds;
+    if (fields & BRF_SEGMENTS)
+        store >> segments >> restrictions;
+    if (fields & BRF_META)
+        store >> meta >> winSurcharges;
+    if (fields & BRF_OPENRTB) {
+        reconstituteOptional(store, site);
+        reconstituteOptional(store, app);
+        reconstituteOptional(store, device);
+        reconstituteOptional(store, user);
+        reconstituteOptional(store, regs);
+
+        string currencies, categories;
+        store >> ext >> unparseable >> currencies >> categories >> badv;
+        bidCurrency = jsonDecodeStr<vector<CurrencyCode> >(currencies);
+        blockedCategories
+            = jsonDecodeStr<OpenRTB::List<OpenRTB::ContentCategory> >(categories);
+    }
+}
+
 } // namespace RTBKIT
 
@@ -262,6 +262,38 @@ IMPL_SERIALIZE_RECONSTITUTE(Location);
 
 using OpenRTB::AuctionType;
 
+
+/*****************************************************************************/
+/* BID REQUEST FIELDS                                                        */
+/*****************************************************************************/
+
+/** Groups of BidRequest fields that BidRequest::serializeFields() can write
+    on their own.  The auction id, auction type, timing, exchange, provider,
+    protocol version and test flag are always written.
+*/
+enum BidRequestFields {
+    BRF_IMP        = 1 << 0,  ///< imp
+    BRF_LOCATION   = 1 << 1,  ///< location and ipAddress
+    BRF_USER_AGENT = 1 << 2,  ///< userAgent, language and userAgentIPHash
+    BRF_URL        = 1 << 3,  ///< url
+    BRF_USER_IDS   = 1 << 4,  ///< userIds
+    BRF_SEGMENTS   = 1 << 5,  ///< segments and restrictions
+    BRF_META       = 1 << 6,  ///< meta and winSurcharges
+    BRF_OPENRTB    = 1 << 7,  ///< site, app, device, user, regs, ext,
+                              ///< bidCurrency, blockedCategories, badv
+                              ///< and unparseable
+    BRF_ALL        = (1 << 8) - 1
+};
+
+/** Parse a comma separated list of field group names, eg "userIds,segments".
+    The names are imp, location, userAgent, url, userIds, segments, meta,
+    openrtb and all.  An empty string means all of them.
+*/
+uint32_t parseBidRequestFields(const std::string & names);
+
+/** Inverse of parseBidRequestFields(). */
+std::string printBidRequestFields(uint32_t fields);
+
 /*****************************************************************************/
 /* BID REQUEST                                                               */
 /*****************************************************************************/
@@ -427,6 +459,14 @@ struct BidRequest {
 
     std::string serializeToString() const;
     static BidRequest createFromString(const std::string & str);
+
+    /** Binary encoding of the given groups of fields (a BidRequestFields
+        mask), which doesn't go through JSON except for the OpenRTB objects.
+        The mask is part of the encoding and reconstituteFields() leaves the
+        fields that weren't written at their defaults.
+    */
+    void serializeFields(ML::DB::Store_Writer & store, uint32_t fields) const;
+    void reconstituteFields(ML::DB::Store_Reader & store);
 };
 
 IMPL_SERIALIZE_RECONSTITUTE(BidRequest);
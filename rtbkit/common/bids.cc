@@ -10,6 +10,8 @@
 
 #include "jml/utils/exc_check.h"
 #include "jml/utils/json_parsing.h"
+#include "soa/jsoncpp/writer.h"
+#include "jml/db/persistent.h"
 
 using namespace std;
 using namespace ML;
@@ -224,10 +226,72 @@ toJson() const
     return json;
 }
 
+namespace {
+
+/** Appends the same text that toJson().toStringNoNewLine() would give for
+    the bid, without building the Json::Value.  FastWriter sorts the members
+    by name so they are written out in that order.
+*/
+void appendJson(std::string & out, const Bid & bid)
+{
+    if (bid.isNullBid()) {
+        out += "null";
+        return;
+    }
+
+    out += '{';
+    if (!bid.account.empty()) {
+        out += "\"account\":";
+        out += Json::valueToQuotedString(bid.account.toString().c_str());
+        out += ',';
+    }
+    out += "\"creative\":";
+    out += Json::valueToString(Json::Int(bid.creativeIndex));
+    out += ",\"ext\":";
+    if (bid.ext.isNull()) out += "null";
+    else out += bid.ext.toStringNoNewLine();
+    out += ",\"price\":";
+    out += Json::valueToQuotedString(bid.price.toString().c_str());
+    out += ",\"priority\":";
+    out += Json::valueToString(bid.priority);
+    out += ",\"spotIndex\":";
+    out += Json::valueToString(Json::Int(bid.spotIndex));
+    out += '}';
+}
+
+} // file scope
+
 std::string
 Bids::
-toJsonStr() const{
-    return toJson().toStringNoNewLine();
+toJsonStr() const
+{
+    // This is done for every bid that comes into the router so it skips the
+    // Json::Value tree; the output is unchanged from toJson().
+    std::string result;
+    result.reserve(128 * (size() + 1));
+
+    result += "{\"bids\":";
+    if (empty()) result += "null";
+    else {
+        result += '[';
+        for (unsigned i = 0;  i < size();  ++i) {
+            if (i != 0) result += ',';
+            appendJson(result, (*this)[i]);
+        }
+        result += ']';
+    }
+
+    if (!dataSources.empty()) {
+        result += ",\"sources\":[";
+        for (auto it = dataSources.begin();  it != dataSources.end();  ++it) {
+            if (it != dataSources.begin()) result += ',';
+            result += Json::valueToQuotedString(it->c_str());
+        }
+        result += ']';
+    }
+
+    result += '}';
+    return result;
 }
 
 Bids
@@ -278,6 +342,27 @@ fromJson(const std::string& raw)
     return result;
 }
 
+Bids
+Bids::
+reconstituteAvailable(ML::DB::Store_Reader & store)
+{
+    Bids result;
+
+    size_t numSpots = ML::DB::compact_size_t(store);
+    result.resize(numSpots);
+
+    for (Bid & bid : result) {
+        bid.spotIndex = ML::DB::compact_size_t(store);
+
+        size_t numCreatives = ML::DB::compact_size_t(store);
+        bid.availableCreatives.reserve(numCreatives);
+        for (size_t i = 0;  i < numCreatives;  ++i)
+            bid.availableCreatives.push_back(ML::DB::compact_size_t(store));
+    }
+
+    return result;
+}
+
 /******************************************************************************/
 /* BID RESULT                                                                 */
 /******************************************************************************/
@@ -115,6 +115,14 @@ struct Bids : public ML::compact_vector<Bid, 4>
     Json::Value toJson() const;
     std::string toJsonStr() const;
     static Bids fromJson(const std::string& raw);
+
+    /** Bids for the spots offered in a binary AUCTION message, with
+        spotIndex and availableCreatives filled in.  This is the binary
+        equivalent of the "imp" JSON array: a compact count of spots, then
+        for each the spot index, the number of creatives and the creative
+        indexes, all as compact sizes.
+    */
+    static Bids reconstituteAvailable(ML::DB::Store_Reader & store);
 };
 
 
@@ -0,0 +1,145 @@
+/** bitfield_ops.h                                 -*- C++ -*-
+    Copyright (c) 2013 Datacratic.  All rights reserved.
+
+    Bulk operations on arrays of 64 bit words used by ConfigSet.
+
+    The AVX2 kernels are only compiled in if the compiler targets AVX2
+    (-mavx2); otherwise we fall back on SSE2 which is always available on
+    x86-64. Popcount relies on the popcnt instruction which is enabled by the
+    -msse4.2 in our build flags.
+
+*/
+
+#pragma once
+
+#include "jml/arch/bitops.h"
+#include "jml/compiler/compiler.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#  include <immintrin.h>
+#elif defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
+
+namespace RTBKIT {
+namespace BitfieldOps {
+
+typedef uint64_t Word;
+
+
+/******************************************************************************/
+/* BINARY OPS                                                                 */
+/******************************************************************************/
+
+#if defined(__AVX2__)
+
+#define RTBKIT_BITFIELD_BINARY_OP(_name_, _op_, _simd_)                 \
+    JML_ALWAYS_INLINE void                                              \
+    _name_(Word* dst, const Word* src, size_t n)                        \
+    {                                                                   \
+        size_t i = 0;                                                   \
+        for (; i + 4 <= n; i += 4) {                                    \
+            __m256i a = _mm256_loadu_si256((const __m256i*) (dst + i)); \
+            __m256i b = _mm256_loadu_si256((const __m256i*) (src + i)); \
+            _mm256_storeu_si256((__m256i*) (dst + i), _simd_);          \
+        }                                                               \
+        for (; i < n; ++i) dst[i] = dst[i] _op_ src[i];                 \
+    }
+
+#define RTBKIT_BITFIELD_AND     _mm256_and_si256(a, b)
+#define RTBKIT_BITFIELD_OR      _mm256_or_si256(a, b)
+#define RTBKIT_BITFIELD_XOR     _mm256_xor_si256(a, b)
+#define RTBKIT_BITFIELD_ANDNOT  _mm256_andnot_si256(b, a)
+
+#elif defined(__SSE2__)
+
+#define RTBKIT_BITFIELD_BINARY_OP(_name_, _op_, _simd_)                 \
+    JML_ALWAYS_INLINE void                                              \
+    _name_(Word* dst, const Word* src, size_t n)                        \
+    {                                                                   \
+        size_t i = 0;                                                   \
+        for (; i + 2 <= n; i += 2) {                                    \
+            __m128i a = _mm_loadu_si128((const __m128i*) (dst + i));    \
+            __m128i b = _mm_loadu_si128((const __m128i*) (src + i));    \
+            _mm_storeu_si128((__m128i*) (dst + i), _simd_);             \
+        }                                                               \
+        for (; i < n; ++i) dst[i] = dst[i] _op_ src[i];                 \
+    }
+
+#define RTBKIT_BITFIELD_AND     _mm_and_si128(a, b)
+#define RTBKIT_BITFIELD_OR      _mm_or_si128(a, b)
+#define RTBKIT_BITFIELD_XOR     _mm_xor_si128(a, b)
+#define RTBKIT_BITFIELD_ANDNOT  _mm_andnot_si128(b, a)
+
+#else
+
+#define RTBKIT_BITFIELD_BINARY_OP(_name_, _op_, _simd_)                 \
+    JML_ALWAYS_INLINE void                                              \
+    _name_(Word* dst, const Word* src, size_t n)                        \
+    {                                                                   \
+        for (size_t i = 0; i < n; ++i) dst[i] = dst[i] _op_ src[i];     \
+    }
+
+#endif
+
+RTBKIT_BITFIELD_BINARY_OP(andWords,    &,  RTBKIT_BITFIELD_AND)
+RTBKIT_BITFIELD_BINARY_OP(orWords,     |,  RTBKIT_BITFIELD_OR)
+RTBKIT_BITFIELD_BINARY_OP(xorWords,    ^,  RTBKIT_BITFIELD_XOR)
+RTBKIT_BITFIELD_BINARY_OP(andNotWords, &~, RTBKIT_BITFIELD_ANDNOT)
+
+#undef RTBKIT_BITFIELD_BINARY_OP
+#undef RTBKIT_BITFIELD_AND
+#undef RTBKIT_BITFIELD_OR
+#undef RTBKIT_BITFIELD_XOR
+#undef RTBKIT_BITFIELD_ANDNOT
+
+
+/******************************************************************************/
+/* REDUCTIONS                                                                 */
+/******************************************************************************/
+
+JML_ALWAYS_INLINE size_t
+popcount(const Word* words, size_t n)
+{
+    // With popcnt available, a plain loop beats the pshufb based SIMD
+    // popcount for the handful of words that a ConfigSet usually holds.
+    size_t total = 0;
+    for (size_t i = 0; i < n; ++i)
+        total += ML::num_bits_set(words[i]);
+    return total;
+}
+
+// Returns true if any bit is set.
+JML_ALWAYS_INLINE bool
+any(const Word* words, size_t n)
+{
+    Word acc = 0;
+    for (size_t i = 0; i < n; ++i) acc |= words[i];
+    return acc;
+}
+
+// Returns true if any bit is set in both arrays.
+JML_ALWAYS_INLINE bool
+anyAnd(const Word* lhs, const Word* rhs, size_t n)
+{
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    for (; i + 4 <= n; i += 4) {
+        __m256i a = _mm256_loadu_si256((const __m256i*) (lhs + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*) (rhs + i));
+        if (!_mm256_testz_si256(a, b)) return true;
+    }
+#endif
+
+    for (; i < n; ++i)
+        if (lhs[i] & rhs[i]) return true;
+
+    return false;
+}
+
+} // namespace BitfieldOps
+} // namespace RTBKIT
@@ -8,7 +8,7 @@ LIBBIDREQUEST_SOURCES := \
 	expand_variable.cc 
 
 LIBBIDREQUEST_LINK := \
-	types boost_regex db openrtb value_description
+	types boost_regex db openrtb value_description gc
 
 $(eval $(call library,bid_request,$(LIBBIDREQUEST_SOURCES),$(LIBBIDREQUEST_LINK)))
 
@@ -27,7 +27,8 @@ LIBRTB_SOURCES := \
 	bid_request_pipeline.cc
 
 LIBRTB_LINK := \
-	ACE arch utils jsoncpp boost_thread endpoint boost_regex zmq opstats bid_request
+	ACE arch utils jsoncpp boost_thread endpoint boost_regex zmq opstats bid_request \
+	gc logger
 
 $(eval $(call library,rtb,$(LIBRTB_SOURCES),$(LIBRTB_LINK)))
 
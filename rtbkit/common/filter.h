@@ -8,15 +8,24 @@
 #pragma once
 
 #include "rtbkit/core/router/router_types.h"
+#include "rtbkit/common/bitfield_ops.h"
 #include "jml/utils/compact_vector.h"
 #include "jml/arch/bitops.h"
 
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <memory>
 #include <functional>
 
 
+// Number of 64 bit words of ConfigSet that are stored inline. Configs beyond
+// InlineWords * 64 are stored on the heap.
+#ifndef RTBKIT_CONFIG_SET_INLINE_WORDS
+#  define RTBKIT_CONFIG_SET_INLINE_WORDS 8
+#endif
+
+
 namespace RTBKIT {
 
 
@@ -38,6 +47,12 @@ struct AgentConfig;
     whether configs should be part of the set by default or not. In other words
     ConfigSet(true) indicades that all configs are part of the set by default.
 
+    The bitfield is stored inline for up to InlineWords * 64 configs so that
+    the many temporary sets created while filtering a bid request never hit
+    the allocator. Bigger sets spill to the heap. The inline capacity can be
+    tuned to the expected agent count through RTBKIT_CONFIG_SET_INLINE_WORDS.
+    Bulk operations use the SIMD kernels of bitfield_ops.h.
+
     Note that this class is easier reflects more a bitfield then it does a
     set. In other words, it uses bitfield nomenclature to manipulate the set.
  */
@@ -45,15 +60,66 @@ struct ConfigSet
 {
     typedef uint64_t Word;
     static constexpr size_t Div = sizeof(Word) * 8;
+    static constexpr size_t InlineWords = RTBKIT_CONFIG_SET_INLINE_WORDS;
 
     explicit ConfigSet(bool defaultValue = false) :
+        words(inlineWords),
+        numWords(0),
+        capacity(InlineWords),
         defaultValue(defaultValue ? ~Word(0) : 0)
     {}
 
+    ConfigSet(const ConfigSet& other) :
+        words(inlineWords),
+        numWords(0),
+        capacity(InlineWords),
+        defaultValue(other.defaultValue)
+    {
+        reserve(other.numWords);
+        std::copy(other.words, other.words + other.numWords, words);
+        numWords = other.numWords;
+    }
+
+    ConfigSet(ConfigSet&& other) :
+        words(inlineWords),
+        numWords(0),
+        capacity(InlineWords),
+        defaultValue(other.defaultValue)
+    {
+        steal(other);
+    }
+
+    ~ConfigSet()
+    {
+        if (words != inlineWords) release(words, capacity);
+    }
+
+    ConfigSet& operator= (const ConfigSet& other)
+    {
+        if (this == &other) return *this;
+
+        reserve(other.numWords);
+        std::copy(other.words, other.words + other.numWords, words);
+        numWords = other.numWords;
+        defaultValue = other.defaultValue;
+
+        return *this;
+    }
+
+    ConfigSet& operator= (ConfigSet&& other)
+    {
+        if (this == &other) return *this;
+
+        defaultValue = other.defaultValue;
+        steal(other);
+
+        return *this;
+    }
+
 
     size_t size() const
     {
-        return bitfield.size() * Div;
+        return numWords * Div;
     }
 
     // Expands the set to contain at least newSize configs and use the
@@ -61,15 +127,19 @@ struct ConfigSet
     void expand(size_t newSize)
     {
         if (newSize) newSize = (newSize - 1) / Div + 1; // ceilDiv(newSize, Div)
-        if (newSize <= bitfield.size()) return;
-        bitfield.resize(newSize, defaultValue);
+        if (newSize <= numWords) return;
+
+        if (newSize > capacity)
+            reserve(std::max<size_t>(newSize, capacity * 2));
+        std::fill(words + numWords, words + newSize, defaultValue);
+        numWords = newSize;
     }
 
 
     void set(size_t index)
     {
         expand(index + 1);
-        bitfield[index / Div] |= 1ULL << (index % Div);
+        words[index / Div] |= 1ULL << (index % Div);
     }
 
     void set(size_t index, bool value)
@@ -81,7 +151,7 @@ struct ConfigSet
     void reset(size_t index)
     {
         expand(index + 1);
-        bitfield[index / Div] &= ~(1ULL << (index % Div));
+        words[index / Div] &= ~(1ULL << (index % Div));
     }
 
     bool operator[] (size_t index) const { return test(index); }
@@ -89,48 +159,52 @@ struct ConfigSet
     bool test(size_t index) const
     {
         if (index >= size()) return defaultValue;
-        return bitfield[index / Div] & (1ULL << (index %Div));
+        return words[index / Div] & (1ULL << (index %Div));
     }
 
     size_t count() const
     {
-        size_t total = 0;
-
-        for (size_t i = 0; i < bitfield.size(); ++i) {
-            if (!bitfield[i]) continue;
-            total += ML::num_bits_set(bitfield[i]);
-        }
-
-        return total;
+        return BitfieldOps::popcount(words, numWords);
     }
 
     size_t empty() const
     {
-        if (bitfield.empty()) return !defaultValue;
+        if (!numWords) return !defaultValue;
+        return !BitfieldOps::any(words, numWords);
+    }
 
-        for (size_t i = 0; i < bitfield.size(); ++i) {
-            if (bitfield[i]) return false;
-        }
-        return true;
+    // Returns true if at least one config is part of both sets. Equivalent to
+    // !(*this & other).empty() but without the temporary.
+    bool intersects(const ConfigSet& other) const
+    {
+        size_t common = std::min(numWords, other.numWords);
+        if (BitfieldOps::anyAnd(words, other.words, common)) return true;
+
+        for (size_t i = common; i < numWords; ++i)
+            if (words[i] & other.defaultValue) return true;
+
+        for (size_t i = common; i < other.numWords; ++i)
+            if (other.words[i] & defaultValue) return true;
+
+        return defaultValue & other.defaultValue;
     }
 
-#define RTBKIT_CONFIG_SET_OP(_op_)                                      \
+#define RTBKIT_CONFIG_SET_OP(_op_, _kernel_)                            \
     ConfigSet& operator _op_ (const ConfigSet& other)                   \
     {                                                                   \
         expand(other.size());                                           \
                                                                         \
-        for (size_t i = 0; i < other.bitfield.size(); ++i)              \
-            bitfield[i] _op_ other.bitfield[i];                         \
+        BitfieldOps::_kernel_(words, other.words, other.numWords);      \
                                                                         \
-        for (size_t i = other.bitfield.size(); i < bitfield.size(); ++i) \
-            bitfield[i] _op_ other.defaultValue;                        \
+        for (size_t i = other.numWords; i < numWords; ++i)              \
+            words[i] _op_ other.defaultValue;                           \
                                                                         \
         return *this;                                                   \
     }
 
-    RTBKIT_CONFIG_SET_OP(&=)
-    RTBKIT_CONFIG_SET_OP(|=)
-    RTBKIT_CONFIG_SET_OP(^=)
+    RTBKIT_CONFIG_SET_OP(&=, andWords)
+    RTBKIT_CONFIG_SET_OP(|=, orWords)
+    RTBKIT_CONFIG_SET_OP(^=, xorWords)
 
 #undef RTBKIT_CONFIG_SET_OP
 
@@ -148,6 +222,19 @@ struct ConfigSet
 
 #undef RTBKIT_CONFIG_SET_OP_CONST
 
+    // Equivalent to *this &= other.negate() but without the temporary.
+    ConfigSet& andNot(const ConfigSet& other)
+    {
+        expand(other.size());
+
+        BitfieldOps::andNotWords(words, other.words, other.numWords);
+
+        for (size_t i = other.numWords; i < numWords; ++i)
+            words[i] &= ~other.defaultValue;
+
+        return *this;
+    }
+
 
     // The not(~) operator which doesn't have a analogue in set terminology.
     // There's a good reason why this isn't an operator overload but I can't
@@ -155,8 +242,8 @@ struct ConfigSet
     ConfigSet& negate()
     {
         defaultValue = ~defaultValue;
-        for (size_t i = 0; i < bitfield.size(); ++i)
-            bitfield[i] = ~bitfield[i];
+        for (size_t i = 0; i < numWords; ++i)
+            words[i] = ~words[i];
         return *this;
     }
 
@@ -180,8 +267,8 @@ struct ConfigSet
         size_t subIndex = start % Div;
         Word mask = -1ULL & ~((1ULL << subIndex) - 1);
 
-        for (size_t i = topIndex; i < bitfield.size(); ++i) {
-            Word value = bitfield[i] & mask;
+        for (size_t i = topIndex; i < numWords; ++i) {
+            Word value = words[i] & mask;
             mask = -1ULL;
 
             if (!value) continue;
@@ -196,15 +283,140 @@ struct ConfigSet
     {
         std::stringstream ss;
         ss << "{ " << std::hex;
-        for (Word w : bitfield) ss << w << " ";
+        for (size_t i = 0; i < numWords; ++i) ss << words[i] << " ";
         ss << "d:" << (defaultValue ? "1" : "0") << " ";
         ss << "}";
         return ss.str();
     }
 
 private:
-    ML::compact_vector<Word, 8> bitfield;
+
+    // Makes sure that there's room for n words. Existing words are preserved.
+    void reserve(size_t n)
+    {
+        if (n <= capacity) return;
+
+        size_t newCapacity = n;
+        Word* newWords = acquire(newCapacity);
+        std::copy(words, words + numWords, newWords);
+        if (words != inlineWords) release(words, capacity);
+
+        words = newWords;
+        capacity = newCapacity;
+    }
+
+    /** Heap buffers are recycled through a per-thread cache so that the
+        temporaries of sets bigger than the inline storage don't hit the
+        allocator either once the cache is warm. Buffers come in powers of two
+        words and each size keeps at most MaxCached of them.
+
+        The cache itself is plain thread local data which outlives every
+        destructor of its thread; a thread local reaper empties it when the
+        thread exits and closes it for the sets destroyed after that.
+     */
+    struct BufferCache
+    {
+        enum { NumSizes = 32, MaxCached = 64 };
+
+        Word* heads[NumSizes];
+        uint32_t sizes[NumSizes];
+        bool closed;
+
+        static Word*& next(Word* buffer)
+        {
+            return *reinterpret_cast<Word**>(buffer);
+        }
+    };
+
+    static BufferCache& bufferCache()
+    {
+        static __thread BufferCache cache;
+        return cache;
+    }
+
+    struct BufferCacheReaper
+    {
+        ~BufferCacheReaper()
+        {
+            BufferCache& cache = bufferCache();
+            cache.closed = true;
+
+            for (size_t i = 0; i < BufferCache::NumSizes; ++i) {
+                while (Word* buffer = cache.heads[i]) {
+                    cache.heads[i] = BufferCache::next(buffer);
+                    delete[] buffer;
+                }
+                cache.sizes[i] = 0;
+            }
+        }
+    };
+
+    // Index of the smallest power of two that holds n words.
+    static size_t sizeClass(size_t n)
+    {
+        return n <= 1 ? 0 : ML::highest_bit(uint64_t(n - 1)) + 1;
+    }
+
+    // Returns a buffer of at least n words and sets n to its actual size.
+    static Word* acquire(size_t& n)
+    {
+        size_t cls = sizeClass(n);
+        n = size_t(1) << cls;
+
+        BufferCache& cache = bufferCache();
+        if (Word* buffer = cache.heads[cls]) {
+            cache.heads[cls] = BufferCache::next(buffer);
+            cache.sizes[cls]--;
+            return buffer;
+        }
+
+        return new Word[n];
+    }
+
+    static void release(Word* buffer, size_t n)
+    {
+        size_t cls = sizeClass(n);
+
+        BufferCache& cache = bufferCache();
+        if (cache.closed || cache.sizes[cls] >= BufferCache::MaxCached) {
+            delete[] buffer;
+            return;
+        }
+
+        static thread_local BufferCacheReaper reaper;
+        (void) reaper;
+
+        BufferCache::next(buffer) = cache.heads[cls];
+        cache.heads[cls] = buffer;
+        cache.sizes[cls]++;
+    }
+
+    // Takes over the content of other, leaving it empty. defaultValue is left
+    // to the caller.
+    void steal(ConfigSet& other)
+    {
+        if (other.words == other.inlineWords) {
+            reserve(other.numWords);
+            std::copy(other.words, other.words + other.numWords, words);
+        }
+        else {
+            if (words != inlineWords) release(words, capacity);
+            words = other.words;
+            capacity = other.capacity;
+
+            other.words = other.inlineWords;
+            other.capacity = InlineWords;
+        }
+
+        numWords = other.numWords;
+        other.numWords = 0;
+    }
+
+    Word* words;
+    uint32_t numWords;
+    uint32_t capacity;
     Word defaultValue;
+    Word inlineWords[InlineWords];
 };
 
 
@@ -375,7 +587,8 @@ struct FilterState
             const ExchangeConnector* ex,
             const CreativeMatrix& activeConfigs) :
         request(br),
-        exchange(ex)
+        exchange(ex),
+        collectReasons_(true)
     {
         if (activeConfigs.size())
             configs_ = activeConfigs[0];
@@ -435,6 +648,11 @@ struct FilterState
 
     void resetFilterReasons();
 
+    // Filters should only fill in the reasons if they are collected; doing so
+    // allocates so the pool only asks for them when it records them.
+    bool collectFilterReasons() const { return collectReasons_; }
+    void collectFilterReasons(bool value) { collectReasons_ = value; }
+
 private:
     void updateConfigs()
     {
@@ -446,6 +664,7 @@ private:
     ConfigSet configs_;
     ML::compact_vector<CreativeMatrix, 8> creatives_;
     FilterReasons filterReasons_;
+    bool collectReasons_;
 };
 
 
@@ -33,6 +33,7 @@ struct PluginInterface
   static void registerPlugin(const std::string& name,
 			     typename T::Factory functor);
   static typename T::Factory& getPlugin(const std::string& name);
+  static typename T::Factory* findPlugin(const std::string& name);
   static std::vector<std::string> getNames();
 };
 
@@ -49,6 +50,12 @@ typename T::Factory& PluginInterface<T>::getPlugin(const std::string& name)
   return PluginTable<typename T::Factory>::instance().getPlugin(name, T::libNameSufix());
 }
 
+template<typename T>
+typename T::Factory* PluginInterface<T>::findPlugin(const std::string& name)
+{
+  return PluginTable<typename T::Factory>::instance().findPlugin(name);
+}
+
 template<typename T>
 std::vector<std::string> PluginInterface<T>::getNames()
 {
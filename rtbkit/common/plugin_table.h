@@ -10,6 +10,8 @@
 #include <boost/any.hpp>
 #include <typeinfo>
 #include <functional>
+#include <atomic>
+#include <memory>
 #include <mutex>
 #include <dlfcn.h>
 #include <iostream>
@@ -20,6 +22,16 @@
 
 namespace RTBKIT {
 
+/** Registered plugins are published as an immutable snapshot of the table
+    which registerPlugin() replaces as a whole, so looking a plugin up never
+    takes a lock.  Plugins are only registered at startup and when a library
+    is loaded so the replaced snapshots are simply kept until the table goes
+    away rather than tracking their readers.
+
+    The functors themselves are never moved or destroyed: the references that
+    getPlugin() returns stay valid and can be held on to instead of looking
+    the plugin up again.
+*/
 template<typename T>
 struct PluginTable
 {
@@ -37,6 +49,10 @@ public:
     //template <typename T>
     T& getPlugin(const std::string& name, const std::string& libSufix);
 
+    // same as getPlugin but only looks at what's already registered;
+    // returns nullptr instead of loading a library or throwing
+    T* findPlugin(const std::string& name) const;
+
     // returns a list of plugin names
     std::vector<std::string> getNames() const;
 
@@ -48,16 +64,32 @@ public:
 
 private:
  
+    typedef std::unordered_map<std::string, T*> Table;
+
     // data
     // -----
-    std::unordered_map<std::string, T> table;
+    std::atomic<const Table*> table;
+    std::vector<std::unique_ptr<const Table> > snapshots;
+    std::vector<std::unique_ptr<T> > functors;
 
-    // lock
+    // serializes the writers
     mutable std::mutex mu;
 
     // default constructor can only be accessed by the class itself
     // used by the static method instance
-    PluginTable(){};
+    PluginTable()
+    {
+        snapshots.emplace_back(new Table());
+        table.store(snapshots.back().get());
+    }
+
+    // returns the functor registered under plugName or nullptr
+    T* find(const std::string& plugName) const
+    {
+        const Table* current = table.load(std::memory_order_acquire);
+        auto iter = current->find(plugName);
+        return iter != current->end() ? iter->second : nullptr;
+    }
 
     // load library by calling dlopen
     void loadLib(const std::string& path);
@@ -75,12 +107,19 @@ PluginTable<T>::registerPlugin(const std::string& name, T& functor)
         throw ML::Exception("'name' parameter cannot be empty");
     }
 
-    // assemble the element
-    auto element = std::pair<std::string, T>(name, functor);
-
-    // lock and write
+    // lock and write; like an insert, the first registration wins
     std::lock_guard<std::mutex> guard(mu);
-    table.insert(element);
+
+    const Table* current = table.load(std::memory_order_relaxed);
+    if (current->count(name)) return;
+
+    functors.emplace_back(new T(functor));
+
+    std::unique_ptr<Table> next(new Table(*current));
+    next->insert(std::make_pair(name, functors.back().get()));
+
+    snapshots.emplace_back(std::move(next));
+    table.store(snapshots.back().get(), std::memory_order_release);
 }
 
  
@@ -97,6 +136,10 @@ PluginTable<T>::getPlugin(const std::string& name, const std::string& libSuffix)
         throw ML::Exception("'name' parameter cannot be empty");
     }
 
+    // the plugin is usually registered already
+    if (T* functor = findPlugin(name))
+        return *functor;
+
     string libPath, plugName;
     vector<string> libAndPlug = ML::split(name,'.');
 
@@ -112,14 +155,6 @@ PluginTable<T>::getPlugin(const std::string& name, const std::string& libSuffix)
         libPath = "lib" + name + "_" + libSuffix + ".so";
     }
 
-    // check if it already exists
-    {
-        std::lock_guard<std::mutex> guard(mu);
-        auto iter = table.find(plugName);
-        if(iter != table.end())
-            return iter->second;
-    }
-
     // since it was not found we have to try to load the library
     // loadlib calls opendl function which in its turn automatically
     // instantiates all global variables inside .so libraries.
@@ -128,26 +163,39 @@ PluginTable<T>::getPlugin(const std::string& name, const std::string& libSuffix)
     loadLib(libPath);
 
     // check if it is created
-    {
-        std::lock_guard<std::mutex> guard(mu);
-        auto iter = table.find(plugName);
-        if(iter != table.end())
-            return iter->second;
-    }
+    if (T* functor = find(plugName))
+        return *functor;
 
     // else: getting the functor fails
     throw ML::Exception("couldn't get requested plugin");
 }
 
+// get the functor from the name if it's registered
+template <typename T>
+T*
+PluginTable<T>::findPlugin(const std::string& name) const
+{
+    // accepts the same "library.plugin" form as getPlugin without splitting
+    // the name in the common case where there's no library
+    size_t dot = name.find('.');
+    if (dot == std::string::npos)
+        return find(name);
+
+    if (name.find('.', dot + 1) != std::string::npos)
+        return nullptr;
+
+    return find(name.substr(dot + 1));
+}
+
 // returns a vector representing all objects in the plugin
 template <typename T>
 std::vector<std::string> PluginTable<T>::getNames() const
 {
-    std::lock_guard<std::mutex> guard(mu);
+    const Table* current = table.load(std::memory_order_acquire);
 
     std::vector<std::string> list;
-    list.reserve(table.size());
-    for(const auto& ele: table){
+    list.reserve(current->size());
+    for(const auto& ele: *current){
         list.push_back(ele.first);
     }
 
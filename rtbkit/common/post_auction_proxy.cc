@@ -23,13 +23,15 @@ namespace RTBKIT {
 PostAuctionProxy::
 PostAuctionProxy(ServiceBase& parent) :
     parent(&parent),
-    proxies(parent.getServices())
+    proxies(parent.getServices()),
+    batchSize(1)
 {}
 
 PostAuctionProxy::
 PostAuctionProxy(std::shared_ptr<Datacratic::ServiceProxies> proxies) :
     parent(nullptr),
-    proxies(proxies)
+    proxies(proxies),
+    batchSize(1)
 {}
 
 void
@@ -47,6 +49,10 @@ initZMQ()
 {
     shards = proxies->params.get("postAuctionShards", 1).asInt();
 
+    batchSize = proxies->params.get("postAuctionBatchSize", 1).asInt();
+    batches.resize(shards);
+    for (auto & batch : batches) batch.reset(new Batch);
+
     zmq.reset(new Datacratic::ZmqMultipleNamedClientBusProxy);
     zmq->init(proxies->config);
     zmq->connectAllServiceProviders("rtbPostAuctionService", "events");
@@ -92,10 +98,52 @@ sendAuction(std::shared_ptr<SubmittedAuctionEvent> event)
     size_t shard = event->auctionId.hash() % shards;
 
     if (!zmq) http[shard]->forwardAuction(event);
-    else {
+    else if (batchSize <= 1) {
         string str = ML::DB::serializeToString(*event);
         (void) zmq->sendMessageToShard(shard, "AUCTION", move(str));
     }
+    else {
+        Events events;
+        {
+            Batch & batch = *batches[shard];
+            std::lock_guard<std::mutex> guard(batch.lock);
+
+            batch.events.push_back(std::move(event));
+            if (batch.events.size() < batchSize) return;
+            events.swap(batch.events);
+        }
+
+        sendBatch(shard, events);
+    }
+}
+
+void
+PostAuctionProxy::
+flush()
+{
+    if (!zmq || batchSize <= 1) return;
+
+    for (size_t shard = 0; shard < shards; ++shard) {
+        Events events;
+        {
+            Batch & batch = *batches[shard];
+            std::lock_guard<std::mutex> guard(batch.lock);
+            if (batch.events.empty()) continue;
+            events.swap(batch.events);
+        }
+
+        sendBatch(shard, events);
+    }
+}
+
+void
+PostAuctionProxy::
+sendBatch(size_t shard, const Events & events)
+{
+    // Serialization happens outside the batch lock so that other threads can
+    // keep adding to the next batch in the meantime.
+    string str = serializeAuctionBatch(events);
+    (void) zmq->sendMessageToShard(shard, "AUCTIONS", move(str));
 }
 
 void
@@ -9,6 +9,7 @@
 #pragma once
 
 #include "rtbkit/common/auction_events.h"
+#include <mutex>
 
 namespace Datacratic {
 
@@ -31,6 +32,15 @@ struct EventForwarder;
     Requires that the postAuctionShard configuration parameter be provided in
     the bootstrap.json to determine the number of active post auction shards. If
     not present, assumes that there's only one active post auction shard.
+
+    When postAuctionBatchSize is set in the bootstrap.json, submitted auctions
+    going over ZMQ are buffered per shard and sent as a single AUCTIONS message
+    once that many are pending or flush() is called, whichever comes first.
+    The owner is expected to call flush() regularly from its event loop.
+
+    sendAuction(), sendEvent() and flush() can be called from several threads
+    at once: each batch has its own lock and the ZMQ sends are serialized by
+    the client bus.
  */
 struct PostAuctionProxy
 {
@@ -45,6 +55,9 @@ struct PostAuctionProxy
     // Sends an auction to the post auction loop.
     void sendAuction(std::shared_ptr<SubmittedAuctionEvent> auction);
 
+    // Sends all the auctions that are waiting in a batch.
+    void flush();
+
     // Sends an event to the post auction loop.
     void sendEvent(std::shared_ptr<PostAuctionEvent> event);
 
@@ -52,12 +65,24 @@ private:
     void initZMQ();
     void initHTTP();
 
+    typedef std::vector< std::shared_ptr<SubmittedAuctionEvent> > Events;
+    void sendBatch(size_t shard, const Events & events);
+
     Datacratic::ServiceBase* parent;
     std::shared_ptr<Datacratic::ServiceProxies> proxies;
 
     size_t shards;
     std::unique_ptr<Datacratic::ZmqMultipleNamedClientBusProxy> zmq;
     std::vector< std::shared_ptr<EventForwarder> > http;
+
+    struct Batch
+    {
+        std::mutex lock;
+        Events events;
+    };
+
+    size_t batchSize;
+    std::vector< std::unique_ptr<Batch> > batches;
 };
 
 } // namespace RTBKIT
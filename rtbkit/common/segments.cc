@@ -13,8 +13,12 @@
 #include "jml/utils/exc_assert.h"
 #include "soa/types/value_description.h"
 #include "jml/db/persistent.h"
+#include "soa/gc/epoch_gc.h"
 #include <boost/make_shared.hpp>
 #include <boost/algorithm/string.hpp>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
 
 using namespace std;
 using namespace ML;
@@ -120,17 +124,131 @@ isDefaultTyped(const SegmentsBySource * val)
 namespace RTBKIT {
 
 
+/*****************************************************************************/
+/* SEGMENT DICTIONARY                                                        */
+/*****************************************************************************/
+
+namespace {
+
+typedef std::unordered_map<std::string, int> SegmentIds;
+
+struct Dictionary {
+    Dictionary() : ids(new SegmentIds())
+    {
+    }
+
+    EpochGc gc;
+    std::atomic<const SegmentIds *> ids;
+
+    /// Only one thread copies the table at a time
+    std::mutex internLock;
+};
+
+Dictionary & dictionary()
+{
+    // Never destroyed since bid requests can be parsed by threads that
+    // outlive the static destructors.
+    static Dictionary * dict = new Dictionary();
+    return *dict;
+}
+
+} // file scope
+
+std::vector<int>
+SegmentDictionary::
+intern(const std::vector<std::string> & segments)
+{
+    std::vector<int> result(segments.size(), NoId);
+
+    ML::compact_vector<int, 7> ids;
+    find(segments, ids);
+
+    bool complete = true;
+    for (unsigned i = 0;  i < segments.size();  ++i) {
+        result[i] = ids[i];
+        if (ids[i] == NoId) complete = false;
+    }
+    if (complete) return result;
+
+    Dictionary & dict = dictionary();
+    std::lock_guard<std::mutex> guard(dict.internLock);
+
+    const SegmentIds * current = dict.ids.load(std::memory_order_acquire);
+    std::unique_ptr<SegmentIds> next(new SegmentIds(*current));
+
+    for (unsigned i = 0;  i < segments.size();  ++i) {
+        if (result[i] != NoId) continue;
+        int id = next->size();
+        result[i] = next->insert(make_pair(segments[i], id)).first->second;
+    }
+
+    dict.ids.store(next.release(), std::memory_order_release);
+    dict.gc.deferDelete(current);
+
+    return result;
+}
+
+int
+SegmentDictionary::
+intern(const std::string & segment)
+{
+    return intern(std::vector<std::string>(1, segment)).front();
+}
+
+int
+SegmentDictionary::
+find(const std::string & segment)
+{
+    Dictionary & dict = dictionary();
+    EpochGc::SharedGuard guard(dict.gc, EpochGc::RD_NO);
+
+    const SegmentIds * ids = dict.ids.load(std::memory_order_acquire);
+    auto it = ids->find(segment);
+    return it == ids->end() ? NoId : it->second;
+}
+
+unsigned
+SegmentDictionary::
+find(const std::vector<std::string> & segments,
+     ML::compact_vector<int, 7> & result)
+{
+    Dictionary & dict = dictionary();
+    EpochGc::SharedGuard guard(dict.gc, EpochGc::RD_NO);
+
+    const SegmentIds * ids = dict.ids.load(std::memory_order_acquire);
+
+    result.resize(segments.size());
+    for (unsigned i = 0;  i < segments.size();  ++i) {
+        auto it = ids->find(segments[i]);
+        result[i] = it == ids->end() ? NoId : it->second;
+    }
+
+    return ids->size();
+}
+
+unsigned
+SegmentDictionary::
+size()
+{
+    Dictionary & dict = dictionary();
+    EpochGc::SharedGuard guard(dict.gc, EpochGc::RD_NO);
+    return dict.ids.load(std::memory_order_acquire)->size();
+}
+
+
 /*****************************************************************************/
 /* SEGMENTS                                                                  */
 /*****************************************************************************/
 
 SegmentList::
 SegmentList()
+    : dictionarySize(0)
 {
 }
 
 SegmentList::
 SegmentList(const std::vector<string> & segs)
+    : dictionarySize(0)
 {
     for (unsigned i = 0;  i < segs.size();  ++i)
         add(segs[i]);
@@ -139,13 +257,14 @@ SegmentList(const std::vector<string> & segs)
 
 SegmentList::
 SegmentList(const std::vector<int> & segs)
-    : ints(segs.begin(), segs.end())
+    : ints(segs.begin(), segs.end()), dictionarySize(0)
 {
     sort();
 }
 
 SegmentList::
 SegmentList(const std::vector<std::pair<int, float> > & segs)
+    : dictionarySize(0)
 {
     for (unsigned i = 0;  i < segs.size();  ++i)
         add(segs[i].first, segs[i].second);
@@ -424,6 +543,8 @@ sort()
             weights[i + ints.size()] = ssorted[i].second;
         }
     }
+
+    dictionarySize = SegmentDictionary::find(strings, stringIds);
 }
 
 void
@@ -443,6 +564,7 @@ reconstitute(ML::DB::Store_Reader & store)
     if (version > 0)
         throw ML::Exception("unknown SegmentList version");
     store >> ints >> strings >> weights;
+    dictionarySize = SegmentDictionary::find(strings, stringIds);
 }
 
 std::string
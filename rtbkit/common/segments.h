@@ -11,6 +11,8 @@
 #include "soa/types/value_description_fwd.h"
 #include <boost/shared_ptr.hpp>
 #include <map>
+#include <string>
+#include <vector>
 
 
 namespace RTBKIT {
@@ -23,6 +25,48 @@ enum SegmentResult {
     SEG_MISSING        ///< Segment is missing
 };
 
+/*****************************************************************************/
+/* SEGMENT DICTIONARY                                                        */
+/*****************************************************************************/
+
+/** Process wide mapping of string segments to dense integer ids so that the
+    filters can match them without hashing or comparing strings.
+
+    Ids are handed out by intern() when agent configurations are loaded and
+    are never taken back.  Bid requests only look their segments up with
+    find(); a segment that no configuration ever mentioned has no id and
+    can't match anything.
+
+    The table is an immutable snapshot that intern() replaces as a whole so
+    lookups never take a lock.
+*/
+
+struct SegmentDictionary {
+    enum { NoId = -1 };
+
+    /** Returns the id of each of segments, giving one to those that don't
+        have one yet.
+    */
+    static std::vector<int> intern(const std::vector<std::string> & segments);
+    static int intern(const std::string & segment);
+
+    /** Returns the id of segment or NoId. */
+    static int find(const std::string & segment);
+
+    /** Writes the id of each of segments, or NoId, to ids and returns the
+        number of ids that had been handed out at that point.
+    */
+    static unsigned find(const std::vector<std::string> & segments,
+                         ML::compact_vector<int, 7> & ids);
+
+    /** Number of ids handed out so far.  Since ids are never taken back, a
+        lookup made when the dictionary had this size is only stale for the
+        segments that had no id.
+    */
+    static unsigned size();
+};
+
+
 /*****************************************************************************/
 /* SEGMENTS                                                                  */
 /*****************************************************************************/
@@ -74,10 +118,36 @@ struct SegmentList {
     void forEach(const std::function<void (int, std::string, float)> & onSegment)
         const;
 
+    /** Calls onId with the SegmentDictionary id of each string that has one.
+        The ids are resolved by sort() and only looked up again if the
+        dictionary grew since then.
+    */
+    template<typename Fn>
+    void forEachStringId(const Fn & onId) const
+    {
+        bool resolved = stringIds.size() == strings.size();
+        if (resolved && dictionarySize == SegmentDictionary::size()) {
+            for (int id: stringIds)
+                if (id != SegmentDictionary::NoId) onId(id);
+            return;
+        }
+
+        for (unsigned i = 0;  i < strings.size();  ++i) {
+            int id = resolved ? stringIds[i] : SegmentDictionary::NoId;
+            if (id == SegmentDictionary::NoId)
+                id = SegmentDictionary::find(strings[i]);
+            if (id != SegmentDictionary::NoId) onId(id);
+        }
+    }
+
     //private:    
     ML::compact_vector<int, 7> ints;          ///< Categories
     std::vector<std::string> strings;         ///< Those that aren't an integer
     ML::compact_vector<float, 5> weights;     ///< Weights over ints and strings
+
+    /// Dictionary ids of strings as of sort(); not serialized
+    ML::compact_vector<int, 7> stringIds;
+    unsigned dictionarySize;                  ///< Dictionary size at the time
     
     void serialize(ML::DB::Store_Writer & store) const;
     void reconstitute(ML::DB::Store_Reader & store);
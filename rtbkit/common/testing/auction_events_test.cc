@@ -0,0 +1,66 @@
+/* auction_events_test.cc
+   Copyright (c) 2014 Datacratic.  All rights reserved.
+
+   Tests for the serialization of the auction events.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "rtbkit/common/auction_events.h"
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace RTBKIT;
+using namespace Datacratic;
+
+
+BOOST_AUTO_TEST_CASE( test_auction_batch_round_trip )
+{
+    vector<shared_ptr<SubmittedAuctionEvent> > events;
+
+    for (unsigned i = 0;  i < 3;  ++i) {
+        auto event = make_shared<SubmittedAuctionEvent>();
+        event->auctionId = Id(1000 + i);
+        event->adSpotId = Id(i);
+        event->lossTimeout = Date::fromSecondsSinceEpoch(1400000000 + i);
+        event->bidRequestStr = "{\"id\":\"" + to_string(1000 + i) + "\"}";
+        event->bidRequestStrFormat = "datacratic";
+        event->bidResponse.account = AccountKey("campaign:strategy");
+        event->bidResponse.agent = "agent" + to_string(i);
+        event->bidResponse.price.maxPrice = MicroUSD_CPM(100 * (i + 1));
+        event->bidResponse.creativeId = i;
+        events.push_back(event);
+    }
+
+    string str = serializeAuctionBatch(events);
+    auto decoded = reconstituteAuctionBatch(str.data(), str.size());
+
+    BOOST_REQUIRE_EQUAL(decoded.size(), events.size());
+    for (unsigned i = 0;  i < events.size();  ++i) {
+        auto & expected = *events[i];
+        auto & actual = *decoded[i];
+
+        BOOST_CHECK_EQUAL(actual.auctionId, expected.auctionId);
+        BOOST_CHECK_EQUAL(actual.adSpotId, expected.adSpotId);
+        BOOST_CHECK_EQUAL(actual.lossTimeout, expected.lossTimeout);
+        BOOST_CHECK_EQUAL(actual.bidRequestStr, expected.bidRequestStr);
+        BOOST_CHECK_EQUAL(actual.bidRequestStrFormat,
+                          expected.bidRequestStrFormat);
+        BOOST_CHECK_EQUAL(actual.bidResponse.account,
+                          expected.bidResponse.account);
+        BOOST_CHECK_EQUAL(actual.bidResponse.agent, expected.bidResponse.agent);
+        BOOST_CHECK_EQUAL(actual.bidResponse.price.maxPrice,
+                          expected.bidResponse.price.maxPrice);
+        BOOST_CHECK_EQUAL(actual.bidResponse.creativeId,
+                          expected.bidResponse.creativeId);
+    }
+
+    // An empty batch is valid; a bad version is not
+    string empty = serializeAuctionBatch({});
+    BOOST_CHECK(reconstituteAuctionBatch(empty.data(), empty.size()).empty());
+
+    str[0] = 42;
+    BOOST_CHECK_THROW(reconstituteAuctionBatch(str.data(), str.size()),
+                      std::exception);
+}
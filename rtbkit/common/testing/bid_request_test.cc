@@ -0,0 +1,113 @@
+/* bid_request_test.cc
+   Copyright (c) 2014 Datacratic.  All rights reserved.
+
+   Tests for the BidRequest class and its pieces.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "rtbkit/common/bid_request.h"
+#include "jml/db/persistent.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/algorithm/string/trim.hpp>
+
+using namespace std;
+using namespace RTBKIT;
+using namespace Datacratic;
+
+
+BOOST_AUTO_TEST_CASE( test_user_ids_json_str )
+{
+    auto check = [] (const UserIds & ids)
+        {
+            BOOST_CHECK_EQUAL(ids.toJsonStr(),
+                              boost::trim_copy(ids.toJson().toString()));
+        };
+
+    UserIds ids;
+    check(ids);
+
+    ids.add(Id("0828398c-5965-11e0-84c8-0026b937c8e1"), ID_EXCHANGE);
+    check(ids);
+
+    ids.add(Id(12345), ID_PROVIDER);
+    ids.add(Id("with \"quotes\" and\ttabs"), "other");
+    ids.add(Id("z/y\\x"), "Upper");
+    check(ids);
+}
+
+BOOST_AUTO_TEST_CASE( test_bid_request_fields )
+{
+    BOOST_CHECK_EQUAL(parseBidRequestFields(""), BRF_ALL);
+    BOOST_CHECK_EQUAL(parseBidRequestFields("all"), BRF_ALL);
+    BOOST_CHECK_EQUAL(parseBidRequestFields("userIds, segments"),
+                      BRF_USER_IDS | BRF_SEGMENTS);
+    BOOST_CHECK_EQUAL(printBidRequestFields(BRF_USER_IDS | BRF_SEGMENTS),
+                      "userIds,segments");
+    BOOST_CHECK_EQUAL(printBidRequestFields(BRF_ALL), "all");
+    BOOST_CHECK_THROW(parseBidRequestFields("userIds,bogus"), ML::Exception);
+
+    BidRequest br;
+    br.auctionId = Id("0828398c-5965-11e0-84c8-0026b937c8e1");
+    br.exchange = "exchange";
+    br.timestamp = Date::fromSecondsSinceEpoch(1400000000);
+    br.isTest = true;
+    br.ipAddress = "127.0.0.1";
+    br.userAgent = "agent";
+    br.userIds.add(Id(12345), ID_PROVIDER);
+    br.segments.add("source", "segment");
+    br.site.emplace();
+    br.site->id = Id("site");
+    br.imp.emplace_back();
+    br.imp[0].id = Id(1);
+    br.userAgentIPHash = Id(6789);
+    br.regs.emplace();
+    br.regs->coppa.val = 1;
+    br.blockedCategories.push_back(OpenRTB::ContentCategory("IAB25"));
+    br.badv.push_back(Datacratic::UnicodeString("blocked.com"));
+    br.bidCurrency.push_back(CurrencyCode::CC_USD);
+    br.ext["extension"] = 1;
+    br.unparseable["unknown"] = "field";
+    br.meta["meta"] = true;
+
+    auto roundTrip = [&] (uint32_t fields)
+        {
+            ostringstream stream;
+            {
+                ML::DB::Store_Writer store(stream);
+                br.serializeFields(store, fields);
+            }
+            string str = stream.str();
+            ML::DB::Store_Reader store(str.c_str(), str.size());
+
+            BidRequest result;
+            result.reconstituteFields(store);
+            return result;
+        };
+
+    /* only what was asked for comes across */
+    BidRequest partial = roundTrip(BRF_USER_IDS | BRF_SEGMENTS);
+    BOOST_CHECK_EQUAL(partial.auctionId, br.auctionId);
+    BOOST_CHECK_EQUAL(partial.exchange, "exchange");
+    BOOST_CHECK_EQUAL(partial.timestamp, br.timestamp);
+    BOOST_CHECK(partial.isTest);
+    BOOST_CHECK_EQUAL(partial.userIds.toJsonStr(), br.userIds.toJsonStr());
+    BOOST_CHECK_EQUAL(partial.segments.toJson(), br.segments.toJson());
+    BOOST_CHECK_EQUAL(partial.ipAddress, "");
+    BOOST_CHECK(partial.imp.empty());
+    BOOST_CHECK(!partial.site);
+
+    BidRequest full = roundTrip(BRF_ALL);
+    BOOST_CHECK_EQUAL(full.toJson(), br.toJson());
+
+    /* not all of them are in the JSON forms */
+    BOOST_CHECK_EQUAL(full.userAgentIPHash, br.userAgentIPHash);
+    BOOST_REQUIRE(full.regs);
+    BOOST_CHECK_EQUAL(full.regs->coppa.val, 1);
+    BOOST_CHECK_EQUAL(full.blockedCategories.size(), 1);
+    BOOST_CHECK_EQUAL(full.blockedCategories[0].val, "IAB25");
+    BOOST_CHECK_EQUAL(full.badv.size(), 1);
+    BOOST_CHECK_EQUAL(full.badv[0], br.badv[0]);
+    BOOST_CHECK_EQUAL(full.ext, br.ext);
+}
@@ -19,3 +19,43 @@ BOOST_AUTO_TEST_CASE(creativeMatrixTest)
   BOOST_CHECK_EQUAL(bidObj[0].spotIndex, 0);
   BOOST_CHECK_EQUAL(bidObj[0].ext.toStringNoNewLine(), "[\"test1\",\"test2\"]");
 }
+
+BOOST_AUTO_TEST_CASE(jsonStrMatchesToJson)
+{
+    auto check = [] (const Bids & bids)
+        {
+            BOOST_CHECK_EQUAL(bids.toJsonStr(), bids.toJson().toStringNoNewLine());
+        };
+
+    Bids bids;
+    check(bids);
+
+    Bid bid;
+    bid.spotIndex = 0;
+    bids.push_back(bid);                // null bid
+    check(bids);
+
+    bid.spotIndex = 1;
+    bid.availableCreatives = { 0, 2 };
+    bid.bid(2, USD_CPM(1.5), 0.25);
+    bids.push_back(bid);
+    check(bids);
+
+    bid.spotIndex = 2;
+    bid.creativeIndex = 0;
+    bid.price = MicroUSD(1234);
+    bid.priority = 1e-7;
+    bid.account = AccountKey("campaign:strategy");
+    bid.ext["tag"] = "a \"quoted\"\tvalue/with\\stuff";
+    bid.ext["list"][0] = 3;
+    bids.push_back(bid);
+    check(bids);
+
+    bids.dataSources.insert("beta");
+    bids.dataSources.insert("alpha");
+    check(bids);
+
+    string str = bids.toJsonStr();
+    Bids parsed = Bids::fromJson(str);
+    BOOST_CHECK_EQUAL(parsed.toJsonStr(), str);
+}
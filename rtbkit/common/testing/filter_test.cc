@@ -114,6 +114,36 @@ BOOST_AUTO_TEST_CASE(configSetTest)
     }
 }
 
+BOOST_AUTO_TEST_CASE(configSetHeapTest)
+{
+    // Bigger than the inline storage so the words live in recycled buffers.
+    enum { n = ConfigSet::InlineWords * 64 * 4 + 3 };
+
+    for (size_t round = 0; round < 4; ++round) {
+        vector<ConfigSet> sets;
+
+        for (size_t i = 1; i < 100; ++i) {
+            ConfigSet set(round % 2);
+            for (size_t j = 0; j < n; j += i) set.set(j, !(round % 2));
+            sets.push_back(set);
+        }
+
+        for (size_t i = 1; i < 100; ++i) {
+            const ConfigSet& set = sets[i - 1];
+            for (size_t j = 0; j < n; ++j)
+                BOOST_CHECK_EQUAL(set.test(j), (j % i == 0) != (round % 2));
+        }
+
+        ConfigSet moved = std::move(sets.back());
+        sets.clear();
+
+        ConfigSet copy = moved;
+        copy ^= moved;
+        BOOST_CHECK(copy.empty());
+        BOOST_CHECK_EQUAL(moved.test(0), !(round % 2));
+    }
+}
+
 BOOST_AUTO_TEST_CASE(creativeMatrixTest)
 {
     enum { n = 10, m = 100 };
@@ -0,0 +1,109 @@
+/** plugin_table_bench.cc                                 -*- C++ -*-
+    Copyright (c) 2015 Datacratic.  All rights reserved.
+
+    Measures the cost of resolving a plugin on every call, like the bid
+    request parsers and the win cost models do, as the number of threads
+    doing it grows.  The previous table, which took a mutex and returned a
+    copy of the functor, serves as the baseline.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "rtbkit/common/plugin_table.h"
+#include "jml/arch/timers.h"
+#include "jml/arch/format.h"
+
+#include <boost/test/unit_test.hpp>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+using namespace std;
+using namespace ML;
+using namespace RTBKIT;
+
+namespace {
+
+enum {
+    NumCalls = 4000000
+};
+
+typedef std::function<int (int)> Factory;
+
+struct MutexTable {
+    Factory getPlugin(const std::string& name)
+    {
+        std::lock_guard<std::mutex> guard(mu);
+        return table.at(name);
+    }
+
+    std::unordered_map<std::string, Factory> table;
+    std::mutex mu;
+};
+
+/** Returns the number of calls per second made by numThreads threads that
+    each call getPlugin(name)(i) in a loop.
+*/
+template<typename GetPlugin>
+double run(int numThreads, const GetPlugin& getPlugin)
+{
+    int perThread = NumCalls / numThreads;
+    std::vector<int> sums(numThreads);
+
+    auto doCalls = [&] (int thread) {
+        int sum = 0;
+        for (int i = 0;  i < perThread;  ++i)
+            sum += getPlugin()(i);
+        sums[thread] = sum;
+    };
+
+    Timer timer;
+
+    vector<std::thread> threads;
+    for (int i = 0;  i < numThreads;  ++i)
+        threads.emplace_back(doCalls, i);
+    for (auto& th: threads)
+        th.join();
+
+    return perThread * numThreads / timer.elapsed_wall();
+}
+
+} // file scope
+
+BOOST_AUTO_TEST_CASE( plugin_table_bench )
+{
+    const std::string name = "bench_plugin";
+    Factory plugin = [] (int i) { return i & 1; };
+
+    MutexTable baseline;
+    auto& table = PluginTable<Factory>::instance();
+
+    // a table with a realistic number of entries
+    for (int i = 0;  i < 32;  ++i) {
+        Factory other = [=] (int) { return i; };
+        baseline.table[format("plugin_%d", i)] = other;
+        table.registerPlugin(format("plugin_%d", i), other);
+    }
+    baseline.table[name] = plugin;
+    table.registerPlugin(name, plugin);
+
+    const Factory& handle = table.getPlugin(name, "bench");
+
+    for (int numThreads: { 1, 2, 4, 8, 16 }) {
+        double mutex = run(numThreads, [&] () { return baseline.getPlugin(name); });
+        double snapshot = run(numThreads, [&] () -> const Factory& {
+                    return table.getPlugin(name, "bench");
+                });
+        double held = run(numThreads, [&] () -> const Factory& {
+                    return handle;
+                });
+
+        cerr << format("%2d threads: mutex %12.0f/s  snapshot %12.0f/s  "
+                       "handle %12.0f/s",
+                       numThreads, mutex, snapshot, held)
+             << endl;
+    }
+}
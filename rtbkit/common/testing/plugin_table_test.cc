@@ -62,3 +62,31 @@ BOOST_AUTO_TEST_CASE(multi_thread_getPlugin_stress_test)
         BOOST_REQUIRE_EQUAL(num,1);
     }
 }
+
+BOOST_AUTO_TEST_CASE(find_plugin_and_handle_test)
+{
+    auto& table = PluginTable<TestPlugin::Factory>::instance();
+
+    BOOST_CHECK(table.findPlugin("not_registered") == nullptr);
+    BOOST_CHECK(table.findPlugin("a.b.c") == nullptr);
+
+    TestPlugin::Factory first = [] () { return new TestPlugin(); };
+    table.registerPlugin("handle_test", first);
+
+    auto& handle = table.getPlugin("handle_test", "plugin");
+    BOOST_CHECK_EQUAL(table.findPlugin("handle_test"), &handle);
+    BOOST_CHECK_EQUAL(table.findPlugin("some_lib.handle_test"), &handle);
+
+    // the first registration wins and the handle survives later ones
+    TestPlugin::Factory second = [] () { return (TestPlugin *)nullptr; };
+    table.registerPlugin("handle_test", second);
+    for (int i = 0; i < 100; i++) {
+        table.registerPlugin("handle_test_" + to_string(i), second);
+    }
+
+    BOOST_CHECK_EQUAL(&table.getPlugin("handle_test", "plugin"), &handle);
+
+    std::unique_ptr<TestPlugin> plugin(handle());
+    BOOST_REQUIRE(plugin);
+    BOOST_CHECK_EQUAL(plugin->getNum(), 0);
+}
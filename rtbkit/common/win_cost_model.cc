@@ -34,15 +34,25 @@ struct AtInit {
 } // file scope
 
 WinCostModel::
-WinCostModel()
+WinCostModel() :
+    model(nullptr)
 {
 }
 
 WinCostModel::
 WinCostModel(std::string name, Json::Value data) :
     name(std::move(name)),
-    data(std::move(data))
+    data(std::move(data)),
+    model(nullptr)
 {
+    bind();
+}
+
+void
+WinCostModel::
+bind()
+{
+    model = name.empty() ? nullptr : PluginInterface<WinCostModel>::findPlugin(name);
 }
 
 Amount
@@ -53,12 +63,17 @@ evaluate(Bid const & bid, Amount const & price) const
         return NoWinCostModel::evaluate(*this, bid, price);
     }
 
-    auto model = PluginInterface<WinCostModel>::getPlugin(name);
-    if(!model) {
+    // the model wasn't registered yet when this one was bound
+    const Model * bound = model;
+    if(!bound) {
+        bound = &PluginInterface<WinCostModel>::getPlugin(name);
+    }
+
+    if(!*bound) {
         throw ML::Exception("win cost model '%s' not found", name.c_str());
     }
 
-    return model(*this, bid, price);
+    return (*bound)(*this, bid, price);
 }
 
 Json::Value
@@ -92,6 +107,7 @@ fromJson(Json::Value const & json)
                                 i.memberName());
     }
 
+    result.bind();
     return result;
 }
 
@@ -114,6 +130,7 @@ reconstitute(ML::DB::Store_Reader & store)
         if(!text.empty()) {
             data = Json::parse(text);
         }
+        bind();
     }
     else {
         ML::Exception("reconstituting wrong version");
@@ -125,6 +142,9 @@ WinCostModel::
 createDescription(WinCostModelDescription & d) {
     d.addField("name", &WinCostModel::name, "");
     d.addField("data", &WinCostModel::data, "");
+    d.onPostValidate = [] (WinCostModel * wcm, JsonParsingContext & context) {
+        wcm->bind();
+    };
 }
 
 } // namespace RTBKIT
@@ -61,9 +61,16 @@ struct WinCostModel {
 
     static void createDescription(WinCostModelDescription&);
 
+    /// Resolve the model from name; needs to be called again if name changes
+    void bind();
+
 public:
     std::string name;
     Json::Value data;
+
+private:
+    /// Model resolved from name or null if it wasn't registered yet
+    const Model * model;
 };
 
 IMPL_SERIALIZE_RECONSTITUTE(WinCostModel);
@@ -661,6 +661,14 @@ createFromJson(const Json::Value & json)
         }
         else if (it.memberName() == "bidderInterface")
             newConfig.bidderInterface = it->asString();
+        else if (it.memberName() == "bidRequestFormat") {
+            newConfig.bidRequestFormat = it->asString();
+            const string & format = newConfig.bidRequestFormat;
+            if (format != "jsonRaw" && format != "jsonNorm"
+                && format != "binary")
+                throw Exception("bidRequestFormat has wrong value: %s",
+                                format.c_str());
+        }
         else if (it.memberName() == "userPartition") {
             newConfig.userPartition.fromJson(*it);
         }
@@ -836,6 +844,8 @@ toJson(bool includeCreatives) const
 
     if (!bidderInterface.empty())
         result["bidderInterface"] = bidderInterface;
+    if (!bidRequestFormat.empty())
+        result["bidRequestFormat"] = bidRequestFormat;
 
     if (!urlFilter.empty())
         result["urlFilter"] = urlFilter.toJson();
@@ -314,6 +314,12 @@ struct AgentConfig {
 
     std::string bidderInterface;
 
+    /** How the router encodes the bid requests it sends to the agent:
+        "jsonRaw" (the default) forwards the exchange's request, "jsonNorm"
+        the normalized JSON and "binary" the binary BidRequest encoding.
+    */
+    std::string bidRequestFormat;
+
     std::vector<std::string> requiredIds;
 
     IncludeExclude<DomainMatcher> hostFilter;
@@ -139,10 +139,9 @@ struct AgentBridge {
     void sendAgentMessage(const std::string & agent,
                           const std::string & messageType,
                           const Date & date,
-                          Args... args)
+                          const Args &... args)
     {
-        agents.sendMessage(agent, messageType, date,
-                           std::forward<Args>(args)...);
+        agents.sendMessage(agent, messageType, date, args...);
     }
 
     /** Send the given message to the given bidding agent. */
@@ -151,10 +150,9 @@ struct AgentBridge {
                           const std::string & eventType,
                           const std::string & messageType,
                           const Date & date,
-                          Args... args)
+                          const Args &... args)
     {
-        agents.sendMessage(agent, eventType, messageType, date,
-                           std::forward<Args>(args)...);
+        agents.sendMessage(agent, eventType, messageType, date, args...);
     }
 };
 
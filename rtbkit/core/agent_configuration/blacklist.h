@@ -13,6 +13,8 @@
 #include "rtbkit/common/bid_request.h"
 #include "rtbkit/core/router/router_types.h"
 #include "soa/service/timeout_map.h"
+#include "jml/arch/spinlock.h"
+#include <mutex>
 
 
 namespace RTBKIT {
@@ -61,11 +63,17 @@ struct BlacklistInfo {
 /* BLACKLIST                                                                 */
 /*****************************************************************************/
 
-/** Indexed on user ID */
+/** Indexed on user ID.  Shared by all the router shards, so every
+    operation takes the lock.
+*/
 struct Blacklist {
     void doExpiries();
 
-    size_t size() const { return entries.size(); }
+    size_t size() const
+    {
+        std::lock_guard<Lock> guard(lock);
+        return entries.size();
+    }
     
     bool matches(const BidRequest & request,
                  const std::string & agentName,
@@ -77,6 +85,10 @@ struct Blacklist {
     
     typedef TimeoutMap<Id, BlacklistInfo> Entries;
     Entries entries;
+
+private:
+    typedef ML::Spinlock Lock;
+    mutable Lock lock;
 };
 
 } // namespace RTBKIT
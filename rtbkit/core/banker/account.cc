@@ -353,17 +353,19 @@ void
 ShadowAccounts::
 logBidEvents(const Datacratic::EventRecorder & eventRecorder)
 {
-    Guard guard(lock);
+    AllStripesGuard guard(*this);
 
     uint32_t attachedBids(0), detachedBids(0), commitments(0), expired(0);
 
-    for (auto & it: accounts) {
-        ShadowAccount & account = it.second;
-        attachedBids += account.attachedBids;
-        detachedBids += account.detachedBids;
-        commitments += account.commitments.size();
-        account.logBidEvents(eventRecorder, it.first.toString('.'));
-        expired += account.lastExpiredCommitments;
+    for (auto & stripe: stripes) {
+        for (auto & it: stripe.accounts) {
+            ShadowAccount & account = it.second;
+            attachedBids += account.attachedBids;
+            detachedBids += account.detachedBids;
+            commitments += account.commitments.size();
+            account.logBidEvents(eventRecorder, it.first.toString('.'));
+            expired += account.lastExpiredCommitments;
+        }
     }
 
     eventRecorder.recordLevel(attachedBids,
@@ -8,13 +8,16 @@
 
 #include <string>
 #include <vector>
+#include <algorithm>
 #include <unordered_map>
 #include <memory>
 #include <unordered_set>
 #include "rtbkit/common/currency.h"
 #include "rtbkit/common/account_key.h"
 #include "soa/types/date.h"
+#include "soa/types/flat_hash_map.h"
 #include "jml/utils/string_functions.h"
+#include "jml/compiler/compiler.h"
 #include <mutex>
 #include <thread>
 #include "jml/arch/spinlock.h"
@@ -467,7 +470,7 @@ struct ShadowAccount {
         Date timestamp;  ///< When the commitment was made
     };
 
-    std::unordered_map<std::string, Commitment> commitments; 
+    Datacratic::FlatHashMap<std::string, Commitment> commitments;
 
     void checkInvariants() const
     {
@@ -1103,6 +1106,42 @@ struct Accounts {
         return shadow.syncToMaster(getAccountImpl(account));
     }
 
+    /** Batched version of syncFromShadow, applied all or nothing: every
+        shadow is checked against a copy of its master account before any
+        of them is written.  Closed accounts are returned unchanged.
+    */
+    std::vector<Account>
+    syncFromShadows(const std::vector<std::pair<AccountKey, ShadowAccount> > & shadows)
+    {
+        Guard guard(lock);
+
+        for (auto & entry: shadows) {
+            auto it = accounts.find(entry.first);
+            if (it == accounts.end()) {
+                Account empty;
+                empty.type = AT_SPEND;
+                entry.second.syncToMaster(empty);
+            }
+            else if (it->second.status != Account::CLOSED) {
+                Account copy = it->second;
+                entry.second.syncToMaster(copy);
+            }
+        }
+
+        std::vector<Account> result;
+        result.reserve(shadows.size());
+
+        for (auto & entry: shadows) {
+            if (accountPresentAndActiveImpl(entry.first)
+                    == std::make_pair(true, false))
+                result.push_back(getAccountImpl(entry.first));
+            else result.push_back(entry.second.syncToMaster(
+                            ensureAccount(entry.first, AT_SPEND)));
+        }
+
+        return result;
+    }
+
     /* "Out of sync" here means that the in-memory version of the relevant
        accounts is obsolete compared to the version stored in the Redis
        backend */
@@ -1120,6 +1159,30 @@ struct Accounts {
         return (outOfSyncAccounts.count(account) > 0);
     }
 
+    /** Return the keys of the accounts that may have been modified since
+        the last call, and start tracking again from an empty set.  This
+        lets persistence only write the accounts that changed.
+    */
+    std::vector<AccountKey> takeDirtyAccounts()
+    {
+        Guard guard(lock);
+
+        std::vector<AccountKey> result(dirtyAccounts.begin(),
+                                       dirtyAccounts.end());
+        dirtyAccounts.clear();
+        return result;
+    }
+
+    /** Put back accounts returned by takeDirtyAccounts() whose changes
+        could not be persisted.
+    */
+    void markAccountsDirty(const std::vector<AccountKey> & keys)
+    {
+        Guard guard(lock);
+
+        dirtyAccounts.insert(keys.begin(), keys.end());
+    }
+
 
     /** interaccount consistency */
     /* "Inconsistent" here means that there is a mismatch between the members
@@ -1162,6 +1225,10 @@ private:
     AccountSet outOfSyncAccounts;
     AccountSet inconsistentAccounts;
 
+    /// Accounts handed out for modification since the last
+    /// takeDirtyAccounts()
+    AccountSet dirtyAccounts;
+
 public:
     std::vector<AccountKey>
     getAccountKeys(const AccountKey & prefix = AccountKey(),
@@ -1236,6 +1303,8 @@ private:
     {
         ExcAssertGreaterEqual(accountKey.size(), 1);
 
+        dirtyAccounts.insert(accountKey);
+
         auto it = accounts.find(accountKey);
         if (it != accounts.end()) {
             ExcAssertEqual(it->second.type, type);
@@ -1262,6 +1331,7 @@ private:
         auto it = accounts.find(account);
         if (it == accounts.end())
             throw ML::Exception("couldn't get account: " + account.toString());
+        dirtyAccounts.insert(account);
         return it->second;
     }
 
@@ -1383,15 +1453,17 @@ struct ShadowAccounts {
     
     const ShadowAccount activateAccount(const AccountKey & account)
     {
-        Guard guard(lock);
-        return getAccountImpl(account);
+        Stripe & stripe = stripeFor(account);
+        Guard guard(stripe.lock);
+        return getAccountImpl(stripe, account);
     }
 
     const ShadowAccount syncFromMaster(const AccountKey & account,
                                        const Account & master)
     {
-        Guard guard(lock);
-        auto & a = getAccountImpl(account);
+        Stripe & stripe = stripeFor(account);
+        Guard guard(stripe.lock);
+        auto & a = getAccountImpl(stripe, account);
         ExcAssert(!a.uninitialized);
         a.syncFromMaster(master);
         return a;
@@ -1404,8 +1476,9 @@ struct ShadowAccounts {
     initializeAndMergeState(const AccountKey & account,
                             const Account & master)
     {
-        Guard guard(lock);
-        auto & a = getAccountImpl(account);
+        Stripe & stripe = stripeFor(account);
+        Guard guard(stripe.lock);
+        auto & a = getAccountImpl(stripe, account);
         ExcAssert(a.uninitialized);
         a.initializeAndMergeState(master);
         a.uninitialized = false;
@@ -1414,29 +1487,33 @@ struct ShadowAccounts {
 
     void checkInvariants() const
     {
-        Guard guard(lock);
-        for (auto & a: accounts) {
-            a.second.checkInvariants();
-        }
+        AllStripesGuard guard(*this);
+        for (auto & stripe: stripes)
+            for (auto & a: stripe.accounts)
+                a.second.checkInvariants();
     }
 
     const ShadowAccount getAccount(const AccountKey & accountKey) const
     {
-        Guard guard(lock);
-        return getAccountImpl(accountKey);
+        const Stripe & stripe = stripeFor(accountKey);
+        Guard guard(stripe.lock);
+        return getAccountImpl(stripe, accountKey);
     }
 
     bool accountExists(const AccountKey & accountKey) const
     {
-        Guard guard(lock);
-        return accounts.count(accountKey);
+        const Stripe & stripe = stripeFor(accountKey);
+        Guard guard(stripe.lock);
+        return stripe.accounts.count(accountKey);
     }
 
     bool createAccountAtomic(const AccountKey & accountKey)
     {
-    	Guard guard(lock);
+        Stripe & stripe = stripeFor(accountKey);
+    	Guard guard(stripe.lock);
 
-    	AccountEntry & account = getAccountImpl(accountKey, false /* call onCreate */);
+    	AccountEntry & account = getAccountImpl(stripe, accountKey,
+                                                false /* call onCreate */);
     	bool result = account.first;
 
     	// record that this account creation is requested for the first time
@@ -1451,55 +1528,63 @@ struct ShadowAccounts {
 
     void syncTo(Accounts & master) const
     {
-        Guard guard1(lock);
+        AllStripesGuard guard1(*this);
         Guard guard2(master.lock);
 
-        for (auto & a: accounts)
-            a.second.syncToMaster(master.getAccountImpl(a.first));
+        for (auto & stripe: stripes)
+            for (auto & a: stripe.accounts)
+                a.second.syncToMaster(master.getAccountImpl(a.first));
     }
 
     void syncFrom(const Accounts & master)
     {
-        Guard guard1(lock);
+        AllStripesGuard guard1(*this);
         Guard guard2(master.lock);
 
-        for (auto & a: accounts) {
-            a.second.syncFromMaster(master.getAccountImpl(a.first));
-            if (master.outOfSyncAccounts.count(a.first) > 0) {
-                outOfSyncAccounts.insert(a.first);
+        for (auto & stripe: stripes) {
+            for (auto & a: stripe.accounts) {
+                a.second.syncFromMaster(master.getAccountImpl(a.first));
+                if (master.outOfSyncAccounts.count(a.first) > 0) {
+                    stripe.outOfSyncAccounts.insert(a.first);
+                }
             }
         }
     }
 
     void sync(Accounts & master)
     {
-        Guard guard1(lock);
+        AllStripesGuard guard1(*this);
         Guard guard2(master.lock);
 
-        for (auto & a: accounts) {
-            a.second.syncToMaster(master.getAccountImpl(a.first));
-            a.second.syncFromMaster(master.getAccountImpl(a.first));
+        for (auto & stripe: stripes) {
+            for (auto & a: stripe.accounts) {
+                a.second.syncToMaster(master.getAccountImpl(a.first));
+                a.second.syncFromMaster(master.getAccountImpl(a.first));
+            }
         }
     }
 
     bool isInitialized(const AccountKey & accountKey) const
     {
-        Guard guard(lock);
-        return !getAccountImpl(accountKey).uninitialized;
+        const Stripe & stripe = stripeFor(accountKey);
+        Guard guard(stripe.lock);
+        return !getAccountImpl(stripe, accountKey).uninitialized;
     }
 
     bool isStalled(const AccountKey & accountKey) const
     {
-        Guard guard(lock);
-        auto & account = getAccountImpl(accountKey);
+        const Stripe & stripe = stripeFor(accountKey);
+        Guard guard(stripe.lock);
+        auto & account = getAccountImpl(stripe, accountKey);
         return account.uninitialized && account.requested.minutesUntil(Date::now()) >= 1.0;
     }
 
     void reinitializeStalledAccount(const AccountKey & accountKey)
     {
         ExcAssert(isStalled(accountKey));
-        Guard guard(lock);
-        auto & account = getAccountImpl(accountKey);
+        Stripe & stripe = stripeFor(accountKey);
+        Guard guard(stripe.lock);
+        auto & account = getAccountImpl(stripe, accountKey);
         account.first = true;
         account.requested = Date::now();
     }
@@ -1512,9 +1597,10 @@ struct ShadowAccounts {
                       const std::string & item,
                       Amount amount)
     {
-        Guard guard(lock);
-        return (outOfSyncAccounts.count(accountKey) == 0
-                && getAccountImpl(accountKey).authorizeBid(item, amount));
+        Stripe & stripe = stripeFor(accountKey);
+        Guard guard(stripe.lock);
+        return (stripe.outOfSyncAccounts.count(accountKey) == 0
+                && getAccountImpl(stripe, accountKey).authorizeBid(item, amount));
     }
     
     void commitBid(const AccountKey & accountKey,
@@ -1522,23 +1608,28 @@ struct ShadowAccounts {
                    Amount amountPaid,
                    const LineItems & lineItems)
     {
-        Guard guard(lock);
-        return getAccountImpl(accountKey).commitBid(item, amountPaid, lineItems);
+        Stripe & stripe = stripeFor(accountKey);
+        Guard guard(stripe.lock);
+        return getAccountImpl(stripe, accountKey)
+            .commitBid(item, amountPaid, lineItems);
     }
 
     void cancelBid(const AccountKey & accountKey,
                    const std::string & item)
     {
-        Guard guard(lock);
-        return getAccountImpl(accountKey).cancelBid(item);
+        Stripe & stripe = stripeFor(accountKey);
+        Guard guard(stripe.lock);
+        return getAccountImpl(stripe, accountKey).cancelBid(item);
     }
     
     void forceWinBid(const AccountKey & accountKey,
                      Amount amountPaid,
                      const LineItems & lineItems)
     {
-        Guard guard(lock);
-        return getAccountImpl(accountKey).forceWinBid(amountPaid, lineItems);
+        Stripe & stripe = stripeFor(accountKey);
+        Guard guard(stripe.lock);
+        return getAccountImpl(stripe, accountKey)
+            .forceWinBid(amountPaid, lineItems);
     }
 
     /// Commit a bid that has been detached from its tracking
@@ -1547,31 +1638,35 @@ struct ShadowAccounts {
                            Amount amountPaid,
                            const LineItems & lineItems)
     {
-        Guard guard(lock);
-        return getAccountImpl(accountKey)
+        Stripe & stripe = stripeFor(accountKey);
+        Guard guard(stripe.lock);
+        return getAccountImpl(stripe, accountKey)
             .commitDetachedBid(amountAuthorized, amountPaid, lineItems);
     }
 
     /// Commit a specific currency (amountToCommit)
     void commitEvent(const AccountKey & accountKey, const Amount & amountToCommit)
     {
-        Guard guard(lock);
-        return getAccountImpl(accountKey).commitEvent(amountToCommit);
+        Stripe & stripe = stripeFor(accountKey);
+        Guard guard(stripe.lock);
+        return getAccountImpl(stripe, accountKey).commitEvent(amountToCommit);
     }
 
     Amount detachBid(const AccountKey & accountKey,
                      const std::string & item)
     {
-        Guard guard(lock);
-        return getAccountImpl(accountKey).detachBid(item);
+        Stripe & stripe = stripeFor(accountKey);
+        Guard guard(stripe.lock);
+        return getAccountImpl(stripe, accountKey).detachBid(item);
     }
 
     void attachBid(const AccountKey & accountKey,
                    const std::string & item,
                    Amount amountAuthorized)
     {
-        Guard guard(lock);
-        getAccountImpl(accountKey).attachBid(item, amountAuthorized);
+        Stripe & stripe = stripeFor(accountKey);
+        Guard guard(stripe.lock);
+        getAccountImpl(stripe, accountKey).attachBid(item, amountAuthorized);
     }
 
     void logBidEvents(const Datacratic::EventRecorder & eventRecorder);
@@ -1600,49 +1695,99 @@ private:
         bool first;
     };
 
-    AccountEntry & getAccountImpl(const AccountKey & account,
+    typedef ML::Spinlock Lock;
+    typedef std::unique_lock<Lock> Guard;
+
+    typedef std::map<AccountKey, AccountEntry> AccountMap;
+    typedef std::unordered_set<AccountKey> AccountSet;
+
+    /** The accounts are spread over a fixed number of stripes by the hash of
+        their key, each with its own lock.  Bid operations only lock the
+        stripe of their account, so the router and post auction threads
+        don't all queue up on a single lock.  Operations that cover every
+        account lock all the stripes, always in the same order.  Each
+        stripe gets its own cache line so that neighbouring locks don't
+        bounce between cores.
+    */
+    enum { NumStripes = 32 };
+
+    struct JML_ALIGNED(64) Stripe {
+        mutable Lock lock;
+        AccountMap accounts;
+        AccountSet outOfSyncAccounts;
+    };
+
+    Stripe stripes[NumStripes];
+
+    Stripe & stripeFor(const AccountKey & account)
+    {
+        return stripes[account.hash() % NumStripes];
+    }
+
+    const Stripe & stripeFor(const AccountKey & account) const
+    {
+        return stripes[account.hash() % NumStripes];
+    }
+
+    struct AllStripesGuard {
+        AllStripesGuard(const ShadowAccounts & owner)
+            : owner(owner)
+        {
+            for (auto & stripe: owner.stripes)
+                stripe.lock.lock();
+        }
+
+        ~AllStripesGuard()
+        {
+            for (int i = NumStripes - 1;  i >= 0;  --i)
+                owner.stripes[i].lock.unlock();
+        }
+
+        const ShadowAccounts & owner;
+    };
+
+    AccountEntry & getAccountImpl(Stripe & stripe,
+                                  const AccountKey & account,
                                   bool callOnNewAccount = true)
     {
-        auto it = accounts.find(account);
-        if (it == accounts.end()) {
+        auto it = stripe.accounts.find(account);
+        if (it == stripe.accounts.end()) {
             if (callOnNewAccount && onNewAccount)
                 onNewAccount(account);
-            it = accounts.insert(std::make_pair(account, AccountEntry()))
+            it = stripe.accounts.insert(std::make_pair(account, AccountEntry()))
                 .first;
         }
         return it->second;
     }
 
-    const AccountEntry & getAccountImpl(const AccountKey & account) const
+    const AccountEntry & getAccountImpl(const Stripe & stripe,
+                                        const AccountKey & account) const
     {
-        auto it = accounts.find(account);
-        if (it == accounts.end())
+        auto it = stripe.accounts.find(account);
+        if (it == stripe.accounts.end())
             throw ML::Exception("getting unknown account " + account.toString());
         return it->second;
     }
 
-    typedef ML::Spinlock Lock;
-    typedef std::unique_lock<Lock> Guard;
-    mutable Lock lock;
-
-    typedef std::map<AccountKey, AccountEntry> AccountMap;
-    AccountMap accounts;
-
-    typedef std::unordered_set<AccountKey> AccountSet;
-    AccountSet outOfSyncAccounts;
-
 public:
     std::vector<AccountKey>
     getAccountKeys(const AccountKey & prefix = AccountKey()) const
     {
-        Guard guard(lock);
-
         std::vector<AccountKey> result;
 
-        for (auto it = accounts.lower_bound(prefix), end = accounts.end();
-             it != accounts.end() && it->first.hasPrefix(prefix);  ++it) {
-            result.push_back(it->first);
+        {
+            AllStripesGuard guard(*this);
+
+            for (auto & stripe: stripes) {
+                auto & accounts = stripe.accounts;
+                for (auto it = accounts.lower_bound(prefix), end = accounts.end();
+                     it != end && it->first.hasPrefix(prefix);  ++it) {
+                    result.push_back(it->first);
+                }
+            }
         }
+
+        std::sort(result.begin(), result.end());
         return result;
     }
 
@@ -1651,10 +1796,12 @@ public:
                                              const ShadowAccount &)> &
                    onAccount) const
     {
-        Guard guard(lock);
+        AllStripesGuard guard(*this);
         
-        for (auto & a: accounts) {
-            onAccount(a.first, a.second);
+        for (auto & stripe: stripes) {
+            for (auto & a: stripe.accounts) {
+                onAccount(a.first, a.second);
+            }
         }
     }
 
@@ -1662,25 +1809,29 @@ public:
     forEachInitializedAndActiveAccount(const std::function<void (const AccountKey &,
                                                         const ShadowAccount &)> & onAccount)
     {
-        Guard guard(lock);
+        AllStripesGuard guard(*this);
         
-        for (auto & a: accounts) {
-            if (a.second.uninitialized || a.second.status == Account::CLOSED)
-                continue;
-            onAccount(a.first, a.second);
+        for (auto & stripe: stripes) {
+            for (auto & a: stripe.accounts) {
+                if (a.second.uninitialized || a.second.status == Account::CLOSED)
+                    continue;
+                onAccount(a.first, a.second);
+            }
         }
     }
 
     size_t size() const
     {
-        Guard guard(lock);
-        return accounts.size();
+        AllStripesGuard guard(*this);
+        size_t result = 0;
+        for (auto & stripe: stripes)
+            result += stripe.accounts.size();
+        return result;
     }
 
     bool empty() const
     {
-        Guard guard(lock);
-        return accounts.empty();
+        return size() == 0;
     }
 };
 
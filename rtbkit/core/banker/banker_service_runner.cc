@@ -16,6 +16,7 @@
 #include <boost/make_shared.hpp>
 
 #include "rtbkit/core/banker/master_banker.h"
+#include "rtbkit/core/banker/file_banker_persistence.h"
 #include "soa/service/service_utils.h"
 #include "soa/service/process_stats.h"
 #include "jml/utils/pair_utils.h"
@@ -46,12 +47,15 @@ int main(int argc, char ** argv)
     int redisTimeout = 0;
     int saveInterval = 0;
 
+    std::string persistenceDir;
+    size_t maxLogRecords = 0;
+
     bool debug = false;
 
     std::vector<std::string> fixedHttpBindAddresses;
 
     configuration_options.add_options()
-        ("redis-uri,r", value<string>(&redisUri)->required(),
+        ("redis-uri,r", value<string>(&redisUri),
          "URI of connection to redis")
         ("redis-password,p", value<string>(&redisPassword),
          "Password of connection to redis")
@@ -59,6 +63,12 @@ int main(int argc, char ** argv)
          "Database of connection to redis")
         ("redis-save-timeout", value<int>(&redisTimeout)->default_value(10),
          "Delay at which redis calls will timeout")
+        ("persistence-dir", value<string>(&persistenceDir),
+         "Directory in which to persist the state instead of redis")
+        ("max-log-records",
+         value<size_t>(&maxLogRecords)
+             ->default_value(Default::MaxBankerLogRecords),
+         "Number of records in the persistence log before it is compacted")
         ("save-interval", value<int>(&saveInterval)->default_value(10),
          "Periodic delay at which state will be saved")
         ("fixed-http-bind-address,a", value(&fixedHttpBindAddresses),
@@ -86,6 +96,12 @@ int main(int argc, char ** argv)
         exit(1);
     }
 
+    if (redisUri.empty() == persistenceDir.empty()) {
+        cerr << "exactly one of --redis-uri and --persistence-dir is required"
+             << endl;
+        exit(1);
+    }
+
     auto proxies = serviceArgs.makeServiceProxies();
     auto serviceName = serviceArgs.serviceName("masterBanker");
 
@@ -95,7 +111,15 @@ int main(int argc, char ** argv)
     if (debug)
         banker.debug.activate();
 
-    if (redisUri != "nopersistence") {
+    if (!persistenceDir.empty()) {
+        std::cout << " persistenceDir=" << persistenceDir << std::endl;
+        auto persistence = std::make_shared<FileBankerPersistence>
+            (persistenceDir, maxLogRecords);
+        if (debug)
+            persistence->debug.activate();
+        banker.init(persistence, saveInterval);
+    }
+    else if (redisUri != "nopersistence") {
         std::cout << " redisUri=" << redisUri << std::endl;
         auto address = Redis::Address(redisUri);
         redis = std::make_shared<Redis::AsyncConnection>(redisUri);
@@ -0,0 +1,471 @@
+/* file_banker_persistence.cc
+   Copyright (c) 2014 Datacratic Inc.  All rights reserved.
+
+   Banker persistence to local files.
+*/
+
+#include "file_banker_persistence.h"
+#include <boost/lexical_cast.hpp>
+#include <fstream>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+
+using namespace std;
+using namespace ML;
+
+namespace RTBKIT {
+
+namespace {
+
+const string GenerationTag = "generation";
+
+string readFile(const string & path, bool & exists)
+{
+    ifstream stream(path.c_str(), ios::in | ios::binary);
+    exists = stream.good();
+    if (!exists)
+        return string();
+
+    ostringstream contents;
+    contents << stream.rdbuf();
+    if (stream.bad())
+        throw ML::Exception("error reading '%s'", path.c_str());
+    return contents.str();
+}
+
+/** Calls onRecord(key, json) for each complete line of a snapshot or log
+    and returns the generation from its header line.  A last line without
+    its newline is a torn write and is skipped.
+*/
+template<typename OnRecord>
+uint64_t parseRecords(const string & path, const string & contents,
+                      const OnRecord & onRecord)
+{
+    uint64_t generation = 0;
+    size_t pos = 0;
+    unsigned lineNum = 0;
+
+    for (;;) {
+        size_t end = contents.find('\n', pos);
+        if (end == string::npos) {
+            if (pos != contents.size())
+                LOG(BankerPersistence::error)
+                    << "ignoring incomplete last record of '" << path
+                    << "'" << endl;
+            break;
+        }
+
+        string line(contents, pos, end - pos);
+        pos = end + 1;
+        ++lineNum;
+
+        size_t tab = line.find('\t');
+        if (tab == string::npos)
+            throw ML::Exception("'%s' line %d: missing separator",
+                                path.c_str(), lineNum);
+
+        string key(line, 0, tab);
+        if (lineNum == 1) {
+            if (key != GenerationTag)
+                throw ML::Exception("'%s' doesn't start with a generation",
+                                    path.c_str());
+            generation = boost::lexical_cast<uint64_t>(line.substr(tab + 1));
+            continue;
+        }
+
+        onRecord(key, Json::parse(line.substr(tab + 1)));
+    }
+
+    return generation;
+}
+
+bool isClosed(const Json::Value & account)
+{
+    return account["status"].asString() == "closed";
+}
+
+string makeRecord(const string & key, const Json::Value & value)
+{
+    return key + "\t" + value.toStringNoNewLine() + "\n";
+}
+
+string makeHeader(uint64_t generation)
+{
+    return GenerationTag + "\t" + to_string(generation) + "\n";
+}
+
+void writeAll(int fd, const string & data, const string & path)
+{
+    const char * p = data.data();
+    size_t left = data.size();
+    while (left) {
+        ssize_t res = ::write(fd, p, left);
+        if (res == -1) {
+            if (errno == EINTR)
+                continue;
+            throw ML::Exception(errno, "write to '" + path + "'");
+        }
+        p += res;
+        left -= res;
+    }
+}
+
+} // file scope
+
+
+/*****************************************************************************/
+/* FILE BANKER PERSISTENCE                                                   */
+/*****************************************************************************/
+
+FileBankerPersistence::
+FileBankerPersistence(const string & directory, size_t maxLogRecords)
+    : directory(directory),
+      maxLogRecords(maxLogRecords),
+      numLogRecords(0),
+      generation(0),
+      generationKnown(false),
+      logFd(-1)
+{
+    if (directory.empty())
+        throw ML::Exception("'directory' cannot be empty");
+}
+
+FileBankerPersistence::
+~FileBankerPersistence()
+{
+    closeLog();
+}
+
+string
+FileBankerPersistence::
+snapshotPath() const
+{
+    return directory + "/accounts.snapshot";
+}
+
+string
+FileBankerPersistence::
+logPath() const
+{
+    return directory + "/accounts.log";
+}
+
+FileBankerPersistence::StoredAccounts
+FileBankerPersistence::
+readState()
+{
+    StoredAccounts result;
+
+    auto onRecord = [&] (const string & key, Json::Value && value)
+        {
+            result[key] = std::move(value);
+        };
+
+    bool exists;
+    string path = snapshotPath();
+    string contents = readFile(path, exists);
+    uint64_t snapshotGeneration = parseRecords(path, contents, onRecord);
+
+    path = logPath();
+    contents = readFile(path, exists);
+
+    // The log belongs to the snapshot if it has the same generation; an
+    // older one was already compacted into the snapshot.
+    StoredAccounts logged;
+    auto onLogged = [&] (const string & key, Json::Value && value)
+        {
+            logged[key] = std::move(value);
+            ++numLogRecords;
+        };
+
+    numLogRecords = 0;
+    uint64_t logGeneration = parseRecords(path, contents, onLogged);
+    if (exists && logGeneration == snapshotGeneration) {
+        for (auto & entry: logged)
+            result[entry.first] = std::move(entry.second);
+    }
+    else numLogRecords = 0;
+
+    generation = snapshotGeneration;
+    generationKnown = true;
+
+    archive.clear();
+    for (auto & entry: result) {
+        if (isClosed(entry.second))
+            archive[entry.first] = entry.second;
+    }
+
+    return result;
+}
+
+void
+FileBankerPersistence::
+loadAll(const string & topLevelKey, OnLoadedCallback onLoaded)
+{
+    shared_ptr<Accounts> newAccounts;
+    StoredAccounts stored;
+
+    try {
+        closeLog();
+        stored = readState();
+    } catch (const std::exception & exc) {
+        onLoaded(newAccounts, DATA_INCONSISTENCY, exc.what());
+        return;
+    }
+
+    newAccounts = make_shared<Accounts>();
+    for (auto & entry: stored) {
+        if (isClosed(entry.second))
+            continue;
+        newAccounts->restoreAccount(AccountKey(entry.first), entry.second);
+    }
+
+    onLoaded(newAccounts, SUCCESS, "");
+}
+
+void
+FileBankerPersistence::
+saveAll(const Accounts & toSave, OnSavedCallback onDone)
+{
+    Date begin = Date::now();
+    Result result(SUCCESS);
+    string info;
+
+    try {
+        writeSnapshot(toSave);
+    } catch (const std::exception & exc) {
+        result.status = PERSISTENCE_ERROR;
+        info = exc.what();
+        LOG(error) << "snapshot failed: " << info << endl;
+    }
+
+    result.recordLatency("totalTimeMs", Date::now().secondsSince(begin) * 1000);
+    onDone(result, info);
+}
+
+void
+FileBankerPersistence::
+saveDirty(const Accounts & toSave,
+          const vector<AccountKey> & dirtyAccounts,
+          OnSavedCallback onDone)
+{
+    Date begin = Date::now();
+    Result result(SUCCESS);
+    string info;
+
+    try {
+        string records;
+        size_t numRecords = 0;
+
+        for (const AccountKey & key: dirtyAccounts) {
+            if (toSave.isAccountOutOfSync(key)) {
+                LOG(trace) << "account '" << key
+                           << "' is out of sync and will not be saved" << endl;
+                continue;
+            }
+            records += makeRecord(key.toString(),
+                                  toSave.getAccount(key).toJson());
+            ++numRecords;
+        }
+
+        if (numRecords > 0) {
+            appendToLog(records);
+            numLogRecords += numRecords;
+        }
+
+        result.recordLatency("logTimeMs",
+                             Date::now().secondsSince(begin) * 1000);
+
+        // Compact once replaying the log costs more than reading a
+        // snapshot would
+        if (numLogRecords >= std::max(maxLogRecords, toSave.size())) {
+            Date beforeSnapshot = Date::now();
+            writeSnapshot(toSave);
+            result.recordLatency("snapshotTimeMs",
+                                 Date::now().secondsSince(beforeSnapshot) * 1000);
+        }
+    } catch (const std::exception & exc) {
+        // A failed append can leave a partial record behind, after which
+        // nothing else may be appended.  The next save will start over
+        // with a snapshot.
+        closeLog();
+        numLogRecords = std::max(maxLogRecords, toSave.size());
+
+        result.status = PERSISTENCE_ERROR;
+        info = exc.what();
+        LOG(error) << "save failed: " << info << endl;
+    }
+
+    result.recordLatency("totalTimeMs", Date::now().secondsSince(begin) * 1000);
+    onDone(result, info);
+}
+
+void
+FileBankerPersistence::
+restoreFromArchive(const AccountKey & key, OnRestoredCallback onRestored)
+{
+    shared_ptr<Accounts> archivedAccounts;
+    StoredAccounts stored;
+
+    try {
+        size_t logged = numLogRecords;
+        stored = readState();
+        numLogRecords = std::max(numLogRecords, logged);
+    } catch (const std::exception & exc) {
+        onRestored(archivedAccounts, DATA_INCONSISTENCY, exc.what());
+        return;
+    }
+
+    auto isArchived = [&] (const string & name)
+        {
+            auto it = stored.find(name);
+            return it != stored.end() && isClosed(it->second);
+        };
+
+    // Bring back the account and its children if it was archived, and
+    // any archived parent in any case.
+    vector<string> keysToRestore;
+    if (stored.count(key.toString())) {
+        for (auto & entry: stored) {
+            if (AccountKey(entry.first).hasPrefix(key)
+                && isArchived(entry.first))
+                keysToRestore.push_back(entry.first);
+        }
+    }
+
+    AccountKey parent = key;
+    while (parent.size() > 1) {
+        parent.pop_back();
+        if (isArchived(parent.toString()))
+            keysToRestore.push_back(parent.toString());
+    }
+
+    archivedAccounts = make_shared<Accounts>();
+    for (auto & k: keysToRestore)
+        archivedAccounts->restoreAccount(AccountKey(k), stored[k]);
+
+    onRestored(archivedAccounts, SUCCESS, "");
+}
+
+void
+FileBankerPersistence::
+writeSnapshot(const Accounts & toSave)
+{
+    if (!generationKnown)
+        readState();
+
+    uint64_t newGeneration = generation + 1;
+
+    string contents = makeHeader(newGeneration);
+    for (const AccountKey & key: toSave.getAccountKeys()) {
+        if (!toSave.isAccountOutOfSync(key))
+            contents += makeRecord(key.toString(),
+                                   toSave.getAccount(key).toJson());
+    }
+
+    // Archived accounts aren't loaded, so unless they have been restored
+    // since, the snapshot is the only place they live on.
+    for (auto & entry: archive) {
+        if (!toSave.accountPresentAndActive(AccountKey(entry.first)).first)
+            contents += makeRecord(entry.first, entry.second);
+    }
+
+    // Write the new snapshot next to the old one, then swap it in
+    string path = snapshotPath();
+    string tmpPath = path + ".tmp";
+
+    int fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1)
+        throw ML::Exception(errno, "open '" + tmpPath + "'");
+
+    try {
+        writeAll(fd, contents, tmpPath);
+        if (::fsync(fd) == -1)
+            throw ML::Exception(errno, "fsync '" + tmpPath + "'");
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+    ::close(fd);
+
+    if (::rename(tmpPath.c_str(), path.c_str()) == -1)
+        throw ML::Exception(errno, "rename '" + tmpPath + "'");
+
+    int dirFd = ::open(directory.c_str(), O_RDONLY);
+    if (dirFd != -1) {
+        ::fsync(dirFd);
+        ::close(dirFd);
+    }
+
+    // From here on the old log is obsolete, even if we crash before it is
+    // truncated
+    generation = newGeneration;
+    closeLog();
+    numLogRecords = 0;
+    openLog();
+}
+
+void
+FileBankerPersistence::
+openLog()
+{
+    if (logFd != -1)
+        return;
+
+    if (!generationKnown)
+        readState();
+
+    string path = logPath();
+
+    // Keep appending to a log of the current generation, minus any torn
+    // record at its end; anything else is left over from before the last
+    // snapshot.
+    bool exists;
+    string contents = readFile(path, exists);
+    string header = makeHeader(generation);
+    size_t validLength = 0;
+    if (contents.compare(0, header.size(), header) == 0)
+        validLength = contents.rfind('\n') + 1;
+
+    logFd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (logFd == -1)
+        throw ML::Exception(errno, "open '" + path + "'");
+
+    if (validLength != 0 && validLength == contents.size())
+        return;
+
+    if (::ftruncate(logFd, validLength) == -1)
+        throw ML::Exception(errno, "ftruncate '" + path + "'");
+    if (validLength == 0)
+        writeAll(logFd, header, path);
+    if (::fdatasync(logFd) == -1)
+        throw ML::Exception(errno, "fdatasync '" + path + "'");
+}
+
+void
+FileBankerPersistence::
+closeLog()
+{
+    if (logFd != -1) {
+        ::close(logFd);
+        logFd = -1;
+    }
+}
+
+void
+FileBankerPersistence::
+appendToLog(const string & records)
+{
+    openLog();
+
+    string path = logPath();
+    writeAll(logFd, records, path);
+    if (::fdatasync(logFd) == -1)
+        throw ML::Exception(errno, "fdatasync '" + path + "'");
+}
+
+} // namespace RTBKIT
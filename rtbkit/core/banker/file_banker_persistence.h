@@ -0,0 +1,107 @@
+/* file_banker_persistence.h                                       -*- C++ -*-
+   Copyright (c) 2014 Datacratic Inc.  All rights reserved.
+
+   Banker persistence to local files: an append-only log of the accounts
+   that changed at each save, periodically compacted into a snapshot of
+   the whole state.
+*/
+
+#pragma once
+
+#include "master_banker.h"
+#include <map>
+#include <string>
+#include <vector>
+
+namespace RTBKIT {
+
+namespace Default {
+    static constexpr size_t MaxBankerLogRecords = 100000;
+}
+
+
+/*****************************************************************************/
+/* FILE BANKER PERSISTENCE                                                   */
+/*****************************************************************************/
+
+/** Keeps the banker state in two files of the given directory:
+
+    - "accounts.snapshot" has one "<key>\t<account json>" line per account;
+    - "accounts.log" has the same kind of lines, appended (and synced to
+      disk) at every save for the accounts that changed since the previous
+      one.
+
+    Loading reads the snapshot and replays the log over it, so the last
+    line for a key wins.  A partially written line at the end of the log,
+    which is what a crash in the middle of a save leaves behind, is
+    ignored.
+
+    Once the log holds more records than both maxLogRecords and the
+    number of accounts, the state is compacted into a new snapshot and the
+    log starts over.  Both files start with a generation number, and a log
+    is only replayed over the snapshot of the same generation; a crash
+    between writing the snapshot and truncating the log therefore can't
+    replay stale records.
+
+    Closed accounts stay in the files but are not loaded, like the archive
+    of the redis persistence, and come back through restoreFromArchive().
+    They are kept aside when the files are read and carried over into
+    every new snapshot.
+
+    Only one banker may use a directory at a time.
+*/
+
+struct FileBankerPersistence : public BankerPersistence {
+    FileBankerPersistence(const std::string & directory,
+                          size_t maxLogRecords = Default::MaxBankerLogRecords);
+    ~FileBankerPersistence();
+
+    void loadAll(const std::string & topLevelKey, OnLoadedCallback onLoaded);
+    void saveAll(const Accounts & toSave, OnSavedCallback onDone);
+    void saveDirty(const Accounts & toSave,
+                   const std::vector<AccountKey> & dirtyAccounts,
+                   OnSavedCallback onDone);
+    void restoreFromArchive(const AccountKey & key,
+                            OnRestoredCallback onRestored);
+
+    std::string snapshotPath() const;
+    std::string logPath() const;
+
+    /** Number of records appended to the log since the last snapshot. */
+    size_t logRecords() const
+    {
+        return numLogRecords;
+    }
+
+private:
+    typedef std::map<std::string, Json::Value> StoredAccounts;
+
+    /** Read the snapshot and replay the log over it.  Throws if the files
+        can't be read or are corrupt.
+    */
+    StoredAccounts readState();
+
+    /** Write every account to a new snapshot and start a new log. */
+    void writeSnapshot(const Accounts & toSave);
+
+    /** Append the given records to the log and sync it to disk. */
+    void appendToLog(const std::string & records);
+
+    /** Make sure that the log is open for appending to the current
+        generation.
+    */
+    void openLog();
+    void closeLog();
+
+    /// Closed accounts found the last time the files were read
+    StoredAccounts archive;
+
+    std::string directory;
+    size_t maxLogRecords;
+    size_t numLogRecords;
+    uint64_t generation;
+    bool generationKnown;
+    int logFd;
+};
+
+} // namespace RTBKIT
@@ -128,6 +128,24 @@ loadAll(const string & topLevelKey, OnLoadedCallback onLoaded)
 void
 RedisBankerPersistence::
 saveAll(const Accounts & toSave, OnSavedCallback onSaved)
+{
+    saveAccounts(toSave, toSave.getAccountKeys(), onSaved);
+}
+
+void
+RedisBankerPersistence::
+saveDirty(const Accounts & toSave,
+          const vector<AccountKey> & dirtyAccounts,
+          OnSavedCallback onSaved)
+{
+    saveAccounts(toSave, dirtyAccounts, onSaved);
+}
+
+void
+RedisBankerPersistence::
+saveAccounts(const Accounts & toSave,
+             const vector<AccountKey> & keysToSave,
+             OnSavedCallback onSaved)
 {
     /* TODO: we need to check the content of the "banker:accounts" set for
      * "extra" account keys */
@@ -145,15 +163,12 @@ saveAll(const Accounts & toSave, OnSavedCallback onSaved)
         return rhs.secondsSince(lhs) * 1000;
     };
 
-    /* fetch all account keys and values from storage */
-    auto onAccount = [&] (const AccountKey & key,
-                          const Account & account)
-        {
-            string keyStr = key.toString();
-            keys.push_back(keyStr);
-            fetchCommand.addArg(PREFIX + keyStr);
-        };
-    toSave.forEachAccount(onAccount);
+    /* fetch the account values from storage */
+    for (const AccountKey & key: keysToSave) {
+        string keyStr = key.toString();
+        keys.push_back(keyStr);
+        fetchCommand.addArg(PREFIX + keyStr);
+    }
 
     const Date beforePhase1Time = Date::now();
     auto onPhase1Result = [=] (const Redis::Result & result)
@@ -963,9 +978,30 @@ saveState()
         return;
 
     saving = true;
-    storage_->saveAll(accounts, bind(&MasterBanker::onStateSaved, this,
-                                          placeholders::_1,
-                                          placeholders::_2));
+
+    // Only the accounts that changed since the last save are written.  If
+    // the save fails they are put back so that the next attempt has them;
+    // so are the out of sync accounts, which the storage skips.
+    auto dirty = accounts.takeDirtyAccounts();
+    recordLevel(dirty.size(), "save.dirtyAccounts");
+
+    auto onSaved = [=] (const BankerPersistence::Result & result,
+                        const string & info)
+        {
+            if (result.status != BankerPersistence::SUCCESS)
+                accounts.markAccountsDirty(dirty);
+            else {
+                vector<AccountKey> skipped;
+                for (auto & key: dirty) {
+                    if (accounts.isAccountOutOfSync(key))
+                        skipped.push_back(key);
+                }
+                accounts.markAccountsDirty(skipped);
+            }
+            this->onStateSaved(result, info);
+        };
+
+    storage_->saveDirty(accounts, dirty, onSaved);
 }
 
 void
@@ -1261,26 +1297,28 @@ std::map<std::string, Account>
 MasterBanker::
 syncFromShadowBatched(const Json::Value &transfers)
 {
-    Record record(this, "syncFromShadow");
+    Record record(this, "syncFromShadowBatched");
     checkPersistence();
 
-    std::map<std::string, Account> result;
-    for (const auto& key : transfers.getMemberNames()) {
-        AccountKey account(key);
-        const auto& body = transfers[key];
+    recordLevel(transfers.size(), "syncFromShadowBatched.accounts");
 
+    // Parse everything first so that a malformed entry rejects the whole
+    // batch before any of it is applied.
+    auto keys = transfers.getMemberNames();
+    std::vector<std::pair<AccountKey, ShadowAccount> > shadows;
+    shadows.reserve(keys.size());
+    for (const auto& key : keys) {
+        const auto& body = transfers[key];
         ExcCheck(body.isMember("shadow"), "missing shadow for account " + key);
-        auto shadow = ShadowAccount::fromJson(body["shadow"]);
+        shadows.emplace_back(AccountKey(key),
+                             ShadowAccount::fromJson(body["shadow"]));
+    }
 
-        pair<bool, bool> presentActive = accounts.accountPresentAndActive(key);
+    auto synced = accounts.syncFromShadows(shadows);
 
-        if (presentActive.first && !presentActive.second) {
-            result[key] = accounts.getAccount(account);
-        }
-        else {
-            result[key] = accounts.syncFromShadow(account, shadow);
-        }
-    }
+    std::map<std::string, Account> result;
+    for (size_t i = 0;  i < keys.size();  ++i)
+        result[keys[i]] = synced[i];
 
     return result;
 }
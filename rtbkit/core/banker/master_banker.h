@@ -199,6 +199,17 @@ struct BankerPersistence {
                          OnSavedCallback onDone) = 0;
     virtual void restoreFromArchive(const AccountKey & accountName,
                          OnRestoredCallback onRestored) = 0;
+
+    /** Save the given accounts, which are the ones that were modified since
+        the last successful save.  Backends that can only write the whole
+        state save everything.
+    */
+    virtual void saveDirty(const Accounts & toSave,
+                           const std::vector<AccountKey> & dirtyAccounts,
+                           OnSavedCallback onDone)
+    {
+        saveAll(toSave, onDone);
+    }
 };
 
 
@@ -251,10 +262,16 @@ struct RedisBankerPersistence : public BankerPersistence {
 
     void loadAll(const std::string & topLevelKey, OnLoadedCallback onLoaded);
     void saveAll(const Accounts & toSave, OnSavedCallback onDone);
+    void saveDirty(const Accounts & toSave,
+                   const std::vector<AccountKey> & dirtyAccounts,
+                   OnSavedCallback onDone);
     void restoreFromArchive(const AccountKey & key, OnRestoredCallback onRestored);
 private:
     void moveToActive(const std::vector<AccountKey> & archivedAccountKeys,
                                 OnRestoredCallback onRestored);
+    void saveAccounts(const Accounts & toSave,
+                      const std::vector<AccountKey> & keysToSave,
+                      OnSavedCallback onDone);
 };
 
 /*****************************************************************************/
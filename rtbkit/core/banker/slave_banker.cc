@@ -28,6 +28,30 @@ namespace  {
         }
     }
 
+    /* The part of a shadow account that the master banker needs: its
+       running totals, without the bids that are still in flight. */
+    RTBKIT::ShadowAccount reportedSpend(const RTBKIT::ShadowAccount & account)
+    {
+        RTBKIT::ShadowAccount result;
+        result.status = account.status;
+        result.netBudget = account.netBudget;
+        result.commitmentsRetired = account.commitmentsRetired;
+        result.commitmentsMade = account.commitmentsMade;
+        result.spent = account.spent;
+        result.balance = account.balance;
+        result.lineItems = account.lineItems;
+        return result;
+    }
+
+    bool sameSpend(const RTBKIT::ShadowAccount & a,
+                   const RTBKIT::ShadowAccount & b)
+    {
+        return a.commitmentsMade == b.commitmentsMade
+            && a.commitmentsRetired == b.commitmentsRetired
+            && a.spent == b.spent
+            && a.lineItems == b.lineItems;
+    }
+
 } // namespace
 namespace RTBKIT {
 
@@ -119,7 +143,10 @@ Logging::Category SlaveBanker::error("SlaveBanker Error", SlaveBanker::print);
 Logging::Category SlaveBanker::trace("SlaveBanker Trace", SlaveBanker::print);
 
 SlaveBanker::SlaveBanker()
-    : createdAccounts(128), reauthorizing(false), numReauthorized(0)
+    : createdAccounts(128),
+      batchedUpdates(false), lastSyncLatency(0.0), lastSyncAccounts(0),
+      spendReportInFlight(false),
+      reauthorizing(false), numReauthorized(0)
 {
 }
 
@@ -129,7 +156,10 @@ SlaveBanker(
         CurrencyPool spendRate,
         double syncRate,
         bool batchedUpdates)
-    : createdAccounts(128), reauthorizing(false), numReauthorized(0)
+    : createdAccounts(128),
+      batchedUpdates(false), lastSyncLatency(0.0), lastSyncAccounts(0),
+      spendReportInFlight(false),
+      reauthorizing(false), numReauthorized(0)
 {
     init(accountSuffix, spendRate, syncRate, batchedUpdates);
 }
@@ -187,14 +217,19 @@ init(const std::string & accountSuffix,
 
     this->accountSuffix = accountSuffix;
     this->spendRate = spendRate * syncRate;
+    this->batchedUpdates = batchedUpdates;
 
     LOG(print) << "Sync Rate: " << syncRate << std::endl;
     LOG(print) << "Spend Rate: " << spendRate.toJson().toString();
 
     lastSync = lastReauthorize = Date::now();
     
+    auto reportSpendPtr = batchedUpdates ?
+        &SlaveBanker::reportSpendBatched :
+        &SlaveBanker::reportSpend;
+
     addPeriodic("SlaveBanker::reportSpend", syncRate,
-                std::bind(&SlaveBanker::reportSpend,
+                std::bind(reportSpendPtr,
                           this,
                           std::placeholders::_1),
                 true /* single threaded */);
@@ -317,25 +352,38 @@ namespace {
 
 void
 SlaveBanker::
-syncAll(std::function<void (std::exception_ptr)> onDone)
+retryStalledAccounts()
 {
-    auto allKeys = accounts.getAccountKeys();
+    for (auto k: accounts.getAccountKeys()) {
+        if (!accounts.isInitialized(k) && accounts.isStalled(k)) {
+            LOG(bankerDebug) << "CRITICAL:" << k << std::endl;
 
-    vector<AccountKey> filteredKeys;
-    for (auto k: allKeys)
-    	if (accounts.isInitialized(k))
-    		filteredKeys.push_back(k);
-        else {
-            if (accounts.isStalled(k)) {
-                LOG(bankerDebug) << "CRITICAL:" << k << std::endl;
-
-                // let's try again
-                accounts.reinitializeStalledAccount(k);
-                createdAccounts.push(k);
-            }
+            // let's try again
+            accounts.reinitializeStalledAccount(k);
+            createdAccounts.push(k);
         }
+    }
+}
 
-    allKeys.swap(filteredKeys);
+std::vector<AccountKey>
+SlaveBanker::
+getInitializedAccountKeys()
+{
+    retryStalledAccounts();
+
+    vector<AccountKey> result;
+    for (auto k: accounts.getAccountKeys())
+    	if (accounts.isInitialized(k))
+    		result.push_back(k);
+
+    return result;
+}
+
+void
+SlaveBanker::
+syncAll(std::function<void (std::exception_ptr)> onDone)
+{
+    auto allKeys = getInitializedAccountKeys();
 
     if (allKeys.empty()) {
         // We need some kind of synchronization here because the lastSync
@@ -360,6 +408,7 @@ syncAll(std::function<void (std::exception_ptr)> onDone)
             itl->numFinished = 0;
             itl->exc = nullptr;
             itl->onDone = onDone;
+            itl->started = Date::now();
         }
 
         struct Itl {
@@ -368,6 +417,7 @@ syncAll(std::function<void (std::exception_ptr)> onDone)
             int numFinished;
             std::exception_ptr exc;
             std::function<void (std::exception_ptr)> onDone;
+            Date started;
         };
 
         std::shared_ptr<Itl> itl;
@@ -381,6 +431,9 @@ syncAll(std::function<void (std::exception_ptr)> onDone)
                 if (!itl->exc) {
                     std::lock_guard<Lock> guard(itl->self->syncLock);
                     itl->self->lastSync = Date::now();
+                    itl->self->lastSyncLatency
+                        = itl->self->lastSync.secondsSince(itl->started);
+                    itl->self->lastSyncAccounts = itl->numTotal;
                 }
 
                 if (itl->onDone)
@@ -464,6 +517,133 @@ reportSpend(uint64_t numTimeoutsExpired)
     syncAll(onDone);
 }
 
+void
+SlaveBanker::
+reportSpendBatched(uint64_t numTimeoutsExpired)
+{
+    if (numTimeoutsExpired > 1) {
+        cerr << "warning: slave banker missed " << numTimeoutsExpired
+             << " timeouts" << endl;
+    }
+
+    // syncAll does this for the unbatched updates.
+    retryStalledAccounts();
+
+    auto report = std::make_shared<SpendReport>();
+
+    // Only the accounts that have changed since they were last sent go in
+    // the message.  A single report is outstanding at a time: if a newer
+    // report overtook an older one, the master would apply the older
+    // totals on top of the newer ones.
+    {
+        std::lock_guard<Lock> guard(spendReportLock);
+        if (spendReportInFlight) {
+            cerr << "warning: spend report still in progress" << endl;
+            return;
+        }
+
+        auto onAccount = [&] (const AccountKey & key,
+                              const ShadowAccount & account)
+            {
+                auto it = lastSpendSent.find(key);
+                if (it != lastSpendSent.end() && sameSpend(it->second, account))
+                    return;
+
+                report->accounts.emplace_back(key, reportedSpend(account));
+                lastSpendSent[key] = report->accounts.back().second;
+            };
+        accounts.forEachInitializedAndActiveAccount(onAccount);
+
+        if (!report->accounts.empty())
+            spendReportInFlight = true;
+    }
+
+    if (report->accounts.empty()) {
+        std::lock_guard<Lock> guard(syncLock);
+        lastSync = Date::now();
+        lastSyncLatency = 0.0;
+        lastSyncAccounts = 0;
+        return;
+    }
+
+    Json::Value request(Json::objectValue);
+    for (auto & entry: report->accounts)
+        request[getShadowAccountStr(entry.first)]["shadow"]
+            = entry.second.toJson();
+
+    report->sent = Date::now();
+
+    using std::placeholders::_1;
+    using std::placeholders::_2;
+    using std::placeholders::_3;
+    applicationLayer->request("POST", "/v1/accounts/shadow", {},
+                              request.toStringNoNewLine(),
+                              std::bind(&SlaveBanker::onReportSpendBatchedResponse,
+                                        this, report, _1, _2, _3));
+}
+
+void
+SlaveBanker::
+onReportSpendBatchedResponse(const std::shared_ptr<SpendReport> & report,
+                             std::exception_ptr exc, int code,
+                             const std::string & payload)
+{
+    bool ok = false;
+
+    if (exc)
+        logException(exc, "Exception when reporting spend", error);
+    else if (code != Default::ExpectedMasterHttpCode) {
+        LOG(error) << "Error when reporting spend" << std::endl;
+        LOG(error) << "Expected HTTP " << Default::ExpectedMasterHttpCode
+            << ", got " << code << std::endl;
+    }
+    else {
+        try {
+            Json::Value response = Json::parse(payload);
+            for (const auto& key : response.getMemberNames()) {
+                auto account = Account::fromJson(response[key]);
+                accounts.syncFromMaster(AccountKey(key).parent(), account);
+            }
+            ok = true;
+        } catch (...) {
+            logException(std::current_exception(),
+                         "Exception when handling the spend report response",
+                         error);
+        }
+    }
+
+    {
+        std::lock_guard<Lock> guard(spendReportLock);
+        spendReportInFlight = false;
+
+        // The master applies a report all or nothing, so on failure every
+        // account in it has to be sent again.
+        if (!ok) {
+            for (auto & entry: report->accounts)
+                lastSpendSent.erase(entry.first);
+        }
+    }
+
+    if (ok) {
+        std::lock_guard<Lock> guard(syncLock);
+        lastSync = Date::now();
+        lastSyncLatency = lastSync.secondsSince(report->sent);
+        lastSyncAccounts = report->accounts.size();
+    }
+}
+
+void
+SlaveBanker::
+logBidEvents(const Datacratic::EventRecorder & eventRecorder)
+{
+    accounts.logBidEvents(eventRecorder);
+
+    std::lock_guard<Lock> guard(syncLock);
+    eventRecorder.recordLevel(lastSyncLatency * 1000.0,
+                              "banker.sync.latencyMs");
+    eventRecorder.recordLevel(lastSyncAccounts, "banker.sync.accounts");
+}
+
 void
 SlaveBanker::
 reauthorizeBudgetBatched(uint64_t numTimeoutsExpired)
@@ -663,7 +843,7 @@ SlaveBankerArguments::makeProgramOptions(std::string title)
         ("banker-sync-rate", po::value<double>(&syncRate),
          "frequency at which the slave banker syncs itself with the master banker.")
         ("banker-batched", po::bool_switch(&batched),
-         "slave banker now uses batched communication to sync with the master banker.")
+         "slave banker reports spend and reauthorizes budget with the master banker in one message per sync period.")
         ("use-http-banker", po::bool_switch(&useHttp),
          "Communicate with the MasterBanker over http")
         ("banker-http-timeouts", po::value<double>(&httpTimeout),
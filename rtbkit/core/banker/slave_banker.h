@@ -244,10 +244,7 @@ struct SlaveBanker : public Banker, public MessageLoop {
     }
 
     /* Logging */
-    virtual void logBidEvents(const Datacratic::EventRecorder & eventRecorder)
-    {
-        accounts.logBidEvents(eventRecorder);
-    }
+    virtual void logBidEvents(const Datacratic::EventRecorder & eventRecorder);
 
     /* Monitor */
     virtual MonitorIndicator getProviderIndicators() const;
@@ -276,6 +273,35 @@ private:
     void reportSpend(uint64_t numTimeoutsExpired);
     Date reportSpendSent;
 
+    /** Batched version of reportSpend: the accounts that changed since the
+        last report are sent to the master in a single message.
+    */
+    void reportSpendBatched(uint64_t numTimeoutsExpired);
+
+    struct SpendReport {
+        Date sent;
+        std::vector<std::pair<AccountKey, ShadowAccount> > accounts;
+    };
+
+    void onReportSpendBatchedResponse(const std::shared_ptr<SpendReport> & report,
+                                      std::exception_ptr exc, int code,
+                                      const std::string & payload);
+
+    /// Request again the accounts whose initialization has stalled
+    void retryStalledAccounts();
+
+    /// Keys of the initialized accounts.  Stalled accounts are retried.
+    std::vector<AccountKey> getInitializedAccountKeys();
+
+    bool batchedUpdates;
+    double lastSyncLatency;      ///< Seconds taken by the last full sync
+    size_t lastSyncAccounts;     ///< Accounts sent in the last full sync
+
+    mutable Lock spendReportLock;
+    bool spendReportInFlight;    ///< A batched report awaits an answer
+    /// Last state sent to the master for each account
+    std::unordered_map<AccountKey, ShadowAccount> lastSpendSent;
+
     /** Periodically we ask the banker to re-authorize our budget. */
     void reauthorizeBudget(uint64_t numTimeoutsExpired);
     CurrencyPool spendRate;
@@ -473,6 +473,51 @@ BOOST_AUTO_TEST_CASE( test_accounts )
     cerr << accounts.getAccountSummary(budget) << endl;
 }
 
+BOOST_AUTO_TEST_CASE( test_sync_from_shadows_all_or_nothing )
+{
+    Accounts accounts;
+
+    AccountKey budget("budget");
+    AccountKey spendA("budget:a");
+    AccountKey spendB("budget:b");
+
+    accounts.createBudgetAccount(budget);
+    accounts.createSpendAccount(spendA);
+    accounts.createSpendAccount(spendB);
+    accounts.setBudget(budget, USD(10));
+    accounts.setBalance(spendA, USD(2), AT_SPEND);
+    accounts.setBalance(spendB, USD(2), AT_SPEND);
+
+    auto shadowThatSpent = [] (Amount amount)
+        {
+            ShadowAccount result;
+            result.netBudget = amount;
+            result.spent = amount;
+            return result;
+        };
+
+    accounts.syncFromShadows({ { spendA, shadowThatSpent(USD(1)) },
+                               { spendB, shadowThatSpent(USD(1)) } });
+
+    BOOST_CHECK_EQUAL(accounts.getAccount(spendA).spent, USD(1));
+    BOOST_CHECK_EQUAL(accounts.getAccount(spendB).spent, USD(1));
+
+    // The second entry goes backwards, as a stale report would; the first
+    // must not be applied either.
+    {
+        ML::Set_Trace_Exceptions notrace(false);
+        BOOST_CHECK_THROW(
+            accounts.syncFromShadows({ { spendA, shadowThatSpent(USD(1.5)) },
+                                       { spendB, shadowThatSpent(USD(0.5)) } }),
+            std::exception);
+    }
+
+    BOOST_CHECK_EQUAL(accounts.getAccount(spendA).spent, USD(1));
+    BOOST_CHECK_EQUAL(accounts.getAccount(spendB).spent, USD(1));
+    BOOST_CHECK_EQUAL(accounts.getBalance(spendA), USD(1));
+    accounts.checkInvariants();
+}
+
 BOOST_AUTO_TEST_CASE( test_multiple_bidder_threads )
 {
     Accounts master;
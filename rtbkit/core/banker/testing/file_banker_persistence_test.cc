@@ -0,0 +1,297 @@
+/* file_banker_persistence_test.cc
+   Copyright (c) 2014 Datacratic.  All rights reserved.
+
+   Unit tests for the FileBankerPersistence class.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <fstream>
+#include <stdlib.h>
+
+#include "rtbkit/core/banker/file_banker_persistence.h"
+
+using namespace std;
+using namespace Datacratic;
+using namespace RTBKIT;
+
+namespace {
+
+struct TemporaryDirectory {
+    TemporaryDirectory()
+    {
+        char tmpl[] = "/tmp/file_banker_persistence_test.XXXXXX";
+        if (!mkdtemp(tmpl))
+            throw ML::Exception(errno, "mkdtemp");
+        path = tmpl;
+    }
+
+    ~TemporaryDirectory()
+    {
+        int res = system(("rm -rf " + path).c_str());
+        (void) res;
+    }
+
+    string path;
+};
+
+shared_ptr<Accounts> load(FileBankerPersistence & storage,
+                          BankerPersistence::PersistenceCallbackStatus
+                              expectedStatus = BankerPersistence::SUCCESS)
+{
+    shared_ptr<Accounts> result;
+    auto onLoaded = [&] (shared_ptr<Accounts> accounts,
+                         BankerPersistence::PersistenceCallbackStatus status,
+                         const string & info)
+        {
+            BOOST_CHECK_EQUAL(status, expectedStatus);
+            result = accounts;
+        };
+    storage.loadAll("", onLoaded);
+    return result;
+}
+
+void saveDirty(FileBankerPersistence & storage, Accounts & accounts)
+{
+    auto onSaved = [&] (const BankerPersistence::Result & result,
+                        const string & info)
+        {
+            BOOST_CHECK_EQUAL(result.status, BankerPersistence::SUCCESS);
+        };
+    storage.saveDirty(accounts, accounts.takeDirtyAccounts(), onSaved);
+}
+
+void createAccounts(Accounts & accounts, int numCampaigns)
+{
+    for (int i = 0;  i < numCampaigns;  ++i) {
+        AccountKey campaign("campaign" + to_string(i));
+        accounts.createBudgetAccount(campaign);
+        accounts.setBudget(campaign, USD(100));
+        accounts.setBalance(campaign.childKey("strategy"), USD(10), AT_SPEND);
+    }
+}
+
+} // file scope
+
+BOOST_AUTO_TEST_CASE( test_save_and_load )
+{
+    TemporaryDirectory dir;
+
+    Accounts accounts;
+    createAccounts(accounts, 3);
+
+    {
+        FileBankerPersistence storage(dir.path);
+
+        /* nothing stored yet */
+        auto loaded = load(storage);
+        BOOST_REQUIRE(loaded);
+        BOOST_CHECK_EQUAL(loaded->size(), 0);
+
+        saveDirty(storage, accounts);
+        BOOST_CHECK_EQUAL(storage.logRecords(), 6);
+
+        /* only the modified account and its parent are appended */
+        accounts.setBalance(AccountKey("campaign1:strategy"), USD(5), AT_SPEND);
+        saveDirty(storage, accounts);
+        BOOST_CHECK_EQUAL(storage.logRecords(), 8);
+
+        /* nothing to write */
+        saveDirty(storage, accounts);
+        BOOST_CHECK_EQUAL(storage.logRecords(), 8);
+    }
+
+    FileBankerPersistence storage(dir.path);
+    auto loaded = load(storage);
+    BOOST_REQUIRE(loaded);
+    BOOST_CHECK_EQUAL(loaded->toJson(), accounts.toJson());
+    BOOST_CHECK_EQUAL(storage.logRecords(), 8);
+}
+
+BOOST_AUTO_TEST_CASE( test_torn_log_record )
+{
+    TemporaryDirectory dir;
+
+    Accounts accounts;
+    createAccounts(accounts, 2);
+
+    FileBankerPersistence storage(dir.path);
+    saveDirty(storage, accounts);
+    Json::Value expected = accounts.toJson();
+
+    /* a crash in the middle of an append leaves a partial last line */
+    {
+        ofstream stream(storage.logPath().c_str(), ios::app);
+        stream << "campaign0:strategy\t{\"md\":{\"objectType\":";
+    }
+
+    auto loaded = load(storage);
+    BOOST_REQUIRE(loaded);
+    BOOST_CHECK_EQUAL(loaded->toJson(), expected);
+
+    /* the torn record is dropped before appending again */
+    accounts.setBalance(AccountKey("campaign0:strategy"), USD(1), AT_SPEND);
+    saveDirty(storage, accounts);
+
+    loaded = load(storage);
+    BOOST_REQUIRE(loaded);
+    BOOST_CHECK_EQUAL(loaded->toJson(), accounts.toJson());
+
+    /* corruption anywhere but at the end is an error */
+    {
+        ofstream stream(storage.logPath().c_str(), ios::app);
+        stream << "campaign0:strategy\tnot json\n";
+        stream << "campaign1:strategy\t{}\n";
+    }
+
+    load(storage, BankerPersistence::DATA_INCONSISTENCY);
+}
+
+BOOST_AUTO_TEST_CASE( test_compaction )
+{
+    TemporaryDirectory dir;
+
+    Accounts accounts;
+    createAccounts(accounts, 5);
+
+    FileBankerPersistence storage(dir.path, 12);
+    saveDirty(storage, accounts);
+    BOOST_CHECK_EQUAL(storage.logRecords(), 10);
+
+    accounts.setBalance(AccountKey("campaign0:strategy"), USD(1), AT_SPEND);
+    saveDirty(storage, accounts);
+
+    /* 12 records reached the limit: everything went into a snapshot */
+    BOOST_CHECK_EQUAL(storage.logRecords(), 0);
+
+    accounts.setBalance(AccountKey("campaign1:strategy"), USD(1), AT_SPEND);
+    saveDirty(storage, accounts);
+    BOOST_CHECK_EQUAL(storage.logRecords(), 2);
+
+    auto loaded = load(storage);
+    BOOST_REQUIRE(loaded);
+    BOOST_CHECK_EQUAL(loaded->toJson(), accounts.toJson());
+
+    /* a log left over from an older generation, as after a crash between
+       the snapshot and the truncation of the log, is not replayed */
+    {
+        ofstream stream(storage.logPath().c_str(), ios::trunc);
+        stream << "generation\t0\n";
+        stream << "campaign2:strategy\t{\"bogus\":true}\n";
+    }
+
+    loaded = load(storage);
+    BOOST_REQUIRE(loaded);
+    BOOST_CHECK_EQUAL(storage.logRecords(), 0);
+
+    Json::Value expected = accounts.toJson();
+    expected.removeMember("campaign1:strategy");
+    expected.removeMember("campaign1");
+    Json::Value actual = loaded->toJson();
+    actual.removeMember("campaign1:strategy");
+    actual.removeMember("campaign1");
+    BOOST_CHECK_EQUAL(actual, expected);
+
+    /* saveAll always writes a snapshot */
+    auto onSaved = [&] (const BankerPersistence::Result & result,
+                        const string & info)
+        {
+            BOOST_CHECK_EQUAL(result.status, BankerPersistence::SUCCESS);
+        };
+    storage.saveAll(accounts, onSaved);
+    BOOST_CHECK_EQUAL(storage.logRecords(), 0);
+
+    loaded = load(storage);
+    BOOST_REQUIRE(loaded);
+    BOOST_CHECK_EQUAL(loaded->toJson(), accounts.toJson());
+}
+
+BOOST_AUTO_TEST_CASE( test_closed_accounts )
+{
+    TemporaryDirectory dir;
+
+    Accounts accounts;
+    createAccounts(accounts, 2);
+    accounts.closeAccount(AccountKey("campaign1"));
+
+    FileBankerPersistence storage(dir.path);
+    saveDirty(storage, accounts);
+
+    /* closed accounts are archived rather than loaded */
+    auto loaded = load(storage);
+    BOOST_REQUIRE(loaded);
+    BOOST_CHECK_EQUAL(loaded->size(), 2);
+    BOOST_CHECK(!loaded->accountPresentAndActive(AccountKey("campaign1")).first);
+
+    shared_ptr<Accounts> restored;
+    auto onRestored = [&] (shared_ptr<Accounts> accounts,
+                           BankerPersistence::PersistenceCallbackStatus status,
+                           const string & info)
+        {
+            BOOST_CHECK_EQUAL(status, BankerPersistence::SUCCESS);
+            restored = accounts;
+        };
+
+    /* restoring a child brings back its parent */
+    storage.restoreFromArchive(AccountKey("campaign1:strategy"), onRestored);
+    BOOST_REQUIRE(restored);
+    BOOST_CHECK_EQUAL(restored->size(), 2);
+    BOOST_CHECK(restored->accountPresentAndActive(AccountKey("campaign1")).second);
+
+    /* restoring the parent brings back its children */
+    restored.reset();
+    storage.restoreFromArchive(AccountKey("campaign1"), onRestored);
+    BOOST_REQUIRE(restored);
+    BOOST_CHECK_EQUAL(restored->size(), 2);
+
+    /* active accounts are not in the archive */
+    restored.reset();
+    storage.restoreFromArchive(AccountKey("campaign0"), onRestored);
+    BOOST_REQUIRE(restored);
+    BOOST_CHECK_EQUAL(restored->size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE( test_closed_accounts_survive_compaction )
+{
+    TemporaryDirectory dir;
+
+    {
+        Accounts accounts;
+        createAccounts(accounts, 2);
+        accounts.closeAccount(AccountKey("campaign1"));
+
+        FileBankerPersistence storage(dir.path);
+        saveDirty(storage, accounts);
+    }
+
+    /* after a restart the closed campaign is only in the archive; a
+       compaction must not lose it */
+    FileBankerPersistence storage(dir.path, 1);
+    auto loaded = load(storage);
+    BOOST_REQUIRE(loaded);
+    BOOST_CHECK_EQUAL(loaded->size(), 2);
+
+    loaded->setBalance(AccountKey("campaign0:strategy"), USD(1), AT_SPEND);
+    saveDirty(storage, *loaded);
+    BOOST_CHECK_EQUAL(storage.logRecords(), 0);
+
+    loaded = load(storage);
+    BOOST_REQUIRE(loaded);
+    BOOST_CHECK_EQUAL(loaded->size(), 2);
+
+    shared_ptr<Accounts> restored;
+    auto onRestored = [&] (shared_ptr<Accounts> accounts,
+                           BankerPersistence::PersistenceCallbackStatus status,
+                           const string & info)
+        {
+            BOOST_CHECK_EQUAL(status, BankerPersistence::SUCCESS);
+            restored = accounts;
+        };
+
+    storage.restoreFromArchive(AccountKey("campaign1"), onRestored);
+    BOOST_REQUIRE(restored);
+    BOOST_CHECK_EQUAL(restored->size(), 2);
+    BOOST_CHECK(restored->accountPresentAndActive(AccountKey("campaign1:strategy")).second);
+}
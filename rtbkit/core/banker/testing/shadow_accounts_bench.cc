@@ -0,0 +1,97 @@
+/* shadow_accounts_bench.cc
+   Copyright (c) 2014 Datacratic.  All rights reserved.
+
+   Measures how ShadowAccounts throughput scales when several bidding
+   threads authorize, commit and cancel bids against a shared set of
+   accounts, the way the router's auction shards do.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/barrier.hpp>
+#include "rtbkit/core/banker/account.h"
+#include "jml/arch/timers.h"
+#include "jml/arch/format.h"
+#include <iostream>
+
+using namespace std;
+using namespace ML;
+using namespace Datacratic;
+using namespace RTBKIT;
+
+BOOST_AUTO_TEST_CASE( shadow_accounts_bench )
+{
+    enum { NumAccounts = 64, OpsPerThread = 200000 };
+
+    Accounts accounts;
+    AccountKey budget("budget");
+    accounts.createBudgetAccount(budget);
+    accounts.setBudget(budget, USD(1000));
+
+    vector<AccountKey> keys;
+    for (unsigned i = 0;  i < NumAccounts;  ++i) {
+        AccountKey key(ML::format("budget:strategy%d", i));
+        accounts.createSpendAccount(key);
+        accounts.setBalance(key, USD(10), AT_SPEND);
+        keys.push_back(key);
+    }
+
+    for (int numThreads: { 1, 2, 4, 8 }) {
+        ShadowAccounts shadow;
+        for (auto & key: keys)
+            shadow.activateAccount(key);
+        shadow.syncFrom(accounts);
+
+        boost::barrier barrier(numThreads + 1);
+        uint64_t authorized[8] = { 0 };
+
+        auto doThread = [&] (int thread)
+            {
+                string item = ML::format("thread%d-", thread);
+                size_t prefix = item.size();
+
+                barrier.wait();
+
+                for (unsigned i = 0;  i < OpsPerThread;  ++i) {
+                    const AccountKey & key
+                        = keys[(i * 7 + thread * 13) % NumAccounts];
+                    item.resize(prefix);
+                    item += std::to_string(i);
+
+                    if (!shadow.authorizeBid(key, item, MicroUSD(100)))
+                        continue;
+                    ++authorized[thread];
+
+                    if (i % 4 == 0) {
+                        Amount detached = shadow.detachBid(key, item);
+                        shadow.commitDetachedBid(key, detached, MicroUSD(50),
+                                                 LineItems());
+                    }
+                    else shadow.cancelBid(key, item);
+                }
+            };
+
+        boost::thread_group threads;
+        for (int i = 0;  i < numThreads;  ++i)
+            threads.create_thread(std::bind<void>(doThread, i));
+
+        ML::Timer timer;
+        barrier.wait();
+        threads.join_all();
+        double elapsed = timer.elapsed_wall();
+
+        uint64_t total = 0;
+        for (int i = 0;  i < numThreads;  ++i)
+            total += authorized[i];
+
+        BOOST_CHECK_EQUAL(total, (uint64_t)numThreads * OpsPerThread);
+        shadow.checkInvariants();
+
+        cerr << ML::format("%d threads: %12.0f authorizations/second",
+                           numThreads, total / elapsed)
+             << endl;
+    }
+}
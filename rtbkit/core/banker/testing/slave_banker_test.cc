@@ -7,6 +7,7 @@
 #define BOOST_TEST_MAIN
 #define BOOST_TEST_DYN_LINK
 #include <memory>
+#include <atomic>
 #include <boost/test/unit_test.hpp>
 #include "jml/arch/format.h"
 #include "jml/arch/exception_handler.h"
@@ -183,6 +184,153 @@ BOOST_AUTO_TEST_CASE( test_initialization_and_spending )
 }
 #endif
 
+#if 1
+BOOST_AUTO_TEST_CASE( test_batched_spend_reporting )
+{
+    /* With batched updates the slave reports the spend of all its accounts
+       to the master in a single message per sync period.
+    */
+
+    ZooKeeper::TemporaryServer zookeeper;
+    zookeeper.start();
+
+    auto proxies = std::make_shared<ServiceProxies>();
+    proxies->useZookeeper(ML::format("localhost:%d", zookeeper.getPort()));
+
+    MasterBanker master(proxies);
+    master.init(make_shared<NoBankerPersistence>());
+    master.bindTcp();
+    master.start();
+
+    SlaveBudgetController slave;
+    slave.setApplicationLayer(make_application_layer<ZmqLayer>(proxies));
+    slave.start();
+
+    vector<AccountKey> keys;
+    for (unsigned i = 0;  i < 10;  ++i) {
+        AccountKey key{"hello", "world" + to_string(i)};
+        slave.addAccountSync(key);
+        keys.push_back(key);
+    }
+    slave.setBudgetSync("hello", USD(200));
+    for (auto & key: keys)
+        slave.topupTransferSync(key, USD(10));
+
+    SlaveBanker banker("slave", USD(1), 0.1 /* syncRate */,
+                       true /* batchedUpdates */);
+    banker.setApplicationLayer(make_application_layer<ZmqLayer>(proxies));
+    banker.start();
+
+    for (auto & key: keys)
+        banker.addSpendAccountSync(key);
+
+    // Spend $1 in each account and let the periodic sync report it
+    for (auto & key: keys)
+        banker.forceWinBid(key, USD(1), LineItems());
+
+    ML::sleep(1.0);
+
+    CurrencyPool total = USD(1);
+    total += Amount(CurrencyCode::CC_IMP, 1);
+
+    for (auto & key: keys) {
+        auto summ = slave.getAccountSummarySync(key, 1 /* depth */);
+        BOOST_CHECK_EQUAL(summ.spent, total);
+    }
+
+    banker.shutdown();
+}
+#endif
+
+#if 1
+namespace {
+
+/* ZeroMQ layer whose first addSpendAccount fails, leaving the account
+   uninitialized on the slave until it is retried.
+*/
+struct FailFirstSpendAccountLayer : public ZmqLayer {
+    std::atomic<int> failuresLeft { 1 };
+
+    void addSpendAccount(const std::string & shadowStr,
+                         std::function<void (std::exception_ptr, Account&&)> onDone)
+    {
+        if (failuresLeft.fetch_sub(1) > 0) {
+            auto exc = std::make_exception_ptr(
+                    ML::Exception("simulated addSpendAccount failure"));
+            onDone(exc, Account());
+            return;
+        }
+        ZmqLayer::addSpendAccount(shadowStr, onDone);
+    }
+};
+
+} // file scope
+
+BOOST_AUTO_TEST_CASE( test_batched_stalled_account_recovers )
+{
+    /* An account whose initialization failed is stalled after a minute.  The
+       batched updates must request it again like the unbatched ones do, after
+       which its spend reaches the master.
+    */
+
+    ZooKeeper::TemporaryServer zookeeper;
+    zookeeper.start();
+
+    auto proxies = std::make_shared<ServiceProxies>();
+    proxies->useZookeeper(ML::format("localhost:%d", zookeeper.getPort()));
+
+    MasterBanker master(proxies);
+    master.init(make_shared<NoBankerPersistence>());
+    master.bindTcp();
+    master.start();
+
+    SlaveBudgetController slave;
+    slave.setApplicationLayer(make_application_layer<ZmqLayer>(proxies));
+    slave.start();
+
+    AccountKey key{"hello", "world"};
+    slave.addAccountSync(key);
+    slave.setBudgetSync("hello", USD(200));
+    slave.topupTransferSync(key, USD(10));
+
+    SlaveBanker banker("slave", USD(1), 0.1 /* syncRate */,
+                       true /* batchedUpdates */);
+    banker.setApplicationLayer(
+            make_application_layer<FailFirstSpendAccountLayer>(proxies));
+    banker.start();
+
+    BOOST_CHECK_THROW(banker.addSpendAccountSync(key), std::exception);
+
+    // The account is only considered stalled a minute after it was requested
+    AccountKey shadowKey = key.childKey("slave");
+    bool recovered = false;
+    Date deadline = Date::now().plusSeconds(90.0);
+    while (!recovered && Date::now() < deadline) {
+        ML::sleep(1.0);
+        try {
+            slave.getAccountSync(shadowKey);
+            recovered = true;
+        } catch (const std::exception &) {
+            // not created on the master yet
+        }
+    }
+    BOOST_REQUIRE(recovered);
+
+    // Let the slave initialize its side before spending
+    ML::sleep(1.0);
+    banker.forceWinBid(key, USD(1), LineItems());
+    ML::sleep(1.0);
+
+    CurrencyPool total = USD(1);
+    total += Amount(CurrencyCode::CC_IMP, 1);
+
+    auto summ = slave.getAccountSummarySync(key, 1 /* depth */);
+    BOOST_CHECK_EQUAL(summ.spent, total);
+
+    banker.shutdown();
+}
+#endif
+
 #if 1
 BOOST_AUTO_TEST_CASE( test_bidding_with_slave )
 {
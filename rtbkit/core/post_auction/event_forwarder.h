@@ -60,16 +60,16 @@ struct EventForwarder :
 
     void forwardAuction(std::shared_ptr<SubmittedAuctionEvent> auction)
     {
-        recordHit("auctions.received");
+        auctionsReceived.hit();
         if (!auctionQueue.tryPush(auction))
-            recordHit("auctions.dropped");
+            auctionsDropped.hit();
     }
 
     void forwardEvent(std::shared_ptr<PostAuctionEvent> event)
     {
-        recordHit("events.received");
+        eventsReceived.hit();
         if (!eventQueue.tryPush(event))
-            recordHit("events.dropped");
+            eventsDropped.hit();
     }
 
 
@@ -79,6 +79,11 @@ private:
     {
         MessageLoop::init();
 
+        auctionsReceived = counterHandle("auctions.received");
+        auctionsDropped = counterHandle("auctions.dropped");
+        eventsReceived = counterHandle("events.received");
+        eventsDropped = counterHandle("events.dropped");
+
         client.sendExpect100Continue(false);
 
         using std::placeholders::_1;
@@ -131,6 +136,11 @@ private:
         send("events", *event);
     }
 
+    Datacratic::CounterHandle auctionsReceived;
+    Datacratic::CounterHandle auctionsDropped;
+    Datacratic::CounterHandle eventsReceived;
+    Datacratic::CounterHandle eventsDropped;
+
     HttpClient client;
     TypedMessageSink< std::shared_ptr< SubmittedAuctionEvent> > auctionQueue;
     TypedMessageSink< std::shared_ptr< PostAuctionEvent> > eventQueue;
@@ -15,6 +15,7 @@
 #include "soa/service/service_base.h"
 
 #include <utility>
+#include <vector>
 
 
 namespace RTBKIT {
@@ -28,7 +29,8 @@ struct EventMatcher : public EventRecorder
     enum
     {
         DefaultAuctionTimeout = 15 * 60,
-        DefaultWinTimeout = 1 * 60 * 60
+        DefaultWinTimeout = 1 * 60 * 60,
+        DefaultMaxFinishedInMemory = 1 << 20
     };
 
     EventMatcher(std::string prefix, std::shared_ptr<EventService> events) :
@@ -102,6 +104,20 @@ struct EventMatcher : public EventRecorder
     /** Handle a post-auction event that came in. */
     virtual void doEvent(std::shared_ptr<PostAuctionEvent> event) = 0;
 
+    /** Handle several auctions that came in together. */
+    virtual void doAuctions(
+            std::vector< std::shared_ptr<SubmittedAuctionEvent> > events)
+    {
+        for (auto& event : events) doAuction(std::move(event));
+    }
+
+    /** Handle several post-auction events that came in together. */
+    virtual void doEvents(
+            std::vector< std::shared_ptr<PostAuctionEvent> > events)
+    {
+        for (auto& event : events) doEvent(std::move(event));
+    }
+
     /** Periodic auction expiry. */
     virtual void checkExpiredAuctions() = 0;
 
@@ -110,7 +126,14 @@ struct EventMatcher : public EventRecorder
     /* PERSISTENCE                                                          */
     /************************************************************************/
 
-    virtual void initStatePersistence(const std::string & path) {}
+    /** Keep the matching state in the given directory so that it survives
+        a restart, holding at most maxFinishedInMemory finished auctions in
+        memory.  Must be called before any auction comes in.
+    */
+    virtual void initStatePersistence(
+            const std::string & path,
+            size_t maxFinishedInMemory = DefaultMaxFinishedInMemory)
+    {}
 
 
 protected:
@@ -79,6 +79,51 @@ toJson() const
     return result;
 }
 
+void
+FinishedInfo::
+serialize(DB::Store_Writer & store) const
+{
+    unsigned char version = 1;
+    store << version << auctionTime << auctionId << adSpotId << spotIndex
+          << bidRequestStr << bidRequestStrFormat << augmentations << uids
+          << visitChannels << bidTime << bid
+          << winTime << DB::compact_size_t(reportedStatus)
+          << winPrice << rawWinPrice << winMeta;
+
+    store << DB::compact_size_t(campaignEvents.size());
+    for (const CampaignEvent & event : campaignEvents)
+        event.serialize(store);
+
+    store << visits;
+}
+
+void
+FinishedInfo::
+reconstitute(DB::Store_Reader & store)
+{
+    unsigned char version;
+    store >> version;
+    if (version != 1)
+        throw ML::Exception("unknown FinishedInfo version %d", (int)version);
+
+    store >> auctionTime >> auctionId >> adSpotId >> spotIndex
+          >> bidRequestStr >> bidRequestStrFormat >> augmentations >> uids
+          >> visitChannels >> bidTime >> bid >> winTime;
+
+    DB::compact_size_t status(store);
+    reportedStatus = BidStatus(size_t(status));
+
+    store >> winPrice >> rawWinPrice >> winMeta;
+
+    DB::compact_size_t numEvents(store);
+    campaignEvents.clear();
+    campaignEvents.resize(numEvents);
+    for (CampaignEvent & event : campaignEvents)
+        event.reconstitute(store);
+
+    store >> visits;
+}
+
 void
 FinishedInfo::Visit::
 serialize(DB::Store_Writer & store) const
@@ -98,6 +143,4 @@ reconstitute(DB::Store_Reader & store)
     store >> visitTime >> channels >> meta;
 }
 
-IMPL_SERIALIZE_RECONSTITUTE(FinishedInfo::Visit);
-
 } // namepsace RTBKIT
@@ -127,8 +127,14 @@ struct FinishedInfo {
 
     Json::Value toJson() const;
 
+    void serialize(ML::DB::Store_Writer & store) const;
+    void reconstitute(ML::DB::Store_Reader & store);
+
     bool fromOldRouter;
 };
 
+IMPL_SERIALIZE_RECONSTITUTE(FinishedInfo::Visit);
+IMPL_SERIALIZE_RECONSTITUTE(FinishedInfo);
+
 
 } // namespace RTBKIT
@@ -41,8 +41,10 @@ static Json::Value loadJsonFromFile(const std::string & filename)
 PostAuctionRunner::
 PostAuctionRunner() :
     shard(0),
+    matcherShards(1),
     auctionTimeout(EventMatcher::DefaultAuctionTimeout),
     winTimeout(EventMatcher::DefaultWinTimeout),
+    maxFinishedInMemory(EventMatcher::DefaultMaxFinishedInMemory),
     bidderConfigurationFile("rtbkit/examples/bidder-config.json"),
     analyticsConfigurationFile(""),
     winLossPipeTimeout(PostAuctionService::DefaultWinLossPipeTimeout),
@@ -68,10 +70,16 @@ doOptions(int argc, char ** argv,
          "configuration file for analytics")
         ("shard,s", value<size_t>(&shard),
          "Shard index starting at 0 for this post auction loop")
+        ("matcher-shards", value<size_t>(&matcherShards),
+         "Number of threads matching events within this post auction loop")
         ("win-seconds", value<float>(&winTimeout),
          "Timeout for storing win auction")
         ("auction-seconds", value<float>(&auctionTimeout),
          "Timeout to get late win auction")
+        ("persistence-dir", value<string>(&persistenceDir),
+         "Directory where finished auctions are kept across restarts")
+        ("max-finished-in-memory", value<size_t>(&maxFinishedInMemory),
+         "Number of persisted finished auctions kept in memory")
         ("winlossPipe-seconds", value<int>(&winLossPipeTimeout),
          "Timeout before sending error on WinLoss pipe")
         ("campaignEventPipe-seconds", value<int>(&campaignEventPipeTimeout),
@@ -80,6 +88,8 @@ doOptions(int argc, char ** argv,
          "Send data to analytics logger.")
         ("analyticsPublisher-connections", value<int>(&analyticsPublisherConnections),
          "Number of connections for the analytics publisher.")
+        ("analyticsPublisher-compression", value<string>(&analyticsPublisherCompression),
+         "Compression of the events sent by the analytics publisher (none or gzip).")
         ("forward-auctions", value<std::string>(&forwardAuctionsUri),
          "When provided the PAL will forward all auctions to the given URI.")
         ("local-banker", value<string>(&localBankerUri),
@@ -127,7 +137,13 @@ init()
     postAuctionLoop = std::make_shared<PostAuctionService>(proxies, serviceName);
     postAuctionLoop->initBidderInterface(bidderConfig);
     postAuctionLoop->initAnalytics(analyticsConfig);
-    postAuctionLoop->init(shard);
+    postAuctionLoop->init(shard, matcherShards);
+
+    if (!persistenceDir.empty()) {
+        LOG(print) << "persisting finished auctions in " << persistenceDir
+                   << std::endl;
+        postAuctionLoop->initStatePersistence(persistenceDir, maxFinishedInMemory);
+    }
 
     postAuctionLoop->setWinTimeout(winTimeout);
     postAuctionLoop->setAuctionTimeout(auctionTimeout);
@@ -177,7 +193,8 @@ init()
     if (analyticsPublisherOn) {
         const auto & analyticsPublisherUri = proxies->params["analytics-uri"].asString();
         if (!analyticsPublisherUri.empty()) {
-            postAuctionLoop->initAnalyticsPublisher(analyticsPublisherUri, analyticsPublisherConnections);
+            postAuctionLoop->initAnalyticsPublisher(analyticsPublisherUri, analyticsPublisherConnections,
+                    analyticsPublisherCompression);
         }
         else
             LOG(print) << "analyticsPublisher-uri is not in the config" << endl;
@@ -29,8 +29,11 @@ struct PostAuctionRunner {
     SlaveBankerArguments bankerArgs;
 
     size_t shard;
+    size_t matcherShards;
     float auctionTimeout;
     float winTimeout;
+    std::string persistenceDir;
+    size_t maxFinishedInMemory;
     std::string bidderConfigurationFile;
     std::string analyticsConfigurationFile;
 
@@ -38,6 +41,7 @@ struct PostAuctionRunner {
     int campaignEventPipeTimeout;
     bool analyticsPublisherOn;
     int analyticsPublisherConnections;
+    std::string analyticsPublisherCompression;
 
     std::string forwardAuctionsUri;
     std::string localBankerUri;
@@ -104,12 +104,27 @@ bindTcp()
     }
 }
 
+PostAuctionService::HotEvents::
+HotEvents(const EventRecorder & recorder)
+    : auctionMessages(recorder.counterHandle("messages.AUCTION")),
+      auctionBatchMessages(recorder.counterHandle("messages.AUCTIONS")),
+      auctionBatchAuctions(recorder.counterHandle("messages.AUCTIONS.auctions")),
+      winMessages(recorder.counterHandle("messages.WIN")),
+      lossMessages(recorder.counterHandle("messages.LOSS")),
+      campaignEventMessages(recorder.counterFamily("messages.EVENT.%s")),
+      delivered(recorder.counterFamily("%s.delivered")),
+      orphaned(recorder.counterFamily("%s.orphaned"))
+{
+}
+
 void
 PostAuctionService::
 init(size_t externalShard, size_t internalShards)
 {
     recordHit("up");
 
+    hotEvents = HotEvents(*this);
+
     // Loop monitor is purely for monitoring purposes. There's no message we can
     // just drop in the PAL to alleviate the load.
     loopMonitor.init();
@@ -163,9 +178,14 @@ initMatcher(size_t shards)
         LOG(print) << "Creating ShardedEventMatcher with " << shards << " shards"
             << endl;
 
+        // Optional list of cpus to pin the matcher shards to.
+        std::vector<int> cpus;
+        for (const auto & cpu : getServices()->params["postAuctionMatcherCpus"])
+            cpus.push_back(cpu.asInt());
+
         ShardedEventMatcher* m;
         matcher.reset(m = new ShardedEventMatcher(serviceName(), getServices()));
-        m->init(shards);
+        m->init(shards, std::move(cpus));
         loop.addSource("PostAuctionService::matcher", *m);
     }
 
@@ -214,6 +234,7 @@ initConnections(size_t shard)
     endpoint.init(getServices()->config, ZMQ_XREP, serviceName() + "/events");
 
     router.bind("AUCTION", std::bind(&PostAuctionService::doAuctionMessage, this, _1));
+    router.bind("AUCTIONS", std::bind(&PostAuctionService::doAuctionBatchMessage, this, _1));
     router.bind("WIN", std::bind(&PostAuctionService::doWinMessage, this, _1));
     router.bind("LOSS", std::bind(&PostAuctionService::doLossMessage, this,_1));
     router.bind("EVENT", std::bind(&PostAuctionService::doCampaignEventMessage, this, _1));
@@ -246,10 +267,11 @@ initConnections(size_t shard)
 
 void
 PostAuctionService::
-initAnalyticsPublisher(const string & baseUrl, const int numConnections)
+initAnalyticsPublisher(const string & baseUrl, const int numConnections,
+                       const string & compression)
 {
     LOG(print) << "analyticsPublisherURI: " << baseUrl << endl;
-    analyticsPublisher.init(baseUrl, numConnections);
+    analyticsPublisher.init(baseUrl, numConnections, compression);
 }
 
 void
@@ -374,17 +396,40 @@ void
 PostAuctionService::
 doAuctionMessage(const std::vector<std::string> & message)
 {
-    recordHit("messages.AUCTION");
-    auto event = std::make_shared<SubmittedAuctionEvent>(
-            ML::DB::reconstituteFromString<SubmittedAuctionEvent>(message.at(2)));
+    hotEvents.auctionMessages.hit();
+
+    const string & str = message.at(2);
+    ML::DB::Store_Reader store(str.data(), str.size());
+
+    auto event = std::make_shared<SubmittedAuctionEvent>();
+    event->reconstitute(store);
     doAuction(std::move(event));
 }
 
+void
+PostAuctionService::
+doAuctionBatchMessage(const std::vector<std::string> & message)
+{
+    hotEvents.auctionBatchMessages.hit();
+
+    const string & str = message.at(2);
+    auto events = reconstituteAuctionBatch(str.data(), str.size());
+    hotEvents.auctionBatchAuctions.count(events.size());
+
+    stats.auctions += events.size();
+    if (forwarder) {
+        for (auto & event : events)
+            forwarder->forwardAuction(event);
+    }
+
+    matcher->doAuctions(std::move(events));
+}
+
 void
 PostAuctionService::
 doWinMessage(const std::vector<std::string> & message)
 {
-    recordHit("messages.WIN");
+    hotEvents.winMessages.hit();
     auto event = std::make_shared<PostAuctionEvent>(
             ML::DB::reconstituteFromString<PostAuctionEvent>(message.at(2)));
     doEvent(event);
@@ -394,7 +439,7 @@ void
 PostAuctionService::
 doLossMessage(const std::vector<std::string> & message)
 {
-    recordHit("messages.LOSS");
+    hotEvents.lossMessages.hit();
     auto event = std::make_shared<PostAuctionEvent>(
             ML::DB::reconstituteFromString<PostAuctionEvent>(message.at(2)));
     doEvent(event);
@@ -406,7 +451,7 @@ doCampaignEventMessage(const std::vector<std::string> & message)
 {
     auto event = std::make_shared<PostAuctionEvent>(
             ML::DB::reconstituteFromString<PostAuctionEvent>(message.at(2)));
-    recordHit("messages.EVENT." + event->label);
+    hotEvents.campaignEventMessages(event->label).hit();
     doEvent(event);
 }
 
@@ -600,7 +645,7 @@ deliverEvent(const std::string& label, const std::string& eventType,
 
     if (!sent) {
         orphanEvents++;
-        recordHit("%s.orphaned", label);
+        hotEvents.orphaned(label).hit();
         const std::string & function = ML::format("%s.noListeners%s", eventType, label);
         if (analytics) analytics->logPAErrorMessage(function,
                                     "nothing listening for account " + account.toString(),
@@ -608,7 +653,7 @@ deliverEvent(const std::string& label, const std::string& eventType,
         recordHit("error.%s",function);
     }
     else {
-        recordHit("%s.delivered", label);
+        hotEvents.delivered(label).hit();
     }
 }
 
@@ -51,7 +51,8 @@ struct PostAuctionService : public ServiceBase, public MonitorProvider
 
     void initBidderInterface(Json::Value const & json);
     void init(size_t externalShard = 0, size_t internalShards = 1);
-    void initAnalyticsPublisher(const std::string & baseUrl, const int numConnections);
+    void initAnalyticsPublisher(const std::string & baseUrl, const int numConnections,
+                                const std::string & compression = "");
     void initAnalytics(const Json::Value & config = Json::Value::null);
     void start(std::function<void ()> onStop = std::function<void ()>());
     void shutdown();
@@ -183,10 +184,15 @@ struct PostAuctionService : public ServiceBase, public MonitorProvider
     /* PERSISTENCE                                                          */
     /************************************************************************/
 
-    void initStatePersistence(const std::string & path)
+    /** Keep the finished auctions on disk under path so that they survive
+        a restart.  Must be called after init() and before start().
+    */
+    void initStatePersistence(
+            const std::string & path,
+            size_t maxFinishedInMemory = EventMatcher::DefaultMaxFinishedInMemory)
     {
-        throw ML::Exception(
-                "post auction service persistence is not yet implemented.");
+        ExcCheck(matcher, "init() must be called first");
+        matcher->initStatePersistence(path, maxFinishedInMemory);
     }
 
 
@@ -213,6 +219,25 @@ struct PostAuctionService : public ServiceBase, public MonitorProvider
 
     } stats;
 
+    /** Handles to the events recorded for every message, registered in
+        init().
+    */
+    struct HotEvents
+    {
+        HotEvents() {}
+        HotEvents(const EventRecorder & recorder);
+
+        CounterHandle auctionMessages;
+        CounterHandle auctionBatchMessages;
+        CounterHandle auctionBatchAuctions;
+        CounterHandle winMessages;
+        CounterHandle lossMessages;
+        CounterFamily campaignEventMessages;
+        CounterFamily delivered;
+        CounterFamily orphaned;
+
+    } hotEvents;
+
     float sampleLoad() const { return loopMonitor.sampleLoad().load; }
 
     static Logging::Category print;
@@ -244,6 +269,7 @@ private:
 
     /** Decode from zeromq and handle a new auction that came in. */
     void doAuctionMessage(const std::vector<std::string> & message);
+    void doAuctionBatchMessage(const std::vector<std::string> & message);
 
     /** Decode from zeromq and handle a new auction that came in. */
     void doWinMessage(const std::vector<std::string> & message);
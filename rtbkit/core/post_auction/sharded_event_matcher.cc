@@ -10,6 +10,14 @@
  */
 
 #include "sharded_event_matcher.h"
+#include "jml/arch/timers.h"
+#include "jml/arch/format.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <errno.h>
 
 using namespace std;
 using namespace ML;
@@ -47,25 +55,27 @@ ShardedEventMatcher(std::string prefix, std::shared_ptr<ServiceProxies> proxies)
 
 ShardedEventMatcher::Shard::
 Shard(std::string prefix, std::shared_ptr<EventService> events) :
-    matcher(std::move(prefix), std::move(events)),
-    auctions(1 << 8),
-    events(1 << 6)
+    index(0),
+    parent(nullptr),
+    matcher(std::move(prefix), std::move(events))
 {}
 
 ShardedEventMatcher::Shard::
 Shard(std::string prefix, std::shared_ptr<ServiceProxies> proxies) :
-    matcher(std::move(prefix), std::move(proxies)),
-    auctions(1 << 8),
-    events(1 << 6)
+    index(0),
+    parent(nullptr),
+    matcher(std::move(prefix), std::move(proxies))
 {}
 
 void
 ShardedEventMatcher::
-init(size_t numShards)
+init(size_t numShards, std::vector<int> cpus)
 {
     if (numShards <= 1)
         THROW(error) << "Invalid number of shards: " << numShards;
 
+    this->cpus = std::move(cpus);
+
     shards.reserve(numShards);
 
     for (size_t i = 0; i < numShards; ++i) {
@@ -101,23 +111,27 @@ void
 ShardedEventMatcher::Shard::
 init(size_t shard, ShardedEventMatcher* parent)
 {
-    using std::placeholders::_1;
-
-    auctions.onEvent = [=] (std::shared_ptr<SubmittedAuctionEvent> event) {
-        parent->recordHit("shards.%d.messages.%s", shard, "AUCTION");
-
-        this->matcher.doAuction(std::move(event));
-    };
-    addSource("ShardedEventMatcher::Shard::auctions", auctions);
-
-    events.onEvent = [=] (std::shared_ptr<PostAuctionEvent> event) {
-        parent->recordHit("shards.%d.messages.%s", shard, RTBKIT::print(event->type));
-        if (event->type == PAE_CAMPAIGN_EVENT)
-            parent->recordHit("shards.%d.messages.events.%s", shard, event->label);
+    this->index = shard;
+    this->parent = parent;
+
+    string prefix = ML::format("shards.%d.", shard);
+    matched = parent->counterFamily(prefix + "results.MATCHED%s");
+    unmatched = parent->counterHandle(prefix + "results.UNMATCHED");
+    errors = parent->counterHandle(prefix + "results.ERROR");
+    throttled = parent->counterHandle(prefix + "throttled");
+    batchSize = parent->levelHandle(prefix + "batchSize");
+    auctionMessages = parent->counterHandle(prefix + "messages.AUCTION");
+    for (int type = 0; type <= PAE_CAMPAIGN_EVENT; ++type) {
+        eventMessages[type] = parent->counterHandle(prefix + "messages."
+                + RTBKIT::print(PostAuctionEventType(type)));
+    }
+    campaignEventMessages
+        = parent->counterFamily(prefix + "messages.events.%s");
 
-        this->matcher.doEvent(std::move(event));
+    messages.onBatch = [=] (std::vector<Message> && batch) {
+        this->doBatch(std::move(batch));
     };
-    addSource("ShardedEventMatcher::Shard::events", events);
+    addSource("ShardedEventMatcher::Shard::messages", messages);
 
     addPeriodic("ShardedEventMatcher::checkExpiredAuctions", 0.1,
             std::bind(&SimpleEventMatcher::checkExpiredAuctions, &matcher));
@@ -125,27 +139,61 @@ init(size_t shard, ShardedEventMatcher* parent)
 
 
     matcher.onMatchedWinLoss = [=] (std::shared_ptr<MatchedWinLoss> event) {
-        parent->recordHit("shards.%d.results.MATCHED%s", shard, event->typeString());
+        this->matched(event->typeString()).hit();
         parent->matchedWinLossEvents.push(std::move(event));
     };
 
     matcher.onMatchedCampaignEvent = [=] (std::shared_ptr<MatchedCampaignEvent> event) {
-        parent->recordHit("shards.%d.results.MATCHED%s", shard, event->label);
+        this->matched(event->label).hit();
         parent->matchedCampaignEvents.push(std::move(event));
     };
 
     matcher.onUnmatchedEvent = [=] (std::shared_ptr<UnmatchedEvent> event) {
-        parent->recordHit("shards.%d.results.%s", shard, "UNMATCHED");
+        this->unmatched.hit();
         parent->unmatchedEvents.push(std::move(event));
     };
 
     matcher.onError = [=] (std::shared_ptr<PostAuctionErrorEvent> event) {
-        parent->recordHit("shards.%d.results.%s", shard, "ERROR");
+        this->errors.hit();
         parent->errorEvents.push(std::move(event));
     };
 }
 
 
+void
+ShardedEventMatcher::Shard::
+doBatch(std::vector<Message> && batch)
+{
+    size_t auctions = 0;
+    size_t events[PAE_CAMPAIGN_EVENT + 1] = { 0 };
+
+    for (auto& msg : batch) {
+        if (msg.auction) {
+            ++auctions;
+            matcher.doAuction(std::move(msg.auction));
+            continue;
+        }
+
+        auto type = msg.event->type;
+        if (type >= 0 && type <= PAE_CAMPAIGN_EVENT) ++events[type];
+        if (type == PAE_CAMPAIGN_EVENT)
+            campaignEventMessages(msg.event->label).hit();
+
+        matcher.doEvent(std::move(msg.event));
+    }
+
+    // Stats are recorded once per batch rather than once per message.
+    batchSize.level(batch.size());
+    if (auctions)
+        auctionMessages.count(auctions);
+
+    for (int type = 0; type <= PAE_CAMPAIGN_EVENT; ++type) {
+        if (!events[type]) continue;
+        eventMessages[type].count(events[type]);
+    }
+}
+
+
 void
 ShardedEventMatcher::
 setBanker(const std::shared_ptr<Banker> & newBanker)
@@ -168,12 +216,47 @@ setAuctionTimeout(float timeout)
 }
 
 
+void
+ShardedEventMatcher::
+initStatePersistence(const std::string & path, size_t maxFinishedInMemory)
+{
+    if (mkdir(path.c_str(), 0755) == -1 && errno != EEXIST)
+        throw ML::Exception(errno, "mkdir " + path);
+
+    // Auctions are assigned to shards by id so the state of a shard can
+    // only be recovered with the same number of shards.
+    size_t perShard = std::max<size_t>(1, maxFinishedInMemory / shards.size());
+    for (auto& shard : shards) {
+        shard->matcher.initStatePersistence(
+                ML::format("%s/shard-%zd-of-%zd",
+                        path.c_str(), shard->index, shards.size()),
+                perShard);
+    }
+}
+
+
 void
 ShardedEventMatcher::
 start()
 {
-    for (size_t i = 0; i < shards.size(); ++i)
+    for (size_t i = 0; i < shards.size(); ++i) {
         shards[i]->start();
+        if (cpus.empty()) continue;
+
+        int cpu = cpus[i % cpus.size()];
+        shards[i]->runInMessageLoopThread([=] {
+                    cpu_set_t set;
+                    CPU_ZERO(&set);
+                    CPU_SET(cpu, &set);
+
+                    int res = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+                    if (res != 0) {
+                        LOG(error) << "couldn't pin shard " << i << " to cpu " << cpu
+                            << ": " << strerror(res) << endl;
+                    }
+                    else LOG(print) << "shard " << i << " pinned to cpu " << cpu << endl;
+                });
+    }
 }
 
 void
@@ -185,11 +268,34 @@ shutdown()
 }
 
 
+size_t
+ShardedEventMatcher::
+shardIndex(const Id& auctionId) const
+{
+    // The low bits of the hash already pick the post auction service that
+    // gets the auction and the slot in the shard's hash maps so we use the
+    // high bits to keep the shards and their maps evenly loaded.
+    return (auctionId.hash() >> 32) % shards.size();
+}
+
 ShardedEventMatcher::Shard&
 ShardedEventMatcher::
 shard(const Id& auctionId)
 {
-    return *shards[auctionId.hash() % shards.size()];
+    return *shards[shardIndex(auctionId)];
+}
+
+void
+ShardedEventMatcher::
+throttle(Shard& s)
+{
+    // The shard queues are unbounded so we push back on whoever is feeding
+    // us when a shard falls too far behind.
+    if (s.messages.size() < MaxQueuedMessages) return;
+
+    s.throttled.hit();
+    while (s.messages.size() >= MaxQueuedMessages)
+        ML::sleep(0.001);
 }
 
 void
@@ -197,7 +303,8 @@ ShardedEventMatcher::
 doAuction(std::shared_ptr<SubmittedAuctionEvent> event)
 {
     auto& s = shard(event->auctionId);
-    s.auctions.push(std::move(event));
+    throttle(s);
+    s.messages.push(Message{ std::move(event), nullptr });
 }
 
 void
@@ -205,7 +312,44 @@ ShardedEventMatcher::
 doEvent(std::shared_ptr<PostAuctionEvent> event)
 {
     auto& s = shard(event->auctionId);
-    s.events.push(std::move(event));
+    throttle(s);
+    s.messages.push(Message{ nullptr, std::move(event) });
+}
+
+void
+ShardedEventMatcher::
+doAuctions(std::vector< std::shared_ptr<SubmittedAuctionEvent> > events)
+{
+    std::vector< std::vector<Message> > batches(shards.size());
+
+    for (auto& event : events) {
+        size_t i = shardIndex(event->auctionId);
+        batches[i].push_back(Message{ std::move(event), nullptr });
+    }
+
+    for (size_t i = 0; i < shards.size(); ++i) {
+        if (batches[i].empty()) continue;
+        throttle(*shards[i]);
+        shards[i]->messages.pushBatch(std::move(batches[i]));
+    }
+}
+
+void
+ShardedEventMatcher::
+doEvents(std::vector< std::shared_ptr<PostAuctionEvent> > events)
+{
+    std::vector< std::vector<Message> > batches(shards.size());
+
+    for (auto& event : events) {
+        size_t i = shardIndex(event->auctionId);
+        batches[i].push_back(Message{ nullptr, std::move(event) });
+    }
+
+    for (size_t i = 0; i < shards.size(); ++i) {
+        if (batches[i].empty()) continue;
+        throttle(*shards[i]);
+        shards[i]->messages.pushBatch(std::move(batches[i]));
+    }
 }
 
 } // namepsace RTBKIT
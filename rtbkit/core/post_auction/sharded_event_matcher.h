@@ -28,7 +28,10 @@ struct ShardedEventMatcher : public EventMatcher, public MessageLoop
     ShardedEventMatcher(std::string prefix, std::shared_ptr<EventService> events);
     ShardedEventMatcher(std::string prefix, std::shared_ptr<ServiceProxies> proxies);
 
-    void init(size_t shards);
+    /** When cpus is not empty, the thread of shard i is pinned to the cpu
+        cpus[i % cpus.size()] once it starts.
+    */
+    void init(size_t shards, std::vector<int> cpus = std::vector<int>());
     void start();
     void shutdown();
 
@@ -47,23 +50,67 @@ struct ShardedEventMatcher : public EventMatcher, public MessageLoop
     /** Handle a post-auction event that came in. */
     virtual void doEvent(std::shared_ptr<PostAuctionEvent> event);
 
+    /** Split the auctions by shard and hand each shard its part at once. */
+    virtual void doAuctions(
+            std::vector< std::shared_ptr<SubmittedAuctionEvent> > events);
+
+    /** Split the events by shard and hand each shard its part at once. */
+    virtual void doEvents(
+            std::vector< std::shared_ptr<PostAuctionEvent> > events);
+
     /** Periodic auction expiry. */
     virtual void checkExpiredAuctions() {}
 
+
+    /** Each shard keeps its state in its own sub-directory of path. */
+    virtual void initStatePersistence(
+            const std::string & path, size_t maxFinishedInMemory);
+
 private:
 
+    /** Either an auction or an event. Both go through the same queue so that
+        a shard sees them in the order in which they were received.
+    */
+    struct Message
+    {
+        std::shared_ptr<SubmittedAuctionEvent> auction;
+        std::shared_ptr<PostAuctionEvent> event;
+    };
+
     struct Shard : public MessageLoop
     {
         Shard(std::string prefix, std::shared_ptr<EventService> events);
         Shard(std::string prefix, std::shared_ptr<ServiceProxies> proxies);
         void init(size_t shard, ShardedEventMatcher* parent);
+        void doBatch(std::vector<Message> && batch);
+
+        size_t index;
+        ShardedEventMatcher* parent;
+
+        /** shards.<index>.* events, registered on the parent in init(). */
+        CounterFamily matched;
+        CounterHandle unmatched;
+        CounterHandle errors;
+        CounterHandle throttled;
+        LevelHandle batchSize;
+        CounterHandle auctionMessages;
+        CounterHandle eventMessages[PAE_CAMPAIGN_EVENT + 1];
+        CounterFamily campaignEventMessages;
 
         SimpleEventMatcher matcher;
-        TypedMessageSink<std::shared_ptr<SubmittedAuctionEvent> > auctions;
-        TypedMessageSink<std::shared_ptr<PostAuctionEvent> > events;
+        TypedMessageBatchSink<Message> messages;
     };
 
     std::vector< std::unique_ptr<Shard> > shards;
+    std::vector<int> cpus;
+
+    /** Number of messages a shard can have waiting before we start waiting
+        for it to catch up.
+    */
+    enum { MaxQueuedMessages = 1 << 16 };
+    void throttle(Shard& shard);
+
+    size_t shardIndex(const Id& auctionId) const;
     Shard& shard(const Id& auctionId);
 
     TypedMessageSink<std::shared_ptr<MatchedWinLoss> > matchedWinLossEvents;
@@ -10,6 +10,8 @@
 #include "jml/utils/guard.h"
 
 #include <iostream>
+#include <sys/stat.h>
+#include <errno.h>
 
 using namespace std;
 using namespace Datacratic;
@@ -26,7 +28,9 @@ size_t
 hash< std::pair<Datacratic::Id, Datacratic::Id> >::
 operator() (const std::pair<Datacratic::Id, Datacratic::Id>& val) const
 {
-    return val.first.hash() ^ val.second.hash();
+    // Mix both halves rather than xor them: a plain xor puts (a, b) and
+    // (b, a) together and sends every pair of equal ids to slot 0.
+    return Hash128to64(std::make_pair(val.first.hash(), val.second.hash()));
 }
 
 } // namespace std
@@ -39,10 +43,10 @@ namespace RTBKIT {
 
 namespace {
 
-template<typename Value>
+template<typename Pending, typename SpotIdMap, typename Value>
 bool findAuction(
-        TimeoutMap<pair<Id,Id>, Value> & pending,
-        const std::unordered_map<Id, Id>& spotIdMap,
+        Pending & pending,
+        const SpotIdMap& spotIdMap,
         const Id & auctionId, Id & adSpotId, Value & val)
 {
     if (!adSpotId) {
@@ -79,12 +83,52 @@ Logging::Category SimpleEventMatcher::trace("SimpleEventMatcher Trace", SimpleEv
 
 SimpleEventMatcher::
 SimpleEventMatcher(std::string prefix, std::shared_ptr<EventService> events) :
-    EventMatcher(std::move(prefix), std::move(events))
+    EventMatcher(std::move(prefix), std::move(events)),
+    hotEvents(*this)
 {}
 
 SimpleEventMatcher::
 SimpleEventMatcher(std::string prefix, std::shared_ptr<ServiceProxies> proxies) :
-    EventMatcher(std::move(prefix), std::move(proxies))
+    EventMatcher(std::move(prefix), std::move(proxies)),
+    hotEvents(*this)
+{}
+
+SimpleEventMatcher::HotEvents::
+HotEvents(const EventRecorder & recorder) :
+    processedAuction(recorder.counterHandle("processedAuction")),
+    auctionAlreadySubmitted(recorder.counterHandle("auctionAlreadySubmitted")),
+    replayedEarlyWinEvent(recorder.counterHandle("replayedEarlyWinEvent")),
+    processedWin(recorder.counterHandle("processedWin")),
+    processedLoss(recorder.counterHandle("processedLoss")),
+    submittedAuctionExpiry(recorder.counterHandle("submittedAuctionExpiry")),
+    submittedAuctionExpiryWithoutBid(
+            recorder.counterHandle("submittedAuctionExpiryWithoutBid")),
+    finishedAuctionExpiry(recorder.counterHandle("finishedAuctionExpiry")),
+    submittedSize(recorder.levelHandle("submittedSize")),
+    finishedSize(recorder.levelHandle("finishedSize")),
+    finishedInMemory(recorder.levelHandle("finishedInMemory")),
+    winLatencyMs(recorder.outcomeHandle("winLatencyMs")),
+
+    messagesReceived(recorder.counterFamily("bidResult.%s.messagesReceived")),
+    messagesReplayed(recorder.counterFamily("bidResult.%s.messagesReplayed")),
+    duplicate(recorder.counterFamily("bidResult.%s.duplicate")),
+    duplicateWithDifferentPrice(
+            recorder.counterFamily("bidResult.%s.duplicateWithDifferentPrice")),
+    auctionAlreadyFinished(
+            recorder.counterFamily("bidResult.%s.auctionAlreadyFinished")),
+    winAfterLossAssumed(
+            recorder.counterFamily("bidResult.%s.winAfterLossAssumed")),
+    winAfterLossAssumedAmount(
+            recorder.outcomeFamily("bidResult.%s.winAfterLossAssumedAmount.%s")),
+    noBidSubmitted(recorder.counterFamily("bidResult.%s.noBidSubmitted")),
+
+    deliveryReceived(
+            recorder.counterFamily("delivery.EVENT.%s.messagesReceived")),
+    deliveryMatched(recorder.counterFamily("delivery.%s.account.%s.matched")),
+
+    bidPrice(recorder.outcomeFamily("accounts.%s.bidPrice.%s")),
+    winPrice(recorder.outcomeFamily("accounts.%s.winPrice.%s")),
+    winCostPrice(recorder.outcomeFamily("accounts.%s.winCostPrice.%s"))
 {}
 
 
@@ -98,10 +142,10 @@ expireSubmitted(Date start, const pair<Id, Id> & key, const SubmissionInfo & inf
     // Just making sure it doesn't leak if doBidResult throws.
     spotIdMap.erase(key.first);
 
-    recordHit("submittedAuctionExpiry");
+    hotEvents.submittedAuctionExpiry.hit();
 
     if (!info.bidRequest) {
-        recordHit("submittedAuctionExpiryWithoutBid");
+        hotEvents.submittedAuctionExpiryWithoutBid.hit();
 
         for(const auto& event : info.pendingWinEvents)
             doReallyLateWin(event);
@@ -130,14 +174,13 @@ expireSubmitted(Date start, const pair<Id, Id> & key, const SubmissionInfo & inf
 }
 
 
-Date
+void
 SimpleEventMatcher::
-expireFinished(const pair<Id, Id> & key, const FinishedInfo & info)
+expireFinished(const pair<Id, Id> & key)
 {
     spotIdMap.erase(key.first);
 
-    recordHit("finishedAuctionExpiry");
-    return Date();
+    hotEvents.finishedAuctionExpiry.hit();
 }
 
 void
@@ -149,14 +192,16 @@ checkExpiredAuctions()
     using std::placeholders::_1;
     using std::placeholders::_2;
 
-    recordLevel(submitted.size(), "submittedSize");
+    hotEvents.submittedSize.level(submitted.size());
     submitted.expire(
             std::bind(&SimpleEventMatcher::expireSubmitted, this, now, _1, _2),
             now);
 
-    recordLevel(finished.size(), "finishedSize");
+    hotEvents.finishedSize.level(finished.size());
+    if (finished.persistent())
+        hotEvents.finishedInMemory.level(finished.inMemory());
     finished.expire(
-            std::bind(&SimpleEventMatcher::expireFinished, this, _1, _2),
+            std::bind(&SimpleEventMatcher::expireFinished, this, _1),
             now);
 
     banker->logBidEvents(*this);
@@ -195,7 +240,7 @@ SimpleEventMatcher::
 doAuction(std::shared_ptr<SubmittedAuctionEvent> event)
 {
     try {
-        recordHit("processedAuction");
+        hotEvents.processedAuction.hit();
 
         const Id & auctionId = event->auctionId;
 
@@ -211,7 +256,7 @@ doAuction(std::shared_ptr<SubmittedAuctionEvent> event)
             spotIdMap.erase(key.first);
 
             pendingWinEvents.swap(submission.pendingWinEvents);
-            recordHit("auctionAlreadySubmitted");
+            hotEvents.auctionAlreadySubmitted.hit();
         }
 
         submission.bidRequest = event->bidRequest();
@@ -232,7 +277,7 @@ doAuction(std::shared_ptr<SubmittedAuctionEvent> event)
         for (auto it = pendingWinEvents.begin(), end = pendingWinEvents.end();
              it != end;  ++it)
         {
-            recordHit("replayedEarlyWinEvent");
+            hotEvents.replayedEarlyWinEvent.hit();
             doWinLoss(*it, true /* is_replay */);
         }
 
@@ -249,19 +294,19 @@ doWinLoss(std::shared_ptr<PostAuctionEvent> event, bool isReplay)
     BidStatus status;
     if (event->type == PAE_WIN) {
         status = BS_WIN;
-        recordHit("processedWin");
+        hotEvents.processedWin.hit();
     }
     else {
         status = BS_LOSS;
-        recordHit("processedLoss");
+        hotEvents.processedLoss.hit();
     }
 
     const char * typeStr = RTBKIT::print(event->type);
 
     if (!isReplay)
-        recordHit("bidResult.%s.messagesReceived", typeStr);
+        hotEvents.messagesReceived(typeStr).hit();
     else
-        recordHit("bidResult.%s.messagesReplayed", typeStr);
+        hotEvents.messagesReplayed(typeStr).hit();
 
     const Id & auctionId = event->auctionId;
     const Id & adSpotId = event->adSpotId;
@@ -285,26 +330,26 @@ doWinLoss(std::shared_ptr<PostAuctionEvent> event, bool isReplay)
         FinishedInfo info = finished.get(key);
         if (info.hasWin() && status == info.reportedStatus) {
             if (winPrice == info.winPrice) {
-                recordHit("bidResult.%s.duplicate", typeStr);
+                hotEvents.duplicate(typeStr).hit();
                 return;
             }
             else {
-                recordHit("bidResult.%s.duplicateWithDifferentPrice", typeStr);
+                hotEvents.duplicateWithDifferentPrice(typeStr).hit();
                 return;
             }
         }
-        else recordHit("bidResult.%s.auctionAlreadyFinished", typeStr);
+        else hotEvents.auctionAlreadyFinished(typeStr).hit();
 
         if (event->type == PAE_WIN) {
             info.bid.wcm.data["win"] = meta.toJson();
             Amount price = info.bid.wcm.evaluate(
                     info.bid.bidData.bidForSpot(info.spotIndex), winPrice);
 
-            recordOutcome(winPrice.value, "accounts.%s.winPrice.%s",
-                    info.bid.account.toString('.'), winPrice.getCurrencyStr());
-
-            recordOutcome(price.value, "accounts.%s.winCostPrice.%s",
-                    info.bid.account.toString('.'), price.getCurrencyStr());
+            const string & account = info.bid.account.toString('.');
+            hotEvents.winPrice(account, winPrice.getCurrencyStr())
+                .outcome(winPrice.value);
+            hotEvents.winCostPrice(account, price.getCurrencyStr())
+                .outcome(price.value);
 
 
             // Late win with auction still around
@@ -312,7 +357,7 @@ doWinLoss(std::shared_ptr<PostAuctionEvent> event, bool isReplay)
 
             info.forceWin(timestamp, price, winPrice, meta.toString());
 
-            finished.get(key) = info;
+            finished.replace(key, info);
 
             doMatchedWinLoss(std::make_shared<MatchedWinLoss>(
                             MatchedWinLoss::LateWin,
@@ -320,13 +365,12 @@ doWinLoss(std::shared_ptr<PostAuctionEvent> event, bool isReplay)
                             *event, info));
 
 
-            recordHit("bidResult.%s.winAfterLossAssumed", typeStr);
-            recordOutcome(price.value,
-                          "bidResult.%s.winAfterLossAssumedAmount.%s",
-                          typeStr, price.getCurrencyStr());
+            hotEvents.winAfterLossAssumed(typeStr).hit();
+            hotEvents.winAfterLossAssumedAmount(typeStr, price.getCurrencyStr())
+                .outcome(price.value);
 
             auto winLatency = Date::now().secondsSince(info.auctionTime);
-            recordOutcome(winLatency * 1000.0, "winLatencyMs");
+            hotEvents.winLatencyMs.outcome(winLatency * 1000.0);
         }
 
         return;
@@ -341,7 +385,7 @@ doWinLoss(std::shared_ptr<PostAuctionEvent> event, bool isReplay)
           is completely unknown.
     */
     if (!submitted.count(key)) {
-        recordHit("bidResult.%s.noBidSubmitted", typeStr);
+        hotEvents.noBidSubmitted(typeStr).hit();
 
         /* We record the win message here and play it back once we submit
            the auction.
@@ -418,7 +462,7 @@ doCampaignEvent(std::shared_ptr<PostAuctionEvent> event)
             << RTBKIT::print(event->type);
     }
 
-    recordHit("delivery.EVENT.%s.messagesReceived", label);
+    hotEvents.deliveryReceived(label).hit();
 
     auto recordUnmatched = [&] (const std::string & why) {
         doUnmatchedEvent(std::make_shared<UnmatchedEvent>(why, *event));
@@ -454,9 +498,8 @@ doCampaignEvent(std::shared_ptr<PostAuctionEvent> event)
 
         finishedInfo.campaignEvents.setEvent(label, timestamp, meta);
 
-        recordHit("delivery.%s.account.%s.matched",
-                  label,
-                  finishedInfo.bid.account.toString().c_str());
+        hotEvents.deliveryMatched(label, finishedInfo.bid.account.toString())
+            .hit();
 
         pair<Id, Id> key(auctionId, adSpotId);
         if (!key.second)
@@ -466,7 +509,7 @@ doCampaignEvent(std::shared_ptr<PostAuctionEvent> event)
         // properly
         finishedInfo.addUids(uids);
 
-        finished.get(key) = finishedInfo;
+        finished.replace(key, finishedInfo);
 
         doMatchedCampaignEvent(
                 std::make_shared<MatchedCampaignEvent>(label, finishedInfo));
@@ -562,17 +605,13 @@ doBidResult(
         Bid bid = bids.bidForSpot(adspot_num);
         price = wcm.evaluate(bid, winPrice);
 
-        recordOutcome(bid.price.value, "accounts.%s.bidPrice.%s",
-                account.toString('.'),
-                bid.price.getCurrencyStr());
-
-        recordOutcome(winPrice.value, "accounts.%s.winPrice.%s",
-                      account.toString('.'),
-                      winPrice.getCurrencyStr());
-
-        recordOutcome(price.value, "accounts.%s.winCostPrice.%s",
-                      account.toString('.'),
-                      price.getCurrencyStr());
+        const string & accountStr = account.toString('.');
+        hotEvents.bidPrice(accountStr, bid.price.getCurrencyStr())
+            .outcome(bid.price.value);
+        hotEvents.winPrice(accountStr, winPrice.getCurrencyStr())
+            .outcome(winPrice.value);
+        hotEvents.winCostPrice(accountStr, price.getCurrencyStr())
+            .outcome(price.value);
 
         // This is a real win
         guard.clear();
@@ -581,7 +620,7 @@ doBidResult(
         banker->winBid(account, transId, price, LineItems());
 
         auto winLatency = Date::now().secondsSince(submission.bidRequest->timestamp);
-        recordOutcome(winLatency * 1000.0, "winLatencyMs");
+        hotEvents.winLatencyMs.outcome(winLatency * 1000.0);
     }
 
     // Finally, place it in the finished queue
@@ -621,176 +660,28 @@ doBidResult(
 /******************************************************************************/
 /* PERSISTENCE                                                                */
 /******************************************************************************/
-// Needs to be properly tested before enabling.
-
-namespace {
-
-#if 0
-std::pair<Id, Id>
-unstringifyPair(const std::string & str)
-{
-    istringstream stream(str);
-    DB::Store_Reader store(stream);
-    pair<Id, Id> result;
-    store >> result.first >> result.second;
-    return result;
-}
-
-std::string stringifyPair(const std::pair<Id, Id> & vals)
-{
-    if (!vals.second || vals.second.type == Id::NULLID)
-        throw ML::Exception("attempt to store null ID");
-
-    ostringstream stream;
-    {
-        DB::Store_Writer store(stream);
-        store << vals.first << vals.second;
-    }
-
-    return stream.str();
-}
-#endif
-
-} // file scope
-
-
-#if 0 // Persistence layer that needs to be reworked.
 
 void
 SimpleEventMatcher::
-initStatePersistence(const std::string & path)
+initStatePersistence(const std::string & path, size_t maxFinishedInMemory)
 {
-    typedef PendingPersistenceT<pair<Id, Id>, SubmissionInfo>
-        SubmittedPending;
-
-    auto submittedDb = std::make_shared<LeveldbPendingPersistence>();
-    submittedDb->open(path + "/submitted");
-
-    auto submittedPersistence
-        = std::make_shared<SubmittedPending>();
-    submittedPersistence->store = submittedDb;
-
-    auto stringifySubmissionInfo = [] (const SubmissionInfo & info)
-        {
-            return info.serializeToString();
-        };
-
-    auto unstringifySubmissionInfo = [] (const std::string & str)
-        {
-            SubmissionInfo info;
-            info.reconstituteFromString(str);
-            return info;
-        };
-
-    submittedPersistence->stringifyKey = stringifyPair;
-    submittedPersistence->unstringifyKey = unstringifyPair;
-    submittedPersistence->stringifyValue = stringifySubmissionInfo;
-    submittedPersistence->unstringifyValue = unstringifySubmissionInfo;
-
-    Date newTimeout = Date::now().plusSeconds(15);
-
-    auto acceptSubmitted = [&] (pair<Id, Id> & key,
-                                SubmissionInfo & info,
-                                Date & timeout) -> bool
-        {
-            info.fromOldRouter = true;
-            newTimeout.addSeconds(0.001);
-            timeout = newTimeout;
-            // this->debugSpot(key.first, key.second, "RECONST SUBMITTED");
-            return true;
-        };
+    if (finished.size())
+        THROW(error) << "persistence must be enabled before matching events";
 
-    submitted.initFromStore(submittedPersistence,
-                            acceptSubmitted,
-                            Date::now().plusSeconds(15));
+    if (mkdir(path.c_str(), 0755) == -1 && errno != EEXIST)
+        throw ML::Exception(errno, "mkdir " + path);
 
-    typedef PendingPersistenceT<pair<Id, Id>, FinishedInfo>
-        FinishedPending;
-
-    auto finishedDb = std::make_shared<LeveldbPendingPersistence>();
-    finishedDb->open(path + "/finished");
-
-    auto finishedPersistence
-        = std::make_shared<FinishedPending>();
-    finishedPersistence->store = finishedDb;
-
-    auto stringifyFinishedInfo = [] (const FinishedInfo & info)
-        {
-            return info.serializeToString();
-        };
-
-    auto unstringifyFinishedInfo = [] (const std::string & str)
-        {
-            FinishedInfo info;
-            info.reconstituteFromString(str);
-            return info;
-        };
-
-    finishedPersistence->stringifyKey = stringifyPair;
-    finishedPersistence->unstringifyKey = unstringifyPair;
-    finishedPersistence->stringifyValue = stringifyFinishedInfo;
-    finishedPersistence->unstringifyValue = unstringifyFinishedInfo;
-
-    newTimeout = Date::now().plusSeconds(auctionTimeout);
-
-    auto acceptFinished = [&] (pair<Id, Id> & key,
-                               FinishedInfo & info,
-                               Date & timeout) -> bool
-        {
-            info.fromOldRouter = true;
-            newTimeout.addSeconds(0.001);
-            timeout = newTimeout;
-            // this->debugSpot(key.first, key.second, "RECONST FINISHED");
-
-            return true;
-        };
-
-    finished.initFromStore(finishedPersistence,
-                           acceptFinished,
-                           Date::now().plusSeconds(auctionTimeout));
-
-    auto backgroundWork = [=] (volatile int & shutdown, int64_t threadId)
-        {
-            while (!shutdown) {
-                futex_wait(const_cast<int &>(shutdown), 0, 600.0);
-                if (shutdown) break;
-                //continue;
-
-                {
-                    Date start = Date::now();
-                    submittedDb->compact();
-                    Date end = Date::now();
-                    this->recordEvent("persistentData.submitted.compactTimeMs",
-                                  ET_OUTCOME,
-                                  1000.0 * (end.secondsSince(start)));
-                    uint64_t size = submittedDb->getDbSize();
-                    //cerr << "submitted db is " << size / 1024.0 / 1024.0
-                    //     << "MB" << endl;
-                    this->recordEvent("persistentData.submitted.dbSizeMb",
-                                  ET_LEVEL, size / 1024.0 / 1024.0);
-                }
-
-                {
-                    Date start = Date::now();
-                    finishedDb->compact();
-                    Date end = Date::now();
-                    this->recordEvent("persistentData.finished.compactTimeMs",
-                                  ET_OUTCOME,
-                                  1000.0 * (end.secondsSince(start)));
-                    uint64_t size = finishedDb->getDbSize();
-                    //cerr << "finished db is " << size / 1024.0 / 1024.0
-                    //     << "MB" << endl;
-                    this->recordEvent("persistentData.finished.dbSizeMb",
-                                  ET_LEVEL, size / 1024.0 / 1024.0);
-                }
-            }
+    // Recovered auctions are only on disk; we just need their spot ids to
+    // match the events that don't carry one.
+    auto onRecovered = [&] (const pair<Id, Id> & key, Date timeout) {
+        spotIdMap[key.first] = key.second;
+    };
 
-            cerr << "exiting background work thread" << endl;
-        };
+    finished.open(path + "/finished", maxFinishedInMemory, onRecovered);
 
-    // loop.startSubordinateThread(backgroundWork);
+    LOG(print) << "recovered " << finished.size()
+        << " finished auctions from " << path << endl;
+    recordLevel(finished.size(), "finishedRecovered");
 }
 
-#endif
-
 } // RTBKIT
@@ -8,11 +8,11 @@
 #pragma once
 
 #include "timeout_map.h"
+#include "tiered_timeout_map.h"
 #include "event_matcher.h"
 #include "finished_info.h"
 #include "submission_info.h"
 #include "rtbkit/common/auction.h"
-// #include "soa/service/pending_list.h"
 #include "soa/service/logs.h"
 
 #include <utility>
@@ -63,7 +63,12 @@ struct SimpleEventMatcher : public EventMatcher
     /* PERSISTENCE                                                          */
     /************************************************************************/
 
-    // virtual void initStatePersistence(const std::string & path);
+    /** Keeps the finished auctions in a LevelDB database under path and
+        recovers the ones left there by a previous run.  Submitted auctions
+        stay in memory only.
+    */
+    virtual void initStatePersistence(
+            const std::string & path, size_t maxFinishedInMemory);
 
     static Logging::Category print;
     static Logging::Category error;
@@ -103,7 +108,7 @@ private:
     Date expireSubmitted(
             Date start, const std::pair<Id, Id> & key, const SubmissionInfo & info);
 
-    Date expireFinished(const std::pair<Id, Id> & key, const FinishedInfo & info);
+    void expireFinished(const std::pair<Id, Id> & key);
 
 
     /** List of auctions we're currently tracking as submitted.  Note that an
@@ -122,9 +127,11 @@ private:
         late WIN message for.
 
         We keep this list around for 5 minutes for those that were lost,
-        and one hour for those that were won.
+        and one hour for those that were won.  Once persistence is enabled,
+        the entries are also on disk and only the most recently used ones
+        are kept in memory.
     */
-    typedef TimeoutMap<std::pair<Id, Id>, FinishedInfo> Finished;
+    typedef TieredTimeoutMap<std::pair<Id, Id>, FinishedInfo> Finished;
     Finished finished;
 
     /** Maintains a map of auction id with the most recently seen spot id. Used
@@ -136,7 +143,50 @@ private:
         which entry is the real entry. So instead we keep an arbitrarily chosen
         entry.
      */
-    std::unordered_map<Id, Id> spotIdMap;
+    typedef Datacratic::FlatHashMap<Id, Id> SpotIdMap;
+    SpotIdMap spotIdMap;
+
+    /** Handles to the events recorded for every auction or event that gets
+        matched, registered on construction.
+    */
+    struct HotEvents
+    {
+        HotEvents() {}
+        HotEvents(const EventRecorder & recorder);
+
+        CounterHandle processedAuction;
+        CounterHandle auctionAlreadySubmitted;
+        CounterHandle replayedEarlyWinEvent;
+        CounterHandle processedWin;
+        CounterHandle processedLoss;
+        CounterHandle submittedAuctionExpiry;
+        CounterHandle submittedAuctionExpiryWithoutBid;
+        CounterHandle finishedAuctionExpiry;
+        LevelHandle submittedSize;
+        LevelHandle finishedSize;
+        LevelHandle finishedInMemory;
+        OutcomeHandle winLatencyMs;
+
+        /** bidResult.<type>.* */
+        CounterFamily messagesReceived;
+        CounterFamily messagesReplayed;
+        CounterFamily duplicate;
+        CounterFamily duplicateWithDifferentPrice;
+        CounterFamily auctionAlreadyFinished;
+        CounterFamily winAfterLossAssumed;
+        OutcomeFamily winAfterLossAssumedAmount;
+        CounterFamily noBidSubmitted;
+
+        /** delivery.* */
+        CounterFamily deliveryReceived;
+        CounterFamily deliveryMatched;
+
+        /** accounts.<account>.*.<currency> */
+        OutcomeFamily bidPrice;
+        OutcomeFamily winPrice;
+        OutcomeFamily winCostPrice;
+
+    } hotEvents;
 };
 
 } // RTBKIT
@@ -0,0 +1,186 @@
+/* event_matcher_bench.cc
+   Copyright (c) 2014 Datacratic.  All rights reserved.
+
+   Measures how fast the event matchers can match wins to submitted
+   auctions.  Auctions come in batches, like the AUCTIONS message from the
+   router, and their wins trail behind in random order with a few of them
+   arriving before their auction.  The time includes building the events on
+   the feeding thread.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/core/post_auction/simple_event_matcher.h"
+#include "rtbkit/core/post_auction/sharded_event_matcher.h"
+#include "rtbkit/core/banker/null_banker.h"
+#include "soa/service/message_loop.h"
+#include "jml/arch/timers.h"
+#include "jml/arch/format.h"
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <iostream>
+
+using namespace std;
+using namespace ML;
+using namespace Datacratic;
+using namespace RTBKIT;
+
+namespace {
+
+enum {
+    NumAuctions = 2000000,
+    BatchSize = 256,
+    WinWindow = 8192     ///< Wins are shuffled within this many auctions
+};
+
+struct Feed
+{
+    Feed() :
+        bidRequest(makeBidRequest()),
+        bid(USD_CPM(2), 1, AccountKey("bench:strategy"))
+    {
+        bid.agent = "bench-agent";
+        bid.bidData = Bids::fromJson("{\"bids\":[{\"spotIndex\":0}]}");
+    }
+
+    Id auctionId(size_t i) const
+    {
+        return Id(i * 0x9e3779b97f4a7c15ULL + 1);
+    }
+
+    std::shared_ptr<SubmittedAuctionEvent> makeAuction(size_t i) const
+    {
+        auto event = std::make_shared<SubmittedAuctionEvent>();
+        event->auctionId = auctionId(i);
+        event->adSpotId = Id(1);
+        event->lossTimeout = Date::now().plusSeconds(3600);
+        event->bidRequest(bidRequest);
+        event->bidRequestStrFormat = "datacratic";
+        event->bidResponse = bid;
+        return event;
+    }
+
+    std::shared_ptr<PostAuctionEvent> makeWin(size_t i) const
+    {
+        auto event = std::make_shared<PostAuctionEvent>();
+        event->type = PAE_WIN;
+        event->auctionId = auctionId(i);
+        event->adSpotId = Id(1);
+        event->winPrice = USD_CPM(1);
+        event->timestamp = Date::now();
+        event->account = bid.account;
+        event->bidTimestamp = Date::now();
+        return event;
+    }
+
+    static std::shared_ptr<BidRequest> makeBidRequest()
+    {
+        auto br = std::make_shared<BidRequest>();
+        AdSpot spot;
+        spot.id = Id(1);
+        spot.formats.push_back(Format(300, 250));
+        br->imp.push_back(spot);
+        br->auctionId = Id(1);
+        br->exchange = "mock";
+        br->timestamp = Date::now();
+        return br;
+    }
+
+    std::shared_ptr<BidRequest> bidRequest;
+    Auction::Response bid;
+};
+
+/** Feeds every auction and its win to the matcher then waits until all the
+    wins were matched.  Returns the number of auctions per second.
+*/
+double feed(EventMatcher & matcher, const std::atomic<size_t> & matched)
+{
+    Feed feed;
+    mt19937 rng(42);
+
+    vector<size_t> pendingWins;
+    auto sendWins = [&] {
+        std::shuffle(pendingWins.begin(), pendingWins.end(), rng);
+        for (size_t i = 0; i < pendingWins.size(); i += BatchSize) {
+            vector< std::shared_ptr<PostAuctionEvent> > wins;
+            size_t end = std::min(pendingWins.size(), i + BatchSize);
+            for (size_t j = i; j < end; ++j)
+                wins.push_back(feed.makeWin(pendingWins[j]));
+            matcher.doEvents(std::move(wins));
+        }
+        pendingWins.clear();
+    };
+
+    ML::Timer timer;
+
+    for (size_t i = 0; i < NumAuctions; i += BatchSize) {
+        vector< std::shared_ptr<SubmittedAuctionEvent> > auctions;
+        vector< std::shared_ptr<PostAuctionEvent> > earlyWins;
+
+        for (size_t j = i; j < i + BatchSize; ++j) {
+            auctions.push_back(feed.makeAuction(j));
+
+            if (rng() % 20 == 0)
+                earlyWins.push_back(feed.makeWin(j));
+            else pendingWins.push_back(j);
+        }
+
+        matcher.doEvents(std::move(earlyWins));
+        matcher.doAuctions(std::move(auctions));
+
+        if (pendingWins.size() >= WinWindow) sendWins();
+    }
+    sendWins();
+
+    while (matched < NumAuctions) ML::sleep(0.001);
+
+    return NumAuctions / timer.elapsed_wall();
+}
+
+} // file scope
+
+BOOST_AUTO_TEST_CASE( event_matcher_bench )
+{
+    auto events = std::make_shared<NullEventService>();
+    auto banker = std::make_shared<NullBanker>(true);
+
+    {
+        std::atomic<size_t> matched(0);
+
+        SimpleEventMatcher matcher("bench", events);
+        matcher.setBanker(banker);
+        matcher.onMatchedWinLoss = [&] (std::shared_ptr<MatchedWinLoss>) {
+            ++matched;
+        };
+
+        double rate = feed(matcher, matched);
+        cerr << ML::format("%10s: %12.0f auctions/second", "simple", rate)
+             << endl;
+    }
+
+    for (size_t shards : { 2, 4, 8 }) {
+        std::atomic<size_t> matched(0);
+
+        ShardedEventMatcher matcher("bench", events);
+        matcher.init(shards);
+        matcher.setBanker(banker);
+        matcher.onMatchedWinLoss = [&] (std::shared_ptr<MatchedWinLoss>) {
+            ++matched;
+        };
+
+        MessageLoop loop;
+        loop.addSource("matcher", matcher);
+        loop.start();
+        matcher.start();
+
+        double rate = feed(matcher, matched);
+        cerr << ML::format("%4zd shards: %12.0f auctions/second", shards, rate)
+             << endl;
+
+        matcher.shutdown();
+        loop.shutdown();
+    }
+}
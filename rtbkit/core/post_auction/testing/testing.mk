@@ -1,2 +1,4 @@
 $(eval $(call program,post_auction_redis_bench,post_auction redis))
 $(eval $(call program,post_auction_sharding_bench,post_auction boost_program_options))
+$(eval $(call test,event_matcher_bench,post_auction,boost manual))
+$(eval $(call test,tiered_timeout_map_test,post_auction,boost))
@@ -0,0 +1,219 @@
+/* tiered_timeout_map_test.cc
+   Copyright (c) 2014 Datacratic.  All rights reserved.
+
+   Unit tests for the TieredTimeoutMap class.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <stdlib.h>
+
+#include "rtbkit/core/post_auction/tiered_timeout_map.h"
+#include "rtbkit/core/post_auction/finished_info.h"
+
+using namespace std;
+using namespace Datacratic;
+using namespace RTBKIT;
+
+namespace {
+
+struct TemporaryDirectory {
+    TemporaryDirectory()
+    {
+        char tmpl[] = "/tmp/tiered_timeout_map_test.XXXXXX";
+        if (!mkdtemp(tmpl))
+            throw ML::Exception(errno, "mkdtemp");
+        path = tmpl;
+    }
+
+    ~TemporaryDirectory()
+    {
+        int res = system(("rm -rf " + path).c_str());
+        (void) res;
+    }
+
+    string path;
+};
+
+typedef TieredTimeoutMap<Id, string> Map;
+
+Id key(int i)
+{
+    return Id(i + 1);
+}
+
+string value(int i)
+{
+    return "value" + to_string(i);
+}
+
+} // file scope
+
+BOOST_AUTO_TEST_CASE( test_in_memory )
+{
+    Map map;
+    Date now = Date::now();
+
+    for (int i = 0;  i < 10;  ++i)
+        BOOST_CHECK(map.emplace(key(i), value(i), now.plusSeconds(i)));
+    BOOST_CHECK(!map.emplace(key(0), "dup", now));
+    BOOST_CHECK_EQUAL(map.size(), 10);
+    BOOST_CHECK_EQUAL(map.inMemory(), 10);
+
+    BOOST_CHECK_EQUAL(map.get(key(3)), value(3));
+    map.replace(key(3), "three");
+    BOOST_CHECK_EQUAL(map.pop(key(3)), "three");
+    BOOST_CHECK(!map.count(key(3)));
+    BOOST_CHECK(map.erase(key(4)));
+    BOOST_CHECK(!map.erase(key(4)));
+
+    vector<Id> expired;
+    map.expire([&] (const Id & k) { expired.push_back(k); },
+               now.plusSeconds(5.5));
+
+    BOOST_CHECK_EQUAL(expired.size(), 4);
+    BOOST_CHECK_EQUAL(map.size(), 4);
+    BOOST_CHECK(map.count(key(6)));
+}
+
+BOOST_AUTO_TEST_CASE( test_spill )
+{
+    TemporaryDirectory dir;
+    Date timeout = Date::now().plusSeconds(60);
+
+    Map map;
+    map.open(dir.path + "/map", 10);
+
+    for (int i = 0;  i < 100;  ++i)
+        map.emplace(key(i), value(i), timeout);
+
+    BOOST_CHECK_EQUAL(map.size(), 100);
+    BOOST_CHECK_EQUAL(map.inMemory(), 10);
+
+    /* spilled values are read back and the oldest ones make room */
+    for (int i = 0;  i < 100;  ++i) {
+        BOOST_CHECK_EQUAL(map.get(key(i)), value(i));
+        BOOST_CHECK_LE(map.inMemory(), 10);
+    }
+
+    /* a spilled value can be replaced or popped */
+    map.replace(key(0), "zero");
+    BOOST_CHECK_EQUAL(map.get(key(0)), "zero");
+    BOOST_CHECK_EQUAL(map.pop(key(1)), value(1));
+    BOOST_CHECK_EQUAL(map.size(), 99);
+    BOOST_CHECK_LE(map.inMemory(), 10);
+}
+
+BOOST_AUTO_TEST_CASE( test_lru_queue_bounded )
+{
+    TemporaryDirectory dir;
+    Date now = Date::now();
+
+    Map map;
+    map.open(dir.path + "/map", 10);
+
+    for (int i = 0;  i < 5;  ++i)
+        map.emplace(key(i), value(i), now.plusSeconds(60));
+
+    /* under capacity nothing is spilled, so the repeated uses of the same
+       keys must still be trimmed */
+    for (int round = 0;  round < 10000;  ++round)
+        map.get(key(round % 5));
+
+    BOOST_CHECK_EQUAL(map.inMemory(), 5);
+    BOOST_CHECK_LE(map.queuedUses(), 2 * 5 + 16 + 1);
+
+    /* values that came and went don't pile up either */
+    for (int i = 5;  i < 10000;  ++i) {
+        map.emplace(key(i), value(i), now.plusSeconds(60));
+        map.pop(key(i));
+    }
+    BOOST_CHECK_LE(map.queuedUses(), 2 * 5 + 16 + 1);
+    BOOST_CHECK_EQUAL(map.get(key(3)), value(3));
+}
+
+BOOST_AUTO_TEST_CASE( test_recovery )
+{
+    TemporaryDirectory dir;
+    Date now = Date::now();
+
+    {
+        Map map;
+        map.open(dir.path + "/map", 4);
+
+        for (int i = 0;  i < 20;  ++i)
+            map.emplace(key(i), value(i), now.plusSeconds(i));
+
+        map.replace(key(2), "two");
+        map.erase(key(3));
+        map.expire([] (const Id &) {}, now.plusSeconds(0.5));
+    }
+
+    Map map;
+    vector<Id> recovered;
+    map.open(dir.path + "/map", 4,
+             [&] (const Id & k, Date) { recovered.push_back(k); });
+
+    /* everything but the erased and expired keys comes back, on disk only */
+    BOOST_CHECK_EQUAL(recovered.size(), 18);
+    BOOST_CHECK_EQUAL(map.size(), 18);
+    BOOST_CHECK_EQUAL(map.inMemory(), 0);
+    BOOST_CHECK(!map.count(key(0)));
+    BOOST_CHECK(!map.count(key(3)));
+    BOOST_CHECK_EQUAL(map.get(key(2)), "two");
+    BOOST_CHECK_EQUAL(map.get(key(19)), value(19));
+
+    /* recovered entries keep their timeout */
+    vector<Id> expired;
+    map.expire([&] (const Id & k) { expired.push_back(k); },
+               now.plusSeconds(10.5));
+    BOOST_CHECK_EQUAL(expired.size(), 9);
+    BOOST_CHECK_EQUAL(map.size(), 9);
+}
+
+BOOST_AUTO_TEST_CASE( test_finished_info )
+{
+    TemporaryDirectory dir;
+
+    FinishedInfo info;
+    info.auctionTime = Date::fromSecondsSinceEpoch(1400000000);
+    info.auctionId = Id("auction");
+    info.adSpotId = Id(2);
+    info.spotIndex = 0;
+    info.bidRequestStr = "{\"id\":\"auction\"}";
+    info.bidRequestStrFormat = "datacratic";
+    info.uids.insert(Id("user"));
+    info.bid.agent = "agent";
+    info.bid.account = AccountKey("campaign:strategy");
+    info.bid.price.maxPrice = USD_CPM(2);
+    info.setWin(info.auctionTime.plusSeconds(1), BS_WIN,
+                USD_CPM(1), USD_CPM(1.5), "meta");
+    info.campaignEvents.setEvent("IMPRESSION", info.auctionTime.plusSeconds(2),
+                                 Json::Value("imp"));
+    info.addVisit(info.auctionTime.plusSeconds(3), "visit", SegmentList());
+
+    TieredTimeoutMap<Id, FinishedInfo> map;
+    map.open(dir.path + "/finished", 1);
+
+    map.emplace(info.auctionId, info, Date::now().plusSeconds(60));
+    map.emplace(key(0), FinishedInfo(), Date::now().plusSeconds(60));
+    BOOST_CHECK_EQUAL(map.inMemory(), 1);
+
+    const FinishedInfo & read = map.get(info.auctionId);
+    BOOST_CHECK_EQUAL(read.auctionTime, info.auctionTime);
+    BOOST_CHECK_EQUAL(read.auctionId, info.auctionId);
+    BOOST_CHECK_EQUAL(read.bidRequestStr, info.bidRequestStr);
+    BOOST_CHECK_EQUAL(read.uids.size(), 1);
+    BOOST_CHECK_EQUAL(read.bid.agent, "agent");
+    BOOST_CHECK_EQUAL(read.bid.account, info.bid.account);
+    BOOST_CHECK_EQUAL(read.bid.price.maxPrice, USD_CPM(2));
+    BOOST_CHECK_EQUAL(read.reportedStatus, BS_WIN);
+    BOOST_CHECK_EQUAL(read.winPrice, USD_CPM(1));
+    BOOST_CHECK_EQUAL(read.rawWinPrice, USD_CPM(1.5));
+    BOOST_CHECK_EQUAL(read.winMeta, "meta");
+    BOOST_CHECK(read.campaignEvents.hasEvent("IMPRESSION"));
+    BOOST_CHECK_EQUAL(read.visits.size(), 1);
+    BOOST_CHECK_EQUAL(read.visits[0].meta, "visit");
+}
@@ -0,0 +1,384 @@
+/* tiered_timeout_map.h                                            -*- C++ -*-
+   Copyright (c) 2014 Datacratic.  All rights reserved.
+
+   TimeoutMap whose values can be spilled to disk.
+
+   Every entry is written through to a LevelDB database so that the map
+   survives a restart, and only the most recently used values are kept in
+   memory.  The keys and timeouts of all the entries stay in memory so that
+   lookups for unknown keys and expiry never touch the disk.
+*/
+
+#pragma once
+
+#include "soa/types/date.h"
+#include "soa/types/flat_hash_map.h"
+#include "jml/db/persistent.h"
+#include "jml/arch/exception.h"
+#include "jml/utils/exc_check.h"
+#include "leveldb/db.h"
+#include "leveldb/write_batch.h"
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <sstream>
+
+namespace RTBKIT {
+
+/******************************************************************************/
+/* TIERED TIMEOUT MAP                                                         */
+/******************************************************************************/
+
+/** Subset of the TimeoutMap interface where the values that weren't used in
+    a while are dropped from memory and read back from disk when needed.
+
+    Until open() is called the map keeps everything in memory and doesn't
+    persist anything.
+
+    Key and Value must be serializable with ML::DB::Store_Writer.  Writes
+    are not synced so an entry survives the crash of the process but may be
+    lost if the machine itself goes down.
+*/
+
+template<typename Key, typename Value>
+struct TieredTimeoutMap
+{
+    typedef std::function<void(const Key&, Datacratic::Date)> OnRecovered;
+
+    TieredTimeoutMap() : maxInMemory(0), numInMemory(0), nextUse(0) {}
+
+    /** Persist the entries in the LevelDB database at path and keep at most
+        maxInMemory values in memory.  The entries left in the database by a
+        previous run are recovered (on disk only) and onRecovered is called
+        for each of them.
+    */
+    void open(const std::string& path, size_t maxInMemory,
+              const OnRecovered& onRecovered = OnRecovered())
+    {
+        ExcCheck(!db, "map is already persistent");
+        ExcCheckGreater(maxInMemory, 0, "maxInMemory must be positive");
+
+        leveldb::DB* newDb;
+        leveldb::Options options;
+        options.create_if_missing = true;
+        check(leveldb::DB::Open(options, path, &newDb), "opening " + path);
+        db.reset(newDb);
+
+        this->maxInMemory = maxInMemory;
+
+        std::unique_ptr<leveldb::Iterator> it(
+                db->NewIterator(leveldb::ReadOptions()));
+
+        for (it->SeekToFirst(); it->Valid(); it->Next()) {
+            Key key = reconstituteKey(it->key());
+
+            // Only the timeout is needed: it's stored ahead of the value.
+            ML::DB::Store_Reader store(it->value().data(), it->value().size());
+            Datacratic::Date timeout;
+            store >> timeout;
+
+            auto ret = map.emplace(key, Entry(timeout));
+            if (!ret.second) continue;
+
+            queue.emplace(key, timeout);
+            if (onRecovered) onRecovered(key, timeout);
+        }
+        check(it->status(), "scanning " + path);
+    }
+
+    bool persistent() const
+    {
+        return !!db;
+    }
+
+    size_t size() const
+    {
+        return map.size();
+    }
+
+    /** Number of use records waiting in the LRU queue. */
+    size_t queuedUses() const
+    {
+        return uses.size();
+    }
+
+    /** Number of values that are currently held in memory. */
+    size_t inMemory() const
+    {
+        return db ? numInMemory : map.size();
+    }
+
+    bool count(const Key& key) const
+    {
+        return map.count(key);
+    }
+
+    /** Returns the value of the key, reading it back from disk if needed.
+        The reference is only valid until the next modification of the map
+        and changes made through it are not persisted: use replace().
+    */
+    Value& get(const Key& key)
+    {
+        auto it = map.find(key);
+        ExcCheck(it != map.end(), "key not present in the timeout map.");
+
+        Entry& entry = it->second;
+        if (!entry.value) {
+            std::unique_ptr<Value> value(new Value(read(key)));
+            entry.value = std::move(value);
+            ++numInMemory;
+        }
+
+        // Spilling can only remove the entries used before this one.
+        Value* result = entry.value.get();
+        touch(key, entry);
+        spill();
+        return *result;
+    }
+
+    bool emplace(Key key, Value value, Datacratic::Date timeout)
+    {
+        if (map.count(key)) return false;
+
+        if (db) write(key, value, timeout);
+
+        auto ret = map.emplace(key, Entry(timeout));
+        Entry& entry = ret.first->second;
+        entry.value.reset(new Value(std::move(value)));
+        ++numInMemory;
+
+        queue.emplace(key, timeout);
+        touch(key, entry);
+        spill();
+        return true;
+    }
+
+    /** Overwrite the value of an existing key. */
+    void replace(const Key& key, Value value)
+    {
+        auto it = map.find(key);
+        ExcCheck(it != map.end(), "key not present in the timeout map.");
+
+        Entry& entry = it->second;
+        if (db) write(key, value, entry.timeout);
+
+        if (!entry.value) ++numInMemory;
+        entry.value.reset(new Value(std::move(value)));
+
+        touch(key, entry);
+        spill();
+    }
+
+    Value pop(const Key& key)
+    {
+        auto it = map.find(key);
+        ExcCheck(it != map.end(), "key not present in the timeout map.");
+
+        Value value = it->second.value
+            ? std::move(*it->second.value)
+            : read(key);
+
+        remove(it);
+        return value;
+    }
+
+    bool erase(const Key& key)
+    {
+        auto it = map.find(key);
+        if (it == map.end()) return false;
+
+        remove(it);
+        return true;
+    }
+
+    /** Removes the entries whose timeout has passed and calls fn with the
+        key of each.  Unlike TimeoutMap, the values are not passed along to
+        avoid reading back the spilled ones only to throw them away.
+    */
+    template<typename Fn>
+    size_t expire(const Fn& fn, Datacratic::Date now = Datacratic::Date::now())
+    {
+        std::vector<Key> toExpire;
+        leveldb::WriteBatch batch;
+
+        while (!queue.empty() && queue.top().timeout <= now) {
+            TimeoutEntry entry = std::move(queue.top());
+            queue.pop();
+
+            auto it = map.find(entry.key);
+            if (it == map.end()) continue;
+            if (it->second.timeout > now) continue;
+
+            if (it->second.value) --numInMemory;
+            if (db) batch.Delete(stringifyKey(entry.key));
+
+            toExpire.emplace_back(std::move(entry.key));
+            map.erase(it);
+        }
+
+        if (db && !toExpire.empty())
+            check(db->Write(leveldb::WriteOptions(), &batch), "expiring");
+
+        for (auto& key : toExpire) fn(key);
+
+        return toExpire.size();
+    }
+
+private:
+
+    struct Entry
+    {
+        std::unique_ptr<Value> value; ///< null if only on disk
+        Datacratic::Date timeout;
+        uint64_t lastUse;
+
+        explicit Entry(Datacratic::Date timeout) :
+            timeout(timeout), lastUse(0)
+        {}
+    };
+
+    struct TimeoutEntry
+    {
+        Key key;
+        Datacratic::Date timeout;
+
+        TimeoutEntry(Key key, Datacratic::Date timeout) :
+            key(std::move(key)), timeout(timeout)
+        {}
+
+        bool operator<(const TimeoutEntry& other) const
+        {
+            return timeout > other.timeout;
+        }
+    };
+
+    typedef Datacratic::FlatHashMap<Key, Entry> Map;
+
+    static void check(const leveldb::Status& status, const std::string& what)
+    {
+        if (!status.ok())
+            throw ML::Exception("TieredTimeoutMap: %s: %s",
+                    what.c_str(), status.ToString().c_str());
+    }
+
+    static std::string stringifyKey(const Key& key)
+    {
+        std::ostringstream stream;
+        {
+            ML::DB::Store_Writer store(stream);
+            store << key;
+        }
+        return stream.str();
+    }
+
+    static Key reconstituteKey(const leveldb::Slice& str)
+    {
+        ML::DB::Store_Reader store(str.data(), str.size());
+        Key key;
+        store >> key;
+        return key;
+    }
+
+    void write(const Key& key, const Value& value, Datacratic::Date timeout)
+    {
+        std::ostringstream stream;
+        {
+            ML::DB::Store_Writer store(stream);
+            store << timeout << value;
+        }
+        check(db->Put(leveldb::WriteOptions(), stringifyKey(key), stream.str()),
+                "writing");
+    }
+
+    Value read(const Key& key) const
+    {
+        ExcCheck(db, "value missing from a non persistent map");
+
+        std::string str;
+        check(db->Get(leveldb::ReadOptions(), stringifyKey(key), &str),
+                "reading");
+
+        ML::DB::Store_Reader store(str.data(), str.size());
+        Datacratic::Date timeout;
+        Value value;
+        store >> timeout >> value;
+        return value;
+    }
+
+    void remove(typename Map::iterator it)
+    {
+        if (db) {
+            check(db->Delete(leveldb::WriteOptions(), stringifyKey(it->first)),
+                    "erasing");
+        }
+
+        if (it->second.value) --numInMemory;
+        map.erase(it);
+    }
+
+    /** Records that the value was just used.  Older records for the same key
+        are skipped by spill() and, once they outnumber the live ones, swept
+        out of the queue so that it stays proportional to numInMemory.
+    */
+    void touch(const Key& key, Entry& entry)
+    {
+        if (!db) return;
+
+        entry.lastUse = ++nextUse;
+        uses.emplace_back(key, entry.lastUse);
+
+        if (uses.size() > 2 * numInMemory + 16) {
+            auto isStale = [&] (const std::pair<Key, uint64_t>& use)
+                {
+                    auto it = map.find(use.first);
+                    return it == map.end()
+                        || it->second.lastUse != use.second
+                        || !it->second.value;
+                };
+            uses.erase(std::remove_if(uses.begin(), uses.end(), isStale),
+                       uses.end());
+        }
+    }
+
+    /** Drops the least recently used values from memory until we're back
+        under maxInMemory.  They're already on disk so nothing is written.
+        Stale uses at the front of the queue are trimmed along the way.
+    */
+    void spill()
+    {
+        if (!db) return;
+
+        while (!uses.empty()) {
+            const auto& use = uses.front();
+
+            auto it = map.find(use.first);
+            bool stale = it == map.end()
+                || it->second.lastUse != use.second
+                || !it->second.value;
+
+            if (!stale) {
+                if (numInMemory <= maxInMemory) break;
+
+                it->second.value.reset();
+                --numInMemory;
+            }
+
+            uses.pop_front();
+        }
+    }
+
+    std::shared_ptr<leveldb::DB> db;
+    size_t maxInMemory;
+    size_t numInMemory;
+
+    Map map;
+    std::priority_queue<TimeoutEntry> queue;
+
+    uint64_t nextUse;
+    std::deque< std::pair<Key, uint64_t> > uses;
+};
+
+} // namespace RTBKIT
@@ -12,6 +12,7 @@
 #pragma once
 
 #include "soa/types/date.h"
+#include "soa/types/flat_hash_map.h"
 
 #include <set>
 #include <queue>
@@ -135,7 +136,7 @@ private:
         }
     };
 
-    std::unordered_map<Key, Entry> map;
+    Datacratic::FlatHashMap<Key, Entry> map;
     std::priority_queue<TimeoutEntry> queue;
 };
 
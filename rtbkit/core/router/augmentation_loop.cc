@@ -385,6 +385,21 @@ doAugmentation(std::shared_ptr<Entry>&& entry)
 
     bool sentToAugmentor = false;
 
+    // Binary encodings of the bid request for 2.0 augmentors, by field mask.
+    std::map<uint32_t, std::string> encodedRequests;
+
+    auto encodeRequest = [&] (uint32_t fields) -> const std::string &
+        {
+            std::string & encoded = encodedRequests[fields];
+            if (encoded.empty()) {
+                std::ostringstream stream;
+                ML::DB::Store_Writer writer(stream);
+                entry->info->auction->request->serializeFields(writer, fields);
+                encoded = stream.str();
+            }
+            return encoded;
+        };
+
     for (auto it = entry->outstanding.begin(), end = entry->outstanding.end();
          it != end;  ++it)
     {
@@ -405,13 +420,17 @@ doAugmentation(std::shared_ptr<Entry>&& entry)
         ML::DB::Store_Writer writer(availableAgentsStr);
         writer.save(agents);
 
-        // Send the message to the augmentor
+        // Send the message to the augmentor.  Both versions have the same
+        // layout; 2.0 replaces the request string by its binary encoding.
+        bool binary = instance->version == "2.0";
         toAugmentors.sendMessage(
                 instance->addr,
-                "AUGMENT", "1.0", *it,
+                "AUGMENT", instance->version, *it,
                 entry->info->auction->id.toString(),
                 entry->info->auction->requestStrFormat,
-                entry->info->auction->requestStr,
+                binary
+                    ? encodeRequest(instance->fields)
+                    : entry->info->auction->requestStr,
                 availableAgentsStr.str(),
                 Date::now());
 
@@ -432,7 +451,7 @@ AugmentationLoop::
 doConfig(const std::vector<std::string> & message)
 {
     ExcCheckGreaterEqual(message.size(), 4, "config message has wrong size");
-    ExcCheckLessEqual(message.size(), 5, "config message has wrong size");
+    ExcCheckLessEqual(message.size(), 6, "config message has wrong size");
 
     const string & addr = message[0];
     const string & version = message[2];
@@ -443,9 +462,17 @@ doConfig(const std::vector<std::string> & message)
         maxInFlight = std::stoi(message[4]);
     if (maxInFlight < 0) maxInFlight = 3000;
 
-    ExcCheckEqual(version, "1.0", "unknown version for config message");
+    ExcCheck(version == "1.0" || version == "2.0",
+             "unknown version for config message");
     ExcCheck(!name.empty(), "no augmentor name specified");
 
+    // Only 2.0 augmentors can ask for a subset of the bid request.
+    uint32_t fields = BRF_ALL;
+    if (message.size() >= 6) {
+        ExcCheckEqual(version, "2.0", "config message has wrong size");
+        fields = parseBidRequestFields(message[5]);
+    }
+
     //cerr << "configuring augmentor " << name << " on " << connectTo
     //     << endl;
 
@@ -457,7 +484,8 @@ doConfig(const std::vector<std::string> & message)
         recordHit("augmentor.%s.configured", name);
     }
 
-    info->instances.push_back(std::make_shared<AugmentorInstanceInfo>(addr, maxInFlight));
+    info->instances.push_back(std::make_shared<AugmentorInstanceInfo>(
+                    addr, maxInFlight, version, fields));
     recordHit("augmentor.%s.instances.%s.configured", name, addr);
 
 
@@ -521,7 +549,8 @@ doResponse(const std::vector<std::string> & message)
     ExcCheckEqual(message.size(), 7, "response message has wrong size");
 
     const string & version = message[2];
-    ExcCheckEqual(version, "1.0", "unknown response version");
+    ExcCheck(version == "1.0" || version == "2.0",
+             "unknown response version");
 
     const std::string & addr = message[0];
     Date startTime = Date::parseSecondsSinceEpoch(message[3]);
@@ -33,13 +33,24 @@ namespace RTBKIT {
 /** Information about a specific augmentor which belongs to an augmentor class.
  */
 struct AugmentorInstanceInfo {
-    AugmentorInstanceInfo(const std::string& addr = "", int maxInFlight = 0) :
-        addr(addr), numInFlight(0), maxInFlight(maxInFlight)
+    AugmentorInstanceInfo(const std::string& addr = "", int maxInFlight = 0,
+                          const std::string& version = "1.0",
+                          uint32_t fields = BRF_ALL) :
+        addr(addr), numInFlight(0), maxInFlight(maxInFlight),
+        version(version), fields(fields)
     {}
 
     std::string addr;
     int numInFlight;
     int maxInFlight;
+
+    /** Protocol version spoken by the instance.  Version 1.0 gets the
+        original bid request string, version 2.0 gets the binary encoding
+        of the parsed bid request restricted to the BidRequestFields in
+        fields.
+    */
+    std::string version;
+    uint32_t fields;
 };
 
 /** Information about a given class of augmentor. */
@@ -7,6 +7,7 @@
 */
 
 #include "filter_pool.h"
+#include "filters/priority.h"
 #include "rtbkit/common/bid_request.h"
 #include "rtbkit/common/exchange_connector.h"
 #include "rtbkit/core/agent_configuration/agent_config.h"
@@ -21,13 +22,23 @@ using namespace ML;
 
 namespace RTBKIT {
 
+namespace {
+
+// Number of sampled bid requests between two re-evaluations of the plan.
+constexpr uint64_t ReplanPeriod = 1024;
+
+// Minimum number of samples before we trust the stats of a filter.
+constexpr uint64_t MinCalls = 64;
+
+} // namespace anonymous
+
 
 /******************************************************************************/
 /* FILTER POOL                                                                */
 /******************************************************************************/
 
 FilterPool::
-FilterPool() : data(new Data()), events(nullptr) {}
+FilterPool() : data(new Data()), adaptiveOrdering(true), events(nullptr) {}
 
 
 void
@@ -56,7 +67,7 @@ FilterPool::
 ~FilterPool()
 {
     {
-        GcLockBase::SharedGuard guard(gc);
+        EpochGc::SharedGuard guard(gc);
 
         unique_ptr<Data> nil;
         Data* current = data.load();
@@ -114,11 +125,30 @@ recordTime(uint64_t start, const FilterBase* filter)
 }
 
 
+void
+FilterPool::
+replan(const Data* data)
+{
+    Plan* oldPlan = data->plan.exchange(data->makePlan());
+    gc.defer([=] { delete oldPlan; });
+
+    // Decay the stats so that the plan can follow changes in the traffic.
+    for (FilterStats& stats : data->stats) {
+        stats.calls -= stats.calls / 2;
+        stats.ticks -= stats.ticks / 2;
+        stats.configsIn -= stats.configsIn / 2;
+        stats.configsOut -= stats.configsOut / 2;
+    }
+
+    if (events) events->recordHit("filters.replan");
+}
+
+
 FilterPool::ConfigList
 FilterPool::
 filter(const BidRequest& br, const ExchangeConnector* conn, const ConfigSet& mask)
 {
-    GcLockBase::SharedGuard guard(gc, GcLockBase::RD_NO);
+    EpochGc::SharedGuard guard(gc, EpochGc::RD_NO);
 
     const Data* current = data.load();
     ExcCheck(!current->filters.empty(), "No filters registered");
@@ -128,31 +158,53 @@ filter(const BidRequest& br, const ExchangeConnector* conn, const ConfigSet& mas
 
     ConfigSet configs = state.configs();
 
-    bool sampleStats = events && (random() % 10 == 0);
+    bool sampleStats = random() % 10 == 0;
+    state.collectFilterReasons(sampleStats && events);
+
     uint64_t ticksStart = sampleStats ? ticks() : 0;
+    size_t configsIn = sampleStats ? configs.count() : 0;
 
-    for (FilterBase* filter : current->filters) {
+    // No point in running any filters if the mask already excluded everyone.
+    static const Plan noFilters;
+    const Plan& plan = configs.empty() ? noFilters : *current->plan.load();
+
+    for (unsigned index : plan) {
+        FilterBase* filter = current->filters[index];
         filter->filter(state);
 
         const ConfigSet& filtered = state.configs();
 
         if (sampleStats) {
-            ticksStart = recordTime(ticksStart, filter);
-            recordDiff(current, filter, configs ^ filtered);
-            if (!state.getFilterReasons().empty()) {
-                recordReason(current, filter, state);
+            uint64_t now = events ? recordTime(ticksStart, filter) : ticks();
+            size_t configsOut = filtered.count();
+            current->stats[index].record(now - ticksStart, configsIn, configsOut);
+            configsIn = configsOut;
+
+            if (events) {
+                recordDiff(current, filter, configs ^ filtered);
+                if (!state.getFilterReasons().empty()) {
+                    recordReason(current, filter, state);
+                }
+                configs = filtered;
             }
-            configs = filtered;
+
+            // Don't charge our bookkeeping to the next filter.
+            ticksStart = ticks();
         }
         state.resetFilterReasons();
 
         if (filtered.empty()) {
-            if (sampleStats) 
+            if (sampleStats && events)
                 events->recordHit("filters.breakLoop.%s", filter->name());
             break;
         }
     }
 
+    if (sampleStats && adaptiveOrdering) {
+        if (current->samples.fetch_add(1) % ReplanPeriod == ReplanPeriod - 1)
+            replan(current);
+    }
+
     auto biddableSpots = state.biddableSpots();
     configs = state.configs();
 
@@ -171,7 +223,7 @@ void
 FilterPool::
 addFilter(const string& name)
 {
-    GcLockBase::SharedGuard guard(gc);
+    EpochGc::SharedGuard guard(gc);
 
     Data* oldData = data.load();
     unique_ptr<Data> newData;
@@ -189,7 +241,7 @@ void
 FilterPool::
 removeFilter(const string& name)
 {
-    GcLockBase::SharedGuard guard(gc);
+    EpochGc::SharedGuard guard(gc);
 
     unique_ptr<Data> newData;
     Data* oldData = data.load();
@@ -206,7 +258,7 @@ void
 FilterPool::
 initWithDefaultFilters()
 {
-    GcLockBase::SharedGuard guard(gc);
+    EpochGc::SharedGuard guard(gc);
 
     Data* oldData = data.load();
     unique_ptr<Data> newData;
@@ -227,7 +279,7 @@ FilterPool::
 initWithFiltersFromJson(const Json::Value & json)
 {
 
-    GcLockBase::SharedGuard guard(gc);
+    EpochGc::SharedGuard guard(gc);
 
     Data* oldData = data.load();
     unique_ptr<Data> newData;
@@ -251,7 +303,7 @@ unsigned
 FilterPool::
 addConfig(const string& name, const AgentInfo& info)
 {
-    GcLockBase::SharedGuard guard(gc);
+    EpochGc::SharedGuard guard(gc);
 
     unique_ptr<Data> newData;
     Data* oldData = data.load();
@@ -272,7 +324,7 @@ void
 FilterPool::
 removeConfig(const string& name)
 {
-    GcLockBase::SharedGuard guard(gc);
+    EpochGc::SharedGuard guard(gc);
 
     unique_ptr<Data> newData;
     Data* oldData = data.load();
@@ -289,7 +341,7 @@ std::vector<string>
 FilterPool::
 getFilterNames() const
 {
-    GcLockBase::SharedGuard guard(gc, GcLockBase::RD_NO);
+    EpochGc::SharedGuard guard(gc, EpochGc::RD_NO);
 
     const Data* current = data.load();
     std::vector<string> filter_names;
@@ -303,14 +355,44 @@ getFilterNames() const
 }
 
 
+/******************************************************************************/
+/* FILTER POOL - FILTER STATS                                                 */
+/******************************************************************************/
+
+FilterPool::FilterStats::
+FilterStats(const FilterStats& other) :
+    calls(other.calls.load()),
+    ticks(other.ticks.load()),
+    configsIn(other.configsIn.load()),
+    configsOut(other.configsOut.load())
+{}
+
+void
+FilterPool::FilterStats::
+record(uint64_t elapsed, size_t in, size_t out)
+{
+    calls++;
+    ticks += elapsed;
+    configsIn += in;
+    configsOut += out;
+}
+
+
 /******************************************************************************/
 /* FILTER POOL - DATA                                                         */
 /******************************************************************************/
 
+FilterPool::Data::
+Data() : plan(new Plan()), samples(0)
+{}
+
 FilterPool::Data::
 Data(const Data& other) :
     configs(other.configs),
-    activeConfigs(other.activeConfigs)
+    activeConfigs(other.activeConfigs),
+    stats(other.stats),
+    plan(new Plan(*other.plan.load())),
+    samples(0)
 {
     filters.reserve(other.filters.size());
     for (FilterBase* filter : other.filters)
@@ -322,6 +404,80 @@ FilterPool::Data::
 ~Data()
 {
     for (FilterBase* filter : filters) delete filter;
+    delete plan.load();
+}
+
+
+/** Resets the stats and sets the plan back to the priority order. Should only
+    be called on a Data that hasn't been published yet.
+ */
+void
+FilterPool::Data::
+resetPlan()
+{
+    stats.clear();
+    stats.resize(filters.size());
+
+    unique_ptr<Plan> newPlan(new Plan(filters.size()));
+    for (size_t i = 0; i < filters.size(); ++i)
+        (*newPlan)[i] = i;
+
+    delete plan.exchange(newPlan.release());
+}
+
+
+/** Orders the filters by ascending cost / selectivity which is the optimal
+    order for independent filters: cheap filters that remove a lot of configs
+    should be executed first. Filters without enough samples are moved to the
+    front so that they quickly get some.
+
+    Filters at or above Priority::ExchangePre are expensive and call into the
+    exchange connector so they are always kept last in priority order.
+ */
+FilterPool::Plan*
+FilterPool::Data::
+makePlan() const
+{
+    vector< pair<double, unsigned> > ranks;
+    ranks.reserve(filters.size());
+
+    size_t pinned = 0;
+    while (pinned < filters.size()
+            && filters[pinned]->priority() < Priority::ExchangePre)
+    {
+        const FilterStats& filterStats = stats[pinned];
+
+        double rank = 0.0;
+        uint64_t calls = filterStats.calls;
+
+        if (calls >= MinCalls) {
+            double cost = double(filterStats.ticks) / calls;
+
+            uint64_t in = filterStats.configsIn;
+            uint64_t out = filterStats.configsOut;
+            double dropRate = in ? 1.0 - double(out) / in : 0.0;
+
+            rank = cost / std::max(dropRate, 0.001);
+        }
+
+        ranks.emplace_back(rank, pinned);
+        pinned++;
+    }
+
+    stable_sort(ranks.begin(), ranks.end(),
+            [] (const pair<double, unsigned>& lhs,
+                const pair<double, unsigned>& rhs)
+            {
+                return lhs.first < rhs.first;
+            });
+
+    unique_ptr<Plan> result(new Plan());
+    result->reserve(filters.size());
+
+    for (const auto& rank : ranks) result->push_back(rank.second);
+    for (size_t i = pinned; i < filters.size(); ++i) result->push_back(i);
+
+    return result.release();
 }
 
 ssize_t
@@ -400,6 +556,8 @@ addFilter(FilterBase* filter)
     sort(filters.begin(), filters.end(), [] (FilterBase* lhs, FilterBase* rhs) {
                 return lhs->priority() < rhs->priority();
             });
+
+    resetPlan();
 }
 
 void
@@ -415,6 +573,8 @@ removeFilter(const string& name)
         filters[i] = filters[i+1];
 
     filters.pop_back();
+
+    resetPlan();
 }
 
 } // namepsace RTBKit
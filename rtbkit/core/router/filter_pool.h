@@ -9,7 +9,7 @@
 #pragma once
 
 #include "rtbkit/common/filter.h"
-#include "soa/gc/gc_lock.h"
+#include "soa/gc/epoch_gc.h"
 
 #include <atomic>
 #include <vector>
@@ -50,7 +50,8 @@ struct FilterPool
             name(std::move(name)),
             config(info.config),
             status(info.status),
-            stats(info.stats)
+            stats(info.stats),
+            events(info.events)
         {}
 
         void reset()
@@ -58,12 +59,14 @@ struct FilterPool
             name = "";
             config.reset();
             stats.reset();
+            events.reset();
         }
 
         std::string name;
         std::shared_ptr<AgentConfig> config;
         std::shared_ptr<AgentStatus> status;
         std::shared_ptr<AgentStats> stats;
+        std::shared_ptr<const AccountEvents> events;
 
         // Only used in the instances returned from filter.
         BiddableSpots biddableSpots;
@@ -90,11 +93,38 @@ struct FilterPool
     // Added for test purposes
     std::vector<string> getFilterNames() const;
 
+    /** When enabled (the default), the order in which the filters are executed
+        is adapted at runtime using the cost and selectivity of each filter
+        measured on a sample of the bid requests. Only filters with a priority
+        lower then Priority::ExchangePre are reordered; the others always run
+        last and in priority order.
+     */
+    void setAdaptiveOrdering(bool value) { adaptiveOrdering = value; }
+
 private:
 
+    /** Runtime statistics of a filter used to plan the execution order. Only
+        updated for sampled bid requests.
+     */
+    struct FilterStats
+    {
+        FilterStats() : calls(0), ticks(0), configsIn(0), configsOut(0) {}
+        FilterStats(const FilterStats& other);
+
+        void record(uint64_t ticks, size_t in, size_t out);
+
+        std::atomic<uint64_t> calls;
+        std::atomic<uint64_t> ticks;
+        std::atomic<uint64_t> configsIn;
+        std::atomic<uint64_t> configsOut;
+    };
+
+    // Order in which to execute the filters as indexes into Data::filters.
+    typedef std::vector<unsigned> Plan;
+
     struct Data
     {
-        Data() {}
+        Data();
         Data(const Data& other);
         ~Data();
 
@@ -106,21 +136,32 @@ private:
         void addFilter(FilterBase* filter);
         void removeFilter(const std::string& name);
 
+        void resetPlan();
+        Plan* makePlan() const;
+
         // \todo Use unique_ptr when moving to gcc 4.7
         std::vector<FilterBase*> filters;
 
         std::vector<ConfigEntry> configs;
         CreativeMatrix activeConfigs;
+
+        // Indexed like filters. Filtering only gets a const Data so these
+        // are mutable.
+        mutable std::vector<FilterStats> stats;
+        mutable std::atomic<Plan*> plan;
+        mutable std::atomic<uint64_t> samples;
     };
 
     bool setData(Data*&, std::unique_ptr<Data>&);
     void recordDiff(const Data* data, const FilterBase* f, const ConfigSet& diff);
     void recordReason(const Data* data, const FilterBase* f, FilterState & state);
     uint64_t recordTime(uint64_t ticks, const FilterBase* filter);
+    void replan(const Data* data);
 
     std::atomic<Data*> data;
+    std::atomic<bool> adaptiveOrdering;
     std::vector< std::shared_ptr<AgentConfig> > configs;
-    mutable Datacratic::GcLock gc;
+    mutable Datacratic::EpochGc gc;
 
     EventRecorder* events;
 };
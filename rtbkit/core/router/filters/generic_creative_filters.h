@@ -396,6 +396,8 @@ private:
 
 /** Segments have quirks and are best handled seperatly from the list filter.
 
+    String segments are keyed by their SegmentDictionary id; see
+    SegmentListFilter.
  */
 struct CreativeSegmentListFilter
 {
@@ -419,16 +421,24 @@ struct CreativeSegmentListFilter
 
     CreativeMatrix filter(int i, const std::string& str) const
     {
-        return i >= 0 ? get(intSet, i) : get(strSet, str);
+        CreativeMatrix configs;
+        if (i >= 0) merge(configs, intSet, i);
+        else merge(configs, strSet, SegmentDictionary::find(str));
+        return configs;
     }
 
     CreativeMatrix filter(const SegmentList& segments) const
     {
         CreativeMatrix configs;
 
-        segments.forEach([&](int i, std::string str, float) {
-                    configs |= filter(i, str);
-                });
+        for (int i : segments.ints)
+            merge(configs, intSet, i);
+
+        if (!strSet.empty()) {
+            segments.forEachStringId([&](int id) {
+                        merge(configs, strSet, id);
+                    });
+        }
 
         return configs;
     }
@@ -438,22 +448,23 @@ private:
     void setConfig(unsigned cfgIndex, unsigned creativeId,
                      const SegmentList& segments, bool value)
     {
-        segments.forEach([&](int i, std::string str, float) {
-                    if (i >= 0) intSet[i].set(creativeId, cfgIndex, value);
-                    else strSet[str].set(creativeId, cfgIndex, value);
-                });
+        for (int i : segments.ints)
+            intSet[i].set(creativeId, cfgIndex, value);
+
+        for (int id : SegmentDictionary::intern(segments.strings))
+            strSet[id].set(creativeId, cfgIndex, value);
     }
 
-    template<typename K>
-    CreativeMatrix get(const std::unordered_map<K,
-                       CreativeMatrix>& m, K k) const
+    static void merge(
+            CreativeMatrix& configs,
+            const std::unordered_map<int, CreativeMatrix>& m, int k)
     {
         auto it = m.find(k);
-        return it != m.end() ? it->second : CreativeMatrix();
+        if (it != m.end()) configs |= it->second;
     }
 
     std::unordered_map<int, CreativeMatrix> intSet;
-    std::unordered_map<std::string, CreativeMatrix> strSet;
+    std::unordered_map<int, CreativeMatrix> strSet; ///< Keyed by dictionary id
 };
 
 } // namespace RTBKIT
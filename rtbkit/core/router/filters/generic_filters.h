@@ -10,7 +10,12 @@
 
 #include "rtbkit/core/agent_configuration/agent_config.h"
 #include "rtbkit/core/agent_configuration/include_exclude.h"
+#include "rtbkit/core/router/filters/literal_set.h"
 #include "rtbkit/common/filter.h"
+#include "jml/arch/thread_specific.h"
+#include "city.h"
+
+#include <array>
 
 
 namespace RTBKIT {
@@ -218,7 +223,7 @@ private:
         if (index < 0) return;
 
         if (interval == intervals[index])
-            intervals[index].configs &= interval.configs.negate();
+            intervals[index].configs.andNot(interval.configs);
     }
 
     ssize_t findInterval(const Interval& interval)
@@ -315,19 +320,42 @@ private:
 
     std::unordered_map<std::string, ConfigSet> domainMap;
 };
-
 /******************************************************************************/
 /* REGEX FILTER                                                               */
 /******************************************************************************/
 
 /** Generic include filter for regexes.
 
-    \todo We could add a TLS cache of all seen values such that we can avoid the
-    regex entirely.
+    The literals that the regexes require are compiled into a single LiteralSet
+    so that one scan of the string gives the few regexes that can match it.
+    Regexes that are plain literals are fully resolved by the scan and regexes
+    without any usable literal are always evaluated.
+
+    Results are also kept in a small per-thread cache indexed by the string
+    which avoids the scan and the regexes entirely for low cardinality values
+    like languages and locations.
  */
 template<typename Regex, typename Str>
 struct RegexFilter
 {
+    RegexFilter() : generation(1) {}
+
+    // The compiled entries point into data and the TLS cache can't be shared
+    // so both are rebuilt on copy.
+    RegexFilter(const RegexFilter& other) :
+        data(other.data), generation(1)
+    {
+        compile();
+    }
+
+    RegexFilter& operator=(const RegexFilter& other)
+    {
+        if (this == &other) return *this;
+        data = other.data;
+        compile();
+        return *this;
+    }
+
     template<typename List>
     bool isEmpty(const List& list) const
     {
@@ -339,6 +367,7 @@ struct RegexFilter
     {
         for (const auto& value : list)
             addConfig(cfgIndex, value);
+        compile();
     }
 
     template<typename List>
@@ -346,16 +375,19 @@ struct RegexFilter
     {
         for (const auto& value : list)
             removeConfig(cfgIndex, value);
+        compile();
     }
 
     ConfigSet filter(const Str& str) const
     {
-        ConfigSet matches;
-
-        for (const auto& entry : data)
-            matches |= entry.second.filter(str);
+        return match(str, nullptr);
+    }
 
-        return matches;
+    // Only evaluates the regexes of configs that are still live and only
+    // returns configs that are in live.
+    ConfigSet filterLive(const ConfigSet& live, const Str& str) const
+    {
+        return match(str, &live);
     }
 
 private:
@@ -387,6 +419,131 @@ private:
         removeConfig(cfgIndex, regex.base);
     }
 
+
+    static std::string pattern(const std::string& str) { return str; }
+
+    template<typename Char>
+    static std::string pattern(const std::basic_string<Char>& str)
+    {
+        std::string result;
+        utf8::utf32to8(str.begin(), str.end(), std::back_inserter(result));
+        return result;
+    }
+
+    static std::pair<const char*, size_t> bytes(const std::string& str)
+    {
+        return std::make_pair(str.data(), str.size());
+    }
+
+    static std::pair<const char*, size_t> bytes(const Utf8String& str)
+    {
+        return std::make_pair(str.rawData(), str.rawLength());
+    }
+
+    void compile()
+    {
+        entries.clear();
+        literals.clear();
+        literalEntries.clear();
+        unfiltered = ConfigSet();
+        generation++;
+
+        for (const auto& item : data) {
+            unsigned index = entries.size();
+
+            RequiredLiterals required = extractLiterals(
+                    pattern(item.first), item.second.regex.flags());
+            entries.push_back(Entry(&item.second, required.exact));
+
+            if (required.literals.empty()) {
+                unfiltered.set(index);
+                continue;
+            }
+
+            for (const auto& literal : required.literals) {
+                unsigned id = literals.add(literal);
+                if (id >= literalEntries.size()) literalEntries.resize(id + 1);
+                literalEntries[id].push_back(index);
+            }
+        }
+
+        literals.compile();
+    }
+
+    ConfigSet match(const Str& str, const ConfigSet* live) const
+    {
+        auto raw = bytes(str);
+
+        uint64_t hash = CityHash64(raw.first, raw.second);
+        CacheEntry& entry = (*cache.get())[hash % CacheSize];
+
+        if (entry.generation != generation
+                || entry.key.compare(0, std::string::npos, raw.first, raw.second))
+        {
+            entry.generation = generation;
+            entry.complete = false;
+            entry.key.assign(raw.first, raw.second);
+            entry.matches = ConfigSet();
+            entry.known = ConfigSet();
+        }
+
+        if (!live) {
+            if (!entry.complete) {
+                entry.matches = evaluate(str, raw, nullptr);
+                entry.complete = true;
+            }
+            return entry.matches;
+        }
+
+        // Only the regexes of the live configs that we haven't seen for this
+        // string yet need to be evaluated.
+        if (!entry.complete) {
+            ConfigSet missing = *live;
+            missing.andNot(entry.known);
+            if (!missing.empty()) {
+                entry.matches |= evaluate(str, raw, &missing);
+                entry.known |= missing;
+            }
+        }
+
+        ConfigSet matches = entry.matches;
+        matches &= *live;
+        return matches;
+    }
+
+    ConfigSet evaluate(
+            const Str& str,
+            std::pair<const char*, size_t> raw,
+            const ConfigSet* live) const
+    {
+        ConfigSet matches;
+
+        // Both sets are indexed by literal and entry index respectively.
+        ConfigSet hits;
+        ConfigSet candidates = unfiltered;
+
+        literals.scan(raw.first, raw.second, [&] (unsigned id) { hits.set(id); });
+
+        for (size_t id = hits.next(); id < hits.size(); id = hits.next(id + 1)) {
+            for (unsigned index : literalEntries[id]) {
+                const Entry& entry = entries[index];
+                if (!entry.exact) candidates.set(index);
+                else matches |= entry.data->configs;
+            }
+        }
+
+        for (size_t index = candidates.next();
+             index < candidates.size();
+             index = candidates.next(index + 1))
+        {
+            const RegexData& data = *entries[index].data;
+            if (live && !data.configs.intersects(*live)) continue;
+            matches |= data.filter(str);
+        }
+
+        return matches;
+    }
+
     struct RegexData
     {
         Regex regex;
@@ -407,6 +564,37 @@ private:
        own because, you guessed it, gcc already defines it. Glorious is it not?
     */
     std::map<KeyT, RegexData> data;
+
+    struct Entry
+    {
+        Entry(const RegexData* data, bool exact) : data(data), exact(exact) {}
+
+        const RegexData* data;
+        bool exact; // A hit in the LiteralSet is a match.
+    };
+
+    std::vector<Entry> entries;
+    std::vector< std::vector<unsigned> > literalEntries;
+    ConfigSet unfiltered; // Entries that must always be evaluated.
+    LiteralSet literals;
+
+    struct CacheEntry
+    {
+        CacheEntry() : generation(0), complete(false) {}
+
+        unsigned generation;
+        bool complete; // Every regex was evaluated.
+        std::string key;
+        ConfigSet matches;
+        ConfigSet known; // Configs whose regexes were all evaluated.
+    };
+
+    enum { CacheSize = 256 };
+    typedef std::array<CacheEntry, CacheSize> Cache;
+
+    // Bumped on every change so that stale cache entries are ignored.
+    unsigned generation;
+    ML::ThreadSpecificInstanceInfo<Cache, RegexFilter> cache;
 };
 
 
@@ -471,6 +659,9 @@ private:
 
 /** Segments have quirks and are best handled seperatly from the list filter.
 
+    String segments are keyed by their SegmentDictionary id, which the bid
+    request's segment lists resolve when they're loaded, so matching them
+    doesn't involve any string.
  */
 struct SegmentListFilter
 {
@@ -491,16 +682,24 @@ struct SegmentListFilter
 
     ConfigSet filter(int i, const std::string& str) const
     {
-        return i >= 0 ? get(intSet, i) : get(strSet, str);
+        ConfigSet configs;
+        if (i >= 0) merge(configs, intSet, i);
+        else merge(configs, strSet, SegmentDictionary::find(str));
+        return configs;
     }
 
     ConfigSet filter(const SegmentList& segments) const
     {
         ConfigSet configs;
 
-        segments.forEach([&](int i, std::string str, float) {
-                    configs |= filter(i, str);
-                });
+        for (int i : segments.ints)
+            merge(configs, intSet, i);
+
+        if (!strSet.empty()) {
+            segments.forEachStringId([&](int id) {
+                        merge(configs, strSet, id);
+                    });
+        }
 
         return configs;
     }
@@ -509,21 +708,23 @@ private:
 
     void setConfig(unsigned cfgIndex, const SegmentList& segments, bool value)
     {
-        segments.forEach([&](int i, std::string str, float) {
-                    if (i >= 0) intSet[i].set(cfgIndex, value);
-                    else strSet[str].set(cfgIndex, value);
-                });
+        for (int i : segments.ints)
+            intSet[i].set(cfgIndex, value);
+
+        for (int id : SegmentDictionary::intern(segments.strings))
+            strSet[id].set(cfgIndex, value);
     }
 
-    template<typename K>
-    ConfigSet get(const std::unordered_map<K, ConfigSet>& m, K k) const
+    static void merge(
+            ConfigSet& configs,
+            const std::unordered_map<int, ConfigSet>& m, int k)
     {
         auto it = m.find(k);
-        return it != m.end() ? it->second : ConfigSet();
+        if (it != m.end()) configs |= it->second;
     }
 
     std::unordered_map<int, ConfigSet> intSet;
-    std::unordered_map<std::string, ConfigSet> strSet;
+    std::unordered_map<int, ConfigSet> strSet; ///< Keyed by dictionary id
 };
 
 
@@ -621,7 +822,23 @@ struct IncludeExcludeFilter
         configs |= includes.filter(std::forward<Args>(args)...);
         if (configs.empty()) return configs;
 
-        configs &= excludes.filter(std::forward<Args>(args)...).negate();
+        configs.andNot(excludes.filter(std::forward<Args>(args)...));
+        return configs;
+    }
+
+    // Same as filter but restricted to the given set of live configs which
+    // lets the underlying filter skip the work for configs that were already
+    // filtered out. The underlying filter must provide filterLive.
+    template<typename... Args>
+    ConfigSet filterLive(const ConfigSet& live, Args&&... args) const
+    {
+        ConfigSet configs = emptyIncludes;
+
+        configs |= includes.filterLive(live, args...);
+        configs &= live;
+        if (configs.empty()) return configs;
+
+        configs.andNot(excludes.filterLive(configs, args...));
         return configs;
     }
 
@@ -0,0 +1,425 @@
+/** literal_set.h                                 -*- C++ -*-
+    Copyright (c) 2013 Datacratic.  All rights reserved.
+
+    Multi-literal matcher used to prefilter the regexes of the RegexFilter.
+
+    Every regex is reduced to a set of literals, one of which must appear in
+    any string that the regex matches. All the literals are then compiled into
+    a single Aho-Corasick automaton so that one scan of the string gives us the
+    handful of regexes that can possibly match it.
+
+*/
+
+#pragma once
+
+#include <boost/regex.hpp>
+#include <array>
+#include <vector>
+#include <string>
+#include <map>
+#include <deque>
+#include <cctype>
+#include <cstdint>
+
+
+namespace RTBKIT {
+
+
+/******************************************************************************/
+/* REQUIRED LITERALS                                                          */
+/******************************************************************************/
+
+/** Literals of which at least one must be present in any match of a regex.
+
+    If literals is empty then nothing could be extracted from the regex and it
+    always has to be evaluated. If exact is set then the regex is a plain
+    literal and finding it in the string is equivalent to a match.
+ */
+struct RequiredLiterals
+{
+    RequiredLiterals() : exact(false) {}
+
+    bool exact;
+    std::vector<std::string> literals;
+};
+
+namespace Literals {
+
+// Returns the position following the character class that starts at i or npos
+// if the class is malformed.
+inline size_t skipClass(const std::string& pattern, size_t i)
+{
+    size_t j = i + 1;
+    if (j < pattern.size() && pattern[j] == '^') ++j;
+    if (j < pattern.size() && pattern[j] == ']') ++j;
+
+    while (j < pattern.size()) {
+        char c = pattern[j];
+
+        if (c == '\\') j += 2;
+        else if (c == '[' && j + 1 < pattern.size()
+                && (pattern[j + 1] == ':' || pattern[j + 1] == '='
+                        || pattern[j + 1] == '.'))
+        {
+            size_t end = pattern.find(']', j + 2);
+            if (end == std::string::npos) return std::string::npos;
+            j = end + 1;
+        }
+        else if (c == ']') return j + 1;
+        else ++j;
+    }
+
+    return std::string::npos;
+}
+
+// Returns the position following the group that starts at i or npos if the
+// group is malformed.
+inline size_t skipGroup(const std::string& pattern, size_t i)
+{
+    size_t depth = 0;
+    size_t j = i;
+
+    while (j < pattern.size()) {
+        char c = pattern[j];
+
+        if (c == '\\') j += 2;
+        else if (c == '[') {
+            j = skipClass(pattern, j);
+            if (j == std::string::npos) return j;
+        }
+        else if (c == '(') { ++depth; ++j; }
+        else if (c == ')') {
+            ++j;
+            if (!--depth) return j;
+        }
+        else ++j;
+    }
+
+    return std::string::npos;
+}
+
+// Escapes that stand for a single character class or an assertion and take no
+// arguments. Any other alphanumeric escape makes us give up on the regex.
+inline bool isSimpleEscape(char c)
+{
+    static const std::string simple = "dDwWsSbBAzZGntrfvaehH";
+    return simple.find(c) != std::string::npos;
+}
+
+// Escapes that aren't alphanumeric but still don't stand for the character
+// itself: the word start and end and the buffer start and end assertions.
+inline bool isZeroWidthEscape(char c)
+{
+    return c == '<' || c == '>' || c == '`' || c == '\'';
+}
+
+// Removes the last utf-8 character of str.
+inline void dropLast(std::string& str)
+{
+    while (!str.empty() && (str.back() & 0xC0) == 0x80) str.pop_back();
+    if (!str.empty()) str.pop_back();
+}
+
+} // namespace Literals
+
+
+/** Extracts the required literals of a utf-8 encoded perl regex with the given
+    boost::regbase flags.
+
+    We only look at the top level of the regex: groups and classes are skipped
+    entirely and a quantified character is dropped from the literal it ends.
+    Anything unusual (case insensitivity, inline modifiers, escapes with
+    arguments, etc.) gives an empty result which is always correct.
+ */
+inline RequiredLiterals
+extractLiterals(const std::string& pattern, unsigned flags = 0)
+{
+    using namespace Literals;
+
+    const unsigned unsupported =
+        boost::regbase::main_option_type | boost::regbase::mod_x |
+        boost::regbase::icase | boost::regbase::newline_alt;
+    if (flags & unsupported) return RequiredLiterals();
+
+    RequiredLiterals result;
+    result.exact = true;
+
+    std::string run, best;
+    auto endRun = [&] {
+        if (run.size() > best.size()) best = run;
+        run.clear();
+        result.exact = false;
+    };
+
+    auto endBranch = [&] {
+        if (run.size() > best.size()) best = run;
+        run.clear();
+
+        if (best.empty()) return false;
+        result.literals.push_back(best);
+        best.clear();
+        return true;
+    };
+
+    size_t i = 0;
+    while (i < pattern.size()) {
+        char c = pattern[i];
+
+        switch (c) {
+
+        case '\\':
+            if (i + 1 >= pattern.size()) return RequiredLiterals();
+            c = pattern[i + 1];
+            if (std::isalnum((unsigned char) c)) {
+                if (!isSimpleEscape(c)) return RequiredLiterals();
+                endRun();
+            }
+            else if (isZeroWidthEscape(c)) endRun();
+            else run += c;
+            i += 2;
+            break;
+
+        case '.': case '^': case '$':
+            endRun();
+            ++i;
+            break;
+
+        case '[':
+            endRun();
+            i = skipClass(pattern, i);
+            if (i == std::string::npos) return RequiredLiterals();
+            break;
+
+        case '(':
+            if (i + 2 < pattern.size() && pattern[i + 1] == '?'
+                    && (std::isalpha((unsigned char) pattern[i + 2])
+                            || pattern[i + 2] == '-'))
+                return RequiredLiterals();
+
+            endRun();
+            i = skipGroup(pattern, i);
+            if (i == std::string::npos) return RequiredLiterals();
+            break;
+
+        case ')':
+            return RequiredLiterals();
+
+        case '|':
+            if (!endBranch()) return RequiredLiterals();
+            result.exact = false;
+            ++i;
+            break;
+
+        case '*': case '?':
+            dropLast(run);
+            endRun();
+            ++i;
+            break;
+
+        case '{':
+            dropLast(run);
+            endRun();
+            i = pattern.find('}', i);
+            if (i == std::string::npos) return RequiredLiterals();
+            ++i;
+            break;
+
+        case '+':
+            endRun();
+            ++i;
+            break;
+
+        default:
+            run += c;
+            ++i;
+        }
+    }
+
+    if (!endBranch()) return RequiredLiterals();
+    return result;
+}
+
+
+/******************************************************************************/
+/* LITERAL SET                                                                */
+/******************************************************************************/
+
+/** Aho-Corasick automaton over a set of byte strings.
+
+    The root state has a dense transition table so that the common case of a
+    byte that starts no literal is a single lookup. The other states keep their
+    transitions in a flat sorted array which is usually only a single entry
+    long.
+ */
+struct LiteralSet
+{
+    LiteralSet() { clear(); }
+
+    size_t size() const { return literals.size(); }
+    bool empty() const { return literals.empty(); }
+
+    void clear()
+    {
+        literals.clear();
+        index.clear();
+        states.assign(1, State());
+        edgeBytes.clear();
+        edgeTargets.clear();
+        outputs.clear();
+        root.fill(0);
+    }
+
+    /** Adds a literal to the set and returns its id. Adding the same literal
+        twice returns the same id. compile() must be called before scan().
+     */
+    unsigned add(const std::string& literal)
+    {
+        auto res = index.insert(std::make_pair(literal, literals.size()));
+        if (res.second) literals.push_back(literal);
+        return res.first->second;
+    }
+
+    void compile()
+    {
+        typedef std::map<uint8_t, uint32_t> Children;
+        std::vector<Children> children(1);
+        std::vector< std::vector<unsigned> > out(1);
+
+        for (unsigned id = 0; id < literals.size(); ++id) {
+            uint32_t node = 0;
+
+            for (uint8_t c : literals[id]) {
+                auto it = children[node].find(c);
+                if (it != children[node].end()) {
+                    node = it->second;
+                    continue;
+                }
+
+                uint32_t child = children.size();
+                children[node][c] = child;
+                children.emplace_back();
+                out.emplace_back();
+                node = child;
+            }
+
+            out[node].push_back(id);
+        }
+
+        states.assign(children.size(), State());
+        edgeBytes.clear();
+        edgeTargets.clear();
+        outputs.clear();
+        root.fill(0);
+
+        // Breadth first so that the fail state of a node is always complete
+        // by the time we get to it.
+        std::deque<uint32_t> queue;
+        for (const auto& edge : children[0]) {
+            root[edge.first] = edge.second;
+            queue.push_back(edge.second);
+        }
+
+        while (!queue.empty()) {
+            uint32_t node = queue.front();
+            queue.pop_front();
+
+            for (const auto& edge : children[node]) {
+                uint32_t f = states[node].fail;
+                while (f && !children[f].count(edge.first))
+                    f = states[f].fail;
+
+                auto it = children[f].find(edge.first);
+                states[edge.second].fail =
+                    it != children[f].end() ? it->second : 0;
+
+                queue.push_back(edge.second);
+            }
+
+            uint32_t fail = states[node].fail;
+            states[node].dictLink =
+                out[fail].empty() ? states[fail].dictLink : fail;
+        }
+
+        for (uint32_t node = 0; node < children.size(); ++node) {
+            State& state = states[node];
+
+            state.firstEdge = edgeBytes.size();
+            for (const auto& edge : children[node]) {
+                edgeBytes.push_back(edge.first);
+                edgeTargets.push_back(edge.second);
+            }
+            state.endEdge = edgeBytes.size();
+
+            state.firstOutput = outputs.size();
+            outputs.insert(outputs.end(), out[node].begin(), out[node].end());
+            state.endOutput = outputs.size();
+        }
+    }
+
+    /** Calls onMatch(id) for every occurence of every literal in the given
+        string. The same id can be reported several times.
+     */
+    template<typename Fn>
+    void scan(const char* str, size_t size, Fn&& onMatch) const
+    {
+        if (literals.empty()) return;
+
+        uint32_t node = 0;
+
+        for (size_t i = 0; i < size; ++i) {
+            uint8_t c = str[i];
+
+            while (true) {
+                if (!node) { node = root[c]; break; }
+
+                uint32_t next = transition(node, c);
+                if (next) { node = next; break; }
+
+                node = states[node].fail;
+            }
+
+            for (uint32_t out = node; out; out = states[out].dictLink) {
+                const State& state = states[out];
+                for (uint32_t j = state.firstOutput; j < state.endOutput; ++j)
+                    onMatch(outputs[j]);
+            }
+        }
+    }
+
+private:
+
+    struct State
+    {
+        State() :
+            fail(0), dictLink(0),
+            firstEdge(0), endEdge(0),
+            firstOutput(0), endOutput(0)
+        {}
+
+        uint32_t fail;
+        uint32_t dictLink; // Closest suffix state with outputs or 0.
+        uint32_t firstEdge, endEdge;
+        uint32_t firstOutput, endOutput;
+    };
+
+    uint32_t transition(uint32_t node, uint8_t c) const
+    {
+        const State& state = states[node];
+        for (uint32_t i = state.firstEdge; i < state.endEdge; ++i) {
+            if (edgeBytes[i] == c) return edgeTargets[i];
+            if (edgeBytes[i] > c) break;
+        }
+        return 0;
+    }
+
+    std::vector<std::string> literals;
+    std::map<std::string, unsigned> index;
+
+    std::vector<State> states;
+    std::vector<uint8_t> edgeBytes;
+    std::vector<uint32_t> edgeTargets;
+    std::vector<unsigned> outputs;
+    std::array<uint32_t, 256> root;
+};
+
+} // namespace RTBKIT
@@ -81,6 +81,8 @@ SegmentsFilter::
 fillFilterReasons(FilterState& state, ConfigSet& beforeFilt,
                   ConfigSet& afterFilt, const std::string & segment) const {
 
+    if (!state.collectFilterReasons()) return;
+
     // Some Magic to get all the filtered out configs by this segment.
     FilterState::FilterReasons& reasons = state.getFilterReasons();
     reasons[segment] = beforeFilt ^ (beforeFilt & afterFilt);
@@ -91,11 +93,9 @@ void
 SegmentsFilter::
 filter(FilterState& state) const
 {
-    unordered_set<string> toCheck = excludeIfNotPresent;
-
-    for (const auto& segment : state.request.segments) {
-        toCheck.erase(segment.first);
+    const auto& segments = state.request.segments;
 
+    for (const auto& segment : segments) {
         auto it = data.find(segment.first);
         if (it == data.end()) continue;
 
@@ -110,7 +110,9 @@ filter(FilterState& state) const
         if (state.configs().empty()) return;
     }
 
-    for (const auto& segment : toCheck) {
+    for (const auto& segment : excludeIfNotPresent) {
+        if (segments.count(segment)) continue;
+
         auto it = data.find(segment);
         if (it == data.end()) continue;
 
@@ -169,7 +171,7 @@ filter(FilterState& state) const
         else matches |= entry.second.filter.filter(value.second);
     }
 
-    matches &= excludes.negate();
+    matches.andNot(excludes);
     state.narrowConfigs(matches);
 }
 
@@ -143,7 +143,8 @@ struct UrlFilter : public FilterBaseT<UrlFilter>
 
     void filter(FilterState& state) const
     {
-        state.narrowConfigs(impl.filter(state.request.url.toString()));
+        state.narrowConfigs(
+                impl.filterLive(state.configs(), state.request.url.toString()));
     }
 
 private:
@@ -192,7 +193,8 @@ struct LanguageFilter : public FilterBaseT<LanguageFilter>
 
     void filter(FilterState& state) const
     {
-        state.narrowConfigs(impl.filter(state.request.language.utf8String()));
+        state.narrowConfigs(impl.filterLive(
+                        state.configs(), state.request.language.utf8String()));
     }
 
 private:
@@ -218,7 +220,7 @@ struct LocationFilter : public FilterBaseT<LocationFilter>
     void filter(FilterState& state) const
     {
         Datacratic::UnicodeString location = state.request.location.fullLocationString();
-        state.narrowConfigs(impl.filter(location));
+        state.narrowConfigs(impl.filterLive(state.configs(), location));
     }
 
 private:
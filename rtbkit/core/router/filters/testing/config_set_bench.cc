@@ -0,0 +1,219 @@
+/** config_set_bench.cc                                 -*- C++ -*-
+    Copyright (c) 2013 Datacratic.  All rights reserved.
+
+    Benchmark of the ConfigSet operations done while filtering a bid request.
+    Compares the current ConfigSet against the previous compact_vector based
+    implementation and reports allocations and ns per simulated request.
+
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "rtbkit/common/filter.h"
+#include "jml/arch/timers.h"
+#include "jml/utils/compact_vector.h"
+
+#include <boost/test/unit_test.hpp>
+#include <atomic>
+#include <iostream>
+#include <random>
+#include <new>
+
+using namespace std;
+using namespace ML;
+using namespace RTBKIT;
+
+
+/******************************************************************************/
+/* ALLOCATION COUNTER                                                         */
+/******************************************************************************/
+
+namespace {
+
+std::atomic<size_t> numAllocs(0);
+
+} // namespace anonymous
+
+void* operator new(size_t size)
+{
+    numAllocs++;
+    void* ptr = malloc(size);
+    if (!ptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+
+/******************************************************************************/
+/* COMPACT CONFIG SET                                                         */
+/******************************************************************************/
+
+/** The ConfigSet as it was before the SIMD kernels and the inline storage.
+    Only what the benchmark needs is reproduced.
+ */
+struct CompactConfigSet
+{
+    typedef uint64_t Word;
+    static constexpr size_t Div = sizeof(Word) * 8;
+
+    explicit CompactConfigSet(bool defaultValue = false) :
+        defaultValue(defaultValue ? ~Word(0) : 0)
+    {}
+
+    size_t size() const { return bitfield.size() * Div; }
+
+    void expand(size_t newSize)
+    {
+        if (newSize) newSize = (newSize - 1) / Div + 1;
+        if (newSize <= bitfield.size()) return;
+        bitfield.resize(newSize, defaultValue);
+    }
+
+    void set(size_t index)
+    {
+        expand(index + 1);
+        bitfield[index / Div] |= 1ULL << (index % Div);
+    }
+
+    size_t count() const
+    {
+        size_t total = 0;
+        for (size_t i = 0; i < bitfield.size(); ++i) {
+            if (!bitfield[i]) continue;
+            total += ML::num_bits_set(bitfield[i]);
+        }
+        return total;
+    }
+
+    size_t empty() const
+    {
+        if (bitfield.empty()) return !defaultValue;
+        for (size_t i = 0; i < bitfield.size(); ++i)
+            if (bitfield[i]) return false;
+        return true;
+    }
+
+#define RTBKIT_CONFIG_SET_OP(_op_)                                      \
+    CompactConfigSet& operator _op_ (const CompactConfigSet& other)     \
+    {                                                                   \
+        expand(other.size());                                           \
+        for (size_t i = 0; i < other.bitfield.size(); ++i)              \
+            bitfield[i] _op_ other.bitfield[i];                         \
+        for (size_t i = other.bitfield.size(); i < bitfield.size(); ++i) \
+            bitfield[i] _op_ other.defaultValue;                        \
+        return *this;                                                   \
+    }
+
+    RTBKIT_CONFIG_SET_OP(&=)
+    RTBKIT_CONFIG_SET_OP(|=)
+
+#undef RTBKIT_CONFIG_SET_OP
+
+    CompactConfigSet& negate()
+    {
+        defaultValue = ~defaultValue;
+        for (size_t i = 0; i < bitfield.size(); ++i)
+            bitfield[i] = ~bitfield[i];
+        return *this;
+    }
+
+    CompactConfigSet negate() const
+    {
+        return CompactConfigSet(*this).negate();
+    }
+
+    CompactConfigSet& andNot(const CompactConfigSet& other)
+    {
+        return *this &= other.negate();
+    }
+
+private:
+    ML::compact_vector<Word, 8> bitfield;
+    Word defaultValue;
+};
+
+
+/******************************************************************************/
+/* BENCH                                                                      */
+/******************************************************************************/
+
+/** Mimics what an include/exclude filter does for every bid request: start
+    from the configs without includes, or in the configs matched by a few
+    values, remove the excluded configs and narrow the live set.
+ */
+template<typename Set>
+void bench(const string& name, size_t numConfigs)
+{
+    enum { NumFilters = 16, NumValues = 64, NumMatches = 3 };
+
+    mt19937 rng(numConfigs);
+
+    auto randomSet = [&] (double density) {
+        Set set;
+        for (size_t i = 0; i < numConfigs; ++i)
+            if (uniform_real_distribution<double>()(rng) < density) set.set(i);
+        return set;
+    };
+
+    struct Filter
+    {
+        Set emptyIncludes;
+        vector<Set> includes;
+        vector<Set> excludes;
+    };
+
+    vector<Filter> filters(NumFilters);
+    for (Filter& filter : filters) {
+        filter.emptyIncludes = randomSet(0.8);
+        for (size_t i = 0; i < NumValues; ++i) {
+            filter.includes.push_back(randomSet(0.05));
+            filter.excludes.push_back(randomSet(0.01));
+        }
+    }
+
+    Set all;
+    for (size_t i = 0; i < numConfigs; ++i) all.set(i);
+
+    enum { NumRequests = 100000 };
+    size_t allocsBefore = numAllocs;
+    size_t totalCount = 0;
+    Timer timer;
+
+    for (size_t rq = 0; rq < NumRequests; ++rq) {
+        Set live = all;
+
+        for (size_t f = 0; f < NumFilters && !live.empty(); ++f) {
+            const Filter& filter = filters[f];
+
+            Set configs = filter.emptyIncludes;
+            for (size_t m = 0; m < NumMatches; ++m)
+                configs |= filter.includes[(rq * 7 + f + m * 13) % NumValues];
+            configs.andNot(filter.excludes[(rq + f) % NumValues]);
+
+            live &= configs;
+        }
+
+        totalCount += live.count();
+    }
+
+    double elapsed = timer.elapsed_wall();
+    size_t allocs = numAllocs - allocsBefore;
+
+    cerr << name << " configs=" << numConfigs
+         << " ns/request=" << elapsed / NumRequests * 1e9
+         << " allocs/request=" << double(allocs) / NumRequests
+         << " (checksum " << totalCount << ")" << endl;
+}
+
+BOOST_AUTO_TEST_CASE( configSetBench )
+{
+    for (size_t numConfigs : { 64, 256, 512, 1024 }) {
+        bench<CompactConfigSet>("before", numConfigs);
+        bench<ConfigSet>("after ", numConfigs);
+    }
+}
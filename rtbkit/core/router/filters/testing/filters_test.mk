@@ -9,5 +9,6 @@
 $(eval $(call test,generic_filters_test,static_filters,boost))
 $(eval $(call test,static_filters_test,static_filters,boost))
 $(eval $(call test,creative_filters_test,static_filters,boost))
+$(eval $(call test,config_set_bench,static_filters,boost manual))
 
 
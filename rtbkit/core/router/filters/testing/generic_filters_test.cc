@@ -13,6 +13,7 @@
 #include "rtbkit/core/router/filters/generic_filters.h"
 
 #include <boost/test/unit_test.hpp>
+#include <random>
 
 using namespace std;
 using namespace RTBKIT;
@@ -191,6 +192,16 @@ BOOST_AUTO_TEST_CASE(regexFilterTest)
     check(filter.filter("abb"), { 0, 1, 2, 3 });
     check(filter.filter("d"),   { });
 
+    title("regex-live");
+    ConfigSet live;
+    live.set(1);
+    live.set(3);
+
+    check(filter.filterLive(live, "a"),   { 1 });
+    check(filter.filterLive(live, "abb"), { 1, 3 });
+    check(filter.filterLive(live, "c"),   { });
+    check(filter.filterLive(ConfigSet(), "abb"), { });
+
     title("regex-2");
     filter.removeConfig(3, makeList({ regex("^ab+")}));
 
@@ -219,6 +230,148 @@ BOOST_AUTO_TEST_CASE(regexFilterTest)
     check(filter.filter("d"),   { });
 }
 
+BOOST_AUTO_TEST_CASE(requiredLiteralsTest)
+{
+    auto doCheck = [] (
+            const string& pattern, bool exact, const vector<string>& literals)
+    {
+        RequiredLiterals required = extractLiterals(pattern);
+        BOOST_CHECK_EQUAL(required.exact, exact);
+        BOOST_CHECK_EQUAL_COLLECTIONS(
+                required.literals.begin(), required.literals.end(),
+                literals.begin(), literals.end());
+    };
+
+    doCheck("cnn\\.com",           true,  { "cnn.com" });
+    doCheck("^http://abc\\.",      false, { "http://abc." });
+    doCheck("ab+c",                 false, { "ab" });
+    doCheck("abcd*e",               false, { "abc" });
+    doCheck("ab{2}cde",             false, { "cde" });
+    doCheck("a(bcd)+efg",           false, { "efg" });
+    doCheck("[abc]xy|foo.*bar",     false, { "xy", "foo" });
+    doCheck("a|.*",                 false, { });
+    doCheck("\\d+abc",              false, { "abc" });
+    doCheck("\\x41bcd",             false, { });
+    doCheck("(?i)abc",              false, { });
+    doCheck("",                     false, { });
+
+    // Assertions and class escapes stand for no character of the literal.
+    doCheck("ab\\<cde",             false, { "cde" });
+    doCheck("abc\\>de",             false, { "abc" });
+    doCheck("\\`abc",               false, { "abc" });
+    doCheck("abc\\'",               false, { "abc" });
+    doCheck("ab\\bcde",             false, { "cde" });
+    doCheck("abc\\Bde",             false, { "abc" });
+    doCheck("ab\\wcde",             false, { "cde" });
+    doCheck("abc\\Wde",             false, { "abc" });
+    doCheck("ab\\scde",             false, { "cde" });
+    doCheck("abc\\Sde",             false, { "abc" });
+    doCheck("abc\\Dde",             false, { "abc" });
+    doCheck("\\Aabc\\z",            false, { "abc" });
+    doCheck("abc\\Z",               false, { "abc" });
+    doCheck("\\Gabc",               false, { "abc" });
+
+    BOOST_CHECK(extractLiterals("abc", boost::regex::icase).literals.empty());
+
+    // The prefilter must never reject a string that the regex matches.
+    for (const string& pattern : {
+                "\\<abc\\>", "foo\\'", "\\`foo", "ab\\<cd", "a\\b-bc",
+                "x\\Bxy", "ab\\wcd", "ab\\Wcd", "\\Aabc\\z" })
+    {
+        boost::regex regex(pattern);
+        RequiredLiterals required = extractLiterals(pattern);
+
+        for (const string& str : {
+                    "abc", "foo", "x abc y", "abxcd", "ab-cd", "a-bc",
+                    "xxy", "abc def", "a foo" })
+        {
+            if (!boost::regex_search(str, regex)) continue;
+
+            bool found = required.literals.empty();
+            for (const string& literal : required.literals)
+                found = found || str.find(literal) != string::npos;
+
+            BOOST_CHECK_MESSAGE(found, pattern + " rejects " + str);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(literalSetTest)
+{
+    LiteralSet set;
+    unsigned he = set.add("he");
+    unsigned she = set.add("she");
+    unsigned his = set.add("his");
+    unsigned hers = set.add("hers");
+    BOOST_CHECK_EQUAL(set.add("she"), she);
+    set.compile();
+
+    string str = "ushers";
+    vector<unsigned> hits;
+    set.scan(str.data(), str.size(), [&] (unsigned id) { hits.push_back(id); });
+    sort(hits.begin(), hits.end());
+
+    vector<unsigned> exp = { he, she, hers };
+    sort(exp.begin(), exp.end());
+    BOOST_CHECK_EQUAL_COLLECTIONS(
+            hits.begin(), hits.end(), exp.begin(), exp.end());
+    (void) his;
+}
+
+BOOST_AUTO_TEST_CASE(regexFilterRandomTest)
+{
+    using boost::regex;
+
+    const vector<string> patterns = {
+        "google\\.com", "^http://news\\.", "sport[s]?", "a+b", "(foo|bar)baz",
+        "x.*y", "[0-9]+", "\\.fr$", "ab|cd", "c\\+\\+", "o{2}", "wiki",
+    };
+
+    const vector<string> strings = {
+        "http://google.com/", "http://news.bbc.co.uk", "sportbaz", "aab",
+        "foobaz", "xzzy", "12", "le.fr", "cd", "c++", "foo", "wikipedia", "",
+        "http://www.google.fr/sports", "barbaz.fr", "zzz",
+    };
+
+    RegexFilter<regex, string> filter;
+    vector< vector<regex> > configs;
+
+    mt19937 rng(0);
+    for (unsigned cfg = 0; cfg < 32; ++cfg) {
+        vector<regex> list;
+        for (size_t i = 0; i < 1 + rng() % 3; ++i)
+            list.emplace_back(patterns[rng() % patterns.size()]);
+
+        filter.addConfig(cfg, list);
+        configs.push_back(list);
+    }
+
+    for (size_t round = 0; round < 4; ++round) {
+        for (const string& str : strings) {
+            ConfigSet exp;
+            for (unsigned cfg = 0; cfg < configs.size(); ++cfg) {
+                for (const regex& rex : configs[cfg])
+                    if (regex_search(str, rex)) exp.set(cfg);
+            }
+
+            ConfigSet live;
+            for (unsigned cfg = round; cfg < configs.size(); cfg += 2)
+                live.set(cfg);
+
+            ConfigSet expLive = exp;
+            expLive &= live;
+
+            ConfigSet diff = filter.filterLive(live, str);
+            diff ^= expLive;
+            BOOST_CHECK(diff.empty());
+
+            diff = filter.filter(str);
+            diff ^= exp;
+            BOOST_CHECK(diff.empty());
+        }
+    }
+}
+
 BOOST_AUTO_TEST_CASE(segmentListTest)
 {
     SegmentListFilter filter;
@@ -258,6 +411,44 @@ BOOST_AUTO_TEST_CASE(segmentListTest)
     check(filter.filter(seg2),     { 0, 1 });
 }
 
+BOOST_AUTO_TEST_CASE(segmentDictionaryTest)
+{
+    SegmentListFilter filter;
+
+    // Resolved before the filter gave its segments an id.
+    SegmentList early = segment("dict-a", "dict-z");
+    BOOST_CHECK_EQUAL(early.stringIds.size(), 2);
+    BOOST_CHECK_EQUAL(early.stringIds[0], SegmentDictionary::NoId);
+
+    int idA = SegmentDictionary::intern("dict-a");
+    BOOST_CHECK_EQUAL(SegmentDictionary::intern("dict-a"), idA);
+    BOOST_CHECK_EQUAL(SegmentDictionary::find("dict-a"), idA);
+    BOOST_CHECK_EQUAL(SegmentDictionary::find("dict-none"),
+                      SegmentDictionary::NoId);
+
+    title("dictionary-1");
+    filter.addConfig(0, segment("dict-a", "dict-b"));
+    filter.addConfig(1, segment("dict-c", 4));
+
+    check(filter.filter(early), { 0 });
+    check(filter.filter(segment("dict-b")), { 0 });
+    check(filter.filter(segment("dict-c", "dict-z")), { 1 });
+    check(filter.filter(segment(4, "dict-none")), { 1 });
+    check(filter.filter(-1, "dict-b"), { 0 });
+
+    // Added without sorting so nothing was resolved.
+    SegmentList unsorted;
+    unsorted.add("dict-c");
+    unsorted.add("dict-a");
+    check(filter.filter(unsorted), { 0, 1 });
+
+    title("dictionary-2");
+    filter.removeConfig(0, segment("dict-a", "dict-b"));
+
+    check(filter.filter(early), { });
+    check(filter.filter(unsorted), { 1 });
+}
+
 BOOST_AUTO_TEST_CASE(includeExcludeFilterTest)
 {
     typedef ListFilter<size_t> BaseFilterT;
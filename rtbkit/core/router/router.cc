@@ -124,10 +124,7 @@ Router(ServiceBase & parent,
       postAuctionEndpoint(*this),
       configBuffer(1024),
       exchangeBuffer(64),
-      startBiddingBuffer(65536),
-      submittedBuffer(65536),
       auctionGraveyard(65536),
-      doBidBuffer(65536),
       augmentationLoop(*this),
       loopMonitor(*this),
       loadStabilizer(loopMonitor),
@@ -158,6 +155,7 @@ Router(ServiceBase & parent,
       augmentationWindow(augmentationWindow)
 {
     monitorProviderClient.addProvider(this);
+    shards.emplace_back(new AuctionShard(0));
 }
 
 Router::
@@ -177,10 +175,7 @@ Router(std::shared_ptr<ServiceProxies> services,
       postAuctionEndpoint(*this),
       configBuffer(1024),
       exchangeBuffer(64),
-      startBiddingBuffer(65536),
-      submittedBuffer(65536),
       auctionGraveyard(65536),
-      doBidBuffer(65536),
       augmentationLoop(*this),
       loopMonitor(*this),
       loadStabilizer(loopMonitor),
@@ -212,6 +207,7 @@ Router(std::shared_ptr<ServiceProxies> services,
 
 {
     monitorProviderClient.addProvider(this);
+    shards.emplace_back(new AuctionShard(0));
 }
 
 void
@@ -225,9 +221,10 @@ initBidderInterface(Json::Value const & json)
 
 void
 Router::
-initAnalyticsPublisher(const string & baseUrl, const int numConnections)
+initAnalyticsPublisher(const string & baseUrl, const int numConnections,
+                       const string & compression)
 {
-    analyticsPublisher.init(baseUrl, numConnections);
+    analyticsPublisher.init(baseUrl, numConnections, compression);
 }
 
 void
@@ -362,6 +359,65 @@ initAnalytics(const Json::Value & config)
     analytics.reset(factory(serviceName(), getServices()));
 }
 
+Router::HotEvents::
+HotEvents(const EventRecorder & recorder)
+{
+    tooLateBeforeAdd = recorder.counterHandle("tooLateBeforeAdd");
+    tooLateAfterAugmenting = recorder.counterHandle("tooLateAfterAugmenting");
+    tooLateBeforeRouting = recorder.counterHandle("tooLateBeforeRouting");
+    tooLateAfterRouting = recorder.counterHandle("tooLateAfterRouting");
+    tooLateToFinish = recorder.counterHandle("tooLateToFinish");
+    ignoredAuctions = recorder.counterHandle("monitor.ignoredAuctions");
+    auctionPassedPreprocessing
+        = recorder.counterHandle("auctionPassedPreprocessing");
+    noPotentialBidders
+        = recorder.counterHandle("auctionDropped.noPotentialBidders");
+    bid = recorder.counterHandle("bid");
+    numRequestWithBid = recorder.counterHandle("numRequestWithBid");
+    shardQueueFull = recorder.counterHandle("bidError.shardQueueFull");
+    unknownAuction = recorder.counterHandle("bidError.unknownAuction");
+    agentSkippedAuction
+        = recorder.counterHandle("bidError.agentSkippedAuction");
+    agentNotBidding = recorder.counterHandle("bidError.agentNotBidding");
+    systemInSlowMode = recorder.counterHandle("monitor.systemInSlowMode");
+    slowModeDroppedBid = recorder.counterHandle("slowMode.droppedBid");
+    cummulatedBidPrice = recorder.counterHandle("cummulatedBidPrice");
+    cummulatedAuthorizedPrice
+        = recorder.counterHandle("cummulatedAuthorizedPrice");
+    potentialBiddersPerRequest
+        = recorder.levelHandle("potentialBiddersPerRequest");
+    bidRequestsSentToBiddersPerRequest
+        = recorder.levelHandle("bidRequestsSentToBiddersPerRequest");
+    bidsPerBidRequest = recorder.levelHandle("bidsPerBidRequest");
+    preprocessAuctionTimeMs = recorder.outcomeHandle("preprocessAuctionTimeMs");
+    bidErrors = BidErrorEvents(recorder, "");
+    exchangeImp = recorder.counterFamily("exchange.%s.imp");
+    exchangeRequests = recorder.counterFamily("exchange.%s.requests");
+}
+
+Router::ExchangeEvents::
+ExchangeEvents(const EventRecorder & recorder, const std::string & exchange)
+    : exchange(exchange),
+      imp(recorder.counterHandle("exchange." + exchange + ".imp")),
+      requests(recorder.counterHandle("exchange." + exchange + ".requests"))
+{
+}
+
+void
+Router::
+recordExchangeRequest(const BidRequest & request,
+                      const ExchangeEvents * events)
+{
+    if (events && request.exchange == events->exchange) {
+        events->imp.count(request.imp.size());
+        events->requests.hit();
+    }
+    else {
+        hotEvents.exchangeImp(request.exchange).count(request.imp.size());
+        hotEvents.exchangeRequests(request.exchange).hit();
+    }
+}
+
 void
 Router::
 init()
@@ -372,6 +428,8 @@ init()
 
     filters.init(this);
 
+    hotEvents = HotEvents(*this);
+
     banker.reset(new NullBanker());
 
     if(!bidder) {
@@ -456,6 +514,21 @@ setBanker(const std::shared_ptr<Banker> & newBanker)
     monitorProviderClient.addProvider(banker.get());
 }
 
+void
+Router::
+setNumAuctionShards(size_t numShards)
+{
+    if (numShards == 0)
+        throw ML::Exception("need at least one auction shard");
+    if (runThread)
+        throw ML::Exception("can't change the auction shards of a running "
+                            "router");
+
+    shards.clear();
+    for (size_t i = 0;  i < numShards;  ++i)
+        shards.emplace_back(new AuctionShard(i));
+}
+
 void
 Router::
 bindTcp()
@@ -542,6 +615,13 @@ start(boost::function<void ()> onStop)
     augmentationLoop.start();
     runThread.reset(new boost::thread(runfn));
 
+    if (shards.size() > 1) {
+        for (auto & shard : shards) {
+            AuctionShard * s = shard.get();
+            shard->thread.reset(new boost::thread([=] () { this->runShard(*s); }));
+        }
+    }
+
     if (connectPostAuctionLoop) {
         postAuctionEndpoint.init();
     }
@@ -582,7 +662,7 @@ numNonIdle() const
     size_t numInFlight, numAwaitingAugmentation;
     {
         Guard guard(lock);
-        numInFlight = inFlight.size();
+        numInFlight = this->numInFlight();
         numAwaitingAugmentation = augmentationLoop.numAugmenting();
     }
 
@@ -734,22 +814,25 @@ run()
             cerr << "zeromq error: " << zmq_strerror(zmq_errno()) << endl;
         }
 
-        {
+        // With a single shard the auctions are handled right here.
+        AuctionShard * shard = shards.size() == 1 ? shards[0].get() : nullptr;
+
+        if (shard) {
             double atStart = getTime();
             std::shared_ptr<AugmentationInfo> info;
-            while (startBiddingBuffer.tryPop(info)) {
-                doStartBidding(info);
+            while (shard->startBiddingBuffer.tryPop(info)) {
+                doStartBidding(*shard, info);
             }
 
             recordTime("doStartBidding", atStart);
         }
 
-        {
+        if (shard) {
             double atStart = getTime();
 
             BidMessage message;
-            while (doBidBuffer.tryPop(message)) {
-                doBidImpl(message);
+            while (shard->doBidBuffer.tryPop(message)) {
+                doBidImpl(*shard, message);
             }
 
             recordTime("doBid", atStart);
@@ -774,25 +857,40 @@ run()
             double atStart = getTime();
 
             std::pair<std::string, std::shared_ptr<const AgentConfig> > config;
-            while (configBuffer.tryPop(config)) {
-                doConfig(config.first, config.second);
+            if (configBuffer.tryPop(config)) {
+                auto guards = lockAllShards();
+                do {
+                    doConfig(config.first, config.second);
+                } while (configBuffer.tryPop(config));
             }
 
             recordTime("doConfig", atStart);
         }
 
-        {
+        if (shard) {
             double atStart = getTime();
 
             std::shared_ptr<Auction> auction;
-            while (submittedBuffer.tryPop(auction))
-                doSubmitted(auction);
+            while (shard->submittedBuffer.tryPop(auction))
+                doSubmitted(*shard, auction);
+
+            std::pair<std::string, Id> lost;
+            while (shard->lostBidBuffer.tryPop(lost))
+                doLostBid(*shard, lost.first, lost.second);
 
             recordTime("doSubmitted", atStart);
         }
 
+        // Each shard flushes the auctions it submitted from its own loop.
+        if (shard && connectPostAuctionLoop) {
+            double atStart = getTime();
+            postAuctionEndpoint.flush();
+            recordTime("flushPostAuction", atStart);
+        }
+
         if (items[0].revents & ZMQ_POLLIN) {
             double atStart = getTime();
+
             // Agent message
             vector<string> message;
             try {
@@ -822,7 +920,10 @@ run()
 
             // Send out pings and interpret the results of the last lot of
             // pinging.
-            sendPings();
+            {
+                auto guards = lockAllShards();
+                sendPings();
+            }
             lastPings = now;
 
             recordTime("sendPings", atStart);
@@ -840,6 +941,8 @@ run()
         }
 
         if (now - last_check > 10.0) {
+            auto guards = lockAllShards();
+
             logUsageMetrics(10.0);
             if (analytics) analytics->logUsageMessage(*this, 10.0);
             if (analytics) analytics->logMarkMessage(*this,last_check);
@@ -899,6 +1002,154 @@ run()
     //cerr << "server shutdown" << endl;
 }
 
+Router::AuctionShard::
+AuctionShard(size_t index)
+    : index(index),
+      startBiddingBuffer(65536),
+      agentBidBuffer(65536),
+      doBidBuffer(65536),
+      submittedBuffer(65536),
+      lostBidBuffer(1024),
+      wakeup(EFD_NONBLOCK)
+{
+}
+
+bool
+Router::AuctionShard::
+trackBidInFlight(const std::string & agent, AgentStatus & status,
+                 const Id & auctionId, Date date)
+{
+    if (!bidsInFlight[agent].insert(make_pair(auctionId, date)).second)
+        return false;
+    ML::atomic_inc(status.numBidsInFlight);
+    return true;
+}
+
+bool
+Router::AuctionShard::
+expireBidInFlight(const std::string & agent, AgentStatus & status,
+                  const Id & auctionId)
+{
+    auto it = bidsInFlight.find(agent);
+    if (it == bidsInFlight.end() || !it->second.erase(auctionId))
+        return false;
+    ML::atomic_dec(status.numBidsInFlight);
+    return true;
+}
+
+Router::ShardGuard
+Router::
+lockShard(AuctionShard & shard)
+{
+    ShardGuard guard(shard.lock, std::defer_lock);
+    if (shards.size() > 1) guard.lock();
+    return guard;
+}
+
+std::vector<Router::ShardGuard>
+Router::
+lockAllShards()
+{
+    std::vector<ShardGuard> guards;
+    if (shards.size() > 1) {
+        for (auto & shard : shards)
+            guards.emplace_back(shard->lock);
+    }
+    return guards;
+}
+
+void
+Router::
+wakeupShard(AuctionShard & shard)
+{
+    if (shards.size() > 1)
+        shard.wakeup.signal();
+    else wakeupMainLoop.signal();
+}
+
+void
+Router::
+runShard(AuctionShard & shard)
+{
+    zmq_pollitem_t items [] = {
+        { 0, shard.wakeup.fd(), ZMQ_POLLIN, 0 }
+    };
+
+    auto getTime = [&] () { return Date::now().secondsSinceEpoch(); };
+
+    double totalActive = 0;
+    double lastTotalActive = 0; // member variable for the lambda.
+    string loopName = ML::format("routerShard%zd", shard.index);
+    loopMonitor.addCallback(loopName,
+            [&, lastTotalActive] (double elapsed) mutable {
+                double delta = totalActive - lastTotalActive;
+                lastTotalActive = totalActive;
+                return delta / elapsed;
+            });
+
+    double afterSleep = getTime();
+
+    while (!shutdown_) {
+        totalActive += getTime() - afterSleep;
+
+        int rc = zmq_poll(items, 1, 0);
+        if (rc == 0)
+            rc = zmq_poll(items, 1, 1 /* milliseconds */);
+
+        afterSleep = getTime();
+
+        if (rc == -1 && zmq_errno() != EINTR) {
+            cerr << "zeromq error: " << zmq_strerror(zmq_errno()) << endl;
+        }
+
+        if (items[0].revents & ZMQ_POLLIN)
+            shard.wakeup.tryRead();
+
+        ShardGuard guard(lockShard(shard));
+
+        // Expiring from the timing wheel is next to free when nothing is due
+        // so we do it on every turn instead of waiting to be idle.
+        expireInFlight(shard);
+
+        std::shared_ptr<AugmentationInfo> info;
+        while (shard.startBiddingBuffer.tryPop(info))
+            doStartBidding(shard, info);
+
+        std::vector<std::string> agentBid;
+        while (shard.agentBidBuffer.tryPop(agentBid)) {
+            try {
+                doBid(shard, agentBid);
+            } catch (const std::exception & exc) {
+                returnErrorResponse(agentBid,
+                                    "threw exception: " + string(exc.what()));
+            }
+        }
+
+        BidMessage message;
+        while (shard.doBidBuffer.tryPop(message)) {
+            try {
+                doBidImpl(shard, message);
+            } catch (const std::exception & exc) {
+                cerr << "error handling bid for auction " << message.auctionId
+                     << ": " << exc.what() << endl;
+            }
+        }
+
+        std::shared_ptr<Auction> auction;
+        while (shard.submittedBuffer.tryPop(auction))
+            doSubmitted(shard, auction);
+
+        std::pair<std::string, Id> lost;
+        while (shard.lostBidBuffer.tryPop(lost))
+            doLostBid(shard, lost.first, lost.second);
+
+        if (connectPostAuctionLoop)
+            postAuctionEndpoint.flush();
+    }
+
+    loopMonitor.remove(loopName);
+}
+
 void
 Router::
 shutdown()
@@ -916,6 +1167,12 @@ shutdown()
     if (runThread)
         runThread->join();
     runThread.reset();
+    for (auto & shard : shards) {
+        if (!shard->thread) continue;
+        shard->wakeup.signal();
+        shard->thread->join();
+        shard->thread.reset();
+    }
     if (cleanupThread)
         cleanupThread->join();
     cleanupThread.reset();
@@ -929,8 +1186,12 @@ shutdown()
 
 void
 Router::
-injectAuction(std::shared_ptr<Auction> auction, double lossTime)
+injectAuction(std::shared_ptr<Auction> auction, double lossTime,
+              const ExchangeEvents * events)
 {
+    if (auction->request)
+        recordExchangeRequest(*auction->request, events);
+
     // cerr << "injectAuction was called!!!" << endl;
     if (!auction->handleAuction) {
         // Modify the auction to insert our auction done handling
@@ -994,6 +1255,28 @@ numAuctionsInProgress() const
     return -1;//inFlight.size();
 }
 
+size_t
+Router::
+numInFlight() const
+{
+    size_t result = 0;
+    for (auto & shard : shards)
+        result += shard->inFlight.size();
+    return result;
+}
+
+bool
+Router::
+pushBid(BidMessage && message)
+{
+    AuctionShard & shard = shardFor(message.auctionId);
+    if (!shard.doBidBuffer.tryPush(std::move(message)))
+        return false;
+
+    wakeupShard(shard);
+    return true;
+}
+
 void
 Router::
 handleAgentMessage(const std::vector<std::string> & message)
@@ -1015,23 +1298,29 @@ handleAgentMessage(const std::vector<std::string> & message)
             return;
         }
 
+        // The shards read the agent infos while bidding so they're only
+        // written with every shard locked.
+        auto guards = lockAllShards();
+
         if (request == "CONFIG") {
             string configName = message.at(2);
-            if (!agents.count(configName)) {
+            auto it = agents.find(configName);
+            if (it == agents.end()) {
                 // We don't yet know about its configuration
                 bidder->sendMessage(nullptr, address, "NEEDCONFIG");
                 return;
             }
-            agents[configName].address = address;
+            it->second.address = address;
             return;
         }
 
-        if (!agents.count(address)) {
+        auto it = agents.find(address);
+        if (it == agents.end()) {
             cerr << "doing NEEDCONFIG for " << address << endl;
             return;
         }
 
-        AgentInfo & info = agents[address];
+        AgentInfo & info = it->second;
         info.gotHeartbeat(Date::now());
 
         if (!info.configured) {
@@ -1039,6 +1328,8 @@ handleAgentMessage(const std::vector<std::string> & message)
         }
 
         if (request[0] == 'B' && request == "BID") {
+            // Bids are only queued for their shard which takes its own lock.
+            guards.clear();
             doBid(message);
             return;
         }
@@ -1146,17 +1437,28 @@ checkDeadAgents()
          ++it) {
         auto & info = it->second;
 
-        const std::string & account = info.config->account.toString('.');
+        const AccountEvents & events = *info.events;
 
         Date now = Date::now();
         double oldest = 0.0;
         double total = 0.0;
 
-        vector<Id> toExpire;
+        // The caller holds the locks of the shards.
+        auto forEachInFlight = [&] (const std::function<void (AuctionShard &, const Id &, Date)> & fn)
+            {
+                for (auto & shard : shards) {
+                    auto jt = shard->bidsInFlight.find(it->first);
+                    if (jt == shard->bidsInFlight.end()) continue;
+                    for (const auto & bid : jt->second)
+                        fn(*shard, bid.first, bid.second);
+                }
+            };
+
+        vector<pair<AuctionShard *, Id> > toExpire;
 
         // Check for in flight timeouts.  This shouldn't happen, but there
         // appears to be a way in which we lose track of an inflight auction
-        auto onInFlight = [&] (const Id & id, const Date & date)
+        auto onInFlight = [&] (AuctionShard & shard, const Id & id, Date date)
             {
                 double secondsSince = now.secondsSince(date);
 
@@ -1165,37 +1467,36 @@ checkDeadAgents()
 
                 if (secondsSince > 30.0) {
 
-                    this->recordHit("accounts.%s.lostBids", account);
+                    events.lostBids.hit();
 
-                    bidder->sendBidLostMessage(info.config, it->first, inFlight[id].auction);
+                    // The auction belongs to its shard; let it tell the
+                    // bidder.
+                    if (shard.lostBidBuffer.tryPush(make_pair(it->first, id)))
+                        this->wakeupShard(shard);
 
-                    toExpire.push_back(id);
+                    toExpire.push_back(make_pair(&shard, id));
                 }
             };
 
-        info.forEachInFlight(onInFlight);
+        forEachInFlight(onInFlight);
 
-        this->recordLevel(info.numBidsInFlight(),
-                          "accounts.%s.inFlight.numInFlight", account);
-        this->recordLevel(oldest,
-                          "accounts.%s.inFlight.oldestAgeSeconds", account);
+        events.numInFlight.level(info.numBidsInFlight());
+        events.oldestInFlightAge.level(oldest);
         double averageAge = 0.0;
         if (info.numBidsInFlight() != 0)
             averageAge = total / info.numBidsInFlight();
 
-        this->recordLevel(averageAge,
-                          "accounts.%s.inFlight.averageAgeSeconds", account);
+        events.averageInFlightAge.level(averageAge);
 
         for (auto jt = toExpire.begin(), jend = toExpire.end();  jt != jend;
              ++jt) {
-            info.expireBidInFlight(*jt);
+            jt->first->expireBidInFlight(it->first, *info.status, jt->second);
         }
 
         double timeSinceHeartbeat
             = now.secondsSince(info.status->lastHeartbeat);
 
-        this->recordLevel(timeSinceHeartbeat,
-                          "accounts.%s.timeSinceHeartbeat", account);
+        events.timeSinceHeartbeat.level(timeSinceHeartbeat);
 
         if (timeSinceHeartbeat > 5.0) {
             info.status->dead = true;
@@ -1204,14 +1505,14 @@ checkDeadAgents()
                      << " has " << it->second.numBidsInFlight()
                      << " undead auctions: " << endl;
 
-                auto onInFlight = [&] (const Id & id, Date date)
+                auto onInFlight = [&] (AuctionShard &, const Id & id, Date date)
                     {
                         cerr << "  " << id << " --> "
                         << date << " (" << now.secondsSince(date)
                         << "s ago)" << endl;
                     };
 
-                info.forEachInFlight(onInFlight);
+                forEachInFlight(onInFlight);
             }
             else {
                 // agent is dead
@@ -1229,6 +1530,8 @@ checkDeadAgents()
              << endl;
         // TODO: undo all bids in progress
         filters.removeConfig((*it)->first);
+        for (auto & shard : shards)
+            shard->bidsInFlight.erase((*it)->first);
         agents.erase(*it);
     }
 
@@ -1246,6 +1549,24 @@ checkExpiredAuctions()
 {
     //recentlySubmitted.clear();
 
+    if (shards.size() == 1)
+        expireInFlight(*shards[0]);
+
+    {
+        RouterProfiler profiler(dutyCycleCurrent.nsExpireBlacklist);
+        blacklist.doExpiries();
+    }
+
+    if (doDebug) {
+        RouterProfiler profiler(dutyCycleCurrent.nsExpireDebug);
+        expireDebugInfo();
+    }
+}
+
+void
+Router::
+expireInFlight(AuctionShard & shard)
+{
     Date start = Date::now();
 
     {
@@ -1262,14 +1583,14 @@ checkExpiredAuctions()
                          end = auctionInfo.bidders.end();
                      it != end;  ++it) {
                     string agent = it->first;
-                    if (!agents.count(agent)) continue;
+                    auto agentIt = agents.find(agent);
+                    if (agentIt == agents.end()) continue;
 
-                    if (agents[agent].expireBidInFlight(auctionId)) {
-                        AgentInfo & info = this->agents[agent];
-                        ++info.stats->tooLate;
+                    AgentInfo & info = agentIt->second;
+                    if (shard.expireBidInFlight(agent, *info.status, auctionId)) {
+                        ML::atomic_inc(info.stats->tooLate);
 
-                        this->recordHit("accounts.%s.EXPIRED",
-                                        info.config->account.toString('.'));
+                        info.events->expired.hit();
 
                         bidder->sendBidDroppedMessage(info.config, agent, auctionInfo.auction);
                     }
@@ -1295,25 +1616,30 @@ checkExpiredAuctions()
                 // end the auction when it expires in case we're waiting on dead agents
         if(!auctionInfo.auction->getResponses().empty()) {
                     if(!auctionInfo.auction->finish()) {
-                this->recordHit("tooLateToFinish");
+                this->hotEvents.tooLateToFinish.hit();
             }
         }
 
                 return Date();
             };
 
-        inFlight.expire(onExpiredInFlight, start);
+        shard.inFlight.expire(onExpiredInFlight, start);
     }
+}
 
-    {
-        RouterProfiler profiler(dutyCycleCurrent.nsExpireBlacklist);
-        blacklist.doExpiries();
-    }
+void
+Router::
+doLostBid(AuctionShard & shard, const std::string & agent,
+          const Id & auctionId)
+{
+    auto it = shard.inFlight.find(auctionId);
+    if (it == shard.inFlight.end()) return;
 
-    if (doDebug) {
-        RouterProfiler profiler(dutyCycleCurrent.nsExpireDebug);
-        expireDebugInfo();
-    }
+    auto agentIt = agents.find(agent);
+    if (agentIt == agents.end()) return;
+
+    bidder->sendBidLostMessage(agentIt->second.config, agent,
+                               it->second.auction);
 }
 
 void
@@ -1323,11 +1649,17 @@ returnErrorResponse(const std::vector<std::string> & message,
 {
     using namespace std;
     if (message.empty()) return;
+
     if (analytics) analytics->logErrorMessage(error,message);
     logMessageToAnalytics("ERROR", error, message);
     const auto& agent = message[0];
-    AgentInfo & info = this->agents[agent];
-    bidder->sendErrorMessage(info.config, agent, error, message);
+
+    // Only the main loop adds agents, so an unknown one must not be
+    // inserted from here.
+    std::shared_ptr<AgentConfig> config;
+    auto it = agents.find(agent);
+    if (it != agents.end()) config = it->second.config;
+    bidder->sendErrorMessage(config, agent, error, message);
 }
 
 void
@@ -1335,55 +1667,20 @@ Router::
 returnInvalidBid(
         const std::string &agent, const std::string &bidData,
         const std::shared_ptr<Auction> &auction,
-        const char *reason, const char *message, ...) {
+        InvalidBidReason reason, const char *message, ...) {
 
-    auto& agentInfo = agents[agent];
-    const auto& agentConfig = agentInfo.config;
-    this->recordHit("bidErrors.%s", reason);
-    this->recordHit("accounts.%s.bidErrors.total",
-                    agentConfig->account.toString('.'));
-    this->recordHit("accounts.%s.bidErrors.%s",
-                    agentConfig->account.toString('.'),
-                    reason);
+    std::shared_ptr<AgentConfig> agentConfig;
+    hotEvents.bidErrors[reason].hit();
 
-    ++agentInfo.stats->invalid;
+    auto it = agents.find(agent);
+    if (it != agents.end()) {
+        auto& agentInfo = it->second;
+        agentConfig = agentInfo.config;
+        agentInfo.events->bidErrors.hit();
+        agentInfo.events->bidErrorsByReason[reason].hit();
 
-    va_list ap;
-    va_start(ap, message);
-    string formatted;
-    try {
-        formatted = vformat(message, ap);
-    } catch (...) {
-        va_end(ap);
-        throw;
+        ML::atomic_inc(agentInfo.stats->invalid);
     }
-    va_end(ap);
-
-    cerr << "invalid bid for agent " << agent << ": "
-         << formatted << endl;
-    cerr << bidData << endl;
-
-    logMessageToAnalytics("INVALID", agentConfig, agent, formatted, auction);
-    bidder->sendBidInvalidMessage(agentConfig, agent, formatted, auction);
-}
-
-void
-Router::
-returnInvalidBid(
-        const std::string &agent, const std::string &bidData,
-        const std::shared_ptr<Auction> &auction,
-        const std::string &reason, const char *message, ...) {
-
-    auto& agentInfo = agents[agent];
-    const auto& agentConfig = agentInfo.config;
-    this->recordHit("bidErrors.%s", reason);
-    this->recordHit("accounts.%s.bidErrors.total",
-                    agentConfig->account.toString('.'));
-    this->recordHit("accounts.%s.bidErrors.%s",
-                    agentConfig->account.toString('.'),
-                    reason);
-
-    ++agentInfo.stats->invalid;
 
     va_list ap;
     va_start(ap, message);
@@ -1411,7 +1708,7 @@ doStats(const std::vector<std::string> & message)
     Json::Value result(Json::objectValue);
 
     result["numAugmenting"] = augmentationLoop.numAugmenting();
-    result["numInFlight"] = inFlight.size();
+    result["numInFlight"] = numInFlight();
     result["blacklistUsers"] = blacklist.size();
 
     result["numAgents"] = agents.size();
@@ -1465,7 +1762,7 @@ augmentAuction(const std::shared_ptr<AugmentationInfo> & info)
         throw ML::Exception("augmentAuction with no auction to augment");
 
     if (info->auction->tooLate()) {
-        recordHit("tooLateBeforeAdd");
+        hotEvents.tooLateBeforeAdd.hit();
         return;
     }
 
@@ -1474,13 +1771,14 @@ augmentAuction(const std::shared_ptr<AugmentationInfo> & info)
             info->auction->doneAugmenting = Date::now();
 
             if (info->auction->tooLate()) {
-                this->recordHit("tooLateAfterAugmenting");
+                this->hotEvents.tooLateAfterAugmenting.hit();
                 return;
             }
 
             // Send it off to be farmed out to the bidders
-            startBiddingBuffer.push(info);
-            wakeupMainLoop.signal();
+            AuctionShard & shard = this->shardFor(info->auction->id);
+            shard.startBiddingBuffer.push(info);
+            this->wakeupShard(shard);
         };
 
     augmentationLoop.augment(info, Date::now().plusSeconds(augmentationWindow.count()),
@@ -1506,19 +1804,11 @@ preprocessAuction(const std::shared_ptr<Auction> & auction)
     //cerr << "url = " << auction->request->url << endl;
 
     if (auction->tooLate()) {
-        recordHit("tooLateBeforeRouting");
+        hotEvents.tooLateBeforeRouting.hit();
         //inFlight.erase(auctionId);
         return std::shared_ptr<AugmentationInfo>();
     }
 
-    const string & exchange = auction->request->exchange;
-
-    /* Parse out the adimp. */
-    const vector<AdSpot> & imp = auction->request->imp;
-
-    recordCount(imp.size(), "exchange.%s.imp", exchange.c_str());
-    recordHit("exchange.%s.requests", exchange.c_str());
-
     // List of possible agents per round robin group
     std::map<string, GroupPotentialBidders> groupAgents;
 
@@ -1529,18 +1819,16 @@ preprocessAuction(const std::shared_ptr<Auction> & auction)
     auto exchangeConnector = auction->exchangeConnector;
 
 
-    auto doFilterStat = [&] (const AgentConfig& config, const char * reason) {
+    auto doFilterStat = [&] (const CounterHandle & handle) {
         if (!traceAuction) return;
 
-        this->recordHit("accounts.%s.filter.%s",
-                config.account.toString('.'),
-                reason);
+        handle.hit();
     };
 
     if (traceAuction) {
         forEachAgent([&] (const AgentInfoEntry& info) {
                     ML::atomic_inc(info.stats->intoFilters);
-                    doFilterStat(*info.config, "intoStaticFilters");
+                    doFilterStat(info.events->filter.intoStaticFilters);
                 });
     }
 
@@ -1550,15 +1838,16 @@ preprocessAuction(const std::shared_ptr<Auction> & auction)
     auto checkAgent = [&] (
             const AgentConfig & config,
             const AgentStatus & status,
-            AgentStats & stats)
+            AgentStats & stats,
+            const AccountEvents & events)
         {
             if (status.dead || status.lastHeartbeat.secondsSince(now) > 2.0) {
-                doFilterStat(config, "static.agentAppearsDead");
+                doFilterStat(events.filter.agentAppearsDead);
                 return false;
             }
 
             if (status.numBidsInFlight >= config.maxInFlight) {
-                doFilterStat(config, "static.earlyTooManyInFlight");
+                doFilterStat(events.filter.earlyTooManyInFlight);
                 return false;
             }
 
@@ -1567,7 +1856,7 @@ preprocessAuction(const std::shared_ptr<Auction> & auction)
                 && timeLeftMs < config.minTimeAvailableMs)
             {
                 ML::atomic_inc(stats.notEnoughTime);
-                doFilterStat(config, "static.notEnoughTime");
+                doFilterStat(events.filter.staticNotEnoughTime);
                 return false;
             }
 
@@ -1576,10 +1865,12 @@ preprocessAuction(const std::shared_ptr<Auction> & auction)
 
     for (const auto& entry : biddableConfigs) {
         if (entry.biddableSpots.empty()) continue;
-        if (!checkAgent(*entry.config, *entry.status, *entry.stats)) continue;
+        if (!checkAgent(*entry.config, *entry.status, *entry.stats,
+                        *entry.events))
+            continue;
 
         ML::atomic_inc(entry.stats->passedStaticFilters);
-        doFilterStat(*entry.config, "passedStaticFilters");
+        doFilterStat(entry.events->filter.passedStaticFilters);
 
         string rrGroup = entry.config->roundRobinGroup;
         if (rrGroup == "") rrGroup = entry.name;
@@ -1588,6 +1879,7 @@ preprocessAuction(const std::shared_ptr<Auction> & auction)
         bidder.agent = entry.name;
         bidder.config = entry.config;
         bidder.stats = entry.stats;
+        bidder.events = entry.events;
         bidder.imp = std::move(entry.biddableSpots);
 
         groupAgents[rrGroup].push_back(bidder);
@@ -1620,13 +1912,13 @@ preprocessAuction(const std::shared_ptr<Auction> & auction)
         validGroups.push_back(it->second);
     }
 
-    this->recordLevel(validGroups.size(), "potentialBiddersPerRequest");
+    hotEvents.potentialBiddersPerRequest.level(validGroups.size());
 
     if (validGroups.empty()) {
         // Now we need to end the auction
         //inFlight.erase(auctionId);
         if (!auction->finish()) {
-            recordHit("tooLateToFinish");
+            hotEvents.tooLateToFinish.hit();
         }
 
         //cerr << "no valid groups " << endl;
@@ -1638,8 +1930,8 @@ preprocessAuction(const std::shared_ptr<Auction> & auction)
 
     auction->outOfPrepro = Date::now();
 
-    recordOutcome(auction->outOfPrepro.secondsSince(auction->inPrepro) * 1000.0,
-                  "preprocessAuctionTimeMs");
+    hotEvents.preprocessAuctionTimeMs.outcome(
+            auction->outOfPrepro.secondsSince(auction->inPrepro) * 1000.0);
 
     return info;
 }
@@ -1650,19 +1942,23 @@ doStartBidding(const std::vector<std::string> & message)
 {
     std::shared_ptr<AugmentationInfo> augInfo
         = sharedPtrFromMessage<AugmentationInfo>(message.at(2));
-    doStartBidding(augInfo);
+
+    AuctionShard & shard = shardFor(augInfo->auction->id);
+    shard.startBiddingBuffer.push(augInfo);
+    wakeupShard(shard);
 }
 
 void
 Router::
-doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
+doStartBidding(AuctionShard & shard,
+               const std::shared_ptr<AugmentationInfo> & augInfo)
 {
     //static const char *fName = "Router::doStartBidding:";
     RouterProfiler profiler(dutyCycleCurrent.nsStartBidding);
 
     try {
         Id auctionId = augInfo->auction->id;
-        if (inFlight.count(auctionId)) {
+        if (shard.inFlight.count(auctionId)) {
             throwException("doStartBidding.alreadyInFlight",
                            "auction with ID %s already in progress",
                            auctionId.toString().c_str());
@@ -1679,7 +1975,7 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
 
         auto groupAgents = augInfo->potentialGroups;
 
-        AuctionInfo & auctionInfo = addAuction(augInfo->auction,
+        AuctionInfo & auctionInfo = addAuction(shard, augInfo->auction,
                                                augInfo->lossTimeout);
         auto auction = augInfo->auction;
 
@@ -1703,36 +1999,38 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
 
             for (unsigned i = 0;  i < bidders.size();  ++i) {
                 PotentialBidder & bidder = bidders[i];
-                if (!agents.count(bidder.agent)) continue;
-                AgentInfo & info = agents[bidder.agent];
+                auto agentIt = agents.find(bidder.agent);
+                if (agentIt == agents.end()) continue;
+                AgentInfo & info = agentIt->second;
                 const AgentConfig & config = *bidder.config;
 
-                auto doFilterStat = [&] (const char * reason)
+                /* Registered with the same configuration as bidder.config,
+                   so the augmentation handles line up with it. */
+                const auto & filterEvents = bidder.events->filter;
+
+                auto doFilterStat = [&] (const CounterHandle & handle)
                     {
                         if (!traceAuction) return;
 
-                        this->recordHit("accounts.%s.filter.%s",
-                                        config.account.toString('.'),
-                                        reason);
+                        handle.hit();
                     };
 
-                auto doFilterMetric = [&] (const char * reason, float val)
+                auto doFilterMetric = [&] (const OutcomeHandle & handle,
+                                           float val)
                     {
                         if (!traceAuction) return;
 
-                        this->recordOutcome(val, "accounts.%s.filter.%s",
-                                            config.account.toString('.'),
-                                            reason);
+                        handle.outcome(val);
                     };
 
 
-                doFilterStat("intoDynamicFilters");
+                doFilterStat(filterEvents.intoDynamicFilters);
 
                 /* Check if we have too many in flight. */
                 if (info.numBidsInFlight() >= info.config->maxInFlight) {
-                    ++info.stats->tooManyInFlight;
+                    ML::atomic_inc(info.stats->tooManyInFlight);
                     bidder.inFlightProp = PotentialBidder::NULL_PROP;
-                    doFilterStat("dynamic.tooManyInFlight");
+                    doFilterStat(filterEvents.tooManyInFlight);
                     continue;
                 }
 
@@ -1775,16 +2073,16 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
 
                     ML::atomic_inc(info.stats->notEnoughTime);
                     bidder.inFlightProp = PotentialBidder::NULL_PROP;
-                    doFilterStat("dynamic.notEnoughTime");
-                    doFilterMetric("metric.timeUsedBeforeDynamicFilter",
+                    doFilterStat(filterEvents.dynamicNotEnoughTime);
+                    doFilterMetric(filterEvents.timeUsedBeforeDynamicFilter,
                                    timeUsedMs);
-                    doFilterMetric("metric.timeLeftBeforeDynamicFilter",
+                    doFilterMetric(filterEvents.timeLeftBeforeDynamicFilter,
                                    timeLeftMs);
-                    doFilterMetric("metric.timeElapsedBeforePreproMs",
+                    doFilterMetric(filterEvents.timeElapsedBeforePreproMs,
                                    auction->start.secondsUntil(auction->inPrepro) * 1000.0);
-                    doFilterMetric("metric.timeElapsedDuringPreproMs",
+                    doFilterMetric(filterEvents.timeElapsedDuringPreproMs,
                                    auction->inPrepro.secondsUntil(auction->outOfPrepro) * 1000.0);
-                    doFilterMetric("metric.timeWindowMs",
+                    doFilterMetric(filterEvents.timeWindowMs,
                                    auction->expiry.secondsSince(auction->start) * 1000.0 - info.config->minTimeAvailableMs);
                     continue;
                 }
@@ -1794,13 +2092,13 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
 
                 /* Filter on the augmentation tags */
                 bool filteredByAugmentation = false;
-                for (const auto& augConfig : config.augmentations) {
+                for (size_t j = 0;  j < config.augmentations.size();  ++j) {
+                    const auto& augConfig = config.augmentations[j];
                     auto it = augList.find(augConfig.name);
 
                     if (it == augList.end()) {
                         if (!augConfig.required) continue;
-                        string stat = "dynamic." + augConfig.name + ".missing";
-                        doFilterStat(stat.c_str());
+                        doFilterStat(filterEvents.augmentationMissing[j]);
                         filteredByAugmentation = true;
                         break;
                     }
@@ -1809,8 +2107,7 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
                     if (augConfig.filters.anyIsIncluded(tags)) continue;
 
                     ML::atomic_inc(info.stats->augmentationTagsExcluded);
-                    string stat = "dynamic." + augConfig.name + ".tags";
-                    doFilterStat(stat.c_str());
+                    doFilterStat(filterEvents.augmentationTags[j]);
                     filteredByAugmentation = true;
                     break;
                 }
@@ -1822,7 +2119,7 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
                     && blacklist.matches(*auction->request, bidder.agent,
                                          config)) {
                     ML::atomic_inc(info.stats->userBlacklisted);
-                    doFilterStat("dynamic.userBlacklisted");
+                    doFilterStat(filterEvents.userBlacklisted);
                     continue;
                 }
 
@@ -1830,7 +2127,7 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
                     = info.numBidsInFlight() / max(info.config->maxInFlight, 1);
 
                 ML::atomic_inc(info.stats->passedDynamicFilters);
-                doFilterStat("passedDynamicFilters");
+                doFilterStat(filterEvents.passedDynamicFilters);
             }
 
             // Sort the roundrobin infos to find the best one
@@ -1858,20 +2155,14 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
             PotentialBidder & winner = bidders[best];
             string agent = winner.agent;
 
-            if (!agents.count(agent)) {
+            auto agentIt = agents.find(agent);
+            if (agentIt == agents.end()) {
                 //cerr << "!!!AGENT IS GONE" << endl;
                 continue;  // agent is gone
             }
-            AgentInfo & info = agents[agent];
+            AgentInfo & info = agentIt->second;
 
-            ++info.stats->auctions;
-
-            Json::Value aggregatedAug;
-            for (const auto& aug : augList) {
-                aggregatedAug[aug.first] =
-                    aug.second.filterForAccount(winner.config->account).toJson();
-            }
-            auction->agentAugmentations[agent] = chomp(aggregatedAug.toString());
+            ML::atomic_inc(info.stats->auctions);
 
             //auctionInfo.activities.push_back("sent to " + agent);
 
@@ -1881,24 +2172,38 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
             bidInfo.imp = winner.imp;
 
             auctionInfo.bidders.insert(make_pair(agent, std::move(bidInfo)));  // create empty bid response
-            if (!info.trackBidInFlight(auctionId, bidInfo.bidTime))
+            if (!shard.trackBidInFlight(agent, *info.status, auctionId,
+                                        bidInfo.bidTime))
                 throwException("doStartBidding.agentAlreadyBidding",
                                "agent %s is already processing auction %s",
                                agent.c_str(),
                                auctionId.toString().c_str());
         }
 
+        for (const auto& entry : auctionInfo.bidders) {
+            const auto& account = entry.second.agentConfig->account;
+
+            Json::Value aggregatedAug;
+            for (const auto& aug : augList) {
+                aggregatedAug[aug.first] =
+                    aug.second.filterForAccount(account).toJson();
+            }
+            auction->agentAugmentations[entry.first] =
+                chomp(aggregatedAug.toString());
+        }
+
         //cerr << " auction " << id << " with "
         //     << auctionInfo.bidders.size() << " bidders" << endl;
 
         //auctionInfo.activities.push_back(ML::format("total of %zd agents",
         //                                 auctionInfo.bidders.size()));
         if (auction->tooLate()) {
-            recordHit("tooLateAfterRouting");
+            hotEvents.tooLateAfterRouting.hit();
             // Unwind everything?
         }
 
-        this->recordLevel(auctionInfo.bidders.size(), "bidRequestsSentToBiddersPerRequest");
+        hotEvents.bidRequestsSentToBiddersPerRequest.level(
+                auctionInfo.bidders.size());
 
         if (!auctionInfo.bidders.empty()) {
             bidder->sendAuctionMessage(
@@ -1907,10 +2212,10 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
         else {
             /* No bidders; don't bother with the bid */
             ML::atomic_inc(numNoBidders);
-            inFlight.erase(auctionId);
+            shard.inFlight.erase(auctionId);
             //cerr << fName << "About to call finish " << endl;
             if (!auction->finish()) {
-                recordHit("tooLateToFinish");
+                hotEvents.tooLateToFinish.hit();
                 //cerr << "couldn't finish auction 1 " << auction->id << endl;
             }
         }
@@ -1925,7 +2230,8 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
 
 AuctionInfo &
 Router::
-addAuction(std::shared_ptr<Auction> auction, Date lossTimeout)
+addAuction(AuctionShard & shard,
+           std::shared_ptr<Auction> auction, Date lossTimeout)
 {
     const Id & id = auction->id;
 
@@ -1933,7 +2239,7 @@ addAuction(std::shared_ptr<Auction> auction, Date lossTimeout)
 
     try {
         AuctionInfo & result
-            = inFlight.insert(id, AuctionInfo(auction, lossTimeout),
+            = shard.inFlight.insert(id, AuctionInfo(auction, lossTimeout),
                               getCurrentTime().plusSeconds(bidMemoryWindow));
         return result;
     } catch (const std::exception & exc) {
@@ -1963,6 +2269,25 @@ doBid(const std::vector<std::string> & message)
         return;
     }
 
+    AuctionShard & shard = shardFor(Id(message[2]));
+    if (shards.size() == 1) {
+        doBid(shard, message);
+        return;
+    }
+
+    // Parsing the bid is left to the shard.
+    if (!shard.agentBidBuffer.tryPush(message)) {
+        hotEvents.shardQueueFull.hit();
+        returnErrorResponse(message, "router can't keep up with the bids");
+        return;
+    }
+    wakeupShard(shard);
+}
+
+void
+Router::
+doBid(AuctionShard & shard, const std::vector<std::string> & message)
+{
     Id auctionId(message[2]);
 
     const string & agent = message[0];
@@ -1985,27 +2310,28 @@ doBid(const std::vector<std::string> & message)
         bids = Bids::fromJson(biddata);
     }
     catch (const std::exception & exc) {
-        auto it = inFlight.find(auctionId);
-        if (it == inFlight.end()) {
-            recordHit("bidError.unknownAuction");
+        auto it = shard.inFlight.find(auctionId);
+        if (it == shard.inFlight.end()) {
+            hotEvents.unknownAuction.hit();
             returnErrorResponse(message, "unknown auction");
             return;
         }
         else {
             returnInvalidBid(agent, biddata, it->second.auction,
-                    "bidParseError",
+                    IBR_BID_PARSE_ERROR,
                     "couldn't parse bid JSON %s: %s", biddata.c_str(), exc.what());
         }
         return;
     }
     bidMessage.bids = std::move(bids);
 
-    doBidImpl(bidMessage, message);
+    doBidImpl(shard, bidMessage, message);
 }
 
 void
 Router::
-doBidImpl(const BidMessage &message, const std::vector<std::string> &originalMessage)
+doBidImpl(AuctionShard & shard, const BidMessage &message,
+          const std::vector<std::string> &originalMessage)
 {
     Date dateGotBid = Date::now();
 
@@ -2017,9 +2343,9 @@ doBidImpl(const BidMessage &message, const std::vector<std::string> &originalMes
     ExcAssert(!message.agents.empty());
 
     const auto& auctionId = message.auctionId;
-    auto it = inFlight.find(auctionId);
-    if (it == inFlight.end()) {
-        recordHit("bidError.unknownAuction");
+    auto it = shard.inFlight.find(auctionId);
+    if (it == shard.inFlight.end()) {
+        hotEvents.unknownAuction.hit();
         returnErrorResponse(originalMessage, "unknown auction");
         return;
     }
@@ -2027,28 +2353,28 @@ doBidImpl(const BidMessage &message, const std::vector<std::string> &originalMes
     AuctionInfo & auctionInfo = it->second;
 
     for (const auto &agent: message.agents) {
-        if (!agents.count(agent)) {
+        auto agentIt = agents.find(agent);
+        if (agentIt == agents.end()) {
             returnErrorResponse(originalMessage, "unknown agent");
             return;
         }
 
         auto biddersIt = auctionInfo.bidders.find(agent);
         if (biddersIt == auctionInfo.bidders.end()) {
-            recordHit("bidError.agentSkippedAuction");
+            hotEvents.agentSkippedAuction.hit();
             returnErrorResponse(originalMessage,
                                 "agent shouldn't bid on this auction");
             return;
         }
 
-        AgentInfo & info = agents[agent];
+        AgentInfo & info = agentIt->second;
         /* One less in flight. */
-        if (!info.expireBidInFlight(auctionId)) {
-            recordHit("bidError.agentNotBidding");
+        if (!shard.expireBidInFlight(agent, *info.status, auctionId)) {
+            hotEvents.agentNotBidding.hit();
             returnErrorResponse(originalMessage, "agent wasn't bidding on this auction");
             return;
         }
-        auto & config = *biddersIt->second.agentConfig;
-        recordHit("accounts.%s.bids", config.account.toString('.'));
+        info.events->bids.hit();
     }
 
 
@@ -2056,16 +2382,18 @@ doBidImpl(const BidMessage &message, const std::vector<std::string> &originalMes
 
     int numValidBids = 0;
 
-    recordHit("bid");
+    hotEvents.bid.hit();
 
     const auto& agent = message.agents[0];
     auto biddersIt = auctionInfo.bidders.find(agent);
     auto & config = *biddersIt->second.agentConfig;
-    AgentInfo & info = agents[agent];
+    // Checked by doBidImpl, and only the main loop removes agents, while it
+    // holds the lock of every shard.
+    AgentInfo & info = agents.find(agent)->second;
     const auto& agentConfig = info.config;
 
     const auto& bids = message.bids;
-    auto bidsString = bids.toJson().toStringNoNewLine();
+    auto bidsString = bids.toJsonStr();
 
     BidInfo bidInfo(std::move(biddersIt->second));
 
@@ -2080,7 +2408,7 @@ doBidImpl(const BidMessage &message, const std::vector<std::string> &originalMes
 
     auctionInfo.auction->addDataSources(bids.dataSources);
 
-    this->recordLevel(bids.size(), "bidsPerBidRequest");
+    hotEvents.bidsPerBidRequest.level(bids.size());
 
     for (int i = 0; i < bids.size(); ++i) {
 
@@ -2095,7 +2423,7 @@ doBidImpl(const BidMessage &message, const std::vector<std::string> &originalMes
 
         if (bid.creativeIndex == -1) {
             returnInvalidBid(agent, bidsString, auctionInfo.auction,
-                    "nullCreativeField",
+                    IBR_NULL_CREATIVE_FIELD,
                     "creative field is null in response %s",
                     bidsString.c_str());
             continue;
@@ -2105,7 +2433,7 @@ doBidImpl(const BidMessage &message, const std::vector<std::string> &originalMes
                 || bid.creativeIndex >= config.creatives.size())
         {
             returnInvalidBid(agent, bidsString, auctionInfo.auction,
-                    "outOfRangeCreative",
+                    IBR_OUT_OF_RANGE_CREATIVE,
                     "parsing field 'creative' of %s: creative "
                     "number %d out of range 0-%zd",
                     bidsString.c_str(), bid.creativeIndex,
@@ -2118,7 +2446,7 @@ doBidImpl(const BidMessage &message, const std::vector<std::string> &originalMes
                 bid.price = maxBidAmount;
             } else {
                 returnInvalidBid(agent, bidsString, auctionInfo.auction,
-                    "invalidPrice",
+                    IBR_INVALID_PRICE,
                     "bid price of %s is outside range of $0-%s parsing bid %s",
                     bid.price.toString().c_str(),
                     maxBidAmount.toString().c_str(),
@@ -2131,7 +2459,7 @@ doBidImpl(const BidMessage &message, const std::vector<std::string> &originalMes
 
         if (!getbid.isValidbid) {
             returnInvalidBid(agent, bidsString, auctionInfo.auction,
-                "noBid",
+                IBR_NO_BID,
                 getbid.reason_.c_str());
             continue;
         }
@@ -2151,7 +2479,7 @@ doBidImpl(const BidMessage &message, const std::vector<std::string> &originalMes
             cerr << "creative: " << creative.toJson().toStringNoNewLine() << endl;
 #endif
             returnInvalidBid(agent, bidsString, auctionInfo.auction,
-                    "creativeNotCompatibleWithSpot",
+                    IBR_CREATIVE_NOT_COMPATIBLE_WITH_SPOT,
                     "creative %s not compatible with spot %s",
                     creative.toJson().toString().c_str(),
                     imp[spotIndex].toJson().toString().c_str());
@@ -2161,7 +2489,7 @@ doBidImpl(const BidMessage &message, const std::vector<std::string> &originalMes
         if (!creative.biddable(auctionInfo.auction->request->exchange,
                         auctionInfo.auction->request->protocolVersion)) {
             returnInvalidBid(agent, bidsString, auctionInfo.auction,
-                    "creativeNotBiddableOnExchange",
+                    IBR_CREATIVE_NOT_BIDDABLE_ON_EXCHANGE,
                     "creative not biddable on exchange/version");
             continue;
         }
@@ -2176,29 +2504,39 @@ doBidImpl(const BidMessage &message, const std::vector<std::string> &originalMes
 
         if (!monitorClient.getStatus(slowModeTolerance)) {
             Date now = Date::now();
-            if ((uint32_t) slowModeLastAuction.secondsSinceEpoch()
-                    < (uint32_t) now.secondsSinceEpoch()) {
-                slowModeLastAuction = now;
-                slowModePeriodicSpentReached = false;
-                // TODO Insure in router.cc (not router_runner) that
-                // maxBidPrice <= slowModeAuthorizedMoneyLimit
-                // Here we're garanteed that price.value >= slowModeAuthorizedMoneyLimit
-                accumulatedBidMoneyInThisPeriod = price.value;
-
-                recordHit("monitor.systemInSlowMode"); 
+            bool dropBid = false;
+
+            {
+                std::lock_guard<ML::Spinlock> guard(slowModeLock);
+
+                if ((uint32_t) slowModeLastAuction.secondsSinceEpoch()
+                        < (uint32_t) now.secondsSinceEpoch()) {
+                    slowModeLastAuction = now;
+                    slowModePeriodicSpentReached = false;
+                    // TODO Insure in router.cc (not router_runner) that
+                    // maxBidPrice <= slowModeAuthorizedMoneyLimit
+                    // Here we're garanteed that price.value >= slowModeAuthorizedMoneyLimit
+                    accumulatedBidMoneyInThisPeriod = price.value;
+
+                    hotEvents.systemInSlowMode.hit();
+                }
+
+                else {
+                    accumulatedBidMoneyInThisPeriod += price.value;
+                    // Check if we're spending more in this period than what slowModeAuthorizedMoneyLimit
+                    // allows us to.
+                    if (accumulatedBidMoneyInThisPeriod > slowModeAuthorizedMoneyLimit.value) {
+                        slowModePeriodicSpentReached = true;
+                        dropBid = true;
+                    }
+                }
             }
 
-            else {
-                accumulatedBidMoneyInThisPeriod += price.value;
-                // Check if we're spending more in this period than what slowModeAuthorizedMoneyLimit
-                // allows us to.
-                if (accumulatedBidMoneyInThisPeriod > slowModeAuthorizedMoneyLimit.value) {
-                    slowModePeriodicSpentReached = true;
-                    bidder->sendBidDroppedMessage(agentConfig, agent, auctionInfo.auction);
-                    recordHit("slowMode.droppedBid");
-                    recordHit("accounts.%s.IGNORED", config.account.toString('.'));
+            if (dropBid) {
+                bidder->sendBidDroppedMessage(agentConfig, agent, auctionInfo.auction);
+                hotEvents.slowModeDroppedBid.hit();
+                info.events->ignored.hit();
                 continue;
-                }
             }
         } else {
             // Make sure slowModePeriodicSpentReached is false if monitor success is satisfied.
@@ -2208,18 +2546,18 @@ doBidImpl(const BidMessage &message, const std::vector<std::string> &originalMes
 
         if (!banker->authorizeBid(config.account, auctionKey, price) || failBid(budgetErrorRate))
         {
-            ++info.stats->noBudget;
+            ML::atomic_inc(info.stats->noBudget);
 
             bidder->sendNoBudgetMessage(agentConfig, agent, auctionInfo.auction);
 
             if (analytics) analytics->logNoBudgetMessage(agent, auctionId, bidsString, message.meta);
             this->logMessageToAnalytics("NOBUDGET", agent, auctionId);
-            recordHit("accounts.%s.NOBUDGET", config.account.toString('.'));
+            info.events->noBudget.hit();
             continue;
         }
         
-        recordCount(bid.price.value, "cummulatedBidPrice");
-        recordCount(price.value, "cummulatedAuthorizedPrice");
+        hotEvents.cummulatedBidPrice.count(bid.price.value);
+        hotEvents.cummulatedAuthorizedPrice.count(price.value);
 
 
         if (doDebug)
@@ -2269,20 +2607,18 @@ doBidImpl(const BidMessage &message, const std::vector<std::string> &originalMes
 
         switch (localResult.val) {
         case Auction::WinLoss::PENDING: {
-            ++info.stats->bids;
-            info.stats->totalBid += price;
+            info.stats->addBid(price);
             break; // response will be sent later once local winning bid known
         }
         case Auction::WinLoss::LOSS:
-            ++info.stats->bids;
-            info.stats->totalBid += price;
+            info.stats->addBid(price);
             // fall through
         case Auction::WinLoss::TOOLATE:
         case Auction::WinLoss::INVALID: {
             if (localResult.val == Auction::WinLoss::TOOLATE)
-                ++info.stats->tooLate;
+                ML::atomic_inc(info.stats->tooLate);
             else if (localResult.val == Auction::WinLoss::INVALID)
-                ++info.stats->invalid;
+                ML::atomic_inc(info.stats->invalid);
 
             banker->cancelBid(config.account, auctionKey);
 
@@ -2291,17 +2627,17 @@ doBidImpl(const BidMessage &message, const std::vector<std::string> &originalMes
             case Auction::WinLoss::LOSS:
                 status = BS_LOSS;
                 bidder->sendLossMessage(agentConfig, agent, auctionId.toString ());
-                recordHit("accounts.%s.LOCAL_LOSS", config.account.toString('.'));
+                info.events->localLoss.hit();
                 break;
             case Auction::WinLoss::TOOLATE:
                 status = BS_TOOLATE;
                 bidder->sendTooLateMessage(agentConfig, agent, auctionInfo.auction);
-                recordHit("accounts.%s.TOOLATE", config.account.toString('.'));
+                info.events->tooLate.hit();
                 continue;
             case Auction::WinLoss::INVALID:
                 status = BS_INVALID;
                 bidder->sendBidInvalidMessage(agentConfig, agent, msg, auctionInfo.auction);
-                recordHit("accounts.%s.INVALID", config.account.toString('.'));
+                info.events->invalid.hit();
                 break;
             default:
                 throw ML::Exception("logic error");
@@ -2348,18 +2684,16 @@ doBidImpl(const BidMessage &message, const std::vector<std::string> &originalMes
     //cerr << "campaign " << info.config->campaign << " bidTime "
     //     << 1000.0 * bidTime << endl;
 
-    recordOutcome(1000.0 * bidTime,
-                  "accounts.%s.bidResponseTimeMs",
-                  config.account.toString('.'));
+    info.events->bidResponseTimeMs.outcome(1000.0 * bidTime);
 
 
     if (auctionInfo.bidders.empty()) {
         debugAuction(auctionId, "FINISH", originalMessage);
         if (!auctionInfo.auction->finish()) {
             debugAuction(auctionId, "FINISH TOO LATE", originalMessage);
-            recordHit("accounts.%s.FINISH_TOOLATE", agentConfig->account.toString('.'));
+            info.events->finishTooLate.hit();
         }
-        inFlight.erase(auctionId);
+        shard.inFlight.erase(auctionId);
         //cerr << "couldn't finish auction " << auctionInfo.auction->id
         //<< " after bid " << message << endl;
     }
@@ -2369,7 +2703,7 @@ doBidImpl(const BidMessage &message, const std::vector<std::string> &originalMes
 
 void
 Router::
-doSubmitted(std::shared_ptr<Auction> auction)
+doSubmitted(AuctionShard & shard, std::shared_ptr<Auction> auction)
 {
     // Auction was submitted
 
@@ -2432,9 +2766,10 @@ doSubmitted(std::shared_ptr<Auction> auction)
 
             //cerr << "doing response " << i << endl;
 
-            if (!agents.count(response.agent)) continue;
+            auto agentIt = agents.find(response.agent);
+            if (agentIt == agents.end()) continue;
 
-            AgentInfo & info = agents[response.agent];
+            AgentInfo & info = agentIt->second;
             const auto& agentConfig = info.config;
 
             Amount bid_price = response.price.maxPrice;
@@ -2473,17 +2808,17 @@ doSubmitted(std::shared_ptr<Auction> auction)
                                "auction should not be invalid");
             case Auction::WinLoss::LOSS:
                 bidStatus = BS_LOSS;
-                ++info.stats->losses;
+                ML::atomic_inc(info.stats->losses);
                 msg = "LOSS";
                 bidder->sendLossMessage(agentConfig, response.agent, auctionId.toString());
-                recordHit("accounts.%s.LOCAL_LOSS", agentConfig->account.toString('.'));
+                info.events->localLoss.hit();
                 break;
             case Auction::WinLoss::TOOLATE:
                 bidStatus = BS_TOOLATE;
-                ++info.stats->tooLate;
+                ML::atomic_inc(info.stats->tooLate);
                 msg = "TOOLATE";
                 bidder->sendTooLateMessage(agentConfig, response.agent, auction);
-                recordHit("accounts.%s.TOOLATE", agentConfig->account.toString('.'));
+                info.events->tooLate.hit();
                 break;
             default:
                 throwException("doSubmitted.unknownStatus",
@@ -2499,10 +2834,14 @@ doSubmitted(std::shared_ptr<Auction> auction)
 
         // If we didn't actually submit a bid then nothing else to do
         if (!hasSubmittedBid) continue;
-        this->recordHit("numRequestWithBid");
+        hotEvents.numRequestWithBid.hit();
         ML::atomic_add(numAuctionsWithBid, 1);
         //cerr << fName << "injecting submitted auction " << endl;
 
+        auto it = agents.find(responses[0].agent);
+        if (it != agents.end())
+            it->second.events->submitted.hit();
+
         logMessageToAnalytics("SUBMITTED", auction->id, responses[0].agent, responses[0].price.toJsonStr());
         onSubmittedAuction(auction, spotId, responses[0]);
         //postAuctionLoop.injectSubmittedAuction(auction, spotId, responses[0]);
@@ -2549,7 +2888,7 @@ onNewAuction(std::shared_ptr<Auction> auction)
         // used by router loop AND exchange connector threads
         if (slowModePeriodicSpentReached && (uint32_t) slowModeLastAuction.secondsSinceEpoch()
                 == (uint32_t) now.secondsSinceEpoch() ) {
-            recordHit("monitor.ignoredAuctions");
+            hotEvents.ignoredAuctions.hit();
             auction->finish();
             return;
         }
@@ -2571,11 +2910,11 @@ onNewAuction(std::shared_ptr<Auction> auction)
     auto info = preprocessAuction(auction);
 
     if (info) {
-        recordHit("auctionPassedPreprocessing");
+        hotEvents.auctionPassedPreprocessing.hit();
         augmentAuction(info);
     }
     else {
-        recordHit("auctionDropped.noPotentialBidders");
+        hotEvents.noPotentialBidders.hit();
         ML::atomic_inc(numNoPotentialBidders);
     }
 }
@@ -2594,7 +2933,10 @@ onAuctionDone(std::shared_ptr<Auction> auction)
 #endif
 
     debugAuction(auction->id, "SENT SUBMITTED");
-    submittedBuffer.push(auction);
+
+    AuctionShard & shard = shardFor(auction->id);
+    shard.submittedBuffer.push(auction);
+    wakeupShard(shard);
 }
 
 void
@@ -2635,6 +2977,7 @@ updateAllAgents()
             entry.filterIndex = it->second.filterIndex;
             entry.config = it->second.config;
             entry.stats = it->second.stats;
+            entry.events = it->second.events;
             entry.status = it->second.status;
             int i = newInfo->size();
             newInfo->push_back(entry);
@@ -2690,8 +3033,8 @@ doConfig(const std::string & agent,
         //cerr << "configured " << agent << " strategy : " << info.config->strategy << " campaign "
         //     <<  info.config->campaign << endl;
 
-        string bidRequestFormat = "jsonRaw";
-        info.setBidRequestFormat(bidRequestFormat);
+        info.setBidRequestFormat(newConfig->bidRequestFormat);
+        info.events = std::make_shared<AccountEvents>(*this, *newConfig);
 
         configure(agent, *newConfig);
         info.configured = true;
@@ -2877,7 +3220,7 @@ void
 Router::
 forEachAgent(const OnAgentFn & onAgent) const
 {
-    GcLock::SharedGuard guard(allAgentsGc);
+    EpochGc::SharedGuard guard(allAgentsGc);
     const AllAgentInfo * ac = allAgents;
     if (!ac) return;
 
@@ -2889,7 +3232,7 @@ Router::
 forEachAccountAgent(const AccountKey & account,
                     const OnAgentFn & onAgent) const
 {
-    GcLock::SharedGuard guard(allAgentsGc);
+    EpochGc::SharedGuard guard(allAgentsGc);
     const AllAgentInfo * ac = allAgents;
     if (!ac) return;
 
@@ -2906,7 +3249,7 @@ AgentInfoEntry
 Router::
 getAgentEntry(const std::string & agent) const
 {
-    GcLock::SharedGuard guard(allAgentsGc);
+    EpochGc::SharedGuard guard(allAgentsGc);
     const AllAgentInfo * ac = allAgents;
     if (!ac) return AgentInfoEntry();
 
@@ -2938,8 +3281,6 @@ submitToPostAuctionService(std::shared_ptr<Auction> auction,
 
     banker->detachBid(bid.account, auctionKey);
 
-    recordHit("accounts.%s.submitted", bid.account.toString('.'));
-
     if (connectPostAuctionLoop) {
         auto event = std::make_shared<SubmittedAuctionEvent>();
         event->auctionId = auction->id;
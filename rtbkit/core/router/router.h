@@ -18,11 +18,12 @@
 #include "soa/service/zmq_named_pub_sub.h"
 #include "soa/service/socket_per_thread.h"
 #include "soa/service/timeout_map.h"
+#include "soa/service/timing_wheel_map.h"
 #include "soa/service/pending_list.h"
 #include "soa/service/loop_monitor.h"
 #include "augmentation_loop.h"
 #include "router_types.h"
-#include "soa/gc/gc_lock.h"
+#include "soa/gc/epoch_gc.h"
 #include "jml/utils/ring_buffer.h"
 #include "jml/arch/wakeup_fd.h"
 #include "jml/utils/smart_ptr_utils.h"
@@ -56,6 +57,7 @@ struct AgentInfoEntry {
     std::shared_ptr<const AgentConfig> config;
     std::shared_ptr<const AgentStatus> status;
     std::shared_ptr<AgentStats> stats;
+    std::shared_ptr<const AccountEvents> events;
 
     bool valid() const { return config && stats; }
 
@@ -145,8 +147,18 @@ struct Router : public ServiceBase,
     /** Initialize the bidder interface. */
     void initBidderInterface(Json::Value const & json);
 
+    /** Number of auction shards.  Each shard runs doStartBidding, doBid,
+        doSubmitted and the in flight expiry for the auctions whose id hashes
+        to it.  With a single shard (the default) everything runs on the
+        main loop as before; with more each shard gets its own thread.  Must
+        be called before start().
+    */
+    void setNumAuctionShards(size_t numShards);
+    size_t numAuctionShards() const { return shards.size(); }
+
     /** Initialize analytics if it is used. */
-    void initAnalyticsPublisher(const std::string & baseUrl, const int numConnections);
+    void initAnalyticsPublisher(const std::string & baseUrl, const int numConnections,
+                                const std::string & compression = "");
 
     /** Initialize exchages from json configuration. */
     void initExchanges(const Json::Value & config);
@@ -219,8 +231,11 @@ struct Router : public ServiceBase,
     */
     void connectExchange(ExchangeConnector & exchange)
     {
+        auto events = std::make_shared<ExchangeEvents>(
+                *this, exchange.exchangeName());
         exchange.onNewAuction  = [=] (std::shared_ptr<Auction> a) {
-                        this->injectAuction(a, secondsUntilLossAssumed_); };
+                        this->injectAuction(a, secondsUntilLossAssumed_,
+                                            events.get()); };
         exchange.onAuctionDone = [=] (std::shared_ptr<Auction> a) {
                         this->onAuctionDone(a); };
         exchange.onAuctionError = [=] (const std::string & channel,
@@ -300,7 +315,10 @@ struct Router : public ServiceBase,
                    the current time and that value used.
     */
     void injectAuction(std::shared_ptr<Auction> auction,
-                       double lossTime = INFINITY);
+                       double lossTime = INFINITY)
+    {
+        injectAuction(auction, lossTime, nullptr);
+    }
     
     /** Inject an auction into the router given its components.
         
@@ -355,6 +373,14 @@ struct Router : public ServiceBase,
     /** Return the number of auctions in progress. */
     int numAuctionsInProgress() const;
 
+    /** Return the number of auctions in flight over all the shards. */
+    size_t numInFlight() const;
+
+    /** Queue a parsed bid for the shard that owns its auction.  Can be
+        called from any thread; returns false if the shard can't keep up.
+    */
+    bool pushBid(BidMessage && message);
+
     /** Return the number of auctions awaiting a win/loss message. */
     int numAuctionsAwaitingResult() const;
 
@@ -420,6 +446,9 @@ protected:
     typedef std::recursive_mutex Lock;
     typedef std::unique_lock<Lock> Guard;
 
+    typedef std::mutex ShardLock;
+    typedef std::unique_lock<ShardLock> ShardGuard;
+
     int shutdown_;
 
 public:
@@ -434,10 +463,7 @@ public:
 
     ML::RingBufferSRMW<std::pair<std::string, std::shared_ptr<const AgentConfig> > > configBuffer;
     ML::RingBufferSRMW<std::shared_ptr<ExchangeConnector> > exchangeBuffer;
-    ML::RingBufferSRMW<std::shared_ptr<AugmentationInfo> > startBiddingBuffer;
-    ML::RingBufferSRMW<std::shared_ptr<Auction> > submittedBuffer;
-    ML::RingBufferSWMR<std::shared_ptr<Auction> > auctionGraveyard;
-    ML::RingBufferSRMW<BidMessage> doBidBuffer;
+    ML::RingBufferSRMW<std::shared_ptr<Auction> > auctionGraveyard;
 
     ML::Wakeup_Fd wakeupMainLoop;
 
@@ -449,13 +475,76 @@ public:
     LoopMonitor loopMonitor;
     LoadStabilizer loadStabilizer;
 
-    /** List of auctions we're currently tracking as active. */
-    typedef TimeoutMap<Id, AuctionInfo> InFlight;
-    InFlight inFlight;
+    /** List of auctions we're currently tracking as active.  This is a
+        timing wheel as it sees an insert and an erase or expiry for every
+        auction.
+    */
+    typedef TimingWheelMap<Id, AuctionInfo> InFlight;
+
+    /** Slice of the auction pipeline.  Every message about an auction is
+        queued to the shard its id hashes to, so the in flight map of a shard
+        is only ever touched by the loop that runs it.
+    */
+    struct AuctionShard {
+        AuctionShard(size_t index);
+
+        size_t index;
+        InFlight inFlight;
+
+        ML::RingBufferSRMW<std::shared_ptr<AugmentationInfo> > startBiddingBuffer;
+        ML::RingBufferSRMW<std::vector<std::string> > agentBidBuffer;
+        ML::RingBufferSRMW<BidMessage> doBidBuffer;
+        ML::RingBufferSRMW<std::shared_ptr<Auction> > submittedBuffer;
+        ML::RingBufferSRMW<std::pair<std::string, Id> > lostBidBuffer;
+
+        /** Auctions of this shard that each agent is bidding on.  The total
+            over all the shards is kept in the status of the agent.
+        */
+        typedef std::map<Id, Date> BidsInFlight;
+        std::unordered_map<std::string, BidsInFlight> bidsInFlight;
+
+        /** Returns false if the agent was already bidding on the auction. */
+        bool trackBidInFlight(const std::string & agent, AgentStatus & status,
+                              const Id & auctionId, Date date);
+
+        /** Returns false if the agent wasn't bidding on the auction. */
+        bool expireBidInFlight(const std::string & agent, AgentStatus & status,
+                               const Id & auctionId);
+
+        /** Held by the loop of the shard while it works on its auctions.
+            The main loop takes the lock of every shard before it changes
+            the agents.
+        */
+        ShardLock lock;
+
+        /** Only used when the shard has its own thread. */
+        ML::Wakeup_Fd wakeup;
+        boost::scoped_ptr<boost::thread> thread;
+    };
+
+    std::vector<std::unique_ptr<AuctionShard> > shards;
+
+    AuctionShard & shardFor(const Id & auctionId)
+    {
+        return *shards[auctionId.hash() % shards.size()];
+    }
+
+    /** Wake up whichever loop runs the given shard. */
+    void wakeupShard(AuctionShard & shard);
+
+    /** Loop of a shard that runs on its own thread. */
+    void runShard(AuctionShard & shard);
+
+    /** Locks of the shards.  Only taken when there is more than one shard,
+        as a single shard runs on the main loop.
+    */
+    ShardGuard lockShard(AuctionShard & shard);
+    std::vector<ShardGuard> lockAllShards();
 
     /** Add the given auction to our data structures. */
     AuctionInfo &
-    addAuction(std::shared_ptr<Auction> auction, Date timeout);
+    addAuction(AuctionShard & shard,
+               std::shared_ptr<Auction> auction, Date timeout);
 
     DutyCycleEntry dutyCycleCurrent;
     std::vector<DutyCycleEntry> dutyCycleHistory;
@@ -468,16 +557,14 @@ public:
 
     void checkExpiredAuctions();
 
+    void expireInFlight(AuctionShard & shard);
+
     void returnErrorResponse(const std::vector<std::string> & message,
                              const std::string & error);
 
     void returnInvalidBid(const std::string &agent, const std::string &bidData,
                           const std::shared_ptr<Auction> &auction,
-                          const char *reason, const char *message, ...);
-
-    void returnInvalidBid(const std::string &agent, const std::string &bidData,
-                          const std::shared_ptr<Auction> &auction,
-                          const std::string &reason, const char *message, ...);
+                          InvalidBidReason reason, const char *message, ...);
     void doShutdown();
 
     /** Perform initial auction processing to see how it can be used.  Returns a
@@ -499,20 +586,26 @@ public:
     void doStartBidding(const std::vector<std::string> & message);
 
     /** Ditto but taking the augmented auction directly. */
-    void doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo);
+    void doStartBidding(AuctionShard & shard,
+                        const std::shared_ptr<AugmentationInfo> & augInfo);
 
     /** Auction has been submitted.  Do the final cleanup here and send
         it off to the post auction loop. */
-    void doSubmitted(std::shared_ptr<Auction> auction);
+    void doSubmitted(AuctionShard & shard, std::shared_ptr<Auction> auction);
 
     //std::unordered_set<Id> recentlySubmitted;  // DEBUG
 
     /** An agent bid on an auction.  Arrange for this bid to be recorded. */
     void doBid(const std::vector<std::string> & message);
+    void doBid(AuctionShard & shard, const std::vector<std::string> & message);
 
-    void doBidImpl(const BidMessage &message,
+    void doBidImpl(AuctionShard & shard, const BidMessage &message,
                    const std::vector<std::string> &originalMessage = std::vector<std::string>());
 
+    /** A bid of the agent has been in flight for far too long. */
+    void doLostBid(AuctionShard & shard, const std::string & agent,
+                   const Id & auctionId);
+
     /** An agent responded to a ping message.  Arrange for the ping time
         to be recorded. */
     void doPong(int level, const std::vector<std::string> & message);
@@ -576,7 +669,7 @@ public:
     AllAgentInfo * allAgents;
 
     /** RCU protection for allAgents. */
-    mutable GcLock allAgentsGc;
+    mutable EpochGc allAgentsGc;
 
     typedef std::function<void (const AgentInfoEntry & info)> OnAgentFn;
     /** Call the given callback for each agent. */
@@ -629,8 +722,10 @@ public:
                         const std::string & exception,
                         Args... args)
     {
-        analyticsPublisher.publish("ROUTERERROR", Date::now().print(5),
-                       function, exception, args...);
+        if (analyticsPublisher.isEnabled("ROUTERERROR"))
+            analyticsPublisher.publishEnabled("ROUTERERROR",
+                                              Date::now().print(5),
+                                              function, exception, args...);
         recordHit("error.%s", function);
     }
 
@@ -725,7 +820,9 @@ public:
     template<typename... Args>
     void logMessageToAnalytics(const std::string & channel, Args... args)
     {
-        analyticsPublisher.publish(channel, Date::now().print(5), args...);
+        if (!analyticsPublisher.isEnabled(channel)) return;
+        analyticsPublisher.publishEnabled(channel, Date::now().print(5),
+                                          args...);
     }
 
 
@@ -785,10 +882,78 @@ public:
     uint64_t numNoPotentialBidders;
     uint64_t numNoBidders;
 
+    /** Handles to the events recorded for every auction or bid, registered
+        in init().  The per-account ones live in AgentInfo::events.
+    */
+    struct HotEvents {
+        HotEvents()
+        {
+        }
+
+        HotEvents(const EventRecorder & recorder);
+
+        CounterHandle tooLateBeforeAdd;
+        CounterHandle tooLateAfterAugmenting;
+        CounterHandle tooLateBeforeRouting;
+        CounterHandle tooLateAfterRouting;
+        CounterHandle tooLateToFinish;
+        CounterHandle ignoredAuctions;
+        CounterHandle auctionPassedPreprocessing;
+        CounterHandle noPotentialBidders;
+        CounterHandle bid;
+        CounterHandle numRequestWithBid;
+        CounterHandle shardQueueFull;
+        CounterHandle unknownAuction;
+        CounterHandle agentSkippedAuction;
+        CounterHandle agentNotBidding;
+        CounterHandle systemInSlowMode;
+        CounterHandle slowModeDroppedBid;
+        CounterHandle cummulatedBidPrice;
+        CounterHandle cummulatedAuthorizedPrice;
+        LevelHandle potentialBiddersPerRequest;
+        LevelHandle bidRequestsSentToBiddersPerRequest;
+        LevelHandle bidsPerBidRequest;
+        OutcomeHandle preprocessAuctionTimeMs;
+        BidErrorEvents bidErrors;
+
+        /** For requests whose exchange isn't the one of the connector that
+            received them; see ExchangeEvents.
+        */
+        CounterFamily exchangeImp;
+        CounterFamily exchangeRequests;
+    };
+
+    HotEvents hotEvents;
+
+    /** Handles to the exchange.<exchange>.* events, registered when an
+        exchange connector is connected to the router.
+    */
+    struct ExchangeEvents {
+        ExchangeEvents(const EventRecorder & recorder,
+                       const std::string & exchange);
+
+        std::string exchange;
+        CounterHandle imp;
+        CounterHandle requests;
+    };
+
+    /** Count a request coming in from an exchange.  events belongs to the
+        connector that received it, if there is one.
+    */
+    void recordExchangeRequest(const BidRequest & request,
+                               const ExchangeEvents * events);
+
+    /** Same as the public injectAuction, for an auction received by the
+        connector that events belongs to.
+    */
+    void injectAuction(std::shared_ptr<Auction> auction, double lossTime,
+                       const ExchangeEvents * events);
+
     /* Client connection to the Monitor, determines if we can process bid
        requests */
     MonitorClient monitorClient;
-    // TODO Make this thread safe
+    // Protects the slow mode accounting, which is shared by the shards.
+    ML::Spinlock slowModeLock;
     Date slowModeLastAuction;
     std::atomic<bool> slowModePeriodicSpentReached;    
     Amount slowModeAuthorizedMoneyLimit;
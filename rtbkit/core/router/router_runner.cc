@@ -64,7 +64,8 @@ RouterRunner() :
     analyticsPublisherOn(false),
     analyticsPublisherConnections(1),
     augmentationWindowms(5),
-    dableSlowMode(false)
+    dableSlowMode(false),
+    numAuctionShards(1)
 {
 }
 
@@ -109,6 +110,8 @@ doOptions(int argc, char ** argv,
          "Send data to analyticsPublisher logger.")
         ("analyticsPublisher-connections", value<int>(&analyticsPublisherConnections),
          "Number of connections for the analytics publisher.")
+        ("analyticsPublisher-compression", value<string>(&analyticsPublisherCompression),
+         "Compression of the events sent by the analytics publisher (none or gzip).")
         ("local-banker", value<string>(&localBankerUri),
          "address of where the local banker can be found.")
         ("local-banker-debug", bool_switch(&localBankerDebug),
@@ -118,7 +121,9 @@ doOptions(int argc, char ** argv,
          ("augmenter-timeout",value<int>(&augmentationWindowms),
          "configure the augmenter  timeout (in milliseconds)")
         ("no slow mode", value<bool>(&dableSlowMode)->zero_tokens(),
-         "disable the slow mode.");
+         "disable the slow mode.")
+        ("auction-shards", value<int>(&numAuctionShards),
+         "number of threads the auctions are sharded over");
 
     options_description all_opt = opts;
     all_opt
@@ -183,6 +188,7 @@ init()
                                       USD_CPM(maxBidPrice),
                                       slowModeTimeout, amountSlowModeMoneyLimit, augmentationWindow);
     router->slowModeTolerance = slowModeTolerance;
+    router->setNumAuctionShards(numAuctionShards);
     router->initBidderInterface(bidderConfig);
     if (dableSlowMode) {
        router->unsafeDisableSlowMode();
@@ -190,7 +196,8 @@ init()
     if (analyticsPublisherOn) {
         const auto & analyticsPublisherUri = proxies->params["analytics-uri"].asString();
         if (!analyticsPublisherUri.empty()) {
-            router->initAnalyticsPublisher(analyticsPublisherUri, analyticsPublisherConnections);
+            router->initAnalyticsPublisher(analyticsPublisherUri, analyticsPublisherConnections,
+                    analyticsPublisherCompression);
         }
         else
             LOG(print) << "analyticsPublisher-uri is not in the config" << endl;
@@ -54,8 +54,10 @@ struct RouterRunner {
     std::string slowModeMoneyLimit;
     bool analyticsPublisherOn;
     int analyticsPublisherConnections;
+    std::string analyticsPublisherCompression;
     int augmentationWindowms;
     bool dableSlowMode;
+    int numAuctionShards;
 
     void doOptions(int argc, char ** argv,
                    const boost::program_options::options_description & opts
@@ -8,6 +8,10 @@
 #include "router_types.h"
 #include "rtbkit/core/agent_configuration/agent_config.h"
 #include "jml/db/persistent.h"
+#include "jml/arch/atomic_ops.h"
+#include "jml/utils/hash_specializations.h"
+#include <mutex>
+#include <sstream>
 
 using namespace std;
 using namespace ML;
@@ -131,16 +135,238 @@ const std::string &
 AgentInfo::
 getBidRequestEncoding(const Auction & auction) const
 {
-    return auction.requestStrFormat;
+    static const std::string normalized = "rtbkit";
+    static const std::string binary = "rtbkitBinary";
+
+    switch (bidRequestFormat) {
+    case BRF_JSON_RAW:  return auction.requestStrFormat;
+    case BRF_JSON_NORM: return normalized;
+    case BRF_BINARY_V1: return binary;
+    }
+
+    throw ML::Exception("unknown bid request format %d", bidRequestFormat);
+}
+
+const std::string &
+AgentInfo::
+encodeBidRequest(AuctionEncodings & encodings) const
+{
+    switch (bidRequestFormat) {
+    case BRF_JSON_RAW:  return encodings.auction.requestStr;
+    case BRF_JSON_NORM: return encodings.normalizedRequest();
+    case BRF_BINARY_V1: return encodings.binaryRequest();
+    }
+
+    throw ML::Exception("unknown bid request format %d", bidRequestFormat);
 }
 
 void
 AgentInfo::
 setBidRequestFormat(const std::string & val)
 {
-    // TODO
+    if (val.empty() || val == "jsonRaw")
+        bidRequestFormat = BRF_JSON_RAW;
+    else if (val == "jsonNorm")
+        bidRequestFormat = BRF_JSON_NORM;
+    else if (val == "binary")
+        bidRequestFormat = BRF_BINARY_V1;
+    else throw ML::Exception("unknown bid request format '%s'", val.c_str());
+}
+
+
+/*****************************************************************************/
+/* AUCTION ENCODINGS                                                         */
+/*****************************************************************************/
+
+AuctionEncodings::
+AuctionEncodings(const Auction & auction, double timeLeftMs)
+    : auction(auction), timeLeftMs(std::to_string(timeLeftMs))
+{
+}
+
+const std::string &
+AuctionEncodings::
+normalizedRequest()
+{
+    if (normalized.empty())
+        normalized = auction.request->toJsonStr();
+    return normalized;
 }
 
+const std::string &
+AuctionEncodings::
+binaryRequest()
+{
+    if (binary.empty()) {
+        std::ostringstream stream;
+        DB::Store_Writer store(stream);
+        auction.request->serializeFields(store, BRF_ALL);
+        binary = stream.str();
+    }
+    return binary;
+}
+
+const std::string &
+AuctionEncodings::
+spots(const BiddableSpots & spots, bool binary)
+{
+    auto & cache = spotsCache[binary];
+    auto it = cache.find(spots);
+    if (it != cache.end())
+        return it->second;
+
+    std::string encoded;
+    if (binary) {
+        std::ostringstream stream;
+        DB::Store_Writer store(stream);
+        spots.serialize(store);
+        encoded = stream.str();
+    }
+    else encoded = spots.toJsonStr();
+
+    return cache.emplace(spots, std::move(encoded)).first->second;
+}
+
+size_t
+AuctionEncodings::SpotsHash::
+operator () (const BiddableSpots & spots) const
+{
+    size_t result = spots.size();
+    for (auto & spot: spots) {
+        result = ML::chain_hash(spot.first, result);
+        for (auto creative: spot.second)
+            result = ML::chain_hash(creative, result);
+    }
+    return result;
+}
+
+const std::string &
+AuctionEncodings::
+winCostModel(const WinCostModel & wcm, bool binary)
+{
+    auto & cache = wcmCache[binary];
+    for (auto & entry: cache)
+        if (entry.first.name == wcm.name && entry.first.data == wcm.data)
+            return entry.second;
+
+    std::string encoded;
+    if (binary) {
+        std::ostringstream stream;
+        DB::Store_Writer store(stream);
+        wcm.serialize(store);
+        encoded = stream.str();
+    }
+    else encoded = wcm.toJson().toStringNoNewLine();
+
+    cache.emplace_back(wcm, std::move(encoded));
+    return cache.back().second;
+}
+
+
+/*****************************************************************************/
+/* ACCOUNT EVENTS                                                            */
+/*****************************************************************************/
+
+const char *
+print(InvalidBidReason reason)
+{
+    switch (reason) {
+    case IBR_BID_PARSE_ERROR:                   return "bidParseError";
+    case IBR_NULL_CREATIVE_FIELD:               return "nullCreativeField";
+    case IBR_OUT_OF_RANGE_CREATIVE:             return "outOfRangeCreative";
+    case IBR_INVALID_PRICE:                     return "invalidPrice";
+    case IBR_NO_BID:                            return "noBid";
+    case IBR_CREATIVE_NOT_COMPATIBLE_WITH_SPOT:
+        return "creativeNotCompatibleWithSpot";
+    case IBR_CREATIVE_NOT_BIDDABLE_ON_EXCHANGE:
+        return "creativeNotBiddableOnExchange";
+    default:
+        throw ML::Exception("unknown invalid bid reason %d", (int)reason);
+    }
+}
+
+BidErrorEvents::
+BidErrorEvents(const EventRecorder & recorder, const std::string & prefix)
+{
+    for (int i = 0;  i < IBR_NUM_REASONS;  ++i) {
+        auto reason = (InvalidBidReason)i;
+        handles[i] = recorder.counterHandle(prefix + "bidErrors."
+                                            + print(reason));
+    }
+}
+
+AccountEvents::
+AccountEvents(const EventRecorder & recorder,
+              const AgentConfig & config)
+{
+    string prefix = "accounts." + config.account.toString('.') + ".";
+
+    bids = recorder.counterHandle(prefix + "bids");
+    submitted = recorder.counterHandle(prefix + "submitted");
+    ignored = recorder.counterHandle(prefix + "IGNORED");
+    noBudget = recorder.counterHandle(prefix + "NOBUDGET");
+    localLoss = recorder.counterHandle(prefix + "LOCAL_LOSS");
+    tooLate = recorder.counterHandle(prefix + "TOOLATE");
+    invalid = recorder.counterHandle(prefix + "INVALID");
+    finishTooLate = recorder.counterHandle(prefix + "FINISH_TOOLATE");
+    expired = recorder.counterHandle(prefix + "EXPIRED");
+    lostBids = recorder.counterHandle(prefix + "lostBids");
+    bidErrors = recorder.counterHandle(prefix + "bidErrors.total");
+    bidErrorsByReason = BidErrorEvents(recorder, prefix);
+    bidResponseTimeMs = recorder.outcomeHandle(prefix + "bidResponseTimeMs");
+
+    numInFlight = recorder.levelHandle(prefix + "inFlight.numInFlight");
+    oldestInFlightAge
+        = recorder.levelHandle(prefix + "inFlight.oldestAgeSeconds");
+    averageInFlightAge
+        = recorder.levelHandle(prefix + "inFlight.averageAgeSeconds");
+    timeSinceHeartbeat = recorder.levelHandle(prefix + "timeSinceHeartbeat");
+
+    string filterPrefix = prefix + "filter.";
+    auto filterCounter = [&] (const std::string & name)
+        {
+            return recorder.counterHandle(filterPrefix + name);
+        };
+    auto filterOutcome = [&] (const std::string & name)
+        {
+            return recorder.outcomeHandle(filterPrefix + name);
+        };
+
+    filter.intoStaticFilters = filterCounter("intoStaticFilters");
+    filter.agentAppearsDead = filterCounter("static.agentAppearsDead");
+    filter.earlyTooManyInFlight = filterCounter("static.earlyTooManyInFlight");
+    filter.staticNotEnoughTime = filterCounter("static.notEnoughTime");
+    filter.passedStaticFilters = filterCounter("passedStaticFilters");
+
+    filter.intoDynamicFilters = filterCounter("intoDynamicFilters");
+    filter.tooManyInFlight = filterCounter("dynamic.tooManyInFlight");
+    filter.dynamicNotEnoughTime = filterCounter("dynamic.notEnoughTime");
+    filter.userBlacklisted = filterCounter("dynamic.userBlacklisted");
+    filter.passedDynamicFilters = filterCounter("passedDynamicFilters");
+
+    filter.timeUsedBeforeDynamicFilter
+        = filterOutcome("metric.timeUsedBeforeDynamicFilter");
+    filter.timeLeftBeforeDynamicFilter
+        = filterOutcome("metric.timeLeftBeforeDynamicFilter");
+    filter.timeElapsedBeforePreproMs
+        = filterOutcome("metric.timeElapsedBeforePreproMs");
+    filter.timeElapsedDuringPreproMs
+        = filterOutcome("metric.timeElapsedDuringPreproMs");
+    filter.timeWindowMs = filterOutcome("metric.timeWindowMs");
+
+    for (const auto & augConfig: config.augmentations) {
+        filter.augmentationMissing.push_back(
+                filterCounter("dynamic." + augConfig.name + ".missing"));
+        filter.augmentationTags.push_back(
+                filterCounter("dynamic." + augConfig.name + ".tags"));
+    }
+}
+
+
+/*****************************************************************************/
+/* AGENT STATS                                                               */
+/*****************************************************************************/
+
 AgentStats::
 AgentStats()
     : auctions(0), bids(0), wins(0), losses(0), tooLate(0),
@@ -166,10 +392,22 @@ AgentStats()
 {
 }
 
+void
+AgentStats::
+addBid(const Amount & price)
+{
+    ML::atomic_inc(bids);
+
+    std::lock_guard<ML::Spinlock> guard(totalsLock);
+    totalBid += price;
+}
+
 Json::Value
 AgentStats::
 toJson() const
 {
+    std::lock_guard<ML::Spinlock> guard(totalsLock);
+
     Json::Value result;
     result["auctions"] = auctions;
     result["bids"] = bids;
@@ -253,6 +491,19 @@ toJson() const
     return result;
 }
 
+void
+BiddableSpots::
+serialize(ML::DB::Store_Writer & store) const
+{
+    store << DB::compact_size_t(size());
+    for (auto & spot: *this) {
+        store << DB::compact_size_t(spot.first)
+              << DB::compact_size_t(spot.second.size());
+        for (auto creative: spot.second)
+            store << DB::compact_size_t(creative);
+    }
+}
+
 std::string
 BiddableSpots::
 toJsonStr() const
@@ -11,9 +11,14 @@
 #include "rtbkit/common/bid_request.h"
 #include "rtbkit/common/auction.h"
 #include "jml/stats/distribution.h"
+#include <deque>
 #include <set>
+#include <unordered_map>
 #include "rtbkit/common/currency.h"
 #include "rtbkit/common/bids.h"
+#include "rtbkit/common/win_cost_model.h"
+#include "soa/service/service_base.h"
+#include "jml/arch/spinlock.h"
 
 
 namespace RTBKIT {
@@ -35,8 +40,14 @@ BiddableSpotsBase;
 struct BiddableSpots : public BiddableSpotsBase {
     Json::Value toJson() const;
     std::string toJsonStr() const;
+
+    /** Binary version of toJsonStr(), read by Bids::reconstituteAvailable().
+    */
+    void serialize(ML::DB::Store_Writer & store) const;
 };
 
+struct AuctionEncodings;
+
 struct AgentStats {
 
     AgentStats();
@@ -89,6 +100,108 @@ struct AgentStats {
 
     uint64_t requiredAugmentorIsMissing;
     uint64_t augmentorValueIsNull;
+
+    /** Record a bid.  Can be called from several router shards at once. */
+    void addBid(const Amount & price);
+
+private:
+    mutable ML::Spinlock totalsLock;
+};
+
+
+/*****************************************************************************/
+/* ACCOUNT EVENTS                                                            */
+/*****************************************************************************/
+
+/** Reasons for which the router rejects a bid from an agent.  Each one has
+    its own bidErrors.<reason> event.
+*/
+enum InvalidBidReason {
+    IBR_BID_PARSE_ERROR,
+    IBR_NULL_CREATIVE_FIELD,
+    IBR_OUT_OF_RANGE_CREATIVE,
+    IBR_INVALID_PRICE,
+    IBR_NO_BID,
+    IBR_CREATIVE_NOT_COMPATIBLE_WITH_SPOT,
+    IBR_CREATIVE_NOT_BIDDABLE_ON_EXCHANGE,
+    IBR_NUM_REASONS
+};
+
+/** Name of the reason as it appears in the event names. */
+const char * print(InvalidBidReason reason);
+
+/** Handles to the <prefix>bidErrors.<reason> events, one per reason. */
+struct BidErrorEvents {
+    BidErrorEvents()
+    {
+    }
+
+    BidErrorEvents(const EventRecorder & recorder,
+                   const std::string & prefix);
+
+    const CounterHandle & operator [] (InvalidBidReason reason) const
+    {
+        return handles[reason];
+    }
+
+    CounterHandle handles[IBR_NUM_REASONS];
+};
+
+/** Handles to the accounts.<account>.* events that the router records for
+    an agent, registered when its configuration comes in so that the account
+    doesn't need to be formatted into the event name on every bid.
+*/
+struct AccountEvents {
+    AccountEvents()
+    {
+    }
+
+    AccountEvents(const EventRecorder & recorder,
+                  const AgentConfig & config);
+
+    CounterHandle bids;
+    CounterHandle submitted;
+    CounterHandle ignored;
+    CounterHandle noBudget;
+    CounterHandle localLoss;
+    CounterHandle tooLate;
+    CounterHandle invalid;
+    CounterHandle finishTooLate;
+    CounterHandle expired;
+    CounterHandle lostBids;
+    CounterHandle bidErrors;
+    BidErrorEvents bidErrorsByReason;
+    OutcomeHandle bidResponseTimeMs;
+
+    LevelHandle numInFlight;
+    LevelHandle oldestInFlightAge;
+    LevelHandle averageInFlightAge;
+    LevelHandle timeSinceHeartbeat;
+
+    /** Filters are only traced for a sample of the auctions. */
+    struct FilterEvents {
+        CounterHandle intoStaticFilters;
+        CounterHandle agentAppearsDead;
+        CounterHandle earlyTooManyInFlight;
+        CounterHandle staticNotEnoughTime;
+        CounterHandle passedStaticFilters;
+
+        CounterHandle intoDynamicFilters;
+        CounterHandle tooManyInFlight;
+        CounterHandle dynamicNotEnoughTime;
+        CounterHandle userBlacklisted;
+        CounterHandle passedDynamicFilters;
+
+        OutcomeHandle timeUsedBeforeDynamicFilter;
+        OutcomeHandle timeLeftBeforeDynamicFilter;
+        OutcomeHandle timeElapsedBeforePreproMs;
+        OutcomeHandle timeElapsedDuringPreproMs;
+        OutcomeHandle timeWindowMs;
+
+        /// Indexed like the augmentations of the agent's configuration
+        std::vector<CounterHandle> augmentationMissing;
+        std::vector<CounterHandle> augmentationTags;
+    } filter;
 };
 
 
@@ -111,6 +224,7 @@ struct AgentInfo {
           configured(false),
           status(new AgentStatus()),
           stats(new AgentStats()),
+          events(new AccountEvents()),
           throttleProbability(1.0)
     {
     }
@@ -126,6 +240,7 @@ struct AgentInfo {
     std::shared_ptr<AgentConfig> config;
     std::shared_ptr<AgentStatus> status;
     std::shared_ptr<AgentStats> stats;
+    std::shared_ptr<const AccountEvents> events;
     double throttleProbability;
 
     /** Address of the zeromq socket for this agent. */
@@ -139,7 +254,14 @@ struct AgentInfo {
     const std::string & encodeBidRequest(const Auction & auction) const;
     const std::string & getBidRequestEncoding(const Auction & auction) const;
 
-    /** Set the bid request format. */
+    /** Same as above, but shares the encoding with the other agents the
+        auction is sent to.
+    */
+    const std::string & encodeBidRequest(AuctionEncodings & encodings) const;
+
+    /** Set the bid request format from the name given in the agent's
+        configuration: jsonRaw (or empty), jsonNorm or binary.
+    */
     void setBidRequestFormat(const std::string & val);
 
     /** Structure in which we record the information on ping timings. */
@@ -195,41 +317,49 @@ struct AgentInfo {
         status->dead = false;
     }
 
-    template<typename Fn>
-    void forEachInFlight(const Fn & fn) const
-    {
-        for (auto it = bidsInFlight.begin(), end = bidsInFlight.end();
-             it != end;  ++it) {
-            fn(it->first, it->second);
-        }
-    }
-
+    /** The auctions themselves are tracked by the router shard that owns
+        them; see Router::AuctionShard::bidsInFlight.
+    */
     size_t numBidsInFlight() const
     {
-        // DEBUG
-        if (status->numBidsInFlight != bidsInFlight.size())
-            throw ML::Exception("numBidsInFlight is wrong");
         return status->numBidsInFlight;
     }
-    
-    bool expireBidInFlight(const Id & id)
-    {
-        bool result = bidsInFlight.erase(id);
-        status->numBidsInFlight = bidsInFlight.size();
-        return result;
-    }
+};
 
-    // Returns true if it was successfully inserted
-    bool trackBidInFlight(const Id & id, Date date = Date::now())
-    {
-        bool result = bidsInFlight.insert(std::make_pair(id, date)).second;
-        status->numBidsInFlight = bidsInFlight.size();
-        return result;
-    }
+
+/*****************************************************************************/
+/* AUCTION ENCODINGS                                                         */
+/*****************************************************************************/
+
+/** The parts of the AUCTION message that are the same for every agent an
+    auction is sent to.  Each one is encoded the first time an agent needs
+    it and the buffer is reused for the others.  Meant to live on the stack
+    of the thread that does the fan-out.
+*/
+struct AuctionEncodings {
+    AuctionEncodings(const Auction & auction, double timeLeftMs);
+
+    const Auction & auction;
+    const std::string timeLeftMs;
+
+    /** Normalized JSON and binary encodings of the bid request. */
+    const std::string & normalizedRequest();
+    const std::string & binaryRequest();
+
+    /** Encodings of the spots and win cost model of an agent.  Agents
+        with the same ones share the buffer.
+    */
+    const std::string & spots(const BiddableSpots & spots, bool binary);
+    const std::string & winCostModel(const WinCostModel & wcm, bool binary);
 
 private:
-    std::map<Id, Date> bidsInFlight;  /// Auctions in which we're participating
-    //std::set<std::pair<Id, Id> > awaitingResult;  ///< Auctions which are awaiting a win/loss result
+    struct SpotsHash {
+        size_t operator () (const BiddableSpots & spots) const;
+    };
+
+    std::string normalized, binary;
+    std::unordered_map<BiddableSpots, std::string, SpotsHash> spotsCache[2];
+    std::deque<std::pair<WinCostModel, std::string> > wcmCache[2];
 };
 
 /** Information about one of the agents in a round robin group. */
@@ -244,6 +374,7 @@ struct PotentialBidder {
     BiddableSpots imp;
     std::shared_ptr<const AgentConfig> config;
     std::shared_ptr<AgentStats> stats;
+    std::shared_ptr<const AccountEvents> events;
 
     bool operator < (const PotentialBidder & other) const
     {
@@ -0,0 +1,118 @@
+/* auction_encodings_test.cc
+   Copyright (c) 2014 Datacratic.  All rights reserved.
+
+   Tests for the encodings shared by the agents an auction is sent to.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "rtbkit/core/router/router_types.h"
+#include "jml/db/persistent.h"
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace ML;
+using namespace Datacratic;
+using namespace RTBKIT;
+
+namespace {
+
+BiddableSpots makeSpots(int spot, std::initializer_list<int> creatives)
+{
+    BiddableSpots result;
+    SmallIntVector indexes;
+    for (int c: creatives)
+        indexes.push_back(c);
+    result.push_back(make_pair(spot, indexes));
+    return result;
+}
+
+} // file scope
+
+BOOST_AUTO_TEST_CASE( test_biddable_spots_binary )
+{
+    BiddableSpots spots = makeSpots(0, { 1, 3 });
+    spots.push_back(make_pair(2, SmallIntVector()));
+
+    ostringstream stream;
+    {
+        DB::Store_Writer store(stream);
+        spots.serialize(store);
+    }
+    string str = stream.str();
+    DB::Store_Reader store(str.c_str(), str.size());
+
+    Bids bids = Bids::reconstituteAvailable(store);
+    BOOST_REQUIRE_EQUAL(bids.size(), 2);
+    BOOST_CHECK_EQUAL(bids[0].spotIndex, 0);
+    BOOST_REQUIRE_EQUAL(bids[0].availableCreatives.size(), 2);
+    BOOST_CHECK_EQUAL(bids[0].availableCreatives[1], 3);
+    BOOST_CHECK_EQUAL(bids[1].spotIndex, 2);
+    BOOST_CHECK(bids[1].availableCreatives.empty());
+}
+
+BOOST_AUTO_TEST_CASE( test_auction_encodings_shared )
+{
+    auto request = std::make_shared<BidRequest>();
+    request->auctionId = Id("encodings");
+    request->exchange = "test";
+    request->regs.emplace();
+    request->regs->coppa.val = 1;
+    request->blockedCategories.push_back(OpenRTB::ContentCategory("IAB25"));
+    request->badv.push_back(Datacratic::UnicodeString("blocked.com"));
+
+    Auction auction;
+    auction.id = request->auctionId;
+    auction.request = request;
+    auction.requestStr = "{\"id\":\"encodings\"}";
+    auction.requestStrFormat = "rtbkit";
+
+    AuctionEncodings encodings(auction, 12.5);
+    BOOST_CHECK_EQUAL(encodings.timeLeftMs, std::to_string(12.5));
+
+    /* the request is only encoded once */
+    const string & binary = encodings.binaryRequest();
+    BOOST_CHECK_EQUAL(&binary, &encodings.binaryRequest());
+    DB::Store_Reader store(binary.c_str(), binary.size());
+    BidRequest decoded;
+    decoded.reconstituteFields(store);
+    BOOST_CHECK_EQUAL(decoded.auctionId, request->auctionId);
+    BOOST_CHECK_EQUAL(decoded.exchange, "test");
+    BOOST_REQUIRE(decoded.regs);
+    BOOST_CHECK_EQUAL(decoded.regs->coppa.val, 1);
+    BOOST_REQUIRE_EQUAL(decoded.blockedCategories.size(), 1);
+    BOOST_CHECK_EQUAL(decoded.blockedCategories[0].val, "IAB25");
+    BOOST_REQUIRE_EQUAL(decoded.badv.size(), 1);
+    BOOST_CHECK_EQUAL(decoded.badv[0], request->badv[0]);
+
+    /* agents with the same spots share a buffer, others don't */
+    const string & s1 = encodings.spots(makeSpots(0, { 1 }), false);
+    const string & s2 = encodings.spots(makeSpots(0, { 1 }), false);
+    const string & s3 = encodings.spots(makeSpots(0, { 2 }), false);
+    BOOST_CHECK_EQUAL(&s1, &s2);
+    BOOST_CHECK_NE(&s1, &s3);
+    BOOST_CHECK_EQUAL(s1, makeSpots(0, { 1 }).toJsonStr());
+    BOOST_CHECK_NE(&s1, &encodings.spots(makeSpots(0, { 1 }), true));
+
+    /* spots that differ only by spot index or creative count don't collide */
+    BiddableSpots twoSpots = makeSpots(0, { 1 });
+    twoSpots.push_back(make_pair(1, SmallIntVector()));
+    const string & s4 = encodings.spots(twoSpots, false);
+    BOOST_CHECK_NE(&s4, &s1);
+    BOOST_CHECK_NE(&s4, &encodings.spots(makeSpots(1, { 1 }), false));
+    BOOST_CHECK_EQUAL(&s4, &encodings.spots(twoSpots, false));
+
+    const string & w1 = encodings.winCostModel(WinCostModel(), false);
+    BOOST_CHECK_EQUAL(&w1, &encodings.winCostModel(WinCostModel(), false));
+    BOOST_CHECK_EQUAL(w1, WinCostModel().toJson().toStringNoNewLine());
+
+    /* the formats pick the matching encoding */
+    AgentInfo info;
+    BOOST_CHECK_EQUAL(&info.encodeBidRequest(encodings), &auction.requestStr);
+    BOOST_CHECK_EQUAL(info.getBidRequestEncoding(auction), "rtbkit");
+    info.setBidRequestFormat("binary");
+    BOOST_CHECK_EQUAL(&info.encodeBidRequest(encodings), &binary);
+    BOOST_CHECK_EQUAL(info.getBidRequestEncoding(auction), "rtbkitBinary");
+    BOOST_CHECK_THROW(info.setBidRequestFormat("xml"), ML::Exception);
+}
@@ -1364,7 +1364,15 @@ struct User {
     within bidders.
 */
 struct Impression {
+    // Spelled out because the out-of-line destructor would otherwise
+    // suppress the implicit move operations.
+    Impression() = default;
+    Impression(const Impression &) = default;
+    Impression(Impression &&) = default;
+    Impression & operator = (const Impression &) = default;
+    Impression & operator = (Impression &&) = default;
     ~Impression();
+
     Datacratic::Id id;                             ///< Impression ID within BR
     Datacratic::List<Metric> metric;
     Datacratic::Optional<Audio> audio;
@@ -1405,7 +1413,13 @@ struct Impression {
 */
 
 struct BidRequest {
+    BidRequest() = default;
+    BidRequest(const BidRequest &) = default;
+    BidRequest(BidRequest &&) = default;
+    BidRequest & operator = (const BidRequest &) = default;
+    BidRequest & operator = (BidRequest &&) = default;
     ~BidRequest();
+
     Datacratic::Id id;                             ///< Bid request ID
     std::vector<Impression> imp;            ///< List of impressions
     //unique_ptr<Context> context;     // TODO: factor out of site and app
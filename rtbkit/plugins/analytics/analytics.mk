@@ -1,6 +1,6 @@
 # analytics makefile
 
-$(eval $(call library,analytics_endpoint,analytics_endpoint.cc,services))
+$(eval $(call library,analytics_endpoint,analytics_endpoint.cc,services boost_iostreams))
 $(eval $(call program,analytics_runner,analytics_endpoint boost_program_options))
 
 $(eval $(call library,zmq_analytics,zmq_analytics.cc,zmq services rtb_router))
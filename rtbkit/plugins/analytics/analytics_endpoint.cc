@@ -14,6 +14,9 @@
 #include "soa/service/rest_request_binding.h"
 #include "soa/jsoncpp/reader.h"
 #include "jml/arch/timers.h"
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
 
 using namespace std;
 using namespace Datacratic;
@@ -80,6 +83,26 @@ init()
                     JsonParam<string>("event", "event to publish")
             );
 
+    RestRequestRouter::OnProcessRequest eventsRoute
+        = [=] (const RestServiceEndpoint::ConnectionId & connection,
+                const RestRequest & request,
+                const RestRequestParsingContext & context) {
+            try {
+                int numAdded = addEvents(request.payload,
+                        request.header.tryGetHeader("content-encoding"));
+                connection.sendResponse(200, to_string(numAdded));
+            } catch (const std::exception & exc) {
+                connection.sendErrorResponse(400, exc.what());
+            }
+            return RestRequestRouter::MR_YES;
+        };
+
+    versionNode.addRoute("/events", { "POST", "PUT" },
+            "Add a batch of events to the logs, given as an array of "
+            "{ channel, event } objects.  The body can be compressed with "
+            "gzip, in which case Content-Encoding must say so.",
+            eventsRoute, Json::Value());
+
     addRouteSyncReturn(versionNode,
                     "/channels",
                     {"GET"},
@@ -165,6 +188,41 @@ addEvent(const string & channel, const string & event) const
     return print(channel, event);
 }
 
+int
+AnalyticsRestEndpoint::
+addEvents(const string & payload, const string & encoding) const
+{
+    string body;
+    if (encoding == "gzip") {
+        namespace io = boost::iostreams;
+        io::filtering_ostream stream;
+        stream.push(io::gzip_decompressor());
+        stream.push(io::back_inserter(body));
+        stream.write(payload.data(), payload.size());
+        stream.reset();
+    }
+    else if (encoding.empty() || encoding == "identity")
+        body = payload;
+    else throw ML::Exception("unknown content encoding " + encoding);
+
+    Json::Value events = Json::parse(body);
+    if (!events.isArray())
+        throw ML::Exception("expected an array of events");
+
+    int numAdded = 0;
+    boost::shared_lock<boost::shared_mutex> lock(access);
+    for (const auto & event : events) {
+        const string & channel = event["channel"].asString();
+        auto it = channelFilter.find(channel);
+        if (it == channelFilter.end() || !it->second)
+            continue;
+
+        print(channel, event["event"].asString());
+        ++numAdded;
+    }
+    return numAdded;
+}
+
 Json::Value
 AnalyticsRestEndpoint::
 listChannels() const
@@ -54,6 +54,12 @@ private:
     std::string addEvent(const std::string & channel,
                          const std::string & event) const;
 
+    /** Add a batch of events sent by an AnalyticsPublisher.  Returns the
+        number of events that were on an enabled channel.
+    */
+    int addEvents(const std::string & payload,
+                  const std::string & encoding) const;
+
     std::string print(const std::string & channel,
                       const std::string & event) const;
 
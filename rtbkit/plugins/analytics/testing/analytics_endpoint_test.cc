@@ -9,6 +9,7 @@
 
 #include <boost/test/unit_test.hpp>
 #include "jml/arch/timers.h"
+#include <thread>
 
 #include "rtbkit/plugins/analytics/analytics_endpoint.h"
 #include "rtbkit/common/analytics_publisher.h"
@@ -109,3 +110,64 @@ BOOST_AUTO_TEST_CASE( analytics_filter_sync_test )
     analyticsEndpoint->shutdown();
 
 }
+
+BOOST_AUTO_TEST_CASE( analytics_batch_test )
+{
+    // Events published from a few threads are batched and every one of them
+    // is either sent or accounted for as dropped.
+
+    shared_ptr<AnalyticsRestEndpoint> analyticsEndpoint;
+    setUpEndpoint(analyticsEndpoint);
+
+    {
+        AnalyticsPublisher badClient;
+        BOOST_CHECK_THROW(badClient.init("http://127.0.0.1:40000", 1, "lzma"),
+                          ML::Exception);
+    }
+
+    // "gz" has to go out as Content-Encoding: gzip for the endpoint to take it
+    for (string compression: { "", "gzip", "gz" }) {
+        auto analyticsClient = make_shared<AnalyticsPublisher> ();
+        analyticsClient->init("http://127.0.0.1:40000", 1, compression, 64);
+        analyticsClient->start();
+
+        analyticsEndpoint->enableChannel("Batch");
+
+        ML::sleep(2.0);
+
+        analyticsClient->syncChannelFilters();
+
+        ML::sleep(0.5);
+
+        BOOST_REQUIRE(analyticsClient->isEnabled("Batch"));
+        BOOST_CHECK(!analyticsClient->isEnabled("Disabled"));
+
+        int numThreads = 4, numEvents = 1000;
+        vector<thread> threads;
+        for (int i = 0;  i < numThreads;  ++i) {
+            threads.emplace_back([&, i] () {
+                    for (int j = 0;  j < numEvents;  ++j) {
+                        analyticsClient->publish("Batch", "thread", i, "event", j, 0.5);
+                        analyticsClient->publish("Disabled", "ignored");
+                    }
+                });
+        }
+        for (auto & t: threads)
+            t.join();
+
+        analyticsClient->flush();
+        ML::sleep(1.0);
+
+        auto stats = analyticsClient->stats();
+        cerr << "compression '" << compression << "': queued " << stats.queued
+             << " sent " << stats.sent << " dropped " << stats.dropped << endl;
+
+        BOOST_CHECK_LE(stats.queued, numThreads * numEvents);
+        BOOST_CHECK_EQUAL(stats.sent + stats.dropped, numThreads * numEvents);
+        BOOST_CHECK_GT(stats.sent, 0);
+
+        analyticsClient->shutdown();
+    }
+
+    analyticsEndpoint->shutdown();
+}
@@ -36,6 +36,7 @@ Augmentor(const std::string & augmentorName,
           std::shared_ptr<ServiceProxies> proxies)
     : ServiceBase(serviceName, proxies),
       augmentorName(augmentorName),
+      requestFields(0),
       toRouters(getZmqContext()),
       responseQueue(QueueSize),
       requestQueue(QueueSize),
@@ -50,6 +51,7 @@ Augmentor(const std::string & augmentorName,
           ServiceBase& parent)
     : ServiceBase(serviceName, parent),
       augmentorName(augmentorName),
+      requestFields(0),
       toRouters(getZmqContext()),
       responseQueue(QueueSize),
       requestQueue(QueueSize),
@@ -91,7 +93,12 @@ init(int numThreads)
 
     toRouters.connectHandler = [=] (const std::string & newRouter)
         {
-            toRouters.sendMessage(newRouter, "CONFIG", "1.0", augmentorName);
+            // Only the augmentors that asked for it get the binary format;
+            // the others may rely on the original request string.
+            if (requestFields)
+                toRouters.sendMessage(newRouter, "CONFIG", "2.0", augmentorName,
+                                      "-1", printBidRequestFields(requestFields));
+            else toRouters.sendMessage(newRouter, "CONFIG", "1.0", augmentorName);
             recordHit("messages.CONFIG");
         };
 
@@ -156,16 +163,23 @@ Augmentor::
 parseMessage(AugmentationRequest& request, Message& message)
 {
     const string & version = message.second.at(1);
-    ExcCheckEqual(version, "1.0", "unexpected version in augment");
+    ExcCheck(version == "1.0" || version == "2.0",
+             "unexpected version in augment");
 
     request.router = message.first;
     request.timeAvailableMs = 0.05;
     request.augmentor = std::move(message.second.at(2));
     request.id = Id(std::move(message.second.at(3)));
 
-    const string & brSource = std::move(message.second.at(4));
-    const string & brStr = std::move(message.second.at(5));
-    request.bidRequest.reset(BidRequest::parse(brSource, brStr));
+    const string & brSource = message.second.at(4);
+    const string & brStr = message.second.at(5);
+    if (version == "2.0") {
+        // Already parsed by the router; no need to go through the parser.
+        ML::DB::Store_Reader reader(brStr.c_str(), brStr.size());
+        request.bidRequest = std::make_shared<BidRequest>();
+        request.bidRequest->reconstituteFields(reader);
+    }
+    else request.bidRequest.reset(BidRequest::parse(brSource, brStr));
 
     istringstream agentsStr(message.second.at(6));
     ML::DB::Store_Reader reader(agentsStr);
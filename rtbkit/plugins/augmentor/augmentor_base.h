@@ -80,6 +80,14 @@ struct Augmentor : public ServiceBase, public MessageLoop {
     void respond(const AugmentationRequest & request,
                  const AugmentationList & response);
 
+    /** Opt in to protocol 2.0: the routers send the bid request already
+        parsed, restricted to the given BidRequestFields (BRF_ALL for all
+        of them) with the others left at their defaults.  Without it the
+        augmentor gets the original request string.  Must be called before
+        init().
+    */
+    void setRequestFields(uint32_t fields) { requestFields = fields; }
+
     double sampleLoad() { return loopMonitor.sampleLoad().load; }
     double shedProbability() { return loadStabilizer.shedProbability(); }
 
@@ -91,6 +99,7 @@ protected:
 
 private:
     std::string augmentorName; // This can differ from the servicenName!
+    uint32_t requestFields;
 
     ZmqMultipleNamedClientBusProxy toRouters;
 
@@ -418,7 +418,7 @@ OpenRtbBidRequestParser::
 parseBidRequest(const std::string & jsonValue)
 {
     const char * strStart = jsonValue.c_str();
-    StreamingJsonParsingContext jsonContext(jsonValue, strStart,
+    StreamingJsonParsingContext jsonContext("OpenRTB bid request", strStart,
                                             strStart + jsonValue.size());
 
     OpenRTB::BidRequest req;
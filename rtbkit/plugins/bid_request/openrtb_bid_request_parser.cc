@@ -122,13 +122,16 @@ OpenRTB::BidRequest
 OpenRTBBidRequestParser::
 parseBidRequest(const std::string & jsonValue)
 {
+    // Parse straight out of the caller's buffer.  Note that the first
+    // argument is only the name used in error messages; passing the
+    // request itself would copy the whole body on every call.
     const char * strStart = jsonValue.c_str();
-    StreamingJsonParsingContext jsonContext(jsonValue, strStart,
+    StreamingJsonParsingContext jsonContext("OpenRTB bid request", strStart,
                                             strStart + jsonValue.size());
 
     OpenRTB::BidRequest req;
     desc.parseJson(&req, jsonContext);
-    return std::move(req);
+    return req;
 }
 
 OpenRTB::BidRequest
@@ -139,7 +142,7 @@ parseBidRequest(ML::Parse_Context & context)
 
     OpenRTB::BidRequest req;
     desc.parseJson(&req, jsonContext);
-    return std::move(req);
+    return req;
 }
 
 RTBKIT::BidRequest *
@@ -256,7 +259,7 @@ onBidRequest(OpenRTB::BidRequest & br) {
 
     // Currencies allowed to bid
     if (!br.cur.empty()) {
-        for(auto curr : br.cur)
+        for(const auto & curr : br.cur)
             ctx.br->bidCurrency.push_back(parseCurrencyCode(curr));
     } else {
         // Assume USD
@@ -265,7 +268,8 @@ onBidRequest(OpenRTB::BidRequest & br) {
 
     // Blocked cats if any, put into restriction segment
     std::vector<string> bcats;
-    for(auto b : br.bcat)
+    bcats.reserve(br.bcat.size());
+    for(const auto & b : br.bcat)
         bcats.push_back(b.val);
 
     ctx.br->restrictions.addStrings("bcat", bcats);
@@ -273,7 +277,8 @@ onBidRequest(OpenRTB::BidRequest & br) {
 
     // Blocked advertisers, put into restrictions segment
     std::vector<string> badvs;
-    for(auto b : br.badv)
+    badvs.reserve(br.badv.size());
+    for(const auto & b : br.badv)
         badvs.push_back(b.utf8String());
 
     ctx.br->restrictions.addStrings("badv", badvs);
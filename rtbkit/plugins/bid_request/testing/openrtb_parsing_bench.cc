@@ -0,0 +1,100 @@
+/* openrtb_parsing_bench.cc
+   Copyright (c) 2014 Datacratic Inc.  All rights reserved.
+
+   Compares parsing the OpenRTB samples by way of a Json::Value tree with
+   parsing them straight out of the request buffer.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/plugins/bid_request/openrtb_bid_request_parser.h"
+#include "rtbkit/openrtb/openrtb_parsing.h"
+#include "soa/types/json_parsing.h"
+#include "jml/utils/filter_streams.h"
+#include "jml/arch/timers.h"
+
+using namespace std;
+using namespace ML;
+using namespace Datacratic;
+using namespace RTBKIT;
+
+namespace {
+
+vector<string> samples = {
+    "rtbkit/plugins/bid_request/testing/openrtb1_req.json",
+    "rtbkit/plugins/bid_request/testing/openrtb2_req.json",
+    "rtbkit/plugins/bid_request/testing/openrtb3_req.json",
+    "rtbkit/plugins/bid_request/testing/openrtb4_req.json",
+    "rtbkit/plugins/bid_request/testing/openrtb_banner.json",
+    "rtbkit/plugins/bid_request/testing/openrtb_mobile.json",
+    "rtbkit/plugins/bid_request/testing/openrtb_video.json",
+    "rtbkit/plugins/bid_request/testing/rubicon_desktop.json",
+    "rtbkit/plugins/bid_request/testing/rubicon_mobile_app.json",
+    "rtbkit/plugins/bid_request/testing/rubicon_mobile_web.json"
+};
+
+enum { Iterations = 20000 };
+
+std::string loadFile(const std::string & filename)
+{
+    ML::filter_istream stream(filename);
+
+    string result;
+
+    while (stream) {
+        string line;
+        getline(stream, line);
+        result += line + "\n";
+    }
+
+    return result;
+}
+
+template<typename Fn>
+double timeIt(const Fn & fn)
+{
+    ML::Timer timer;
+    for (unsigned i = 0;  i < Iterations;  ++i)
+        fn();
+    return timer.elapsed_wall() / Iterations * 1000000.0;
+}
+
+} // file scope
+
+BOOST_AUTO_TEST_CASE( openrtb_parsing_bench )
+{
+    static DefaultDescription<OpenRTB::BidRequest> desc;
+    auto parser = OpenRTBBidRequestParser::openRTBBidRequestParserFactory("2.2");
+
+    double totalTree = 0.0, totalStreaming = 0.0;
+
+    for (auto & filename: samples) {
+        string json = loadFile(filename);
+
+        double tree = timeIt([&] () {
+                Json::Value val = Json::parse(json);
+                StructuredJsonParsingContext context(val);
+                OpenRTB::BidRequest req;
+                desc.parseJson(&req, context);
+            });
+
+        double streaming = timeIt([&] () {
+                OpenRTB::BidRequest req = parser->parseBidRequest(json);
+            });
+
+        totalTree += tree;
+        totalStreaming += streaming;
+
+        cerr << ML::format("%-60s %8.2fus %8.2fus %6.2fx",
+                           filename.c_str(), tree, streaming,
+                           tree / streaming)
+             << endl;
+    }
+
+    cerr << ML::format("%-60s %8.2fus %8.2fus %6.2fx",
+                       "total", totalTree, totalStreaming,
+                       totalTree / totalStreaming)
+         << endl;
+}
@@ -24,23 +24,34 @@ void AgentsBidderInterface::sendAuctionMessage(std::shared_ptr<Auction> const &
                                                double timeLeftMs,
                                                std::map<std::string, BidInfo> const & bidders) {
 
+    Date start = Date::now();
+
+    // Everything but the augmentations is shared between the agents, so
+    // it's only encoded once.
+    AuctionEncodings encodings(*auction, timeLeftMs);
+
     for(auto & item : bidders) {
         auto & agent = item.first;
         auto & spots = item.second.imp;
-        auto & info = router->agents[agent];
+        auto agentIt = router->agents.find(agent);
+        if (agentIt == router->agents.end()) continue;
+        auto & info = agentIt->second;
         WinCostModel wcm = auction->exchangeConnector->getWinCostModel(*auction, *info.config);
+        bool binary = info.bidRequestFormat == AgentInfo::BRF_BINARY_V1;
 
         bridge->sendAgentMessage(agent,
                                  "AUCTION",
                                  auction->start,
                                  auction->id,
                                  info.getBidRequestEncoding(*auction),
-                                 info.encodeBidRequest(*auction),
-                                 spots.toJsonStr(),
-                                 std::to_string(timeLeftMs),
+                                 info.encodeBidRequest(encodings),
+                                 encodings.spots(spots, binary),
+                                 encodings.timeLeftMs,
                                  auction->agentAugmentations[agent],
-                                 wcm.toJson());
+                                 encodings.winCostModel(wcm, binary));
     }
+
+    recordLevel(Date::now().secondsSince(start) * 1000.0, "fanOutTimeMs");
 }
 
 
@@ -651,13 +651,12 @@ void HttpBidderInterface::injectBids(const std::string &agent, Id auctionId,
      // calling doBid from the context of an other thread (the MessageLoop worker thread).
      // Since the object that handles in flight BidRequests for an agent is not
      // thread-safe, we can not call the doBid function from an other thread.
-     // Instead, we use a queue to communicate with the router thread. We then avoid
-     // an evil race condition.
+     // Instead, we use a queue to communicate with the loop of the shard that
+     // owns the auction. We then avoid an evil race condition.
 
-     if (!router->doBidBuffer.tryPush(std::move(message))) {
-         throw ML::Exception("Main router loop can not keep up with HttpBidderInterface");
+     if (!router->pushBid(std::move(message))) {
+         throw ML::Exception("Router loop can not keep up with HttpBidderInterface");
      }
-     router->wakeupMainLoop.signal();
 }
 
 void HttpBidderInterface::submitBids(AgentBids &info) {
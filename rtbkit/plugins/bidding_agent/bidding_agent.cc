@@ -16,6 +16,7 @@
 #include "jml/arch/futex.h"
 #include "soa/service/zmq_utils.h"
 #include "soa/service/process_stats.h"
+#include "jml/db/persistent.h"
 
 #include <boost/lexical_cast.hpp>
 #include <boost/algorithm/string.hpp>
@@ -374,29 +375,47 @@ handleBidRequest(const std::string & fromRouter,
     double timestamp = boost::lexical_cast<double>(msg[1]);
     Id id(msg[2]);
 
-    string bidRequestSource = msg[3];
+    const string & bidRequestSource = msg[3];
 
-    std::shared_ptr<BidRequest> br(
-            BidRequest::parse(bidRequestSource, msg[4]));
+    std::shared_ptr<BidRequest> br;
+    Bids bids;
+    WinCostModel wcm;
 
-    Json::Value imp = jsonParse(msg[5]);
-    double timeLeftMs = boost::lexical_cast<double>(msg[6]);
-    Json::Value augmentations = jsonParse(msg[7]);
-    WinCostModel wcm = WinCostModel::fromJson(jsonParse(msg[8]));
+    // Agents configured with the binary bidRequestFormat get the request,
+    // the spots and the win cost model without any JSON.
+    if (bidRequestSource == "rtbkitBinary") {
+        br = std::make_shared<BidRequest>();
+        ML::DB::Store_Reader requestStore(msg[4].c_str(), msg[4].size());
+        br->reconstituteFields(requestStore);
 
-    Bids bids;
-    bids.reserve(imp.size());
+        ML::DB::Store_Reader spotsStore(msg[5].c_str(), msg[5].size());
+        bids = Bids::reconstituteAvailable(spotsStore);
+
+        ML::DB::Store_Reader wcmStore(msg[8].c_str(), msg[8].size());
+        wcm.reconstitute(wcmStore);
+    }
+    else {
+        br.reset(BidRequest::parse(bidRequestSource, msg[4]));
 
-    for (size_t i = 0; i < imp.size(); ++i) {
-        Bid bid;
+        Json::Value imp = jsonParse(msg[5]);
+        bids.reserve(imp.size());
 
-        bid.spotIndex = imp[i]["spot"].asInt();
-        for (const auto& creative : imp[i]["creatives"])
-            bid.availableCreatives.push_back(creative.asInt());
+        for (size_t i = 0; i < imp.size(); ++i) {
+            Bid bid;
 
-        bids.push_back(bid);
+            bid.spotIndex = imp[i]["spot"].asInt();
+            for (const auto& creative : imp[i]["creatives"])
+                bid.availableCreatives.push_back(creative.asInt());
+
+            bids.push_back(bid);
+        }
+
+        wcm = WinCostModel::fromJson(jsonParse(msg[8]));
     }
 
+    double timeLeftMs = boost::lexical_cast<double>(msg[6]);
+    Json::Value augmentations = jsonParse(msg[7]);
+
     recordHit("requests");
 
     {
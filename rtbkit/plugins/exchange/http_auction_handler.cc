@@ -139,6 +139,24 @@ HttpAuctionHandler()
     : hasTimer(false), disconnected(false), servingRequest(false)
 {
     atomic_add(created, 1);
+
+    parser.onHeader = [=] (const HttpRequestParser::Request & request) {
+        request.toHttpHeader(this->header);
+        addActivityS("header parsing OK");
+        this->readState = PAYLOAD;
+        this->handleHttpHeader(this->header);
+    };
+
+    parser.onRequest = [=] (const HttpRequestParser::Request & request) {
+        if (this->readState != PAYLOAD) {
+            doError("extra data");
+            return;
+        }
+        this->payload.assign(request.body.data, request.body.size);
+        this->readState = DONE;
+        addActivityS("got HTTP payload");
+        this->handleHttpPayload(this->header, this->payload);
+    };
 }
 
 HttpAuctionHandler::
@@ -174,6 +192,28 @@ onGotTransport()
     startReading();
 }
 
+void
+HttpAuctionHandler::
+handleData(const std::string & data)
+{
+    if (readState == HEADER && parser.buffered() == 0)
+        firstData = Date::now();
+
+    addActivity("handleData with state %d", readState);
+
+    if (readState != HEADER && readState != PAYLOAD) {
+        throw Exception("invalid read state %d handling data '%s' for %p",
+                        readState, data.c_str(), this);
+    }
+
+    try {
+        parser.feed(data.c_str(), data.size());
+    } catch (...) {
+        cerr << "problem parsing in state: " << status() << endl;
+        throw;
+    }
+}
+
 void
 HttpAuctionHandler::
 handleDisconnect()
@@ -403,13 +443,18 @@ handleHttpPayload(const HttpHeader & header,
             return;
         }
 
-        auction.reset(new Auction(endpoint,
-                                  handleAuction, bidRequest,
-                                  bidRequest->toJsonStr(),
-                                  "datacratic",
-                                  firstData, expiry));
-
-        auction->requestOriginal = payload;
+        // One allocation for the auction and its reference count
+        auction = std::make_shared<Auction>(endpoint,
+                                            handleAuction, bidRequest,
+                                            bidRequest->toJsonStr(),
+                                            "datacratic",
+                                            firstData, expiry);
+
+        // The payload we parsed ourselves isn't needed after this point so
+        // the auction can have it without a copy.
+        if (&payload == &this->payload)
+            auction->requestOriginal.swap(this->payload);
+        else auction->requestOriginal = payload;
         endpoint->adjustAuction(auction);
 
         auto postStatus = endpoint->postBidRequest(auction);
@@ -9,6 +9,7 @@
 
 #include "jml/utils/filter_streams.h"
 #include "soa/service/http_endpoint.h"
+#include "soa/service/http_parsers.h"
 #include "soa/service/stats_events.h"
 #include "rtbkit/common/auction.h"
 
@@ -71,6 +72,13 @@ struct HttpAuctionHandler
     bool disconnected;
     bool servingRequest;  ///< Are we currently, actively serving a request?
 
+    /** Parses the request in place instead of accumulating the header text
+        and the payload like HttpConnectionHandler does.
+    */
+    HttpRequestParser parser;
+
+    virtual void handleData(const std::string & data);
+
     virtual void handleHttpPayload(const HttpHeader & header,
                                    const std::string & payload);
 
@@ -19,6 +19,7 @@ namespace RTBKIT {
 struct BidStack {
     std::shared_ptr<ServiceProxies> proxies;
     bool enforceAgents;
+    size_t numAuctionShards;
 
     // components
     struct Services {
@@ -33,6 +34,7 @@ struct BidStack {
     BidStack()
      : proxies(new ServiceProxies())
      , enforceAgents(true)
+     , numAuctionShards(1)
     { }
 
     void run(Json::Value const & routerConfig,
@@ -74,6 +76,7 @@ struct BidStack {
         services.router.reset(new Router(proxies, "router"));
         services.router->unsafeDisableMonitor();
         services.router->initBidderInterface(bidderConfig);
+        services.router->setNumAuctionShards(numAuctionShards);
         services.router->init();
 
         // Set a null banker that blindly approves all bids so that we can
@@ -0,0 +1,86 @@
+/* router_shard_bench.cc
+   Copyright (c) 2014 Datacratic Inc.  All rights reserved.
+
+   Throughput of the router as its auctions are spread over more shards.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+
+#include "rtbkit/testing/bid_stack.h"
+#include "jml/arch/timers.h"
+
+using namespace std;
+using namespace ML;
+using namespace Datacratic;
+using namespace RTBKIT;
+
+
+/** Pushes the same load through a full bid stack and returns the number of
+    auctions per second that made it through the router.
+ */
+double bench(size_t numShards)
+{
+    enum { NumAgents = 8, NumThreads = 8, NumRequests = 5000 };
+
+    Json::Value routerConfig;
+    routerConfig[0]["exchangeType"] = "openrtb";
+
+    Json::Value bidderConfig;
+    bidderConfig["type"] = "agents";
+
+    BidStack stack;
+    stack.numAuctionShards = numShards;
+
+    for (size_t i = 0; i < NumAgents; ++i) {
+        auto agent = make_shared<TestAgent>(
+                stack.proxies, ML::format("agent%zd", i));
+        agent->bidWithFixedAmount(USD_CPM(10));
+        stack.addAgent(agent);
+    }
+
+    double elapsed = 0.0;
+
+    stack.runThen(
+            routerConfig, bidderConfig, USD_CPM(10), NumRequests,
+            [&] (Json::Value json) {
+                json["workers"][0]["threads"] = int(NumThreads);
+
+                Timer timer;
+                {
+                    auto proxies = make_shared<ServiceProxies>();
+                    MockExchange mockExchange(proxies);
+                    mockExchange.start(json);
+                }
+                elapsed = timer.elapsed_wall();
+            });
+
+    auto events = stack.proxies->events->get(cerr);
+    double auctions = events["router.auctionPassedPreprocessing"];
+    double bids = events["router.bid"];
+
+    cerr << "shards=" << numShards
+         << " elapsed=" << elapsed << "s"
+         << " auctions=" << auctions
+         << " bids=" << bids
+         << endl;
+
+    return auctions / elapsed;
+}
+
+BOOST_AUTO_TEST_CASE( routerShardBench )
+{
+    double base = 0.0;
+
+    for (size_t numShards : { 1, 2, 4, 8 }) {
+        double rate = bench(numShards);
+        if (base == 0.0) base = rate;
+
+        cerr << "shards=" << numShards
+             << " auctions/s=" << rate
+             << " speedup=" << rate / base
+             << endl;
+    }
+}
@@ -24,3 +24,5 @@ $(eval $(call program,json_listener,boost_program_options services utils))
 $(eval $(call test,exchange_parsing_from_file_test,openrtb_bid_request rtb_router openrtb_exchange,boost))
 
 $(eval $(call test,agent_context_switch_test,rtb_router bidding_agent,boost))
+
+$(eval $(call test,router_shard_bench,openrtb_exchange bidding_agent integration_test_utils,boost manual))
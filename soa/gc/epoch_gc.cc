@@ -0,0 +1,210 @@
+/* epoch_gc.cc
+   Copyright (c) 2014 Datacratic.  All rights reserved.
+*/
+
+#include "soa/gc/epoch_gc.h"
+#include "jml/utils/guard.h"
+#include <chrono>
+
+using namespace std;
+using namespace ML;
+
+namespace Datacratic {
+
+
+/*****************************************************************************/
+/* EPOCH GC                                                                  */
+/*****************************************************************************/
+
+EpochGc::
+EpochGc(double reclaimPeriod, size_t batchSize, size_t maxPending)
+    : epoch(0),
+      reclaimPeriod(reclaimPeriod),
+      batchSize(batchSize ? batchSize : 1),
+      maxPending(maxPending),
+      numDeferred(0),
+      numRun(0),
+      reclaimOwner(std::thread::id()),
+      shutdown(false)
+{
+    reclaimer = std::thread([=] () { this->runReclaimer(); });
+}
+
+EpochGc::
+~EpochGc()
+{
+    {
+        std::lock_guard<std::mutex> guard(wakeupLock);
+        shutdown = true;
+    }
+    wakeup.notify_all();
+    reclaimer.join();
+
+    // Nobody can be reading anymore so everything is safe to run.
+    std::deque<Deferred> toRun;
+    {
+        std::lock_guard<std::mutex> guard(deferLock);
+        toRun.swap(pending);
+    }
+    for (auto & item: toRun)
+        item.work();
+}
+
+EpochGc::Record *
+EpochGc::
+acquireRecord()
+{
+    std::lock_guard<std::mutex> guard(recordsLock);
+
+    for (auto & record: records) {
+        bool free = false;
+        if (record->inUse.compare_exchange_strong(free, true))
+            return record.get();
+    }
+
+    records.emplace_back(new Record());
+    return records.back().get();
+}
+
+void
+EpochGc::
+defer(std::function<void ()> work)
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint64_t current = epoch.load();
+
+    size_t numWaiting;
+    {
+        std::lock_guard<std::mutex> guard(deferLock);
+        pending.push_back(Deferred{ current, std::move(work) });
+        ++numDeferred;
+        numWaiting = pending.size();
+    }
+
+    // Deferred work can itself defer, in which case the reclaimer is already
+    // busy and we only nudge it.
+    if (numWaiting >= maxPending && reclaim(false))
+        return;
+    if (numWaiting >= maxPending || numWaiting % batchSize == 0)
+        wakeup.notify_one();
+}
+
+size_t
+EpochGc::
+numPending() const
+{
+    std::lock_guard<std::mutex> guard(deferLock);
+    return pending.size();
+}
+
+bool
+EpochGc::
+tryAdvance()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint64_t current = epoch.load();
+
+    {
+        std::lock_guard<std::mutex> guard(recordsLock);
+        for (auto & record: records) {
+            uint64_t state = record->state.load(std::memory_order_acquire);
+            if ((state & 1) && (state >> 1) != current)
+                return false;
+        }
+    }
+
+    return epoch.compare_exchange_strong(current, current + 1);
+}
+
+bool
+EpochGc::
+reclaim(bool wait)
+{
+    // Deferred work that defers again lands back here on the thread that
+    // already holds reclaimLock; locking it a second time is undefined.
+    if (reclaimOwner.load() == std::this_thread::get_id())
+        return false;
+
+    std::unique_lock<std::mutex> guard(reclaimLock, std::defer_lock);
+    if (wait) guard.lock();
+    else if (!guard.try_lock()) return false;
+
+    reclaimOwner.store(std::this_thread::get_id());
+    ML::Call_Guard clearOwner([&] { reclaimOwner.store(std::thread::id()); });
+
+    // Something deferred in epoch e can run once we're at e + 2 so there's
+    // no point in trying to go further than two steps at a time.
+    for (unsigned i = 0;  i < 2;  ++i)
+        if (!tryAdvance()) break;
+
+    uint64_t current = epoch.load();
+
+    std::vector<std::function<void ()> > toRun;
+    {
+        std::lock_guard<std::mutex> guard(deferLock);
+        while (!pending.empty() && pending.front().epoch + 2 <= current) {
+            toRun.emplace_back(std::move(pending.front().work));
+            pending.pop_front();
+        }
+    }
+
+    for (auto & work: toRun)
+        work();
+
+    numRun += toRun.size();
+    return true;
+}
+
+void
+EpochGc::
+runReclaimer()
+{
+    auto period = std::chrono::microseconds(
+            (int64_t)(reclaimPeriod * 1000000.0));
+
+    std::unique_lock<std::mutex> guard(wakeupLock);
+
+    while (!shutdown) {
+        wakeup.wait_for(guard, period);
+        if (shutdown) break;
+
+        guard.unlock();
+        if (numPending()) reclaim();
+        guard.lock();
+    }
+}
+
+void
+EpochGc::
+visibleBarrier()
+{
+    if (isLockedShared())
+        throw ML::Exception("visibleBarrier called in critical section");
+
+    uint64_t start = epoch.load();
+    while (epoch.load() < start + 2) {
+        reclaim();
+        std::this_thread::yield();
+    }
+}
+
+void
+EpochGc::
+deferBarrier()
+{
+    if (isLockedShared())
+        throw ML::Exception("deferBarrier called in critical section");
+
+    uint64_t target;
+    {
+        std::lock_guard<std::mutex> guard(deferLock);
+        target = numDeferred;
+    }
+
+    while (numRun.load() < target) {
+        reclaim();
+        std::this_thread::yield();
+    }
+}
+
+} // namespace Datacratic
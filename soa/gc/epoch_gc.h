@@ -0,0 +1,274 @@
+/* epoch_gc.h                                                      -*- C++ -*-
+   Copyright (c) 2014 Datacratic.  All rights reserved.
+
+   Epoch based reclamation with per-thread epochs.
+*/
+
+#ifndef __mmap__epoch_gc_h__
+#define __mmap__epoch_gc_h__
+
+#include "jml/arch/exception.h"
+#include "jml/arch/thread_specific.h"
+#include "jml/compiler/compiler.h"
+#include <boost/noncopyable.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** Alternative to GcLock for read-mostly structures that are read from many
+    threads at once.
+
+    GcLock keeps the count of threads in each epoch in a single shared word
+    which every reader has to update on entry and exit of its critical
+    section, so with many readers that cache line bounces between cores.
+    Here every thread publishes the epoch it entered in in its own record
+    and the read side never writes to shared memory.
+
+    The price is paid on the reclamation side: to move to the next epoch the
+    records of all of the threads are scanned, and a deferred function only
+    runs once the epoch has moved twice past the one it was deferred in.
+    That's done in batches by a background thread, never by the readers.
+    The amount of pending work is bounded: a thread calling defer() while
+    maxPending functions are waiting reclaims them itself.
+
+    Only shared critical sections are supported; there is no exclusive or
+    speculative section and no sharing between processes.
+*/
+
+namespace Datacratic {
+
+
+/*****************************************************************************/
+/* EPOCH GC                                                                  */
+/*****************************************************************************/
+
+struct EpochGc : public boost::noncopyable {
+
+    /** Same meaning as in GcLockBase.  The readers never run deferred work
+        so RD_YES and RD_NO are equivalent; they are there so that the
+        guards can be swapped.
+    */
+    enum RunDefer {
+        RD_NO = 0,
+        RD_YES = 1
+    };
+
+    enum DoLock {
+        DONT_LOCK = 0,
+        DO_LOCK = 1
+    };
+
+    /** The background thread reclaims every reclaimPeriod seconds or when
+        batchSize functions are pending, whichever comes first.
+    */
+    EpochGc(double reclaimPeriod = 0.01,
+            size_t batchSize = 256,
+            size_t maxPending = 65536);
+
+    /** Runs whatever deferred work is left.  No thread may still be in a
+        critical section.
+    */
+    ~EpochGc();
+
+    void lockShared(RunDefer runDefer = RD_YES)
+    {
+        ThreadEntry & entry = getEntry();
+        if (entry.nesting++ == 0)
+            enterCS(entry);
+    }
+
+    void unlockShared(RunDefer runDefer = RD_YES)
+    {
+        ThreadEntry & entry = getEntry();
+        if (entry.nesting <= 0)
+            throw ML::Exception("Bad read lock nesting");
+        if (--entry.nesting == 0)
+            entry.record->state.store(0, std::memory_order_release);
+    }
+
+    bool isLockedShared() const
+    {
+        return getEntry().nesting;
+    }
+
+    struct SharedGuard {
+        SharedGuard(EpochGc & lock,
+                    RunDefer runDefer = RD_YES,
+                    DoLock doLock = DO_LOCK)
+            : lock_(lock),
+              runDefer_(runDefer),
+              doLock_(doLock)
+        {
+            if (doLock_)
+                lock_.lockShared(runDefer_);
+        }
+
+        ~SharedGuard()
+        {
+            if (doLock_)
+                lock_.unlockShared(runDefer_);
+        }
+
+        void lock()
+        {
+            if (doLock_)
+                return;
+            lock_.lockShared(runDefer_);
+            doLock_ = DO_LOCK;
+        }
+
+        void unlock()
+        {
+            if (!doLock_)
+                return;
+            lock_.unlockShared(runDefer_);
+            doLock_ = DONT_LOCK;
+        }
+
+        EpochGc & lock_;
+        const RunDefer runDefer_;
+        DoLock doLock_;
+    };
+
+    /** Run work once no critical section that is open now, or that could
+        have seen what was visible before the call, is still open.
+    */
+    void defer(std::function<void ()> work);
+
+    template<typename T>
+    void defer(void (*work) (T *), T * arg)
+    {
+        defer([=] () { work(arg); });
+    }
+
+    template<typename T>
+    void deferDelete(T * toDelete)
+    {
+        if (!toDelete) return;
+        defer([=] () { delete toDelete; });
+    }
+
+    /** Wait until everything that's currently visible is no longer
+        accessible.  Must not be called from within a critical section.
+    */
+    void visibleBarrier();
+
+    /** Wait until all of the functions deferred so far have run.  Must not
+        be called from within a critical section.
+    */
+    void deferBarrier();
+
+    uint64_t currentEpoch() const
+    {
+        return epoch.load(std::memory_order_relaxed);
+    }
+
+    /** Number of deferred functions that haven't run yet. */
+    size_t numPending() const;
+
+private:
+
+    /** A thread's published epoch for this gc.  They are allocated once per
+        thread, never freed before the gc and reused after the thread exits.
+    */
+    struct Record {
+        Record() : state(0), inUse(true) {}
+
+        /// (epoch << 1) | 1 while in a critical section, 0 otherwise
+        std::atomic<uint64_t> state;
+        std::atomic<bool> inUse;
+
+        char padding[64 - sizeof(std::atomic<uint64_t>)
+                     - sizeof(std::atomic<bool>)];
+    };
+
+    struct ThreadEntry {
+        ThreadEntry() : record(nullptr), nesting(0) {}
+
+        ~ThreadEntry()
+        {
+            if (record)
+                record->inUse.store(false, std::memory_order_release);
+        }
+
+        Record * record;
+        int nesting;
+    };
+
+    struct Deferred {
+        uint64_t epoch;
+        std::function<void ()> work;
+    };
+
+    typedef ML::ThreadSpecificInstanceInfo<ThreadEntry, EpochGc> GcInfo;
+
+    ThreadEntry & getEntry() const
+    {
+        return *gcInfo.get();
+    }
+
+    void enterCS(ThreadEntry & entry)
+    {
+        if (JML_UNLIKELY(!entry.record))
+            entry.record = acquireRecord();
+
+        uint64_t current = epoch.load(std::memory_order_relaxed);
+        entry.record->state.store((current << 1) | 1,
+                                  std::memory_order_relaxed);
+
+        // Pairs with the fence in tryAdvance: either the reclaimer sees us or
+        // we see everything that was unlinked before it scanned.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    Record * acquireRecord();
+
+    /** Move to the next epoch if every thread in a critical section has
+        seen the current one.
+    */
+    bool tryAdvance();
+
+    /** Advance as far as possible and run whatever became safe to run.
+        Returns false without doing anything if wait is false and another
+        thread is already reclaiming, or if called from within deferred work
+        being run by this thread's reclaim.
+    */
+    bool reclaim(bool wait = true);
+
+    void runReclaimer();
+
+    std::atomic<uint64_t> epoch;
+
+    const double reclaimPeriod;
+    const size_t batchSize;
+    const size_t maxPending;
+
+    mutable std::mutex recordsLock;
+    std::vector<std::unique_ptr<Record> > records;
+
+    /// Destroyed before records so that the threads' entries let go first
+    mutable GcInfo gcInfo;
+
+    mutable std::mutex deferLock;
+    std::deque<Deferred> pending;
+    uint64_t numDeferred;
+    std::atomic<uint64_t> numRun;
+
+    /// Only one thread reclaims at a time
+    std::mutex reclaimLock;
+    std::atomic<std::thread::id> reclaimOwner;
+
+    std::mutex wakeupLock;
+    std::condition_variable wakeup;
+    bool shutdown;
+    std::thread reclaimer;
+};
+
+} // namespace Datacratic
+
+#endif /* __mmap__epoch_gc_h__ */
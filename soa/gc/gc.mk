@@ -8,7 +8,8 @@
 
 
 LIBGC_SOURCES := \
-	gc_lock.cc 
+	gc_lock.cc \
+	epoch_gc.cc
 
 $(eval $(call library,gc,$(LIBGC_SOURCES),arch utils urcu))
 
@@ -0,0 +1,85 @@
+/* epoch_gc_bench.cc
+   Copyright (c) 2014 Datacratic.  All rights reserved.
+
+   Read side throughput of EpochGc compared to GcLock with a growing number
+   of reader threads and one writer deferring deletes.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "soa/gc/epoch_gc.h"
+#include "soa/gc/gc_lock.h"
+#include "jml/arch/timers.h"
+#include "jml/arch/format.h"
+#include <boost/test/unit_test.hpp>
+#include <atomic>
+#include <iostream>
+#include <thread>
+
+using namespace ML;
+using namespace Datacratic;
+using namespace std;
+
+namespace {
+
+enum { ReadsPerThread = 2000000 };
+
+/** Returns the number of critical sections per second entered by all of
+    the readers together.
+*/
+template<typename Gc>
+double run(Gc & gc, int numReaders)
+{
+    std::atomic<int *> current(new int(0));
+    std::atomic<int> done(0);
+
+    auto reader = [&] () {
+        uint64_t sum = 0;
+        for (unsigned i = 0;  i < ReadsPerThread;  ++i) {
+            typename Gc::SharedGuard guard(gc);
+            sum += *current.load(std::memory_order_relaxed);
+        }
+        if (sum == (uint64_t)-1) cerr << sum;
+        ++done;
+    };
+
+    Timer timer;
+
+    vector<thread> readers;
+    for (int i = 0;  i < numReaders;  ++i)
+        readers.emplace_back(reader);
+
+    for (int i = 1;  done < numReaders;  ++i) {
+        int * old = current.exchange(new int(i));
+        gc.deferDelete(old);
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+
+    double elapsed = timer.elapsed_wall();
+
+    for (auto & t: readers)
+        t.join();
+
+    gc.deferBarrier();
+    delete current.load();
+
+    return (double)ReadsPerThread * numReaders / elapsed;
+}
+
+} // file scope
+
+BOOST_AUTO_TEST_CASE( epoch_gc_bench )
+{
+    for (int numReaders: { 1, 2, 4, 8, 16, 32 }) {
+        GcLock gcLock;
+        EpochGc epochGc;
+
+        double gcLockRate = run(gcLock, numReaders);
+        double epochRate = run(epochGc, numReaders);
+
+        cerr << format("%2d readers: GcLock %12.0f/s  EpochGc %12.0f/s",
+                       numReaders, gcLockRate, epochRate)
+             << endl;
+    }
+}
@@ -0,0 +1,178 @@
+/* epoch_gc_test.cc
+   Copyright (c) 2014 Datacratic.  All rights reserved.
+
+   Tests for the per-thread epoch reclamation.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "soa/gc/epoch_gc.h"
+#include <boost/test/unit_test.hpp>
+#include <atomic>
+#include <iostream>
+#include <thread>
+
+using namespace ML;
+using namespace Datacratic;
+using namespace std;
+
+BOOST_AUTO_TEST_CASE( test_defer_barrier )
+{
+    EpochGc gc;
+
+    int numRun = 0;
+    for (unsigned i = 0;  i < 1000;  ++i)
+        gc.defer([&] () { ++numRun; });
+
+    gc.deferBarrier();
+    BOOST_CHECK_EQUAL(numRun, 1000);
+    BOOST_CHECK_EQUAL(gc.numPending(), 0);
+}
+
+BOOST_AUTO_TEST_CASE( test_reader_holds_back_reclamation )
+{
+    EpochGc gc;
+    std::atomic<bool> run(false);
+    std::atomic<bool> inside(false);
+    std::atomic<bool> release(false);
+
+    std::thread reader([&] () {
+            EpochGc::SharedGuard guard(gc);
+            {
+                // Nesting doesn't publish anything new
+                EpochGc::SharedGuard nested(gc);
+                BOOST_CHECK(gc.isLockedShared());
+            }
+            BOOST_CHECK(gc.isLockedShared());
+            inside = true;
+            while (!release) ;
+        });
+
+    while (!inside) ;
+
+    gc.defer([&] () { run = true; });
+
+    // Give the reclaimer plenty of chances to make the mistake.
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    BOOST_CHECK(!run);
+    BOOST_CHECK_EQUAL(gc.numPending(), 1);
+
+    release = true;
+    reader.join();
+
+    gc.deferBarrier();
+    BOOST_CHECK(run);
+}
+
+BOOST_AUTO_TEST_CASE( test_guard_lock_unlock )
+{
+    EpochGc gc;
+
+    EpochGc::SharedGuard guard(gc, EpochGc::RD_NO, EpochGc::DONT_LOCK);
+    BOOST_CHECK(!gc.isLockedShared());
+    guard.lock();
+    BOOST_CHECK(gc.isLockedShared());
+    guard.unlock();
+    BOOST_CHECK(!gc.isLockedShared());
+
+    BOOST_CHECK_THROW(gc.unlockShared(), ML::Exception);
+
+    gc.lockShared();
+    BOOST_CHECK_THROW(gc.deferBarrier(), ML::Exception);
+    gc.unlockShared();
+}
+
+BOOST_AUTO_TEST_CASE( test_defer_from_deferred_work )
+{
+    /* With maxPending of 1 every defer tries to reclaim inline, including
+       the ones made by work that the reclaim is itself running.
+    */
+    EpochGc gc(1.0, 1, 1);
+
+    std::atomic<int> numRun(0);
+    std::function<void (int)> chain = [&] (int depth) {
+        ++numRun;
+        if (depth) gc.defer([&, depth] () { chain(depth - 1); });
+    };
+
+    for (unsigned i = 0;  i < 10;  ++i)
+        gc.defer([&] () { chain(5); });
+
+    // The barrier only covers what was deferred before it was called.
+    while (numRun.load() < 60)
+        gc.deferBarrier();
+    BOOST_CHECK_EQUAL(numRun.load(), 60);
+    BOOST_CHECK_EQUAL(gc.numPending(), 0);
+}
+
+namespace {
+
+struct Checked {
+    Checked(int value) : magic(Magic), value(value) {}
+    ~Checked() { magic = 0; }
+
+    enum { Magic = 0x5ca1ab1e };
+    std::atomic<int> magic;
+    int value;
+};
+
+} // file scope
+
+BOOST_AUTO_TEST_CASE( test_stress_swap )
+{
+    enum { NumReaders = 8, NumSwaps = 20000 };
+
+    // Small batches and bound so that all of the paths get exercised.
+    EpochGc gc(0.001, 16, 256);
+
+    std::atomic<Checked *> current(new Checked(0));
+    std::atomic<bool> finished(false);
+    std::atomic<uint64_t> errors(0), reads(0);
+
+    auto reader = [&] () {
+        while (!finished) {
+            EpochGc::SharedGuard guard(gc);
+            Checked * value = current.load();
+            if (value->magic != Checked::Magic)
+                ++errors;
+            ++reads;
+        }
+    };
+
+    vector<thread> readers;
+    for (unsigned i = 0;  i < NumReaders;  ++i)
+        readers.emplace_back(reader);
+
+    for (int i = 1;  i <= NumSwaps;  ++i) {
+        Checked * old = current.exchange(new Checked(i));
+        gc.deferDelete(old);
+    }
+
+    finished = true;
+    for (auto & t: readers)
+        t.join();
+
+    gc.deferBarrier();
+    BOOST_CHECK_EQUAL(gc.numPending(), 0);
+    BOOST_CHECK_EQUAL(errors, 0);
+
+    cerr << "reads " << reads << " epoch " << gc.currentEpoch() << endl;
+
+    delete current.load();
+}
+
+BOOST_AUTO_TEST_CASE( test_thread_records_are_reused )
+{
+    EpochGc gc;
+
+    for (unsigned i = 0;  i < 100;  ++i) {
+        std::thread t([&] () { EpochGc::SharedGuard guard(gc); });
+        t.join();
+    }
+
+    // A dead thread's record must not hold the epoch back.
+    uint64_t start = gc.currentEpoch();
+    gc.visibleBarrier();
+    BOOST_CHECK_GE(gc.currentEpoch(), start + 2);
+}
@@ -7,4 +7,6 @@
 #------------------------------------------------------------------------------#
 
 $(eval $(call test,gc_test,gc,boost))
+$(eval $(call test,epoch_gc_test,gc,boost))
+$(eval $(call test,epoch_gc_bench,gc,boost manual))
 
@@ -186,6 +186,42 @@ recordOutcome(const std::string & stat, float value,
 }
 
 
+std::shared_ptr<StatAggregator>
+MultiAggregator::
+getStat(const std::string & stat,
+        StatEventType type,
+        const std::vector<int>& percentiles)
+{
+    std::unique_lock<Lock> guard(lock);
+
+    auto found = stats.find(stat);
+    if (found != stats.end())
+        return found->second;
+
+    StatAggregator * aggregator;
+    switch (type) {
+    case ET_HIT:
+    case ET_COUNT:
+        aggregator = createNewCounter();
+        break;
+    case ET_STABLE_LEVEL:
+        aggregator = createNewStableLevel();
+        break;
+    case ET_LEVEL:
+        aggregator = createNewLevel();
+        break;
+    case ET_OUTCOME:
+        aggregator = createNewOutcome(percentiles);
+        break;
+    default:
+        throw ML::Exception("unknown stat type");
+    }
+
+    std::shared_ptr<StatAggregator> result(aggregator);
+    stats.insert(make_pair(stat, result));
+    return result;
+}
+
 void
 MultiAggregator::
 dump()
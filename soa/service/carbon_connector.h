@@ -101,6 +101,16 @@ struct MultiAggregator {
     void recordOutcome(const std::string & stat, float value,
             const std::vector<int>& percentiles = DefaultOutcomePercentiles);
 
+    /** Return the aggregator behind the given stat, creating it for the
+        given type if it doesn't exist yet.  Recording directly into the
+        returned aggregator skips the name lookup that the record*
+        functions do on each call; it stays valid for as long as it's held.
+    */
+    std::shared_ptr<StatAggregator>
+    getStat(const std::string & stat,
+            StatEventType type,
+            const std::vector<int>& percentiles = DefaultOutcomePercentiles);
+
     /** Dump synchronously (taking the lock).  This should only be used in
         testing or debugging, not when connected to Carbon.
     */
@@ -6,10 +6,12 @@
 
 #include <string.h>
 
+#include <algorithm>
 #include <iostream>
 #include "jml/arch/exception.h"
 #include "jml/utils/string_functions.h"
 
+#include "http_header.h"
 #include "http_parsers.h"
 
 using namespace std;
@@ -395,3 +397,557 @@ finalizeParsing()
     }
     clear();
 }
+
+
+/****************************************************************************/
+/* HTTP REQUEST PARSER                                                      */
+/****************************************************************************/
+
+namespace {
+
+/* Parsers live as long as a single request, so the buffers they need when a
+ * request is split over several packets are recycled through a per-thread
+ * pool rather than reallocated for every request. */
+struct BufferPool {
+    enum {
+        MaxBuffers = 256,
+        MaxCapacity = 1024 * 1024
+    };
+
+    std::string get()
+    {
+        std::string result;
+        if (!buffers.empty()) {
+            result.swap(buffers.back());
+            buffers.pop_back();
+        }
+        return result;
+    }
+
+    void put(std::string & buffer)
+    {
+        if (buffer.capacity() > MaxCapacity || buffers.size() >= MaxBuffers) {
+            return;
+        }
+        buffer.clear();
+        buffers.emplace_back();
+        buffers.back().swap(buffer);
+    }
+
+    vector<string> buffers;
+};
+
+BufferPool &
+bufferPool()
+{
+    static thread_local BufferPool pool;
+    return pool;
+}
+
+void
+trimSpaces(const char * & start, const char * & end)
+{
+    while (start < end && (*start == ' ' || *start == '\t')) {
+        start++;
+    }
+    while (end > start && (end[-1] == ' ' || end[-1] == '\t')) {
+        end--;
+    }
+}
+
+int
+hexValue(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+string
+urlDecode(const char * start, const char * end)
+{
+    string result;
+    result.reserve(end - start);
+
+    while (start < end) {
+        char c = *start++;
+        if (c == '%') {
+            int high = end - start >= 2 ? hexValue(start[0]) : -1;
+            int low = high >= 0 ? hexValue(start[1]) : -1;
+            if (low < 0) {
+                throw ML::Exception("invalid url encoded character");
+            }
+            result += (char)(high * 16 + low);
+            start += 2;
+        }
+        else if (c == '+') {
+            result += ' ';
+        }
+        else {
+            result += c;
+        }
+    }
+
+    return result;
+}
+
+string
+lowercaseView(const HttpRequestParser::View & view)
+{
+    string result(view.data, view.size);
+    for (char & c: result) {
+        c = tolower(c);
+    }
+    return result;
+}
+
+struct KnownHeaderName {
+    const char * name;
+    size_t size;
+};
+
+const KnownHeaderName knownHeaderNames[HttpRequestParser::NUM_KNOWN_HEADERS] = {
+    { "content-length", 14 },
+    { "content-type", 12 },
+    { "transfer-encoding", 17 },
+    { "connection", 10 },
+    { "expect", 6 },
+    { "host", 4 }
+};
+
+int
+findKnownHeader(const HttpRequestParser::View & name)
+{
+    for (int i = 0; i < HttpRequestParser::NUM_KNOWN_HEADERS; i++) {
+        const KnownHeaderName & known = knownHeaderNames[i];
+        if (name.equalsNoCase(known.name, known.size)) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+} // file scope
+
+bool
+HttpRequestParser::View::
+operator == (const char * other)
+    const
+{
+    size_t otherSize = ::strlen(other);
+    return (size == otherSize
+            && (size == 0 || ::memcmp(data, other, size) == 0));
+}
+
+bool
+HttpRequestParser::View::
+equalsNoCase(const char * other, size_t otherSize)
+    const
+{
+    return (size == otherSize
+            && (size == 0 || ::strncasecmp(data, other, size) == 0));
+}
+
+void
+HttpRequestParser::Request::
+clear()
+{
+    verb = resource = query = version = View();
+    for (View & header: known) {
+        header = View();
+    }
+    numFields = 0;
+    contentLength = -1;
+    isChunked = false;
+    body = View();
+}
+
+HttpRequestParser::View
+HttpRequestParser::Request::
+getHeader(const char * name)
+    const
+{
+    View nameView(name, ::strlen(name));
+
+    int knownIndex = findKnownHeader(nameView);
+    if (knownIndex >= 0) {
+        return known[knownIndex];
+    }
+    for (unsigned i = 0; i < numFields; i++) {
+        if (fields[i].name.equalsNoCase(name, nameView.size)) {
+            return fields[i].value;
+        }
+    }
+
+    return View();
+}
+
+void
+HttpRequestParser::Request::
+toHttpHeader(HttpHeader & header)
+    const
+{
+    header = HttpHeader();
+
+    header.verb = verb.str();
+    header.resource = resource.str();
+    header.version = version.str();
+
+    const char * current = query.data;
+    const char * end = query.data + query.size;
+    while (current < end) {
+        const char * paramEnd = (const char *) ::memchr(current, '&',
+                                                        end - current);
+        if (!paramEnd) {
+            paramEnd = end;
+        }
+        const char * equals = (const char *) ::memchr(current, '=',
+                                                      paramEnd - current);
+        if (equals) {
+            header.queryParams.emplace_back(urlDecode(current, equals),
+                                            urlDecode(equals + 1, paramEnd));
+        }
+        else {
+            header.queryParams.emplace_back(urlDecode(current, paramEnd), "");
+        }
+        current = paramEnd + 1;
+    }
+
+    header.contentType = known[CONTENT_TYPE].str();
+    header.contentLength = contentLength;
+    header.isChunked = isChunked;
+
+    /* HttpHeader keeps everything but the three headers above in its map,
+       under lowercase names */
+    for (int i = CONNECTION; i < NUM_KNOWN_HEADERS; i++) {
+        if (known[i].data) {
+            header.headers[knownHeaderNames[i].name] = known[i].str();
+        }
+    }
+    for (unsigned i = 0; i < numFields; i++) {
+        header.headers[lowercaseView(fields[i].name)] = fields[i].value.str();
+    }
+}
+
+HttpRequestParser::
+HttpRequestParser(size_t maxHeaderSize)
+    : maxHeaderSize_(maxHeaderSize),
+      scanned_(0), headerSize_(0), requestSize_(0),
+      pooledBuffer_(false), pooledChunkedBody_(false)
+{
+}
+
+HttpRequestParser::
+~HttpRequestParser()
+{
+    if (pooledBuffer_) {
+        bufferPool().put(buffer_);
+    }
+    if (pooledChunkedBody_) {
+        bufferPool().put(chunkedBody_);
+    }
+}
+
+void
+HttpRequestParser::
+feed(const char * data)
+{
+    feed(data, strlen(data));
+}
+
+void
+HttpRequestParser::
+feed(const char * data, size_t size)
+{
+    bool fromBuffer = !buffer_.empty();
+    if (fromBuffer) {
+        buffer_.append(data, size);
+        data = buffer_.c_str();
+        size = buffer_.size();
+    }
+
+    /* We loop as there may be more than one request in the data. */
+    size_t done(0);
+    while (done < size) {
+        size_t used = parseRequest(data + done, size - done);
+        if (used == 0) {
+            break;
+        }
+        done += used;
+    }
+
+    size_t remaining = size - done;
+    if (fromBuffer) {
+        if (remaining == 0) {
+            buffer_.clear();
+        }
+        else if (done > 0) {
+            buffer_.erase(0, done);
+        }
+    }
+    else if (remaining > 0) {
+        if (!pooledBuffer_) {
+            buffer_ = bufferPool().get();
+            pooledBuffer_ = true;
+        }
+        /* The content length comes from the peer, so don't let it decide
+           how much we allocate up front. */
+        if (requestSize_ > 0) {
+            buffer_.reserve(std::min<size_t>(requestSize_,
+                                             BufferPool::MaxCapacity));
+        }
+        buffer_.assign(data + done, remaining);
+    }
+}
+
+size_t
+HttpRequestParser::
+parseRequest(const char * data, size_t size)
+{
+    if (headerSize_ == 0) {
+        const char * end = (const char *) ::memmem(data + scanned_,
+                                                   size - scanned_,
+                                                   "\r\n\r\n", 4);
+        if (!end) {
+            if (size > maxHeaderSize_) {
+                throw ML::Exception("HTTP header exceeds %zd bytes",
+                                    maxHeaderSize_);
+            }
+            scanned_ = size > 3 ? size - 3 : 0;
+            return 0;
+        }
+
+        headerSize_ = end + 4 - data;
+        if (headerSize_ > maxHeaderSize_) {
+            throw ML::Exception("HTTP header exceeds %zd bytes",
+                                maxHeaderSize_);
+        }
+        parseHeaders(data, headerSize_);
+        if (!request_.isChunked) {
+            requestSize_ = headerSize_ + request_.contentLength;
+        }
+
+        if (onHeader) {
+            onHeader(request_);
+        }
+    }
+
+    size_t used;
+    if (request_.isChunked) {
+        size_t bodySize = parseChunkedBody(data + headerSize_,
+                                           size - headerSize_);
+        if (bodySize == 0) {
+            return 0;
+        }
+        used = headerSize_ + bodySize;
+    }
+    else {
+        if (size < requestSize_) {
+            return 0;
+        }
+        used = requestSize_;
+    }
+
+    /* The data may have moved to our buffer since the headers were parsed,
+       in which case the views have to be recomputed. */
+    if (request_.verb.data != data) {
+        parseHeaders(data, headerSize_);
+    }
+    if (request_.isChunked) {
+        request_.body = View(chunkedBody_.c_str(), chunkedBody_.size());
+    }
+    else {
+        request_.body = View(data + headerSize_, request_.contentLength);
+    }
+
+    if (onRequest) {
+        onRequest(request_);
+    }
+
+    request_.clear();
+    chunkedBody_.clear();
+    scanned_ = headerSize_ = requestSize_ = 0;
+
+    return used;
+}
+
+size_t
+HttpRequestParser::
+parseHeaders(const char * data, size_t headerSize)
+{
+    request_.clear();
+
+    /* excluding the final empty line */
+    const char * end = data + headerSize - 2;
+
+    /* request line */
+    const char * current = data;
+    const char * lineEnd = (const char *) ::memchr(current, '\r',
+                                                   end - current);
+    if (lineEnd[1] != '\n') {
+        throw ML::Exception("expected \\n");
+    }
+
+    const char * verbEnd = (const char *) ::memchr(current, ' ',
+                                                   lineEnd - current);
+    if (!verbEnd || verbEnd == current) {
+        throw ML::Exception("invalid request line: no verb");
+    }
+    request_.verb = View(current, verbEnd - current);
+
+    current = verbEnd + 1;
+    const char * targetEnd = (const char *) ::memchr(current, ' ',
+                                                     lineEnd - current);
+    if (!targetEnd || targetEnd == current) {
+        throw ML::Exception("invalid request line: no resource");
+    }
+    const char * queryStart = (const char *) ::memchr(current, '?',
+                                                      targetEnd - current);
+    if (queryStart) {
+        request_.resource = View(current, queryStart - current);
+        request_.query = View(queryStart + 1, targetEnd - queryStart - 1);
+    }
+    else {
+        request_.resource = View(current, targetEnd - current);
+    }
+
+    current = targetEnd + 1;
+    if (lineEnd - current < 5 || ::memcmp(current, "HTTP/", 5) != 0) {
+        throw ML::Exception("version must start with 'HTTP/'");
+    }
+    request_.version = View(current, lineEnd - current);
+
+    /* header lines */
+    current = lineEnd + 2;
+    while (current < end) {
+        lineEnd = (const char *) ::memchr(current, '\r', end - current);
+        if (lineEnd[1] != '\n') {
+            throw ML::Exception("expected \\n");
+        }
+        if (*current == ' ' || *current == '\t') {
+            throw ML::Exception("multi-line headers are not supported");
+        }
+
+        const char * colon = (const char *) ::memchr(current, ':',
+                                                     lineEnd - current);
+        if (!colon || colon == current) {
+            throw ML::Exception("invalid header line");
+        }
+
+        View name(current, colon - current);
+        const char * valueStart = colon + 1;
+        const char * valueEnd = lineEnd;
+        trimSpaces(valueStart, valueEnd);
+        View value(valueStart, valueEnd - valueStart);
+
+        int knownIndex = findKnownHeader(name);
+        if (knownIndex >= 0) {
+            request_.known[knownIndex] = value;
+        }
+        else {
+            if (request_.numFields == MaxFields) {
+                throw ML::Exception("too many HTTP headers");
+            }
+            Field & field = request_.fields[request_.numFields++];
+            field.name = name;
+            field.value = value;
+        }
+
+        current = lineEnd + 2;
+    }
+
+    const View & transferEncoding = request_.known[TRANSFER_ENCODING];
+    if (!transferEncoding.empty()) {
+        if (!transferEncoding.equalsNoCase("chunked", 7)) {
+            throw ML::Exception("unknown transfer-encoding");
+        }
+        request_.isChunked = true;
+    }
+
+    const View & contentLength = request_.known[CONTENT_LENGTH];
+    if (!contentLength.empty()) {
+        int64_t length(0);
+        for (size_t i = 0; i < contentLength.size; i++) {
+            char c = contentLength.data[i];
+            if (c < '0' || c > '9' || length > (INT64_MAX - 9) / 10) {
+                throw ML::Exception("invalid content-length");
+            }
+            length = length * 10 + (c - '0');
+        }
+        request_.contentLength = length;
+    }
+    else if (!request_.isChunked) {
+        request_.contentLength = 0;
+    }
+
+    return headerSize;
+}
+
+size_t
+HttpRequestParser::
+parseChunkedBody(const char * data, size_t size)
+{
+    /* Chunked requests are rare, so the body is decoded from scratch every
+       time more data comes in. */
+    chunkedBody_.clear();
+
+    size_t ptr(0);
+    while (true) {
+        const char * lineEnd = (const char *) ::memmem(data + ptr, size - ptr,
+                                                       "\r\n", 2);
+        if (!lineEnd) {
+            return 0;
+        }
+
+        const char * sizeEnd = (const char *) ::memchr(data + ptr, ';',
+                                                       lineEnd - data - ptr);
+        if (!sizeEnd) {
+            sizeEnd = lineEnd;
+        }
+        if (sizeEnd == data + ptr) {
+            throw ML::Exception("invalid chunk length");
+        }
+
+        size_t chunkSize(0);
+        for (const char * c = data + ptr; c < sizeEnd; c++) {
+            int digit = hexValue(*c);
+            if (digit < 0 || chunkSize > (SIZE_MAX >> 4)) {
+                throw ML::Exception("invalid chunk length");
+            }
+            chunkSize = chunkSize * 16 + digit;
+        }
+        ptr = lineEnd + 2 - data;
+
+        if (chunkSize == 0) {
+            /* last chunk, followed by optional trailers and an empty line */
+            if (size - ptr < 2) {
+                return 0;
+            }
+            if (data[ptr] == '\r' && data[ptr + 1] == '\n') {
+                return ptr + 2;
+            }
+            const char * trailersEnd
+                = (const char *) ::memmem(data + ptr, size - ptr,
+                                          "\r\n\r\n", 4);
+            if (!trailersEnd) {
+                return 0;
+            }
+            return trailersEnd + 4 - data;
+        }
+
+        if (size - ptr < chunkSize + 2) {
+            return 0;
+        }
+        if (data[ptr + chunkSize] != '\r' || data[ptr + chunkSize + 1] != '\n') {
+            throw ML::Exception("expected \\r\\n after chunk");
+        }
+        if (!pooledChunkedBody_) {
+            chunkedBody_ = bufferPool().get();
+            pooledChunkedBody_ = true;
+        }
+        chunkedBody_.append(data + ptr, chunkSize);
+        ptr += chunkSize + 2;
+    }
+}
@@ -6,11 +6,16 @@
 
 #pragma once
 
+#include <cstdint>
 #include <functional>
+#include <string>
 
 
 namespace Datacratic {
 
+struct HttpHeader;
+
+
 /****************************************************************************/
 /* HTTP RESPONSE PARSER                                                     */
 /****************************************************************************/
@@ -125,4 +130,150 @@ private:
     bool requireClose_;
 };
 
-}
+
+/****************************************************************************/
+/* HTTP REQUEST PARSER                                                      */
+/****************************************************************************/
+
+/* HttpRequestParser is the server-side counterpart of HttpResponseParser. It
+ * parses HTTP/1.1 requests incrementally without copying them: when a
+ * request is complete, the request line, the headers and the body are
+ * reported as views into the data that was fed, or into an internal buffer
+ * taken from a pool when the request was split over several packets.
+ *
+ * The headers most commonly needed by the endpoints are recognized while
+ * parsing and stored in a fixed-size table. The others are kept in a
+ * bounded array in their order of appearance. */
+
+struct HttpRequestParser {
+    /* A non-owning reference to a part of the parsed data. Only valid for
+       the duration of the callback it is passed to. */
+    struct View {
+        View()
+            : data(nullptr), size(0)
+        {
+        }
+
+        View(const char * data, size_t size)
+            : data(data), size(size)
+        {
+        }
+
+        bool empty() const { return size == 0; }
+
+        std::string str() const { return std::string(data, size); }
+
+        bool operator == (const char * other) const;
+
+        /* case-insensitive comparison */
+        bool equalsNoCase(const char * other, size_t otherSize) const;
+
+        const char * data;
+        size_t size;
+    };
+
+    /* Headers which get a dedicated slot in Request::known */
+    enum KnownHeader {
+        CONTENT_LENGTH,
+        CONTENT_TYPE,
+        TRANSFER_ENCODING,
+        CONNECTION,
+        EXPECT,
+        HOST,
+        NUM_KNOWN_HEADERS
+    };
+
+    /* Maximum number of headers that are not in the known table */
+    enum { MaxFields = 64 };
+
+    struct Field {
+        View name;
+        View value;
+    };
+
+    struct Request {
+        Request()
+        {
+            clear();
+        }
+
+        void clear();
+
+        /* Value of the given header, looking in the known table first.
+           The name comparison is case-insensitive. Returns an empty view
+           when the header is missing. */
+        View getHeader(const char * name) const;
+
+        /* Fill an HttpHeader from the request, for the code that still
+           deals with those. */
+        void toHttpHeader(HttpHeader & header) const;
+
+        View verb;
+        View resource;  // path, without the query string
+        View query;     // after the '?', still url-encoded
+        View version;
+
+        View known[NUM_KNOWN_HEADERS];
+        Field fields[MaxFields];
+        unsigned numFields;
+
+        int64_t contentLength;
+        bool isChunked;
+
+        View body;
+    };
+
+    /* Type of callback used once the headers of a request are complete,
+       before its body has been received. The body view is empty. */
+    typedef std::function<void (const Request &)> OnHeader;
+
+    /* Type of callback used once a request has been entirely received. */
+    typedef std::function<void (const Request &)> OnRequest;
+
+    HttpRequestParser(size_t maxHeaderSize = 16384);
+    ~HttpRequestParser();
+
+    /* Feed the parsing with a 0-ended data chunk. Useful for testing. */
+    void feed(const char * data);
+
+    /* Feed the parsing with a data chunk of a specied size. */
+    void feed(const char * data, size_t size);
+
+    /* Number of bytes received for a request that is not complete yet. */
+    size_t buffered() const
+    {
+        return buffer_.size();
+    }
+
+    OnHeader onHeader;
+    OnRequest onRequest;
+
+private:
+    /* Parse the request at the start of data. Returns the number of bytes
+       it used or 0 if it is not complete. */
+    size_t parseRequest(const char * data, size_t size);
+
+    size_t parseHeaders(const char * data, size_t headerSize);
+    size_t parseChunkedBody(const char * data, size_t size);
+
+    size_t maxHeaderSize_;
+
+    /* where to resume looking for the end of the headers */
+    size_t scanned_;
+
+    /* size of the headers and of the full request, once they are known */
+    size_t headerSize_;
+    size_t requestSize_;
+
+    Request request_;
+
+    std::string buffer_;
+    std::string chunkedBody_;
+
+    /* whether the buffers above were taken from the pool and should go
+       back to it */
+    bool pooledBuffer_;
+    bool pooledChunkedBody_;
+};
+
+} // namespace Datacratic
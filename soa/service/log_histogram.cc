@@ -0,0 +1,178 @@
+/* log_histogram.cc
+   Copyright (c) 2014 Datacratic.  All rights reserved.
+
+*/
+
+#include "soa/service/log_histogram.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+using namespace std;
+
+namespace Datacratic {
+
+
+/*****************************************************************************/
+/* LOG HISTOGRAM                                                             */
+/*****************************************************************************/
+
+LogHistogram::
+LogHistogram()
+    : firstBucket(0)
+{
+    clear();
+}
+
+void
+LogHistogram::
+record(float value, uint64_t n)
+{
+    if (std::isnan(value) || n == 0)
+        return;
+
+    int bucket = bucketOf(value);
+    cover(bucket, bucket);
+    counts[bucket - firstBucket] += n;
+    count_ += n;
+    sum_ += double(value) * n;
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+}
+
+void
+LogHistogram::
+merge(const LogHistogram & other)
+{
+    if (!other.counts.empty()) {
+        cover(other.firstBucket, other.firstBucket + other.counts.size() - 1);
+        uint64_t * dest = &counts[other.firstBucket - firstBucket];
+        for (unsigned i = 0;  i < other.counts.size();  ++i)
+            dest[i] += other.counts[i];
+    }
+    count_ += other.count_;
+    sum_ += other.sum_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+}
+
+void
+LogHistogram::
+cover(int first, int last)
+{
+    if (counts.empty()) {
+        counts.assign(last - first + 1, 0);
+        firstBucket = first;
+        return;
+    }
+
+    int end = firstBucket + counts.size();
+    if (first >= firstBucket && last < end)
+        return;
+
+    // Grow by at least half of the current size so that values creeping
+    // outwards one bucket at a time don't each cost a copy.
+    int grow = counts.size() / 2;
+    int newFirst = first < firstBucket
+        ? std::max<int>(0, std::min(first, firstBucket - grow)) : firstBucket;
+    int newEnd = last >= end
+        ? std::min<int>(NumBuckets, std::max(last + 1, end + grow)) : end;
+
+    std::vector<uint64_t> newCounts(newEnd - newFirst, 0);
+    std::copy(counts.begin(), counts.end(),
+              newCounts.begin() + (firstBucket - newFirst));
+    counts.swap(newCounts);
+    firstBucket = newFirst;
+}
+
+void
+LogHistogram::
+clear()
+{
+    std::fill(counts.begin(), counts.end(), 0);
+    count_ = 0;
+    sum_ = 0.0;
+    min_ = numeric_limits<float>::infinity();
+    max_ = -numeric_limits<float>::infinity();
+}
+
+double
+LogHistogram::
+bucketValue(int bucket)
+{
+    int offset = bucket - ZeroBucket;
+    if (offset == 0)
+        return 0.0;
+
+    int magnitude = std::abs(offset);
+    double result;
+    if (magnitude == NumMagnitudes)
+        result = numeric_limits<double>::infinity();
+    else {
+        uint32_t lowerBits = MinBits + ((magnitude - 1) << (23 - SubBucketBits));
+        uint32_t upperBits = lowerBits + (1 << (23 - SubBucketBits));
+        float lower, upper;
+        std::memcpy(&lower, &lowerBits, sizeof(lower));
+        std::memcpy(&upper, &upperBits, sizeof(upper));
+        result = 0.5 * (double(lower) + double(upper));
+    }
+
+    return offset < 0 ? -result : result;
+}
+
+double
+LogHistogram::
+percentile(float outOf100) const
+{
+    if (count_ == 0)
+        return 0.0;
+
+    uint64_t element
+        = std::max<int64_t>(0,
+                            std::min<int64_t>(count_ - 1,
+                                              outOf100 / 100.0 * count_));
+
+    uint64_t seen = 0;
+    unsigned index = 0;
+    for (;  index + 1 < counts.size();  ++index) {
+        seen += counts[index];
+        if (seen > element)
+            break;
+    }
+
+    double value = bucketValue(firstBucket + index);
+    return std::max<double>(min_, std::min<double>(max_, value));
+}
+
+void
+LogHistogram::
+fixExtremes()
+{
+    if (count_ == 0 || min_ <= max_)
+        return;
+
+    if (counts.empty())
+        return;
+
+    int first = 0, last = counts.size() - 1;
+    while (first < last && counts[first] == 0)
+        ++first;
+    while (last > first && counts[last] == 0)
+        --last;
+
+    // The overflow buckets stand for infinities which would make a poor
+    // guess; take the edge of the range instead.
+    auto value = [] (int bucket)
+        {
+            double result = bucketValue(bucket);
+            if (std::isinf(result))
+                result = (result > 0 ? 1 : -1) * std::ldexp(1.0, MaxExponent);
+            return result;
+        };
+
+    min_ = value(firstBucket + first);
+    max_ = value(firstBucket + last);
+}
+
+} // namespace Datacratic
@@ -0,0 +1,136 @@
+/* log_histogram.h                                                 -*- C++ -*-
+   Copyright (c) 2014 Datacratic.  All rights reserved.
+
+   Fixed size histogram with log-linear buckets.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+
+namespace Datacratic {
+
+
+/*****************************************************************************/
+/* LOG HISTOGRAM                                                             */
+/*****************************************************************************/
+
+/** Histogram of float values whose memory doesn't depend on the number of
+    values recorded, in the same spirit as HdrHistogram.
+
+    Every power of two between 2^MinExponent and 2^MaxExponent is split in
+    SubBuckets buckets of equal width, so that a value is known to within
+    1 / (2 * SubBuckets) of itself (0.8%) wherever it is in the range.
+    Negative values are mirrored on the other side of a bucket that holds
+    everything smaller in magnitude than 2^MinExponent.  Anything bigger
+    than 2^MaxExponent goes in an overflow bucket.
+
+    The bucket of a value is taken straight from the exponent and the top
+    mantissa bits of the float so that recording is a few integer
+    operations.  Bucket numbers increase with the value.
+
+    Only the buckets between the smallest and the largest value seen are
+    stored, so an empty histogram doesn't allocate anything and one for
+    values that span a few powers of two stays small.
+
+    The count, sum, minimum and maximum are exact; only the percentiles are
+    approximate.  Two histograms can be merged by adding their buckets up,
+    which is how the per period snapshots of a GaugeAggregator are built.
+
+    NaN values are ignored.  Not thread safe; see GaugeAggregator.
+*/
+
+struct LogHistogram {
+
+    enum {
+        SubBucketBits = 6,
+        SubBuckets = 1 << SubBucketBits,
+        MinExponent = -10,   ///< Smallest magnitude kept is ~0.001
+        MaxExponent = 34,    ///< Largest magnitude kept is ~1.7e10
+
+        /// Buckets on each side of zero, including the overflow bucket
+        NumMagnitudes = (MaxExponent - MinExponent) * SubBuckets + 1,
+        NumBuckets = 2 * NumMagnitudes + 1,
+        ZeroBucket = NumMagnitudes
+    };
+
+    LogHistogram();
+
+    /** Record n occurrences of value. */
+    void record(float value, uint64_t n = 1);
+
+    /** Add all of the values of other to this one. */
+    void merge(const LogHistogram & other);
+
+    void clear();
+
+    bool empty() const { return count_ == 0; }
+    uint64_t count() const { return count_; }
+    double sum() const { return sum_; }
+    double mean() const { return count_ ? sum_ / count_ : 0.0; }
+    float min() const { return min_; }
+    float max() const { return max_; }
+
+    /** Approximation of the value that would be at the position
+        outOf100 / 100 * count() if all of the values were sorted, which is
+        the value that was reported before the histogram was used.  Always
+        within [min(), max()].
+    */
+    double percentile(float outOf100) const;
+
+    uint64_t bucketCount(int bucket) const
+    {
+        unsigned index = bucket - firstBucket;
+        return index < counts.size() ? counts[index] : 0;
+    }
+
+    /** Bucket that value falls in.  value must not be NaN. */
+    static int bucketOf(float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+
+        uint32_t magnitude = bits & 0x7fffffff;
+        int offset;
+        if (magnitude < MinBits)
+            offset = 0;
+        else if (magnitude >= MaxBits)
+            offset = NumMagnitudes;
+        else offset = 1 + ((magnitude - MinBits) >> (23 - SubBucketBits));
+
+        return (bits & 0x80000000) ? ZeroBucket - offset : ZeroBucket + offset;
+    }
+
+    /** Value that stands for the values of a bucket: the middle of its
+        range, 0 for the zero bucket and infinity for the overflow buckets.
+    */
+    static double bucketValue(int bucket);
+
+private:
+    friend struct GaugeAggregator;
+
+    /// Float bits of 2^MinExponent and 2^MaxExponent
+    static constexpr uint32_t MinBits = uint32_t(127 + MinExponent) << 23;
+    static constexpr uint32_t MaxBits = uint32_t(127 + MaxExponent) << 23;
+
+    /** Set min and max from the buckets when they weren't recorded, which
+        happens when a snapshot is taken while values are being recorded.
+    */
+    void fixExtremes();
+
+    /** Make sure that the buckets from first to last are stored. */
+    void cover(int first, int last);
+
+    /// Counts of the buckets from firstBucket on
+    std::vector<uint64_t> counts;
+    int firstBucket;
+    uint64_t count_;
+    double sum_;
+    float min_;
+    float max_;
+};
+
+} // namespace Datacratic
@@ -3,7 +3,8 @@
 
 
 LIBOPSTATS_SOURCES := \
-	statsd_connector.cc carbon_connector.cc stat_aggregator.cc process_stats.cc
+	statsd_connector.cc carbon_connector.cc stat_aggregator.cc process_stats.cc \
+	log_histogram.cc
 
 LIBOPSTATS_LINK := \
 	ACE arch utils boost_thread types
@@ -93,6 +93,16 @@ dump(std::ostream & stream) const
     stats->dumpSync(stream);
 }
 
+std::shared_ptr<StatAggregator>
+NullEventService::
+getAggregator(const std::string & name,
+              const std::string & event,
+              StatEventType type,
+              const std::vector<int> & percentiles)
+{
+    return stats->getStat(name + "." + event, type, percentiles);
+}
+
 
 /*****************************************************************************/
 /* CARBON EVENT SERVICE                                                      */
@@ -142,6 +152,17 @@ onEvent(const std::string & name,
     connector->record(stat, type, value, extra);
 }
 
+std::shared_ptr<StatAggregator>
+CarbonEventService::
+getAggregator(const std::string & name,
+              const std::string & event,
+              StatEventType type,
+              const std::vector<int> & percentiles)
+{
+    return connector->getStat(name.empty() ? event : name + "." + event,
+                              type, percentiles);
+}
+
 
 /*****************************************************************************/
 /* CONFIGURATION SERVICE                                                     */
@@ -711,6 +732,45 @@ recordEventFmt(StatEventType type,
     }
 }
 
+EventHandle
+EventRecorder::
+registerEvent(const std::string & event,
+              StatEventType type,
+              const std::vector<int> & percentiles) const
+{
+    EventHandle result;
+
+    result.events = events_;
+    if (!result.events && services_)
+        result.events = services_->events;
+    if (!result.events)
+        return result;
+
+    result.prefix = eventPrefix_;
+    result.event = event;
+    result.type = type;
+    result.aggregator
+        = result.events->getAggregator(eventPrefix_, event, type, percentiles);
+
+    return result;
+}
+
+
+/*****************************************************************************/
+/* EVENT HANDLE                                                              */
+/*****************************************************************************/
+
+void
+EventHandle::
+record(float value) const
+{
+    if (JML_LIKELY(aggregator != nullptr))
+        aggregator->record(value);
+    else if (events)
+        events->onEvent(prefix, event.c_str(), type, value);
+}
+
+
 /*****************************************************************************/
 /* SERVICE BASE                                                              */
 /*****************************************************************************/
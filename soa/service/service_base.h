@@ -23,6 +23,8 @@
 #include <mutex>
 #include <thread>
 #include <initializer_list>
+#include <functional>
+#include <vector>
 #include "jml/utils/exc_assert.h"
 #include "jml/utils/unnamed_bool.h"
 
@@ -36,6 +38,7 @@ namespace Datacratic {
 
 class MultiAggregator;
 class CarbonConnector;
+struct StatAggregator;
 
 /*****************************************************************************/
 /* EVENT SERVICE                                                             */
@@ -56,6 +59,20 @@ struct EventService {
     {
     }
 
+    /** Return the aggregator that the given event ends up in so that it can
+        be recorded to directly through an EventHandle.  Services that don't
+        aggregate locally return null and keep receiving the events through
+        onEvent.
+    */
+    virtual std::shared_ptr<StatAggregator>
+    getAggregator(const std::string & name,
+                  const std::string & event,
+                  StatEventType type,
+                  const std::vector<int> & percentiles)
+    {
+        return std::shared_ptr<StatAggregator>();
+    }
+
     /** Dump the content
     */
     std::map<std::string, double> get(std::ostream & output) const;
@@ -78,6 +95,12 @@ struct NullEventService : public EventService {
 
     virtual void dump(std::ostream & stream) const;
 
+    virtual std::shared_ptr<StatAggregator>
+    getAggregator(const std::string & name,
+                  const std::string & event,
+                  StatEventType type,
+                  const std::vector<int> & percentiles);
+
     std::unique_ptr<MultiAggregator> stats;
 };
 
@@ -102,6 +125,12 @@ struct CarbonEventService : public EventService {
                          float value,
                          std::initializer_list<int> extra = std::initializer_list<int>());
 
+    virtual std::shared_ptr<StatAggregator>
+    getAggregator(const std::string & name,
+                  const std::string & event,
+                  StatEventType type,
+                  const std::vector<int> & percentiles);
+
     std::shared_ptr<CarbonConnector> connector;
 };
 
@@ -443,6 +472,179 @@ struct ServiceProxies {
 };
 
 
+/*****************************************************************************/
+/* EVENT HANDLES                                                             */
+/*****************************************************************************/
+
+/** An event whose name was resolved once, when it was registered with
+    EventRecorder::counterHandle() and friends.  Recording through it doesn't
+    format or look up anything: with an event service that aggregates
+    locally the value goes straight to the aggregator, and otherwise it is
+    passed on to onEvent.
+
+    A default constructed handle, or one registered before the event service
+    was set up, records nothing.
+*/
+struct EventHandle {
+    EventHandle()
+        : type(ET_COUNT)
+    {
+    }
+
+    const std::string & eventName() const
+    {
+        return event;
+    }
+
+    JML_IMPLEMENT_OPERATOR_BOOL(events.get());
+
+protected:
+    friend struct EventRecorder;
+
+    void record(float value) const;
+
+    std::string prefix;
+    std::string event;
+    StatEventType type;
+    std::shared_ptr<EventService> events;
+    std::shared_ptr<StatAggregator> aggregator;
+};
+
+/** Handle to an ET_HIT or ET_COUNT event. */
+struct CounterHandle : public EventHandle {
+    CounterHandle(const EventHandle & handle = EventHandle())
+        : EventHandle(handle)
+    {
+    }
+
+    void hit() const
+    {
+        record(1.0);
+    }
+
+    void count(float count) const
+    {
+        record(count);
+    }
+};
+
+/** Handle to an ET_LEVEL or ET_STABLE_LEVEL event. */
+struct LevelHandle : public EventHandle {
+    LevelHandle(const EventHandle & handle = EventHandle())
+        : EventHandle(handle)
+    {
+    }
+
+    void level(float level) const
+    {
+        record(level);
+    }
+};
+
+/** Handle to an ET_OUTCOME event. */
+struct OutcomeHandle : public EventHandle {
+    OutcomeHandle(const EventHandle & handle = EventHandle())
+        : EventHandle(handle)
+    {
+    }
+
+    void outcome(float outcome) const
+    {
+        record(outcome);
+    }
+};
+
+/** Set of handles to events whose names differ by labels, such as the
+    account in "accounts.%s.bids".  Each %s in the pattern is replaced by a
+    label, in order.  The handle for a given set of labels is registered the
+    first time it is asked for and looked up in a small table afterwards;
+    callers that can should hold on to the handle itself.
+
+    Copies share the same table.
+*/
+template<typename Handle>
+struct EventFamily {
+    typedef std::function<EventHandle (const std::string &)> Register;
+
+    EventFamily()
+    {
+    }
+
+    EventFamily(const std::string & pattern, const Register & doRegister)
+        : state(std::make_shared<State>(pattern, doRegister))
+    {
+    }
+
+    const Handle & operator () (const std::string & label) const
+    {
+        const std::string * labels[1] = { &label };
+        return get(label, labels, 1);
+    }
+
+    const Handle & operator () (const std::string & label1,
+                                const std::string & label2) const
+    {
+        // Reuse the key's storage rather than allocate on every call
+        static thread_local std::string key;
+        key.assign(label1).append(1, '\0').append(label2);
+
+        const std::string * labels[2] = { &label1, &label2 };
+        return get(key, labels, 2);
+    }
+
+private:
+    struct State {
+        State(const std::string & pattern, const Register & doRegister)
+            : pattern(pattern), doRegister(doRegister)
+        {
+        }
+
+        std::string pattern;
+        Register doRegister;
+        ML::Spinlock lock;
+        std::unordered_map<std::string, Handle> handles;
+    };
+
+    const Handle & get(const std::string & key,
+                       const std::string * const * labels,
+                       int numLabels) const
+    {
+        static const Handle none;
+        if (!state) return none;
+
+        std::lock_guard<ML::Spinlock> guard(state->lock);
+        auto it = state->handles.find(key);
+        if (it != state->handles.end())
+            return it->second;
+
+        // Not on the fast path: build the name and register it
+        std::string name;
+        size_t pos = 0;
+        for (int i = 0;  i < numLabels;  ++i) {
+            size_t found = state->pattern.find("%s", pos);
+            if (found == std::string::npos)
+                throw ML::Exception("event pattern '%s' has fewer than %d "
+                                    "labels", state->pattern.c_str(),
+                                    numLabels);
+            name.append(state->pattern, pos, found - pos);
+            name.append(*labels[i]);
+            pos = found + 2;
+        }
+        name.append(state->pattern, pos, std::string::npos);
+
+        Handle handle(state->doRegister(name));
+        return state->handles.insert(std::make_pair(key, handle))
+            .first->second;
+    }
+
+    std::shared_ptr<State> state;
+};
+
+typedef EventFamily<CounterHandle> CounterFamily;
+typedef EventFamily<LevelHandle> LevelFamily;
+typedef EventFamily<OutcomeHandle> OutcomeFamily;
+
+
 /*****************************************************************************/
 /* EVENT RECORDER                                                            */
 /*****************************************************************************/
@@ -644,7 +846,74 @@ struct EventRecorder {
         recordEvent(event.c_str(), ET_STABLE_LEVEL, level);
     }
 
+
+    /*************************************************************************/
+    /* EVENT HANDLES                                                         */
+    /*************************************************************************/
+
+    /** Register an event up front and return a handle to record it with.
+        Meant for events recorded on hot paths, where the recordHit()
+        family's formatting and name lookup are too expensive.  The event
+        service needs to be set up already.
+    */
+    CounterHandle counterHandle(const std::string & event) const
+    {
+        return registerEvent(event, ET_COUNT);
+    }
+
+    LevelHandle levelHandle(const std::string & event) const
+    {
+        return registerEvent(event, ET_LEVEL);
+    }
+
+    LevelHandle stableLevelHandle(const std::string & event) const
+    {
+        return registerEvent(event, ET_STABLE_LEVEL);
+    }
+
+    OutcomeHandle outcomeHandle(const std::string & event,
+                                const std::vector<int> & percentiles
+                                    = DefaultOutcomePercentiles) const
+    {
+        return registerEvent(event, ET_OUTCOME, percentiles);
+    }
+
+    /** Same for events whose names contain labels; see EventFamily. */
+    CounterFamily counterFamily(const std::string & pattern) const
+    {
+        return CounterFamily(pattern, familyRegister(ET_COUNT));
+    }
+
+    LevelFamily levelFamily(const std::string & pattern) const
+    {
+        return LevelFamily(pattern, familyRegister(ET_LEVEL));
+    }
+
+    OutcomeFamily outcomeFamily(const std::string & pattern,
+                                const std::vector<int> & percentiles
+                                    = DefaultOutcomePercentiles) const
+    {
+        return OutcomeFamily(pattern, familyRegister(ET_OUTCOME, percentiles));
+    }
+
+    EventHandle registerEvent(const std::string & event,
+                              StatEventType type,
+                              const std::vector<int> & percentiles
+                                  = DefaultOutcomePercentiles) const;
+
 protected:
+    std::function<EventHandle (const std::string &)>
+    familyRegister(StatEventType type,
+                   const std::vector<int> & percentiles
+                       = DefaultOutcomePercentiles) const
+    {
+        EventRecorder recorder(*this);
+        return [=] (const std::string & event)
+            {
+                return recorder.registerEvent(event, type, percentiles);
+            };
+    }
+
     std::string eventPrefix_;
     std::shared_ptr<EventService> events_;
     std::shared_ptr<ServiceProxies> services_;
@@ -16,6 +16,10 @@
 #include "jml/utils/exc_check.h"
 #include <boost/tuple/tuple.hpp>
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <mutex>
 
 
 using namespace std;
@@ -30,7 +34,7 @@ namespace Datacratic {
 
 CounterAggregator::
 CounterAggregator()
-    : start(Date::now()), total(0.0),
+    : start(Date::now()),
       totalsBuffer() // Keep 10sec of data.
 {
 }
@@ -40,10 +44,21 @@ CounterAggregator::
 {
 }
 
+namespace {
+
+std::atomic<unsigned> nextCounterShard(0);
+__thread int counterShard = -1;
+
+} // file scope
+
 void
 CounterAggregator::
 record(float value)
 {
+    if (JML_UNLIKELY(counterShard == -1))
+        counterShard = nextCounterShard.fetch_add(1) % NumShards;
+
+    double & total = shards[counterShard].total;
     double oldval = total;
 
     while (!ML::cmp_xchg(total, oldval, oldval + value));
@@ -53,14 +68,18 @@ std::pair<double, Date>
 CounterAggregator::
 reset()
 {
-    double oldval = total;
+    double result = 0.0;
 
-    while (!ML::cmp_xchg(total, oldval, 0.0));
+    for (auto & shard: shards) {
+        double oldval = shard.total;
+        while (!ML::cmp_xchg(shard.total, oldval, 0.0));
+        result += oldval;
+    }
 
     Date oldStart = start;
     start = Date::now();
 
-    return make_pair(oldval, oldStart);
+    return make_pair(result, oldStart);
 }
 
 std::vector<StatReading>
@@ -91,99 +110,161 @@ read(const std::string & prefix)
 
 GaugeAggregator::
 GaugeAggregator(Verbosity verbosity, const std::vector<int>& extra)
-    : verbosity(verbosity), values(new ML::distribution<float>())
-    , extra(extra)
+    : verbosity(verbosity),
+      extra(extra),
+      minValue(numeric_limits<float>::infinity()),
+      maxValue(-numeric_limits<float>::infinity()),
+      counts(nullptr)
 {
     if (verbosity == Outcome)
         ExcCheck(this->extra.size() > 0, "Can not construct with empty percentiles");
-
-    values->reserve(100);
 }
 
 GaugeAggregator::
 ~GaugeAggregator()
 {
-    delete values;
+    delete[] counts.load();
+}
+
+std::atomic<uint32_t> *
+GaugeAggregator::
+getCounts()
+{
+    std::atomic<uint32_t> * current = counts.load(std::memory_order_acquire);
+    if (JML_LIKELY(current != nullptr))
+        return current;
+
+    std::unique_ptr<std::atomic<uint32_t>[]> fresh
+        (new std::atomic<uint32_t>[LogHistogram::NumBuckets]);
+    for (unsigned i = 0;  i < LogHistogram::NumBuckets;  ++i)
+        fresh[i].store(0, std::memory_order_relaxed);
+
+    // Someone else may have beaten us to it
+    if (counts.compare_exchange_strong(current, fresh.get()))
+        return fresh.release();
+    return current;
 }
 
 void
 GaugeAggregator::
 record(float value)
 {
-    ML::distribution<float> * current = values;
-    while ((current = values) == 0 || !cmp_xchg(values, current,
-                                     (ML::distribution<float>*)0));
-    
-    current->push_back(value);
+    if (JML_UNLIKELY(std::isnan(value)))
+        return;
+
+    if (JML_UNLIKELY(counterShard == -1))
+        counterShard = nextCounterShard.fetch_add(1) % NumShards;
 
-    memory_barrier();
+    getCounts()[LogHistogram::bucketOf(value)]
+        .fetch_add(1, std::memory_order_relaxed);
 
-    values = current;
+    double & sum = sums[counterShard].sum;
+    double oldSum = sum;
+    while (!cmp_xchg(sum, oldSum, oldSum + value));
+
+    // The extremes rarely move once a period has started so they're only
+    // written when they do.
+    float oldMin = minValue;
+    while (value < oldMin && !cmp_xchg(minValue, oldMin, value));
+
+    float oldMax = maxValue;
+    while (value > oldMax && !cmp_xchg(maxValue, oldMax, value));
 }
 
-std::pair<ML::distribution<float> *, Date>
+std::pair<LogHistogram, Date>
 GaugeAggregator::
 reset()
 {
-    ML::distribution<float> * current = values;
-    ML::distribution<float> * new_current = new ML::distribution<float>();
+    LogHistogram result;
+
+    if (std::atomic<uint32_t> * buckets = counts.load()) {
+        int first = 0, last = LogHistogram::NumBuckets - 1;
+        while (first <= last && !buckets[first].load(std::memory_order_relaxed))
+            ++first;
+        while (last > first && !buckets[last].load(std::memory_order_relaxed))
+            --last;
+
+        // Values recorded meanwhile outside of [first, last] are left for
+        // the next call.
+        if (first <= last) {
+            result.cover(first, last);
+            for (int i = first;  i <= last;  ++i) {
+                uint32_t added = buckets[i].exchange(0);
+                result.counts[i - first] = added;
+                result.count_ += added;
+            }
+        }
+    }
+
+    for (auto & shard: sums) {
+        double oldSum = shard.sum;
+        while (!cmp_xchg(shard.sum, oldSum, 0.0));
+        result.sum_ += oldSum;
+    }
 
-    // TODO: reserve memory for new_current
+    float oldMin = minValue;
+    while (!cmp_xchg(minValue, oldMin, numeric_limits<float>::infinity()));
 
-    while ((current = values) == 0 || !cmp_xchg(values, current, new_current));
+    float oldMax = maxValue;
+    while (!cmp_xchg(maxValue, oldMax, -numeric_limits<float>::infinity()));
 
-    // Date oldStart = start;
-    start = Date::now();
+    // Another reset may have taken the buckets that go with these
+    if (result.count_) {
+        result.min_ = oldMin;
+        result.max_ = oldMax;
+    }
+
+    result.fixExtremes();
+
+    Date oldStart;
+    {
+        std::lock_guard<ML::Spinlock> guard(startLock);
+        oldStart = start;
+        start = Date::now();
+    }
 
-    return make_pair(current, start);
+    return make_pair(std::move(result), oldStart);
 }
 
 std::vector<StatReading>
 GaugeAggregator::
 read(const std::string & prefix)
 {
-    ML::distribution<float> * values;
+    LogHistogram values;
     Date oldStart;
 
     boost::tie(values, oldStart) = reset();
 
-    std::auto_ptr<ML::distribution<float> > vptr(values);
-
-    if (values->empty())
+    if (values.empty())
         return vector<StatReading>();
+
+    Date readingDate;
+    {
+        std::lock_guard<ML::Spinlock> guard(startLock);
+        readingDate = start;
+    }
     
     vector<StatReading> result;
 
     auto addMetric = [&] (const char * name, double value)
         {
             result.push_back(StatReading(prefix + "." + name,
-                                         value, start));
+                                         value, readingDate));
         };
     
-    auto percentile = [&] (float outOf100) -> double
-        {
-            int element
-                = std::max(0,
-                           std::min<int>(values->size() - 1,
-                                         outOf100 / 100.0 * values->size()));
-            return (*values)[element];
-        };
-    
-    std::sort(values->begin(), values->end(),
-              ML::safe_less<float>());
-
     if (verbosity == StableLevel)
-        result.push_back(StatReading(prefix, values->mean(), start));
+        result.push_back(StatReading(prefix, values.mean(), readingDate));
     
     else {
-        addMetric("mean", values->mean());
-        addMetric("upper", values->back());
-        addMetric("lower", values->front());
+        addMetric("mean", values.mean());
+        addMetric("upper", values.max());
+        addMetric("lower", values.min());
 
         if (verbosity == Outcome) {
-            addMetric("count", values->size());
+            addMetric("count", values.count());
             for (int pct: extra) {
-                addMetric(ML::format("upper_%d", pct).c_str(), percentile(pct));
+                addMetric(ML::format("upper_%d", pct).c_str(),
+                          values.percentile(pct));
             }
         }
     }
@@ -11,11 +11,15 @@
 #include "jml/stats/distribution.h"
 #include <boost/thread.hpp>
 #include "soa/types/date.h"
+#include "jml/arch/spinlock.h"
 #include "stats_events.h"
+#include "log_histogram.h"
 #include <unordered_map>
 #include <map>
 #include <deque>
 #include <boost/scoped_ptr.hpp>
+#include <atomic>
+#include <memory>
 
 
 namespace Datacratic {
@@ -59,7 +63,12 @@ struct StatAggregator {
 /* COUNTER AGGREGATOR                                                        */
 /*****************************************************************************/
 
-/** Class that aggregates counts over a period of time. */
+/** Class that aggregates counts over a period of time.
+
+    The total is split over a few cache lines and each thread adds into the
+    one it was assigned, so that threads hitting the same counter don't
+    fight over a single word.  reset() adds them back up.
+*/
 
 struct CounterAggregator : public StatAggregator {
     CounterAggregator();
@@ -75,8 +84,16 @@ struct CounterAggregator : public StatAggregator {
     virtual std::vector<StatReading> read(const std::string & prefix);
 
 private:
+    enum { NumShards = 8 };
+
+    struct Shard {
+        Shard() : total(0.0) {}
+        double total;
+        char padding[64 - sizeof(double)];
+    };
+
     Date start;    //< Date at which we last cleared the counter
-    double total;  //< total since we last added it up
+    Shard shards[NumShards];  //< totals since we last added them up
 
     std::deque<double> totalsBuffer; //< Totals for the last n reads.
 
@@ -87,7 +104,15 @@ private:
 /* GAUGE AGGREGATOR                                                          */
 /*****************************************************************************/
 
-/** Class that aggregates a gauge over a period of time. */
+/** Class that aggregates a gauge over a period of time.
+
+    Values go into a LogHistogram-shaped set of buckets rather than being
+    kept one by one, so the memory used and the time taken by read() don't
+    grow with the rate at which values are recorded.  The buckets are only
+    allocated once a value is recorded, and reset() takes what each one
+    holds with an atomic exchange.  The sum is split over a few cache lines
+    like the total of a CounterAggregator.
+*/
 
 struct GaugeAggregator : public StatAggregator {
 
@@ -103,11 +128,14 @@ struct GaugeAggregator : public StatAggregator {
 
     virtual ~GaugeAggregator();
 
-    /** Record a new value of the stat.  Lock-free but may spin briefly. */
+    /** Record a new value of the stat.  Lock-free. */
     virtual void record(float value);
 
-    /** Obtain a the current statistics and replace with a new version. */
-    std::pair<ML::distribution<float> *, Date> reset();
+    /** Obtain the values recorded since the last call.  Can be called
+        from several threads at once; each value goes to exactly one of
+        them.
+    */
+    std::pair<LogHistogram, Date> reset();
 
     /** Read and reset the counter, providing output in Graphite's preferred
         format.
@@ -115,10 +143,29 @@ struct GaugeAggregator : public StatAggregator {
     virtual std::vector<StatReading> read(const std::string & prefix);
 
 private:
+    enum { NumShards = 8 };
+
+    struct Shard {
+        Shard() : sum(0.0) {}
+        double sum;
+        char padding[64 - sizeof(double)];
+    };
+
     Verbosity verbosity;
     Date start;  //< Date at which we last cleared the counter
-    ML::distribution<float> * volatile values;  //< List of added values
+    ML::Spinlock startLock;  //< protects start
     std::vector<int> extra;
+
+    Shard sums[NumShards];       //< sum of the values since the last reset
+    float minValue;              //< smallest value since the last reset
+    float maxValue;              //< largest value since the last reset
+
+    /** Buckets of a LogHistogram.  Null until the first value is recorded
+        since many gauges never see one.
+    */
+    std::atomic<std::atomic<uint32_t> *> counts;
+
+    std::atomic<uint32_t> * getCounts();
 };
 
 
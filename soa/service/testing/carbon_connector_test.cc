@@ -88,32 +88,24 @@ BOOST_AUTO_TEST_CASE( test_gauge_aggregator )
 
     boost::mutex mutex;
 
-    ML::distribution<float> allValues;
+    LogHistogram allValues;
 
     for (unsigned i = 0;  i < nthreads;  ++i) {
         auto doThread = [&] ()
             {
-                ML::distribution<float> threadValues;
+                LogHistogram threadValues;
 
                 barrier.wait();
 
                 for (unsigned i = 0;  i < iter;  ++i) {
                     aggregator.record(1.0 + (i % 2));
 
-                    if (random() % 1000 == 0) {
-                        ML::distribution<float> * values
-                            = aggregator.reset().first;
-                       
-                        threadValues.insert(threadValues.end(),
-                                            values->begin(), values->end());
-
-                        delete values;
-                    }
+                    if (random() % 1000 == 0)
+                        threadValues.merge(aggregator.reset().first);
                 }
                 
                 boost::lock_guard<boost::mutex> lock(mutex);
-                allValues.insert(allValues.end(),
-                                 threadValues.begin(), threadValues.end());
+                allValues.merge(threadValues);
             };
         
         tg.create_thread(doThread);
@@ -121,16 +113,16 @@ BOOST_AUTO_TEST_CASE( test_gauge_aggregator )
 
     tg.join_all();
 
-    ML::distribution<float> * values
-        = aggregator.reset().first;
-    
-    allValues.insert(allValues.end(),
-                     values->begin(), values->end());
-    std::sort(allValues.begin(), allValues.end());
+    allValues.merge(aggregator.reset().first);
 
-    BOOST_CHECK_EQUAL(allValues.size(), iter * nthreads);
+    BOOST_CHECK_EQUAL(allValues.count(), iter * nthreads);
     BOOST_CHECK_EQUAL(allValues.mean(), 1.5);
-    BOOST_CHECK_EQUAL(allValues.std(), 0.5);
+    BOOST_CHECK_EQUAL(allValues.min(), 1.0);
+    BOOST_CHECK_EQUAL(allValues.max(), 2.0);
+    BOOST_CHECK_EQUAL(allValues.bucketCount(LogHistogram::bucketOf(1.0)),
+                      iter * nthreads / 2);
+    BOOST_CHECK_EQUAL(allValues.bucketCount(LogHistogram::bucketOf(2.0)),
+                      iter * nthreads / 2);
 }
 
 BOOST_AUTO_TEST_CASE( test_multi_aggregator )
@@ -169,6 +161,38 @@ BOOST_AUTO_TEST_CASE( test_multi_aggregator )
     BOOST_CHECK_EQUAL(readings[0].value, 50.0);
 }
 
+BOOST_AUTO_TEST_CASE( test_multi_aggregator_get_stat )
+{
+    std::vector<StatReading> readings;
+
+    boost::mutex m;
+    m.lock();
+
+    auto recordReading = [&] (const std::vector<StatReading> & stats)
+        {
+            readings.insert(readings.end(), stats.begin(), stats.end());
+            m.unlock();
+        };
+
+    MultiAggregator agg("hello", recordReading, 0.0);
+
+    // Records through the handle and by name end up in the same stat
+    auto stat = agg.getStat("hits", ET_COUNT);
+    BOOST_CHECK_EQUAL(stat, agg.getStat("hits", ET_COUNT));
+
+    for (unsigned i = 0;  i < 10;  ++i) {
+        stat->record(1.0);
+        agg.recordHit("hits");
+    }
+
+    agg.dump();
+    m.lock();
+
+    BOOST_REQUIRE_EQUAL(readings.size(), 1);
+    BOOST_CHECK_EQUAL(readings[0].name, "hits");
+    BOOST_CHECK_EQUAL(readings[0].value, 20.0);
+}
+
 struct FakeCarbon : public PassiveEndpointT<SocketTransport> {
 
     FakeCarbon()
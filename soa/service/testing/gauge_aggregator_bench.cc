@@ -0,0 +1,156 @@
+/* gauge_aggregator_bench.cc
+   Copyright (c) 2014 Datacratic.  All rights reserved.
+
+   Measures GaugeAggregator as a number of threads record into it while
+   another one reads it every so often, like the carbon dump thread does.
+   The previous implementation, which kept every value in a distribution
+   and sorted it on read, serves as the baseline.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "soa/service/stat_aggregator.h"
+#include "jml/arch/cmp_xchg.h"
+#include "jml/arch/atomic_ops.h"
+#include "jml/arch/timers.h"
+#include "jml/arch/format.h"
+#include "jml/utils/floating_point.h"
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+using namespace ML;
+using namespace std;
+using namespace Datacratic;
+
+namespace {
+
+enum {
+    NumValues = 4000000
+};
+
+struct DistributionGauge {
+    DistributionGauge()
+        : values(new distribution<float>())
+    {
+    }
+
+    ~DistributionGauge()
+    {
+        delete values;
+    }
+
+    void record(float value)
+    {
+        distribution<float> * current;
+        while ((current = values) == 0
+               || !cmp_xchg(values, current, (distribution<float> *)0));
+        current->push_back(value);
+        memory_barrier();
+        values = current;
+    }
+
+    double read()
+    {
+        distribution<float> * current;
+        distribution<float> * next = new distribution<float>();
+        while ((current = values) == 0 || !cmp_xchg(values, current, next));
+
+        std::unique_ptr<distribution<float> > vptr(current);
+        if (current->empty())
+            return 0.0;
+
+        std::sort(current->begin(), current->end(), safe_less<float>());
+        return (*current)[current->size() * 9 / 10];
+    }
+
+    distribution<float> * volatile values;
+};
+
+struct HistogramGauge {
+    void record(float value)
+    {
+        aggregator.record(value);
+    }
+
+    double read()
+    {
+        return aggregator.reset().first.percentile(90);
+    }
+
+    GaugeAggregator aggregator;
+};
+
+/** Returns the number of values recorded per second with numWriters
+    recording and one thread reading every millisecond, along with the
+    average time taken by a read in microseconds.
+*/
+template<typename Gauge>
+std::pair<double, double> run(int numWriters)
+{
+    Gauge gauge;
+    int perWriter = NumValues / numWriters;
+
+    std::atomic<bool> finished(false);
+    double readTime = 0.0;
+    int numReads = 0;
+
+    auto reader = [&] () {
+        while (!finished) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            Timer timer;
+            gauge.read();
+            readTime += timer.elapsed_wall();
+            ++numReads;
+        }
+    };
+
+    auto writer = [&] (int seed) {
+        unsigned value = seed;
+        for (int i = 0;  i < perWriter;  ++i) {
+            value = value * 1103515245 + 12345;
+            gauge.record((value >> 16) % 100 + 0.5);
+        }
+    };
+
+    Timer timer;
+
+    std::thread readerThread(reader);
+
+    vector<thread> writers;
+    for (int i = 0;  i < numWriters;  ++i)
+        writers.emplace_back(writer, i);
+
+    for (auto & t: writers)
+        t.join();
+
+    double elapsed = timer.elapsed_wall();
+
+    finished = true;
+    readerThread.join();
+
+    return make_pair(perWriter * numWriters / elapsed,
+                     numReads ? readTime / numReads * 1000000.0 : 0.0);
+}
+
+} // file scope
+
+BOOST_AUTO_TEST_CASE( gauge_aggregator_bench )
+{
+    for (int numWriters: { 1, 2, 4, 8, 16 }) {
+        auto distribution = run<DistributionGauge>(numWriters);
+        auto histogram = run<HistogramGauge>(numWriters);
+
+        cerr << format("%2d writers: distribution %12.0f/s %8.1fus/read  "
+                       "histogram %12.0f/s %8.1fus/read",
+                       numWriters,
+                       distribution.first, distribution.second,
+                       histogram.first, histogram.second)
+             << endl;
+    }
+}
@@ -4,6 +4,7 @@
 #include <iostream>
 #include <boost/test/unit_test.hpp>
 
+#include "soa/service/http_header.h"
 #include "soa/service/http_parsers.h"
 #include "soa/utils/print_utils.h"
 
@@ -255,3 +256,141 @@ BOOST_AUTO_TEST_CASE( http_parser_chunked_encoding_test )
     BOOST_CHECK_EQUAL(numResponses, 3);
 }
 #endif
+
+#if 1
+/* Feeds a request to HttpRequestParser in one go and then byte by byte, and
+ * checks that the same request comes out both ways. */
+BOOST_AUTO_TEST_CASE( http_request_parser_test )
+{
+    string request("POST /auctions?id=12&name=a%20b+c&flag HTTP/1.1\r\n"
+                   "Host: example.com\r\n"
+                   "content-type:   application/json  \r\n"
+                   "X-OpenRTB-Version: 2.1\r\n"
+                   "Content-Length: 13\r\n"
+                   "\r\n"
+                   "{\"id\":\"1234\"}");
+
+    int numHeaders(0), numRequests(0);
+    string verb, resource, query, version, host, contentType, openrtbVersion;
+    string body;
+    const char * bodyPtr(nullptr);
+    HttpHeader header;
+
+    HttpRequestParser parser;
+    parser.onHeader = [&] (const HttpRequestParser::Request & request) {
+        numHeaders++;
+        BOOST_CHECK(request.body.empty());
+    };
+    parser.onRequest = [&] (const HttpRequestParser::Request & request) {
+        numRequests++;
+        verb = request.verb.str();
+        resource = request.resource.str();
+        query = request.query.str();
+        version = request.version.str();
+        host = request.known[HttpRequestParser::HOST].str();
+        contentType = request.getHeader("Content-Type").str();
+        openrtbVersion = request.getHeader("x-openrtb-version").str();
+        body = request.body.str();
+        bodyPtr = request.body.data;
+        request.toHttpHeader(header);
+    };
+
+    parser.feed(request.c_str(), request.size());
+    BOOST_CHECK_EQUAL(numHeaders, 1);
+    BOOST_CHECK_EQUAL(numRequests, 1);
+    BOOST_CHECK_EQUAL(parser.buffered(), 0);
+    BOOST_CHECK_EQUAL(verb, "POST");
+    BOOST_CHECK_EQUAL(resource, "/auctions");
+    BOOST_CHECK_EQUAL(query, "id=12&name=a%20b+c&flag");
+    BOOST_CHECK_EQUAL(version, "HTTP/1.1");
+    BOOST_CHECK_EQUAL(host, "example.com");
+    BOOST_CHECK_EQUAL(contentType, "application/json");
+    BOOST_CHECK_EQUAL(openrtbVersion, "2.1");
+    BOOST_CHECK_EQUAL(body, "{\"id\":\"1234\"}");
+
+    /* a request received in one piece is not copied */
+    BOOST_CHECK(bodyPtr == request.c_str() + request.size() - 13);
+
+    BOOST_CHECK_EQUAL(header.verb, "POST");
+    BOOST_CHECK_EQUAL(header.resource, "/auctions");
+    BOOST_CHECK_EQUAL(header.contentType, "application/json");
+    BOOST_CHECK_EQUAL(header.contentLength, 13);
+    BOOST_CHECK_EQUAL(header.queryParams.size(), 3);
+    BOOST_CHECK_EQUAL(header.queryParams.getValue("name"), "a b c");
+    BOOST_CHECK(header.queryParams.hasValue("flag"));
+    BOOST_CHECK_EQUAL(header.tryGetHeader("x-openrtb-version"), "2.1");
+    BOOST_CHECK_EQUAL(header.tryGetHeader("host"), "example.com");
+
+    body.clear();
+    for (size_t i = 0; i < request.size(); i++) {
+        parser.feed(request.c_str() + i, 1);
+        if (i < request.size() - 1) {
+            BOOST_CHECK_EQUAL(numRequests, 1);
+        }
+    }
+    BOOST_CHECK_EQUAL(numHeaders, 2);
+    BOOST_CHECK_EQUAL(numRequests, 2);
+    BOOST_CHECK_EQUAL(parser.buffered(), 0);
+    BOOST_CHECK_EQUAL(resource, "/auctions");
+    BOOST_CHECK_EQUAL(contentType, "application/json");
+    BOOST_CHECK_EQUAL(body, "{\"id\":\"1234\"}");
+
+    /* pipelined requests, the second one without a body */
+    string twoRequests = request + "GET /ready HTTP/1.1\r\n\r\n";
+    parser.feed(twoRequests.c_str(), twoRequests.size());
+    BOOST_CHECK_EQUAL(numRequests, 4);
+    BOOST_CHECK_EQUAL(verb, "GET");
+    BOOST_CHECK_EQUAL(resource, "/ready");
+    BOOST_CHECK_EQUAL(body, "");
+}
+#endif
+
+#if 1
+BOOST_AUTO_TEST_CASE( http_request_parser_chunked_test )
+{
+    int numRequests(0);
+    string body;
+
+    HttpRequestParser parser;
+    parser.onRequest = [&] (const HttpRequestParser::Request & request) {
+        numRequests++;
+        BOOST_CHECK(request.isChunked);
+        body = request.body.str();
+    };
+
+    parser.feed("PUT /data HTTP/1.1\r\n"
+                "Transfer-Encoding: chunked\r\n"
+                "\r\n"
+                "5;ext=1\r\nhello\r\n");
+    BOOST_CHECK_EQUAL(numRequests, 0);
+    parser.feed("1\r\n \r\n5\r\nworld\r\n0\r\n");
+    BOOST_CHECK_EQUAL(numRequests, 0);
+    parser.feed("\r\n");
+    BOOST_CHECK_EQUAL(numRequests, 1);
+    BOOST_CHECK_EQUAL(body, "hello world");
+}
+#endif
+
+#if 1
+BOOST_AUTO_TEST_CASE( http_request_parser_errors_test )
+{
+    auto parse = [] (const string & data) {
+        HttpRequestParser parser(1024);
+        parser.feed(data.c_str(), data.size());
+    };
+
+    BOOST_CHECK_THROW(parse("GET /\r\n\r\n"), ML::Exception);
+    BOOST_CHECK_THROW(parse("GET / FTP/1.0\r\n\r\n"), ML::Exception);
+    BOOST_CHECK_THROW(parse("GET / HTTP/1.1\r\nNoColon\r\n\r\n"),
+                      ML::Exception);
+    BOOST_CHECK_THROW(parse("GET / HTTP/1.1\r\nA: b\r\n c\r\n\r\n"),
+                      ML::Exception);
+    BOOST_CHECK_THROW(parse("POST / HTTP/1.1\r\nContent-Length: 1x\r\n\r\n"),
+                      ML::Exception);
+    BOOST_CHECK_THROW(parse("POST / HTTP/1.1\r\n"
+                            "Transfer-Encoding: gzip\r\n\r\n"),
+                      ML::Exception);
+    BOOST_CHECK_THROW(parse("GET / HTTP/1.1\r\nA: " + string(2000, 'a')),
+                      ML::Exception);
+}
+#endif
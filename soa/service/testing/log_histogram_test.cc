@@ -0,0 +1,194 @@
+/* log_histogram_test.cc
+   Copyright (c) 2014 Datacratic.  All rights reserved.
+
+   Checks the percentiles of LogHistogram against the ones that were
+   computed by sorting all of the values.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "soa/service/log_histogram.h"
+#include "soa/service/stat_aggregator.h"
+#include "jml/stats/distribution.h"
+#include "jml/utils/floating_point.h"
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <random>
+
+using namespace std;
+using namespace Datacratic;
+
+namespace {
+
+/** What GaugeAggregator reported before it used a LogHistogram. */
+double exactPercentile(const ML::distribution<float> & sorted, float outOf100)
+{
+    int element
+        = std::max(0,
+                   std::min<int>(sorted.size() - 1,
+                                 outOf100 / 100.0 * sorted.size()));
+    return sorted[element];
+}
+
+/** Record values into a histogram and check that every percentile is within
+    a percent of the exact one; buckets are 1.6% wide.
+*/
+void checkAccuracy(const ML::distribution<float> & values)
+{
+    LogHistogram histogram;
+    for (float value: values)
+        histogram.record(value);
+
+    ML::distribution<float> sorted = values;
+    std::sort(sorted.begin(), sorted.end(), ML::safe_less<float>());
+
+    BOOST_CHECK_EQUAL(histogram.count(), values.size());
+    BOOST_CHECK_CLOSE(histogram.mean(), values.mean(), 0.001);
+    BOOST_CHECK_EQUAL(histogram.min(), sorted.front());
+    BOOST_CHECK_EQUAL(histogram.max(), sorted.back());
+
+    for (float pct: { 1.0, 10.0, 50.0, 90.0, 95.0, 98.0, 99.0, 99.9 }) {
+        double exact = exactPercentile(sorted, pct);
+        BOOST_CHECK_CLOSE(histogram.percentile(pct), exact, 1.0);
+    }
+}
+
+} // file scope
+
+BOOST_AUTO_TEST_CASE( test_log_histogram_buckets )
+{
+    // Buckets increase with the value
+    vector<float> values;
+    for (float value = 1e-6;  value < 1e12;  value *= 1.001) {
+        values.push_back(value);
+        values.push_back(-value);
+    }
+    std::sort(values.begin(), values.end());
+
+    for (unsigned i = 1;  i < values.size();  ++i)
+        BOOST_CHECK_LE(LogHistogram::bucketOf(values[i - 1]),
+                       LogHistogram::bucketOf(values[i]));
+
+    BOOST_CHECK_EQUAL(LogHistogram::bucketOf(0.0), LogHistogram::ZeroBucket);
+    BOOST_CHECK_EQUAL(LogHistogram::bucketOf(-0.0), LogHistogram::ZeroBucket);
+    BOOST_CHECK_EQUAL(LogHistogram::bucketOf(1e-6), LogHistogram::ZeroBucket);
+    BOOST_CHECK_EQUAL(LogHistogram::bucketOf(INFINITY),
+                      LogHistogram::NumBuckets - 1);
+    BOOST_CHECK_EQUAL(LogHistogram::bucketOf(-INFINITY), 0);
+
+    // Every value is close to the value of its bucket
+    for (float value = 0.002;  value < 1e10;  value *= 1.01) {
+        double bucketValue
+            = LogHistogram::bucketValue(LogHistogram::bucketOf(value));
+        BOOST_CHECK_CLOSE(bucketValue, value, 1.0);
+        BOOST_CHECK_EQUAL(LogHistogram::bucketValue(
+                                  LogHistogram::bucketOf(-value)),
+                          -bucketValue);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_log_histogram_accuracy )
+{
+    std::mt19937 rng(42);
+
+    // Latencies in ms
+    {
+        std::lognormal_distribution<float> latency(2.0, 1.0);
+        ML::distribution<float> values;
+        for (unsigned i = 0;  i < 100000;  ++i)
+            values.push_back(latency(rng));
+        checkAccuracy(values);
+    }
+
+    // Prices in micros, with some negative adjustments
+    {
+        std::uniform_real_distribution<float> price(-1000.0, 1000000.0);
+        ML::distribution<float> values;
+        for (unsigned i = 0;  i < 100000;  ++i)
+            values.push_back(price(rng));
+        checkAccuracy(values);
+    }
+
+    // A handful of values
+    checkAccuracy(ML::distribution<float>({ 3.0 }));
+    checkAccuracy(ML::distribution<float>({ 1.0, 2.0, 3.0, 4.0, 5.0 }));
+}
+
+BOOST_AUTO_TEST_CASE( test_log_histogram_merge )
+{
+    LogHistogram all, first, second;
+
+    for (unsigned i = 0;  i < 1000;  ++i) {
+        float value = i * 0.5;
+        all.record(value);
+        (i % 3 ? first : second).record(value);
+    }
+
+    first.merge(second);
+
+    BOOST_CHECK_EQUAL(first.count(), all.count());
+    BOOST_CHECK_EQUAL(first.sum(), all.sum());
+    BOOST_CHECK_EQUAL(first.min(), all.min());
+    BOOST_CHECK_EQUAL(first.max(), all.max());
+    for (unsigned i = 0;  i < LogHistogram::NumBuckets;  ++i)
+        BOOST_CHECK_EQUAL(first.bucketCount(i), all.bucketCount(i));
+
+    // NaN is ignored
+    first.record(NAN);
+    BOOST_CHECK_EQUAL(first.count(), all.count());
+
+    first.clear();
+    BOOST_CHECK(first.empty());
+    BOOST_CHECK_EQUAL(first.percentile(50), 0.0);
+
+    // Histograms covering ranges far apart
+    LogHistogram low, high;
+    low.record(0.01);
+    high.record(-5.0);
+    high.record(1e9);
+    low.merge(high);
+    low.record(1e6);
+
+    BOOST_CHECK_EQUAL(low.count(), 4);
+    for (float value: { 0.01, -5.0, 1e9, 1e6 })
+        BOOST_CHECK_EQUAL(low.bucketCount(LogHistogram::bucketOf(value)), 1);
+    BOOST_CHECK_EQUAL(low.percentile(0), -5.0);
+    BOOST_CHECK_CLOSE(low.percentile(99), 1e9, 1.0);
+}
+
+BOOST_AUTO_TEST_CASE( test_gauge_aggregator_read )
+{
+    GaugeAggregator aggregator(GaugeAggregator::Outcome, { 50, 90 });
+
+    for (unsigned i = 1;  i <= 1000;  ++i)
+        aggregator.record(i);
+
+    auto readings = aggregator.read("latency");
+
+    std::map<std::string, float> values;
+    for (auto & reading: readings)
+        values[reading.name] = reading.value;
+
+    BOOST_CHECK_EQUAL(values.size(), 6);
+    BOOST_CHECK_EQUAL(values["latency.count"], 1000);
+    BOOST_CHECK_EQUAL(values["latency.mean"], 500.5);
+    BOOST_CHECK_EQUAL(values["latency.lower"], 1);
+    BOOST_CHECK_EQUAL(values["latency.upper"], 1000);
+    BOOST_CHECK_CLOSE(values["latency.upper_50"], 501, 1.0);
+    BOOST_CHECK_CLOSE(values["latency.upper_90"], 901, 1.0);
+
+    // Nothing was recorded since the last read
+    BOOST_CHECK(aggregator.read("latency").empty());
+
+    aggregator.record(7.0);
+    readings = aggregator.read("latency");
+    BOOST_REQUIRE_EQUAL(readings.size(), 6);
+    for (auto & reading: readings) {
+        if (reading.name == "latency.count")
+            BOOST_CHECK_EQUAL(reading.value, 1);
+        else BOOST_CHECK_EQUAL(reading.value, 7.0);
+    }
+}
@@ -209,4 +209,74 @@ BOOST_AUTO_TEST_CASE( test_typed_message_queue )
     }
 }
 
+
+BOOST_AUTO_TEST_CASE( test_typed_message_batch_sink )
+{
+    const int numThreads(8);
+    const int numMessages(100000);
+
+    ML::Watchdog watchdog(60);
+
+    MessageLoop loop;
+    loop.start();
+
+    /* messages are (thread, sequence number) pairs */
+    TypedMessageBatchSink<pair<int, int> > sink;
+
+    vector<int> lastSeen(numThreads, -1);
+    std::atomic<int> numReceived(0);
+    std::atomic<int> numBatches(0);
+    std::atomic<int> numErrors(0);
+
+    sink.onBatch = [&] (vector<pair<int, int> > && batch) {
+        numBatches++;
+        for (size_t i = 0;  i < batch.size();  ++i) {
+            auto & msg = batch[i];
+
+            /* each writer's messages come out in order */
+            if (msg.second != lastSeen[msg.first] + 1)
+                numErrors++;
+            lastSeen[msg.first] = msg.second;
+
+            /* a pushBatch of 10 is never split */
+            if (msg.second % 10 == 0 && (i + 10 > batch.size()
+                    || batch[i + 9] != make_pair(msg.first, msg.second + 9)))
+                numErrors++;
+        }
+        numReceived += batch.size();
+    };
+    loop.addSource("sink", sink);
+
+    auto threadFn = [&] (int threadNum) {
+        for (int i = 0;  i < numMessages;  i += 10) {
+            vector<pair<int, int> > batch;
+            for (int j = 0;  j < 10;  ++j)
+                batch.emplace_back(threadNum, i + j);
+            sink.pushBatch(std::move(batch));
+        }
+    };
+
+    vector<thread> workers;
+    for (int i = 0;  i < numThreads;  i++)
+        workers.emplace_back(threadFn, i);
+    for (thread & worker: workers)
+        worker.join();
+
+    while (numReceived < numThreads * numMessages)
+        ML::sleep(0.01);
+
+    cerr << "received " << numReceived << " messages in " << numBatches
+         << " batches" << endl;
+
+    BOOST_CHECK_EQUAL(numErrors, 0);
+    BOOST_CHECK_EQUAL(sink.size(), 0);
+
+    /* a single message is delivered too */
+    sink.push(make_pair(0, numMessages));
+    while (numReceived < numThreads * numMessages + 1)
+        ML::sleep(0.01);
+
+    loop.shutdown();
+}
+
 } // namespace Datacratic
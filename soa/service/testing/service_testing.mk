@@ -28,6 +28,8 @@ $(eval $(call nodejs_test,opstats_js_test,opstats,,,manual))
 
 $(eval $(call test,statsd_connector_test,opstats,boost  manual))
 $(eval $(call test,carbon_connector_test,opstats endpoint,boost manual))
+$(eval $(call test,log_histogram_test,opstats,boost))
+$(eval $(call test,gauge_aggregator_bench,opstats,boost manual))
 
 $(eval $(call test,endpoint_unit_test,endpoint,boost))
 $(eval $(call test,test_active_endpoint_nothing_listening,endpoint,boost manual))
@@ -68,6 +70,9 @@ $(eval $(call test,http_parsers_test,services test_services,boost valgrind))
 
 $(eval $(call test,logs_test,services,boost))
 
+$(eval $(call test,timing_wheel_map_test,types,boost))
+$(eval $(call test,timeout_map_bench,types,boost manual))
+
 $(eval $(call test,sns_mock_test,cloud services,boost))
 $(eval $(call test,zmq_message_loop_test,services,boost))
 
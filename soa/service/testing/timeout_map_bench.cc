@@ -0,0 +1,94 @@
+/* timeout_map_bench.cc
+   Copyright (c) 2012 Datacratic.  All rights reserved.
+
+   Compare TimeoutMap and TimingWheelMap under a router-like in-flight
+   auction load: millions of outstanding entries, most of which are erased
+   before they time out, with the rest being expired in batches.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <iostream>
+#include "jml/arch/timers.h"
+#include "soa/service/timeout_map.h"
+#include "soa/service/timing_wheel_map.h"
+#include "soa/types/id.h"
+
+
+using namespace std;
+using namespace Datacratic;
+
+namespace {
+
+struct AuctionInfo {
+    AuctionInfo(uint64_t n = 0)
+        : n(n)
+    {
+    }
+
+    uint64_t n;
+};
+
+/** Simulates numRequests auctions arriving at qps, each staying in flight
+    for timeout seconds unless it is erased first (every other one is, as
+    when a bid comes back).  Expiry runs every 10ms of simulated time.
+*/
+template<typename Map>
+void bench(const std::string & name, Map & map,
+           size_t numOutstanding, size_t numRequests)
+{
+    double qps = 50000;
+    double timeout = numOutstanding / qps;
+    Date start = Date::fromSecondsSinceEpoch(1000000);
+    Date lastExpiry = start;
+    size_t numExpired = 0;
+
+    auto onExpire = [&] (const Id & id, const AuctionInfo & info)
+        {
+            ++numExpired;
+            return Date();
+        };
+
+    ML::Timer timer;
+
+    for (size_t i = 0;  i < numRequests;  ++i) {
+        Date now = start.plusSeconds(i / qps);
+        map.insert(Id(i + 1), AuctionInfo(i), now.plusSeconds(timeout));
+
+        // Bids come back for half of the auctions while in flight
+        if (i >= 1000 && i % 2 == 0)
+            map.erase(Id(i + 1 - 1000));
+
+        if (now.secondsSince(lastExpiry) >= 0.01) {
+            map.expire(onExpire, now);
+            lastExpiry = now;
+        }
+    }
+
+    double elapsed = timer.elapsed_wall();
+
+    cerr << name << ": " << numRequests << " requests with "
+         << numOutstanding << " outstanding in " << elapsed << "s ("
+         << numRequests / elapsed << " requests/s, "
+         << elapsed / numRequests * 1e9 << "ns/request); "
+         << numExpired << " expired, " << map.size() << " left" << endl;
+}
+
+} // file scope
+
+BOOST_AUTO_TEST_CASE( bench_timeout_maps )
+{
+    for (size_t numOutstanding: { 100000, 1000000, 4000000 }) {
+        size_t numRequests = numOutstanding * 4;
+        {
+            TimeoutMap<Id, AuctionInfo> map;
+            bench("TimeoutMap", map, numOutstanding, numRequests);
+        }
+        {
+            TimingWheelMap<Id, AuctionInfo> map;
+            bench("TimingWheelMap", map, numOutstanding, numRequests);
+        }
+    }
+}
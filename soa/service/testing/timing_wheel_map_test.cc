@@ -0,0 +1,187 @@
+/* timing_wheel_map_test.cc
+   Copyright (c) 2012 Datacratic.  All rights reserved.
+
+   Test for the timing wheel map.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <random>
+#include "soa/service/timing_wheel_map.h"
+#include "soa/service/timeout_map.h"
+#include "soa/types/id.h"
+
+
+using namespace std;
+using namespace Datacratic;
+
+namespace {
+
+struct Value {
+    Value(int i = 0)
+        : i(i)
+    {
+    }
+
+    int i;
+};
+
+} // file scope
+
+BOOST_AUTO_TEST_CASE( test_timing_wheel_map_basics )
+{
+    TimingWheelMap<Id, Value> map;
+    Date start = Date::fromSecondsSinceEpoch(1000000);
+
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK_EQUAL(map.earliest, Date::positiveInfinity());
+
+    map.insert(Id(1), Value(1), start.plusSeconds(1.0));
+    map.insert(Id(2), Value(2), start.plusSeconds(2.0));
+    map.insert(Id(3), Value(3), start.plusSeconds(3.0));
+
+    BOOST_CHECK_EQUAL(map.size(), 3);
+    BOOST_CHECK(map.count(Id(2)));
+    BOOST_CHECK(!map.count(Id(4)));
+    BOOST_CHECK_EQUAL(map.get(Id(3)).i, 3);
+    BOOST_CHECK_EQUAL(map.find(Id(1))->second.i, 1);
+    BOOST_CHECK(map.find(Id(4)) == map.end());
+    BOOST_CHECK_LE(map.earliest, start.plusSeconds(1.0));
+
+    BOOST_CHECK_THROW(map.insert(Id(1), Value(1), start), ML::Exception);
+
+    map.update(Id(1), Value(10));
+    BOOST_CHECK_EQUAL(map.get(Id(1)).i, 10);
+
+    int n = 0;
+    for (auto it = map.begin();  it != map.end();  ++it, ++n);
+    BOOST_CHECK_EQUAL(n, 3);
+
+    BOOST_CHECK(map.erase(Id(2)));
+    BOOST_CHECK(!map.erase(Id(2)));
+    BOOST_CHECK_EQUAL(map.size(), 2);
+
+    map.clear();
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK(map.begin() == map.end());
+}
+
+BOOST_AUTO_TEST_CASE( test_timing_wheel_map_expiry )
+{
+    TimingWheelMap<Id, Value> map;
+    Date start = Date::fromSecondsSinceEpoch(1000000);
+
+    // Spread timeouts over all levels of the wheel, including some past
+    // its end.
+    vector<double> offsets = { 0.0001, 0.0005, 0.001, 0.1, 0.3, 1.0, 10.0,
+                               100.0, 1000.0, 100000.0, 10000000.0 };
+    for (unsigned i = 0;  i < offsets.size();  ++i)
+        map.insert(Id(i + 1), Value(i), start.plusSeconds(offsets[i]));
+
+    vector<int> expired;
+    auto onExpire = [&] (const Id & id, const Value & value)
+        {
+            expired.push_back(value.i);
+            return Date();
+        };
+
+    map.expire(onExpire, start);
+    BOOST_CHECK(expired.empty());
+
+    for (unsigned i = 0;  i < offsets.size();  ++i) {
+        // Nothing is expired before its exact timeout...
+        map.expire(onExpire, start.plusSeconds(offsets[i] * 0.999));
+        BOOST_CHECK_EQUAL(expired.size(), i);
+
+        // ... and it is expired as soon as it's reached
+        map.expire(onExpire, start.plusSeconds(offsets[i]));
+        BOOST_REQUIRE_EQUAL(expired.size(), i + 1);
+        BOOST_CHECK_EQUAL(expired.back(), i);
+        BOOST_CHECK_EQUAL(map.size(), offsets.size() - i - 1);
+    }
+
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK_EQUAL(map.earliest, Date::positiveInfinity());
+}
+
+BOOST_AUTO_TEST_CASE( test_timing_wheel_map_rearm )
+{
+    TimingWheelMap<Id, Value> map;
+    Date start = Date::fromSecondsSinceEpoch(1000000);
+
+    map.insert(Id(1), Value(1), start.plusSeconds(1.0));
+    map.insert(Id(2), Value(2), start.plusSeconds(1.0));
+
+    int numCalls = 0;
+    auto onExpire = [&] (const Id & id, const Value & value) -> Date
+        {
+            ++numCalls;
+            if (value.i == 1) return start.plusSeconds(5.0);
+            return Date();
+        };
+
+    map.expire(onExpire, start.plusSeconds(2.0));
+    BOOST_CHECK_EQUAL(numCalls, 2);
+    BOOST_CHECK_EQUAL(map.size(), 1);
+    BOOST_CHECK(map.count(Id(1)));
+    BOOST_CHECK_EQUAL(map.find(Id(1))->second.timeout, start.plusSeconds(5.0));
+
+    map.updateTimeout(Id(1), start.plusSeconds(3.0));
+    map.expire(start.plusSeconds(3.0));
+    BOOST_CHECK(map.empty());
+}
+
+/** Check against TimeoutMap under random operations with random time
+    steps.
+*/
+BOOST_AUTO_TEST_CASE( test_timing_wheel_map_vs_timeout_map )
+{
+    TimeoutMap<Id, Value> reference;
+    TimingWheelMap<Id, Value> map;
+
+    mt19937 rng(42);
+    uniform_real_distribution<double> timeoutDist(0.0, 20.0);
+    uniform_real_distribution<double> stepDist(0.0, 0.5);
+
+    Date now = Date::fromSecondsSinceEpoch(1000000);
+
+    for (unsigned i = 0;  i < 100000;  ++i) {
+        Id id(rng() % 20000 + 1);
+        switch (rng() % 4) {
+        case 0:
+        case 1:
+            if (!reference.count(id)) {
+                Date timeout = now.plusSeconds(timeoutDist(rng));
+                reference.insert(id, Value(i), timeout);
+                map.insert(id, Value(i), timeout);
+            }
+            break;
+        case 2:
+            BOOST_REQUIRE_EQUAL(reference.erase(id), map.erase(id));
+            break;
+        case 3: {
+            now = now.plusSeconds(stepDist(rng));
+            vector<pair<Id, int> > refExpired, expired;
+            reference.expire([&] (const Id & id, const Value & value)
+                             {
+                                 refExpired.emplace_back(id, value.i);
+                                 return Date();
+                             }, now);
+            map.expire([&] (const Id & id, const Value & value)
+                       {
+                           expired.emplace_back(id, value.i);
+                           return Date();
+                       }, now);
+            sort(refExpired.begin(), refExpired.end());
+            sort(expired.begin(), expired.end());
+            BOOST_REQUIRE(refExpired == expired);
+            BOOST_REQUIRE_LE(map.earliest, reference.earliest);
+            break;
+        }
+        }
+
+        BOOST_REQUIRE_EQUAL(reference.size(), map.size());
+    }
+}
@@ -0,0 +1,747 @@
+/* timing_wheel_map.h                                              -*- C++ -*-
+   Copyright (c) 2012 Datacratic.  All rights reserved.
+
+   Map from key -> value with inbuilt timeouts, implemented as a hashed
+   hierarchical timing wheel.
+
+   Drop-in replacement for TimeoutMap (timeout_map.h) for maps that hold
+   a very large number of short-lived entries, like the router's in-flight
+   auctions.  Entries live in slab-allocated nodes that are indexed by a
+   flat hash table (for lookup) and chained into a slot of the timing
+   wheel (for expiry), so that insert and erase are O(1) and do not
+   allocate in the steady state.
+
+   The wheel has NUM_LEVELS levels of SLOTS slots each.  Level 0 has one
+   slot per tick; each slot of level N covers SLOTS^N ticks and is
+   cascaded down into the lower levels when the wheel reaches it.  Expiry
+   is done in batches: each call to expire() visits only the slots between
+   the previous and the current tick and skips empty levels entirely.
+*/
+
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <boost/function.hpp>
+#include "soa/types/date.h"
+#include "soa/types/flat_hash_map.h"
+#include "jml/arch/exception.h"
+
+namespace Datacratic {
+
+
+/*****************************************************************************/
+/* TIMING WHEEL MAP                                                          */
+/*****************************************************************************/
+
+/** Map with the same interface as TimeoutMap, but which uses a timing wheel
+    rather than a sorted multimap of timeouts.
+
+    Timeouts are quantized to the given resolution (in seconds) inside the
+    wheel, but an entry is never expired before its exact timeout has
+    passed.
+
+    The earliest member is a lower bound on the earliest timeout in the
+    map rather than its exact value, which is sufficient to avoid calling
+    expire() when nothing can be due.
+*/
+
+template<typename Key, class Value, class Hash = std::hash<Key> >
+struct TimingWheelMap {
+
+    enum {
+        LEVEL_BITS = 8,
+        SLOTS = 1 << LEVEL_BITS,
+        SLOT_MASK = SLOTS - 1,
+        NUM_LEVELS = 4,
+        SLAB_SIZE = 1024
+    };
+
+    TimingWheelMap(double defaultTimeout = -INFINITY,
+                   double resolution = 0.001)
+        : defaultTimeout(defaultTimeout),
+          earliest(Date::positiveInfinity()),
+          resolution(resolution),
+          currentTick(tickOf(Date::now())),
+          numEntries(0),
+          freeList(nullptr),
+          slabUsed(SLAB_SIZE)
+    {
+        if (!(resolution > 0.0))
+            throw ML::Exception("TimingWheelMap: resolution must be positive");
+
+        for (unsigned i = 0;  i < NUM_LEVELS;  ++i) {
+            levelCount[i] = 0;
+            for (unsigned j = 0;  j < SLOTS;  ++j)
+                wheel[i][j].prev = wheel[i][j].next = &wheel[i][j];
+        }
+
+        index.reserve(64);
+    }
+
+    ~TimingWheelMap()
+    {
+        destroyAll();
+    }
+
+    TimingWheelMap(const TimingWheelMap & other) = delete;
+    void operator = (const TimingWheelMap & other) = delete;
+
+    double defaultTimeout;
+
+    boost::function<void (const std::string & reason)> throwException;
+
+    void doThrowException(const std::string & reason) const
+    {
+        if (throwException) throwException(reason);
+        else throw ML::Exception(reason);
+        std::cerr << "TimingWheelMap exception thrower returned" << std::endl;
+        abort();
+    }
+
+    struct Node : public Value {
+        Node() {}
+        Node(const Value & val, Date timeout)
+            : Value(val), timeout(timeout)
+        {
+        }
+
+        Node(Value && val, Date timeout)
+            : Value(std::move(val)), timeout(timeout)
+        {
+        }
+
+        Date timeout;
+    };
+
+    // Lower bound on the date of the earliest timeout
+    Date earliest;
+
+private:
+    /** Links of the intrusive doubly linked list that chains the entries
+        of a single wheel slot.
+    */
+    struct Link {
+        Link * prev;
+        Link * next;
+    };
+
+    struct Entry : public Link {
+        template<typename V>
+        Entry(const Key & key, V && value, Date timeout)
+            : kv(key, Node(std::forward<V>(value), timeout)),
+              tick(0), level(-1)
+        {
+        }
+
+        std::pair<const Key, Node> kv;
+        uint64_t tick;
+        int level;         ///< Wheel level we're linked into, or -1
+    };
+
+    typedef FlatHashMap<Key, Entry *, Hash> Index;
+
+    template<typename EntryT, typename ValueT>
+    struct IteratorT
+        : public std::iterator<std::forward_iterator_tag, ValueT> {
+
+        IteratorT()
+            : entry(nullptr)
+        {
+        }
+
+        IteratorT(typename Index::const_iterator it,
+                  typename Index::const_iterator end)
+            : it(it), end(end), entry(it == end ? nullptr : it->second)
+        {
+        }
+
+        /** Allow conversion from iterator to const_iterator. */
+        template<typename E2, typename V2>
+        IteratorT(const IteratorT<E2, V2> & other)
+            : it(other.it), end(other.end), entry(other.entry)
+        {
+        }
+
+        ValueT & operator * () const { return entry->kv; }
+        ValueT * operator -> () const { return &entry->kv; }
+
+        IteratorT & operator ++ ()
+        {
+            ++it;
+            entry = (it == end ? nullptr : it->second);
+            return *this;
+        }
+
+        IteratorT operator ++ (int)
+        {
+            IteratorT result = *this;
+            ++*this;
+            return result;
+        }
+
+        template<typename E2, typename V2>
+        bool operator == (const IteratorT<E2, V2> & other) const
+        {
+            return entry == other.entry;
+        }
+
+        template<typename E2, typename V2>
+        bool operator != (const IteratorT<E2, V2> & other) const
+        {
+            return entry != other.entry;
+        }
+
+        typename Index::const_iterator it, end;
+        EntryT * entry;
+    };
+
+public:
+    typedef IteratorT<Entry, std::pair<const Key, Node> > iterator;
+    typedef IteratorT<const Entry, const std::pair<const Key, Node> >
+        const_iterator;
+
+    /** Returns true if the key is in the map. */
+    bool count(const Key & key) const
+    {
+        return findEntry(key);
+    }
+
+    /** Access the entry for the given node.  If it already exists then
+        return the existing entry; otherwise insert it with the default
+        timeout.
+    */
+    Node & operator [] (const Key & key)
+    {
+        Entry * entry = findEntry(key);
+        if (entry) return entry->kv.second;
+
+        if (!std::isnormal(defaultTimeout) || defaultTimeout < 0.0)
+            doThrowException("no default timeout specified and insert "
+                             "not used");
+        Date timeout = Date::now().plusSeconds(defaultTimeout);
+        return newEntry(key, Value(), timeout)->kv.second;
+    }
+
+    /** Return the given key or insert a default value if it doesn't exist.
+        Updates the timeout to the given value.
+    */
+    Node & access(const Key & key, Date timeout)
+    {
+        Entry * entry = findEntry(key);
+        if (entry) {
+            // already existed... update the timeout
+            retime(entry, timeout);
+            return entry->kv.second;
+        }
+        return newEntry(key, Value(), timeout)->kv.second;
+    }
+
+    /** Insert the given key, value pair with the given timeout.  Throws an
+        exception if the key already exists.
+    */
+    Node & insert(const Key & key, const Value & value, Date timeout)
+    {
+        if (findEntry(key))
+            doThrowDuplicate(key);
+        return newEntry(key, value, timeout)->kv.second;
+    }
+
+    /** Insert the given key, value pair with the given timeout.  Throws an
+        exception if the key already exists.
+    */
+    Node & insert(const Key & key, Value && value, Date timeout)
+    {
+        if (findEntry(key))
+            doThrowDuplicate(key);
+        return newEntry(key, std::move(value), timeout)->kv.second;
+    }
+
+    /** Update the given key which must already exist. */
+    Node & update(const Key & key, Value && value)
+    {
+        Entry * entry = findEntry(key);
+        if (!entry)
+            doThrowException("TimingWheelMap: "
+                             "attempt to update nonexistant key");
+        Value & v = entry->kv.second;
+        v = std::move(value);
+        return entry->kv.second;
+    }
+
+    /** Update the given key which must already exist. */
+    Node & update(const Key & key, const Value & value)
+    {
+        Entry * entry = findEntry(key);
+        if (!entry)
+            doThrowException("TimingWheelMap: "
+                             "attempt to update nonexistant key");
+        Value & v = entry->kv.second;
+        v = value;
+        return entry->kv.second;
+    }
+
+    void updateTimeout(const Key & key, Date timeout)
+    {
+        Entry * entry = findEntry(key);
+        if (!entry)
+            doThrowException("TimingWheelMap: "
+                             "attempt to update nonexistant key");
+        retime(entry, timeout);
+    }
+
+    void updateTimeout(const iterator & it, Date timeout)
+    {
+        if (it == end())
+            throw ML::Exception("attempt to update wrong timeout");
+        retime(it.entry, timeout);
+    }
+
+    /** Call the callback on any which have expired, removing them from
+        the map.  If the callback returns a valid date then the entry is
+        kept with that date as its new timeout.
+    */
+    template<typename Callback>
+    void expire(const Callback & callback, Date now = Date::now())
+    {
+        advance(now, [&] (Entry * entry)
+                {
+                    Date newExpiry = callback(entry->kv.first,
+                                              entry->kv.second);
+                    if (newExpiry != Date()) {
+                        entry->kv.second.timeout = newExpiry;
+                        linkWheel(entry, tickOf(newExpiry));
+                        if (newExpiry < earliest) earliest = newExpiry;
+                    }
+                    else destroyEntry(entry);
+                });
+    }
+
+    /** Remove any which have expired. */
+    void expire(Date now = Date::now())
+    {
+        advance(now, [&] (Entry * entry) { destroyEntry(entry); });
+    }
+
+    Value get(const Key & key) const
+    {
+        const Entry * entry = findEntry(key);
+        if (!entry) return Value();
+        return entry->kv.second;
+    }
+
+    iterator find(const Key & key)
+    {
+        return iterator(index.find(key), index.end());
+    }
+
+    const_iterator find(const Key & key) const
+    {
+        return const_iterator(index.find(key), index.end());
+    }
+
+    iterator begin()
+    {
+        return iterator(index.begin(), index.end());
+    }
+
+    iterator end()
+    {
+        return iterator(index.end(), index.end());
+    }
+
+    const_iterator begin() const
+    {
+        return const_iterator(index.begin(), index.end());
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator(index.end(), index.end());
+    }
+
+    /** Remove the entry for the given key.  Returns true if it was erased
+        or false otherwise.
+    */
+    bool erase(const Key & key)
+    {
+        Entry * entry = findEntry(key);
+        if (!entry) return false;
+        destroyEntry(entry);
+        return true;
+    }
+
+    void erase(const iterator & it)
+    {
+        if (it == end())
+            doThrowException("erasing with invalid iterator");
+        destroyEntry(it.entry);
+    }
+
+    size_t size() const
+    {
+        return numEntries;
+    }
+
+    bool empty() const
+    {
+        return numEntries == 0;
+    }
+
+    void clear()
+    {
+        destroyAll();
+        earliest = Date::positiveInfinity();
+    }
+
+private:
+    typedef typename std::aligned_storage<sizeof(Entry),
+                                          alignof(Entry)>::type Storage;
+
+    static constexpr uint64_t MAX_TICK
+        = std::numeric_limits<uint64_t>::max() >> 2;
+
+    double resolution;
+
+    Link wheel[NUM_LEVELS][SLOTS];
+    size_t levelCount[NUM_LEVELS];
+    uint64_t currentTick;       ///< Tick whose level 0 slot is current
+
+    Index index;
+    size_t numEntries;
+
+    std::vector<std::unique_ptr<Storage[]> > slabs;
+    void * freeList;
+    size_t slabUsed;
+
+    uint64_t tickOf(Date date) const
+    {
+        double ticks = date.secondsSinceEpoch() / resolution;
+        if (!(ticks > 0.0)) return 0;  // also catches NaN
+        if (ticks >= MAX_TICK) return MAX_TICK;
+        return ticks;
+    }
+
+    Date dateOf(uint64_t tick) const
+    {
+        return Date::fromSecondsSinceEpoch(tick * resolution);
+    }
+
+    void doThrowDuplicate(const Key & key) const
+    {
+        std::cerr << "key = " << key << std::endl;
+        std::cerr << "contents (" << numEntries << ") = " << std::endl;
+        int n = 0;
+        for (auto it = begin(), e = end();  it != e && n < 20;  ++it, ++n)
+            std::cerr << it->first << " @ " << it->second.timeout << " "
+                      << (it->first == key ? "*****" : "") << std::endl;
+        doThrowException("TimingWheelMap: "
+                         "attempt to re-insert existing key");
+    }
+
+    /*************************************************************************/
+    /* SLAB ALLOCATION                                                       */
+    /*************************************************************************/
+
+    void * allocate()
+    {
+        if (freeList) {
+            void * result = freeList;
+            freeList = *reinterpret_cast<void **>(result);
+            return result;
+        }
+
+        if (slabUsed == SLAB_SIZE) {
+            slabs.emplace_back(new Storage[SLAB_SIZE]);
+            slabUsed = 0;
+        }
+
+        return &slabs.back()[slabUsed++];
+    }
+
+    void deallocate(void * mem)
+    {
+        *reinterpret_cast<void **>(mem) = freeList;
+        freeList = mem;
+    }
+
+    /*************************************************************************/
+    /* HASH TABLE                                                            */
+    /*************************************************************************/
+
+    Entry * findEntry(const Key & key) const
+    {
+        auto it = index.find(key);
+        return it == index.end() ? nullptr : it->second;
+    }
+
+    /*************************************************************************/
+    /* TIMING WHEEL                                                          */
+    /*************************************************************************/
+
+    static void linkBefore(Link * pos, Link * link)
+    {
+        link->next = pos;
+        link->prev = pos->prev;
+        pos->prev->next = link;
+        pos->prev = link;
+    }
+
+    static void unlinkList(Link * link)
+    {
+        link->prev->next = link->next;
+        link->next->prev = link->prev;
+    }
+
+    /** Move the whole contents of the list at from onto the empty list
+        at to.
+    */
+    static void spliceList(Link * from, Link * to)
+    {
+        if (from->next == from) {
+            to->prev = to->next = to;
+            return;
+        }
+        to->next = from->next;
+        to->prev = from->prev;
+        to->next->prev = to;
+        to->prev->next = to;
+        from->prev = from->next = from;
+    }
+
+    /** Link the entry into the wheel slot corresponding to the given tick,
+        relative to the current position of the wheel.
+    */
+    void linkWheel(Entry * entry, uint64_t tick)
+    {
+        entry->tick = tick;
+
+        // Overdue entries go into the current slot to be expired on the next
+        // call to expire()
+        if (tick < currentTick) tick = currentTick;
+
+        uint64_t delta = tick - currentTick;
+        int level = 0;
+        while (level < NUM_LEVELS - 1
+               && delta >= (uint64_t(1) << (LEVEL_BITS * (level + 1))))
+            ++level;
+
+        // Past the end of the wheel: park it in the last slot to be visited;
+        // it will be re-placed when that slot is cascaded.
+        uint64_t range = uint64_t(1) << (LEVEL_BITS * NUM_LEVELS);
+        if (delta >= range)
+            tick = currentTick + range - 1;
+
+        unsigned slot = (tick >> (LEVEL_BITS * level)) & SLOT_MASK;
+        linkBefore(&wheel[level][slot], entry);
+        entry->level = level;
+        ++levelCount[level];
+    }
+
+    void unlinkWheel(Entry * entry)
+    {
+        if (entry->level < 0) return;
+        unlinkList(entry);
+        --levelCount[entry->level];
+        entry->level = -1;
+    }
+
+    /** Re-place all entries from the given slot into lower levels. */
+    void cascade(int level, unsigned slot)
+    {
+        Link pending;
+        spliceList(&wheel[level][slot], &pending);
+        while (pending.next != &pending) {
+            Entry * entry = static_cast<Entry *>(pending.next);
+            unlinkWheel(entry);
+            linkWheel(entry, entry->tick);
+        }
+    }
+
+    /** Advance the wheel to the tick containing now, calling onExpired on
+        each entry whose timeout is at or before now.  onExpired is passed
+        an entry that is unlinked from the wheel but still in the hash
+        table; it must either destroy it or link it back into the wheel.
+    */
+    template<typename OnExpired>
+    void advance(Date now, const OnExpired & onExpired)
+    {
+        uint64_t target = tickOf(now);
+
+        for (;;) {
+            if (levelCount[0] > 0)
+                expireSlot(now, onExpired);
+
+            if (currentTick >= target) break;
+
+            if (numEntries == 0) {
+                currentTick = target;
+                break;
+            }
+
+            // Find the next tick that can have anything to do.  If the lower
+            // levels are empty we can skip straight to the next boundary of
+            // the lowest non-empty level.
+            uint64_t next;
+            if (levelCount[0] > 0) next = currentTick + 1;
+            else {
+                int lowest = 1;
+                while (lowest < NUM_LEVELS - 1 && levelCount[lowest] == 0)
+                    ++lowest;
+                int bits = LEVEL_BITS * lowest;
+                next = ((currentTick >> bits) + 1) << bits;
+                if (next > target) next = target;
+            }
+
+            currentTick = next;
+
+            if ((currentTick & SLOT_MASK) == 0) {
+                for (int level = 1;  level < NUM_LEVELS;  ++level) {
+                    unsigned slot = (currentTick >> (LEVEL_BITS * level))
+                        & SLOT_MASK;
+                    cascade(level, slot);
+                    if (slot != 0) break;
+                }
+            }
+        }
+
+        earliest = lowerBound();
+    }
+
+    template<typename OnExpired>
+    void expireSlot(Date now, const OnExpired & onExpired)
+    {
+        // Detach the slot so that entries re-linked into it by the
+        // callback don't get visited again during this pass.
+        Link pending;
+        spliceList(&wheel[0][currentTick & SLOT_MASK], &pending);
+
+        // Entries in pending stay counted in level 0 until they are
+        // unlinked, which keeps erasure from within the callback safe.
+        while (pending.next != &pending) {
+            Entry * entry = static_cast<Entry *>(pending.next);
+            unlinkWheel(entry);
+
+            if (entry->kv.second.timeout > now)
+                linkWheel(entry, entry->tick);
+            else onExpired(entry);
+        }
+    }
+
+    /** Return a lower bound on the earliest timeout in the map. */
+    Date lowerBound() const
+    {
+        if (numEntries == 0)
+            return Date::positiveInfinity();
+
+        Date result = Date::positiveInfinity();
+
+        // Entries in the higher levels are all due at or after the next
+        // boundary of the lowest non-empty one.  We step back a tick to be
+        // safe against rounding in dateOf().
+        for (int level = 1;  level < NUM_LEVELS;  ++level) {
+            if (levelCount[level] == 0) continue;
+            int bits = LEVEL_BITS * level;
+            result = dateOf((((currentTick >> bits) + 1) << bits) - 1);
+            break;
+        }
+
+        if (levelCount[0] == 0)
+            return result;
+
+        // Level 0 slots are in tick order starting from the current one, so
+        // the first non-empty slot holds its earliest entries.
+        for (unsigned i = 0;  i < SLOTS;  ++i) {
+            const Link * head = &wheel[0][(currentTick + i) & SLOT_MASK];
+            if (head->next == head) continue;
+            for (const Link * l = head->next;  l != head;  l = l->next) {
+                const Entry * entry = static_cast<const Entry *>(l);
+                if (entry->kv.second.timeout < result)
+                    result = entry->kv.second.timeout;
+            }
+            break;
+        }
+
+        return result;
+    }
+
+    /*************************************************************************/
+    /* ENTRIES                                                               */
+    /*************************************************************************/
+
+    template<typename V>
+    Entry * newEntry(const Key & key, V && value, Date timeout)
+    {
+        if (numEntries == 0) {
+            // Nothing in the wheel; we can reposition it freely.  Doing so
+            // keeps a long-idle (or simulated-time) map from doing lots of
+            // work on the next expire().
+            currentTick = std::min(tickOf(timeout), tickOf(Date::now()));
+        }
+
+        void * mem = allocate();
+        Entry * entry;
+        try {
+            entry = new (mem) Entry(key, std::forward<V>(value), timeout);
+        } catch (...) {
+            deallocate(mem);
+            throw;
+        }
+
+        try {
+            index.insert(std::make_pair(key, entry));
+        } catch (...) {
+            entry->~Entry();
+            deallocate(mem);
+            throw;
+        }
+        ++numEntries;
+
+        linkWheel(entry, tickOf(timeout));
+        if (timeout < earliest) earliest = timeout;
+
+        return entry;
+    }
+
+    void retime(Entry * entry, Date timeout)
+    {
+        entry->kv.second.timeout = timeout;
+        unlinkWheel(entry);
+        linkWheel(entry, tickOf(timeout));
+        if (timeout < earliest) earliest = timeout;
+    }
+
+    void destroyEntry(Entry * entry)
+    {
+        unlinkWheel(entry);
+        index.erase(entry->kv.first);
+        --numEntries;
+        entry->~Entry();
+        deallocate(entry);
+
+        if (numEntries == 0)
+            earliest = Date::positiveInfinity();
+    }
+
+    void destroyAll()
+    {
+        for (auto & kv: index) {
+            Entry * entry = kv.second;
+            unlinkWheel(entry);
+            entry->~Entry();
+            deallocate(entry);
+        }
+        index.clear();
+        numEntries = 0;
+    }
+};
+
+} // namespace Datacratic
@@ -8,8 +8,11 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <queue>
 #include <thread>
+#include <vector>
 
 #include "jml/utils/ring_buffer.h"
 #include "jml/arch/wakeup_fd.h"
@@ -23,11 +26,19 @@ struct TypedMessageChannel {
     ML::RingBufferSRMW<Message> buf;
 };
 
+/* A bounded multiple writer, single reader channel feeding an AsyncEventSource.
+ *
+ * The eventfd is only signalled when the reader is parked, ie when it found
+ * the buffer empty and went back to its message loop; while it's busy the
+ * writers only touch the ring.  The reader handles up to MaxBatch messages
+ * each time it's called. */
 template<typename Message>
 struct TypedMessageSink: public AsyncEventSource {
 
+    enum { MaxBatch = 64 };
+
     TypedMessageSink(size_t bufferSize)
-        : wakeup(EFD_NONBLOCK), buf(bufferSize)
+        : wakeup(EFD_NONBLOCK), buf(bufferSize), parked(true)
     {
     }
 
@@ -37,7 +48,7 @@ struct TypedMessageSink: public AsyncEventSource {
     void push(MessageT&& message)
     {
         buf.push(std::forward<MessageT>(message));
-        wakeup.signal();
+        unpark();
     }
 
     template<typename MessageT>
@@ -45,7 +56,7 @@ struct TypedMessageSink: public AsyncEventSource {
     {
         bool pushed = buf.tryPush(std::forward<MessageT>(message));
         if (pushed)
-            wakeup.signal();
+            unpark();
 
         return pushed;
     }
@@ -63,26 +74,43 @@ struct TypedMessageSink: public AsyncEventSource {
 
     virtual bool processOne()
     {
-        // Try to do one
         Message msg;
-        if (!buf.tryPop(msg))
-            return false;
-        onEvent(std::move(msg));
+        for (unsigned i = 0;  i < MaxBatch && buf.tryPop(msg);  ++i)
+            onEvent(std::move(msg));
 
-        // Are there more waiting for us?
+        // The eventfd is left readable until we park so that we get called
+        // again for the rest.
         if (buf.couldPop())
             return true;
-        
-        // Warning: race condition... that's why we need the couldPop from
-        // the next instruction to be accurate
+
         wakeup.tryRead();
+        parked.store(true);
 
-        return buf.couldPop();
+        // Pairs with the fence in unpark: either we see the message or the
+        // writer sees that we're parked and signals.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!buf.couldPop() || !parked.exchange(false))
+            return false;
+
+        // A message arrived while we were parking and no writer signalled
+        // it.
+        wakeup.signal();
+        return true;
     }
-    uint64_t size() const { return buf.ring.size() ; }
+
+    uint64_t size() const { return buf.capacity(); }
+
 private:
+    void unpark()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (parked.load(std::memory_order_relaxed) && parked.exchange(false))
+            wakeup.signal();
+    }
+
     ML::Wakeup_Fd wakeup;
     ML::RingBufferSRMW<Message> buf;
+    std::atomic<bool> parked;
 };
 
 
@@ -210,4 +238,142 @@ private:
     OnNotify onNotify_;
 };
 
+
+/*****************************************************************************
+ * TYPED MESSAGE BATCH SINK                                                  *
+ *****************************************************************************/
+
+/* An unbounded multiple writer, single reader channel which hands the reader
+ * everything that was pushed since it last looked as a single batch.
+ *
+ * Writers link their messages onto an atomic list with a single
+ * compare-and-swap and only signal the eventfd when the list was empty, so a
+ * burst of messages costs one wakeup no matter how many writers there are.
+ * The reader takes the whole list with one exchange. */
+template<typename Message>
+struct TypedMessageBatchSink: public AsyncEventSource
+{
+    TypedMessageBatchSink()
+        : wakeup(EFD_NONBLOCK), head(nullptr), pending(0)
+    {
+    }
+
+    ~TypedMessageBatchSink()
+    {
+        freeList(head.exchange(nullptr));
+    }
+
+    /* Called with the messages in the order in which they were pushed. */
+    std::function<void (std::vector<Message> && batch)> onBatch;
+
+    template<typename MessageT>
+    void push(MessageT && message)
+    {
+        Node * node = new Node(std::forward<MessageT>(message));
+        link(node, node, 1);
+    }
+
+    /* Push all the given messages at once; they are guaranteed to end up
+     * next to each other in the same batch. */
+    void pushBatch(std::vector<Message> && messages)
+    {
+        if (messages.empty())
+            return;
+
+        Node * newest = nullptr;
+        Node * oldest = nullptr;
+        for (auto & message: messages) {
+            Node * node = new Node(std::move(message));
+            node->next = newest;
+            newest = node;
+            if (!oldest) oldest = node;
+        }
+
+        link(newest, oldest, messages.size());
+    }
+
+    /* Approximate number of messages waiting for the reader. */
+    uint64_t size() const
+    {
+        return pending;
+    }
+
+    virtual int selectFd() const
+    {
+        return wakeup.fd();
+    }
+
+    virtual bool poll() const
+    {
+        return head.load(std::memory_order_relaxed) != nullptr;
+    }
+
+    virtual bool processOne()
+    {
+        // The wakeup has to be cleared before the list is taken: a writer
+        // that links onto the list after the exchange finds it empty and
+        // signals again.
+        wakeup.tryRead();
+
+        Node * node = head.exchange(nullptr, std::memory_order_acquire);
+        if (!node)
+            return false;
+
+        // The list is newest first
+        std::vector<Message> batch;
+        while (node) {
+            batch.emplace_back(std::move(node->message));
+            Node * next = node->next;
+            delete node;
+            node = next;
+        }
+        std::reverse(batch.begin(), batch.end());
+
+        pending -= batch.size();
+        onBatch(std::move(batch));
+
+        return poll();
+    }
+
+private:
+    struct Node {
+        template<typename MessageT>
+        Node(MessageT && message)
+            : message(std::forward<MessageT>(message)), next(nullptr)
+        {
+        }
+
+        Message message;
+        Node * next;
+    };
+
+    void link(Node * newest, Node * oldest, size_t count)
+    {
+        pending += count;
+
+        Node * old = head.load(std::memory_order_relaxed);
+        do {
+            oldest->next = old;
+        } while (!head.compare_exchange_weak(old, newest,
+                                             std::memory_order_release,
+                                             std::memory_order_relaxed));
+
+        if (!old)
+            wakeup.signal();
+    }
+
+    static void freeList(Node * node)
+    {
+        while (node) {
+            Node * next = node->next;
+            delete node;
+            node = next;
+        }
+    }
+
+    ML::Wakeup_Fd wakeup;
+    std::atomic<Node *> head;
+    std::atomic<uint64_t> pending;
+};
+
 } // namespace Datacratic
@@ -314,7 +314,7 @@ inline void sendMessage(zmq::socket_t & socket,
 template<typename Arg1, typename... Args>
 void sendMessage(zmq::socket_t & socket,
                  const Arg1 & arg1,
-                 Args... args)
+                 const Args &... args)
 {
     if (!sendMesg(socket, arg1, ZMQ_SNDMORE | BLOCK_FLAG)) {
         throwSocketError(__FUNCTION__);
@@ -337,7 +337,8 @@ bool trySendMessage(zmq::socket_t & socket, const Arg1 & arg1)
 }
 
 template<typename Arg1, typename... Args>
-bool trySendMessage(zmq::socket_t & socket, const Arg1 & arg1, Args... args)
+bool trySendMessage(zmq::socket_t & socket, const Arg1 & arg1,
+                    const Args &... args)
 {
     if (!sendMesg(socket, arg1, ZMQ_SNDMORE | BLOCK_FLAG)) {
         if (errno == EAGAIN)
@@ -0,0 +1,518 @@
+/* flat_hash_map.h                                                 -*- C++ -*-
+   Copyright (c) 2014 Datacratic.  All rights reserved.
+
+   Open addressing hash map laid out as two flat arrays, meant for the hot
+   maps keyed on Id (in flight auctions, submitted and finished auctions).
+
+   Each slot has a control byte which is either EMPTY or the top 7 bits of
+   the key's hash.  Lookups compare 16 control bytes at a time (with SSE2
+   when available) and only touch the slots whose byte matches, so a miss
+   usually costs a single cache line.  The full hash is stored next to each
+   entry so that Id keys, whose hash is not cached, are only hashed once.
+
+   Probing is linear and deletion shifts the following entries back into
+   the hole, so there are no tombstones and the table never needs to be
+   rebuilt because of churn.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "jml/arch/exception.h"
+#include "jml/arch/bitops.h"
+#include "jml/compiler/compiler.h"
+
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
+
+namespace Datacratic {
+
+
+/*****************************************************************************/
+/* FLAT HASH MAP                                                             */
+/*****************************************************************************/
+
+/** Unordered map with the subset of the std::unordered_map interface that
+    the router and post auction loop use.
+
+    Any insertion or erasure invalidates all iterators and references into
+    the map.  Use eraseIf() to remove entries while scanning.
+
+    Entries are exposed as std::pair<Key, Value>; the key must not be
+    modified through an iterator.
+*/
+
+template<typename Key, typename Value,
+         class Hash = std::hash<Key>,
+         class Equal = std::equal_to<Key> >
+struct FlatHashMap {
+
+    typedef Key key_type;
+    typedef Value mapped_type;
+    typedef std::pair<Key, Value> value_type;
+
+    enum {
+        GROUP = 16,           ///< Control bytes compared at once
+        MIN_CAPACITY = 16
+    };
+
+    FlatHashMap()
+        : ctrl(emptyGroup()), slots(nullptr), mask(0), size_(0),
+          growthLeft(0)
+    {
+    }
+
+    explicit FlatHashMap(size_t capacity)
+        : FlatHashMap()
+    {
+        reserve(capacity);
+    }
+
+    FlatHashMap(const FlatHashMap & other)
+        : FlatHashMap()
+    {
+        reserve(other.size());
+        for (size_t i = 0;  i < other.capacity();  ++i)
+            if (other.ctrl[i] != EMPTY)
+                insertUnique(other.slots[i].hash, other.slots[i].kv);
+    }
+
+    FlatHashMap(FlatHashMap && other) noexcept
+        : FlatHashMap()
+    {
+        swap(other);
+    }
+
+    FlatHashMap & operator = (FlatHashMap other)
+    {
+        swap(other);
+        return *this;
+    }
+
+    ~FlatHashMap()
+    {
+        destroy();
+    }
+
+    void swap(FlatHashMap & other) noexcept
+    {
+        std::swap(ctrl, other.ctrl);
+        std::swap(slots, other.slots);
+        std::swap(mask, other.mask);
+        std::swap(size_, other.size_);
+        std::swap(growthLeft, other.growthLeft);
+        std::swap(hasher, other.hasher);
+        std::swap(equal, other.equal);
+    }
+
+private:
+    static const int8_t EMPTY = -128;
+
+    struct Slot {
+        size_t hash;
+        value_type kv;
+    };
+
+    template<typename MapT, typename ValueT>
+    struct IteratorT
+        : public std::iterator<std::forward_iterator_tag, ValueT> {
+
+        IteratorT()
+            : map(nullptr), index(0)
+        {
+        }
+
+        IteratorT(MapT * map, size_t index)
+            : map(map), index(index)
+        {
+        }
+
+        /** Allow conversion from iterator to const_iterator. */
+        template<typename M2, typename V2>
+        IteratorT(const IteratorT<M2, V2> & other)
+            : map(other.map), index(other.index)
+        {
+        }
+
+        ValueT & operator * () const { return map->slots[index].kv; }
+        ValueT * operator -> () const { return &map->slots[index].kv; }
+
+        IteratorT & operator ++ ()
+        {
+            index = map->nextFull(index + 1);
+            return *this;
+        }
+
+        IteratorT operator ++ (int)
+        {
+            IteratorT result = *this;
+            ++*this;
+            return result;
+        }
+
+        template<typename M2, typename V2>
+        bool operator == (const IteratorT<M2, V2> & other) const
+        {
+            return index == other.index;
+        }
+
+        template<typename M2, typename V2>
+        bool operator != (const IteratorT<M2, V2> & other) const
+        {
+            return index != other.index;
+        }
+
+        MapT * map;
+        size_t index;
+    };
+
+public:
+    typedef IteratorT<FlatHashMap, value_type> iterator;
+    typedef IteratorT<const FlatHashMap, const value_type> const_iterator;
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    size_t capacity() const { return slots ? mask + 1 : 0; }
+
+    iterator begin() { return iterator(this, nextFull(0)); }
+    iterator end() { return iterator(this, capacity()); }
+    const_iterator begin() const { return const_iterator(this, nextFull(0)); }
+    const_iterator end() const { return const_iterator(this, capacity()); }
+
+    iterator find(const Key & key)
+    {
+        return iterator(this, findIndex(key, hasher(key)));
+    }
+
+    const_iterator find(const Key & key) const
+    {
+        return const_iterator(this, findIndex(key, hasher(key)));
+    }
+
+    size_t count(const Key & key) const
+    {
+        return findIndex(key, hasher(key)) != capacity();
+    }
+
+    /** Insert the given value if its key is not yet present.  Returns the
+        position of the entry and whether it was inserted, like
+        std::unordered_map::insert.
+    */
+    std::pair<iterator, bool> insert(const value_type & kv)
+    {
+        return emplace(kv.first, kv.second);
+    }
+
+    std::pair<iterator, bool> insert(value_type && kv)
+    {
+        return emplace(std::move(kv.first), std::move(kv.second));
+    }
+
+    template<typename K, typename... Args>
+    std::pair<iterator, bool> emplace(K && key, Args &&... args)
+    {
+        size_t hash = hasher(key);
+        size_t index = findIndex(key, hash);
+        if (index != capacity())
+            return std::make_pair(iterator(this, index), false);
+
+        index = insertUnique(hash,
+                             std::piecewise_construct,
+                             std::forward_as_tuple(std::forward<K>(key)),
+                             std::forward_as_tuple(std::forward<Args>(args)...));
+        return std::make_pair(iterator(this, index), true);
+    }
+
+    Value & operator [] (const Key & key)
+    {
+        return emplace(key).first->second;
+    }
+
+    Value & at(const Key & key)
+    {
+        size_t index = findIndex(key, hasher(key));
+        if (index == capacity())
+            throw ML::Exception("FlatHashMap::at(): key not found");
+        return slots[index].kv.second;
+    }
+
+    const Value & at(const Key & key) const
+    {
+        size_t index = findIndex(key, hasher(key));
+        if (index == capacity())
+            throw ML::Exception("FlatHashMap::at(): key not found");
+        return slots[index].kv.second;
+    }
+
+    size_t erase(const Key & key)
+    {
+        size_t index = findIndex(key, hasher(key));
+        if (index == capacity()) return 0;
+        eraseIndex(index);
+        return 1;
+    }
+
+    void erase(const iterator & it)
+    {
+        eraseIndex(it.index);
+    }
+
+    /** Remove every entry for which pred(kv) returns true, in one pass over
+        the table.  The predicate may move the value out of the entry it is
+        given, which is useful to expire entries in bulk.  Returns the
+        number of entries removed.
+    */
+    template<typename Pred>
+    size_t eraseIf(const Pred & pred)
+    {
+        if (size_ == 0) return 0;
+
+        // Start just after an empty slot: no run of entries wraps around
+        // it, so entries shifted back by an erase never cross the point we
+        // started from and each entry is visited exactly once.
+        size_t start = 0;
+        while (ctrl[start] != EMPTY) ++start;
+
+        size_t removed = 0;
+        for (size_t n = 1;  n <= mask + 1;  ++n) {
+            size_t index = (start + n) & mask;
+            while (ctrl[index] != EMPTY && pred(slots[index].kv)) {
+                eraseIndex(index);
+                ++removed;
+            }
+        }
+
+        return removed;
+    }
+
+    void clear()
+    {
+        if (!slots) return;
+        for (size_t i = 0;  i <= mask;  ++i)
+            if (ctrl[i] != EMPTY)
+                slots[i].~Slot();
+        std::memset(ctrl, EMPTY, mask + 1 + GROUP);
+        size_ = 0;
+        growthLeft = maxLoad(mask + 1);
+    }
+
+    /** Make sure that n entries fit without the table growing. */
+    void reserve(size_t n)
+    {
+        size_t capacity = MIN_CAPACITY;
+        while (maxLoad(capacity) < n)
+            capacity *= 2;
+        if (capacity > this->capacity())
+            rehash(capacity);
+    }
+
+private:
+    int8_t * ctrl;
+    Slot * slots;
+    size_t mask;
+    size_t size_;
+    size_t growthLeft;
+    Hash hasher;
+    Equal equal;
+
+    /** Control bytes of a table with no storage yet, so that lookups in an
+        empty map don't need a special case.
+    */
+    static int8_t * emptyGroup()
+    {
+        static int8_t group[GROUP] = {
+            EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY,
+            EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY
+        };
+        return group;
+    }
+
+    static size_t maxLoad(size_t capacity)
+    {
+        return capacity - capacity / 8;
+    }
+
+    static int8_t tag(size_t hash)
+    {
+        return (hash >> (sizeof(size_t) * 8 - 7)) & 0x7f;
+    }
+
+    /** Bitmask of the control bytes in the group starting at the given
+        position that are equal to the given byte.
+    */
+    static uint32_t matchGroup(const int8_t * group, int8_t byte)
+    {
+#if defined(__SSE2__)
+        __m128i ctrl = _mm_loadu_si128((const __m128i *)group);
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(byte)));
+#else
+        uint32_t result = 0;
+        for (unsigned i = 0;  i < GROUP;  ++i)
+            if (group[i] == byte) result |= 1U << i;
+        return result;
+#endif
+    }
+
+    size_t findIndex(const Key & key, size_t hash) const
+    {
+        if (!slots) return 0;
+
+        int8_t h2 = tag(hash);
+        size_t pos = hash & mask;
+
+        for (;;) {
+            const int8_t * group = ctrl + pos;
+            uint32_t empties = matchGroup(group, EMPTY);
+
+            // Only candidates before the first empty slot can be ours
+            uint32_t limit = empties ? (empties & -empties) - 1 : 0xffff;
+            uint32_t matches = matchGroup(group, h2) & limit;
+
+            while (matches) {
+                size_t index = (pos + ML::lowest_bit(matches)) & mask;
+                const Slot & slot = slots[index];
+                if (slot.hash == hash && equal(slot.kv.first, key))
+                    return index;
+                matches &= matches - 1;
+            }
+
+            if (empties) return capacity();
+            pos = (pos + GROUP) & mask;
+        }
+    }
+
+    /** Index of the first empty slot at or after the ideal position for
+        the given hash.
+    */
+    size_t findEmpty(size_t hash) const
+    {
+        size_t pos = hash & mask;
+        for (;;) {
+            uint32_t empties = matchGroup(ctrl + pos, EMPTY);
+            if (empties)
+                return (pos + ML::lowest_bit(empties)) & mask;
+            pos = (pos + GROUP) & mask;
+        }
+    }
+
+    void setCtrl(size_t index, int8_t byte)
+    {
+        ctrl[index] = byte;
+        // The first group is mirrored after the end of the table so that
+        // a group load never needs to wrap around.
+        if (index < GROUP)
+            ctrl[mask + 1 + index] = byte;
+    }
+
+    template<typename... Args>
+    size_t insertUnique(size_t hash, Args &&... args)
+    {
+        if (growthLeft == 0)
+            rehash(slots ? 2 * (mask + 1) : MIN_CAPACITY);
+
+        size_t index = findEmpty(hash);
+        Slot * slot = slots + index;
+        new (&slot->kv) value_type(std::forward<Args>(args)...);
+        slot->hash = hash;
+        setCtrl(index, tag(hash));
+        ++size_;
+        --growthLeft;
+        return index;
+    }
+
+    /** Remove the entry at the given index and shift the entries that
+        follow it back towards their ideal positions.
+    */
+    void eraseIndex(size_t hole)
+    {
+        slots[hole].~Slot();
+
+        for (size_t index = (hole + 1) & mask;
+             ctrl[index] != EMPTY;
+             index = (index + 1) & mask) {
+
+            size_t ideal = slots[index].hash & mask;
+
+            // Can move back if its ideal slot isn't between the hole and
+            // where it currently is
+            if (((index - ideal) & mask) < ((index - hole) & mask))
+                continue;
+
+            Slot & from = slots[index];
+            new (&slots[hole].kv) value_type(std::move(from.kv));
+            slots[hole].hash = from.hash;
+            setCtrl(hole, ctrl[index]);
+            from.~Slot();
+            hole = index;
+        }
+
+        setCtrl(hole, EMPTY);
+        --size_;
+        ++growthLeft;
+    }
+
+    size_t nextFull(size_t index) const
+    {
+        size_t cap = capacity();
+        while (index < cap && ctrl[index] == EMPTY)
+            ++index;
+        return index;
+    }
+
+    void rehash(size_t newCapacity)
+    {
+        int8_t * oldCtrl = ctrl;
+        Slot * oldSlots = slots;
+        size_t oldCapacity = capacity();
+
+        ctrl = (int8_t *)std::malloc(newCapacity + GROUP);
+        slots = (Slot *)std::malloc(newCapacity * sizeof(Slot));
+        if (!ctrl || !slots) {
+            std::free(ctrl);
+            std::free(slots);
+            ctrl = oldCtrl;
+            slots = oldSlots;
+            throw std::bad_alloc();
+        }
+
+        std::memset(ctrl, EMPTY, newCapacity + GROUP);
+        mask = newCapacity - 1;
+        size_ = 0;
+        growthLeft = maxLoad(newCapacity);
+
+        for (size_t i = 0;  i < oldCapacity;  ++i) {
+            if (oldCtrl[i] == EMPTY) continue;
+            Slot & slot = oldSlots[i];
+            insertUnique(slot.hash, std::move(slot.kv));
+            slot.~Slot();
+        }
+
+        if (oldSlots) {
+            std::free(oldCtrl);
+            std::free(oldSlots);
+        }
+    }
+
+    void destroy()
+    {
+        if (!slots) return;
+        clear();
+        std::free(ctrl);
+        std::free(slots);
+        ctrl = emptyGroup();
+        slots = nullptr;
+        mask = 0;
+        growthLeft = 0;
+    }
+};
+
+} // namespace Datacratic
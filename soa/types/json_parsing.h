@@ -343,7 +343,7 @@ struct StreamingJsonParsingContext
 
     void skip()
     {
-        ML::expectJson(*context);
+        ML::skipJson(*context);
     }
 
     virtual int expectInt()
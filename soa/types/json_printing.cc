@@ -6,6 +6,7 @@
 */
 
 #include "jml/utils/exc_assert.h"
+#include "jml/arch/thread_specific.h"
 
 #include "json_printing.h"
 #include "dtoa.h"
@@ -224,6 +225,101 @@ writeBool(bool b)
 }
 
 
+/*****************************************************************************/
+/* JSON PRINTING BUFFER                                                      */
+/*****************************************************************************/
+
+struct JsonPrintingBuffer::Buffer : public std::streambuf {
+
+    Buffer()
+        : inUse(false)
+    {
+    }
+
+    void reset()
+    {
+        if (storage.empty())
+            storage.resize(256);
+        setp(&storage[0], &storage[0] + storage.size());
+    }
+
+    virtual int overflow(int c)
+    {
+        size_t used = pptr() - pbase();
+        storage.resize(storage.size() * 2);
+        setp(&storage[0], &storage[0] + storage.size());
+        pbump(used);
+
+        if (c != traits_type::eof()) {
+            *pptr() = c;
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    std::string str() const
+    {
+        return std::string(pbase(), pptr());
+    }
+
+    std::string storage;
+    bool inUse;
+};
+
+namespace {
+
+struct JsonPrintingBufferTag {
+};
+
+/** Buffers bigger than this are released when done with instead of being
+    kept around for the next use.
+*/
+enum { MaxKeptBufferSize = 1024 * 1024 };
+
+JsonPrintingBuffer::Buffer * threadBuffer()
+{
+    static ML::Thread_Specific<JsonPrintingBuffer::Buffer,
+                               JsonPrintingBufferTag> buffers;
+    return buffers.get();
+}
+
+} // file scope
+
+JsonPrintingBuffer::
+JsonPrintingBuffer()
+    : std::ostream(nullptr), buffer(threadBuffer()), owned(false)
+{
+    if (buffer->inUse) {
+        buffer = new Buffer();
+        owned = true;
+    }
+
+    buffer->inUse = true;
+    buffer->reset();
+    rdbuf(buffer);
+}
+
+JsonPrintingBuffer::
+~JsonPrintingBuffer()
+{
+    if (owned) {
+        delete buffer;
+        return;
+    }
+
+    buffer->inUse = false;
+    if (buffer->storage.size() > MaxKeptBufferSize)
+        std::string().swap(buffer->storage);
+}
+
+std::string
+JsonPrintingBuffer::
+str() const
+{
+    return buffer->str();
+}
+
+
 /*****************************************************************************/
 /* STRUCTURED JSON PRINTING CONTEXT                                          */
 /*****************************************************************************/
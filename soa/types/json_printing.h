@@ -123,6 +123,33 @@ struct StreamJsonPrintingContext
 };
 
 
+/*****************************************************************************/
+/* JSON PRINTING BUFFER                                                      */
+/*****************************************************************************/
+
+/** Output stream for a StreamJsonPrintingContext on hot paths.  It borrows
+    a buffer belonging to the calling thread which keeps its capacity from
+    one use to the next, so once it has grown the only allocation left is
+    the string returned by str().  Nested uses on the same thread get a
+    private buffer instead.
+*/
+
+struct JsonPrintingBuffer : public std::ostream {
+
+    JsonPrintingBuffer();
+    ~JsonPrintingBuffer();
+
+    /** Return everything printed so far. */
+    std::string str() const;
+
+    struct Buffer;
+
+private:
+    Buffer * buffer;
+    bool owned;
+};
+
+
 /*****************************************************************************/
 /* STRUCTURED JSON PRINTING CONTEXT                                          */
 /*****************************************************************************/
@@ -0,0 +1,88 @@
+/* flat_hash_map_bench.cc
+   Copyright (c) 2014 Datacratic.  All rights reserved.
+
+   Compares FlatHashMap with std::unordered_map on the access pattern of the
+   in flight and submitted auction maps: a sliding window of live Ids where
+   every new auction is inserted, looked up a few times and erased.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "soa/types/flat_hash_map.h"
+#include "soa/types/id.h"
+#include "jml/arch/timers.h"
+#include "jml/arch/format.h"
+#include <unordered_map>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+using namespace Datacratic;
+
+namespace {
+
+struct Payload {
+    uint64_t words[4];
+};
+
+template<typename Map>
+double runWindow(const vector<Id> & ids, size_t window, int lookups)
+{
+    Map map;
+    uint64_t total = 0;
+
+    ML::Timer timer;
+
+    for (size_t i = 0;  i < ids.size();  ++i) {
+        map.insert(make_pair(ids[i], Payload{ { i, 0, 0, 0 } }));
+
+        for (int j = 0;  j < lookups;  ++j) {
+            auto it = map.find(ids[i - (i * 7 + j) % std::min(i + 1, window)]);
+            if (it != map.end()) total += it->second.words[0];
+        }
+
+        if (i >= window)
+            map.erase(ids[i - window]);
+    }
+
+    double elapsed = timer.elapsed_wall();
+    BOOST_CHECK(total > 0);
+    return elapsed / ids.size() * 1e9;
+}
+
+} // file scope
+
+BOOST_AUTO_TEST_CASE( flat_hash_map_bench )
+{
+    enum { NumIds = 4000000 };
+
+    vector<Id> ids;
+    ids.reserve(NumIds);
+    for (unsigned i = 0;  i < NumIds;  ++i) {
+        uint64_t h = i * 0x9e3779b97f4a7c15ULL;
+        ids.push_back(Id(ML::format("%08x-%04x-%04x-%04x-%012llx",
+                                    (unsigned)(h >> 32), (unsigned)(h >> 16) & 0xffff,
+                                    (unsigned)h & 0xffff, i & 0xffff,
+                                    (unsigned long long)i)));
+    }
+
+    cerr << ML::format("%10s %8s %14s %14s %8s",
+                       "window", "lookups", "unordered_map", "FlatHashMap",
+                       "speedup")
+         << endl;
+
+    for (size_t window: { 1000, 100000, 1000000 }) {
+        for (int lookups: { 1, 4 }) {
+            double stdNs = runWindow<unordered_map<Id, Payload> >
+                (ids, window, lookups);
+            double flatNs = runWindow<FlatHashMap<Id, Payload> >
+                (ids, window, lookups);
+            cerr << ML::format("%10zd %8d %12.1fns %12.1fns %7.2fx",
+                               window, lookups, stdNs, flatNs,
+                               stdNs / flatNs)
+                 << endl;
+        }
+    }
+}
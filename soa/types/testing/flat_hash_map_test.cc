@@ -0,0 +1,160 @@
+/* flat_hash_map_test.cc
+   Copyright (c) 2014 Datacratic.  All rights reserved.
+
+   Test for the FlatHashMap class.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "soa/types/flat_hash_map.h"
+#include "soa/types/id.h"
+#include <unordered_map>
+#include <string>
+#include <random>
+
+using namespace std;
+using namespace Datacratic;
+
+/** Hash that puts every key in one of a few buckets, to exercise long
+    probe runs, wrap around and backward shifting on erase.
+*/
+struct CollidingHash {
+    size_t operator () (int key) const
+    {
+        return (key % 3) * 0x9e3779b97f4a7c15ULL + (key % 3);
+    }
+};
+
+BOOST_AUTO_TEST_CASE( test_flat_hash_map_basics )
+{
+    FlatHashMap<Id, string> map;
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK(map.find(Id(1)) == map.end());
+    BOOST_CHECK_EQUAL(map.count(Id(1)), 0);
+    BOOST_CHECK_EQUAL(map.erase(Id(1)), 0);
+
+    auto res = map.insert(make_pair(Id(1), string("one")));
+    BOOST_CHECK(res.second);
+    BOOST_CHECK_EQUAL(res.first->second, "one");
+
+    res = map.insert(make_pair(Id(1), string("uno")));
+    BOOST_CHECK(!res.second);
+    BOOST_CHECK_EQUAL(res.first->second, "one");
+
+    map[Id("hello")] = "string id";
+    BOOST_CHECK_EQUAL(map.size(), 2);
+    BOOST_CHECK_EQUAL(map.at(Id("hello")), "string id");
+    BOOST_CHECK_THROW(map.at(Id(2)), std::exception);
+
+    FlatHashMap<Id, string> copy = map;
+    BOOST_CHECK_EQUAL(map.erase(Id(1)), 1);
+    BOOST_CHECK_EQUAL(map.size(), 1);
+    BOOST_CHECK_EQUAL(copy.size(), 2);
+    BOOST_CHECK_EQUAL(copy[Id(1)], "one");
+
+    map.clear();
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK(map.begin() == map.end());
+}
+
+template<typename Map>
+void checkSame(const Map & map, const unordered_map<int, int> & expected)
+{
+    BOOST_REQUIRE_EQUAL(map.size(), expected.size());
+
+    size_t n = 0;
+    for (auto & kv: map) {
+        auto it = expected.find(kv.first);
+        BOOST_REQUIRE(it != expected.end());
+        BOOST_REQUIRE_EQUAL(it->second, kv.second);
+        ++n;
+    }
+    BOOST_REQUIRE_EQUAL(n, expected.size());
+
+    for (auto & kv: expected) {
+        auto it = map.find(kv.first);
+        BOOST_REQUIRE(it != map.end());
+        BOOST_REQUIRE_EQUAL(it->second, kv.second);
+    }
+}
+
+template<typename Hash>
+void testRandomOps()
+{
+    FlatHashMap<int, int, Hash> map;
+    unordered_map<int, int> expected;
+
+    mt19937 rng(42);
+    uniform_int_distribution<int> keys(0, 500);
+
+    for (unsigned i = 0;  i < 20000;  ++i) {
+        int key = keys(rng);
+        switch (rng() % 3) {
+        case 0:
+            BOOST_REQUIRE_EQUAL(map.insert(make_pair(key, i)).second,
+                                expected.insert(make_pair(key, i)).second);
+            break;
+        case 1:
+            BOOST_REQUIRE_EQUAL(map.erase(key), expected.erase(key));
+            break;
+        case 2:
+            BOOST_REQUIRE_EQUAL(map.count(key), expected.count(key));
+            break;
+        }
+
+        if (i % 1000 == 0)
+            checkSame(map, expected);
+    }
+
+    checkSame(map, expected);
+
+    // Batch removal of every odd value
+    size_t removed = map.eraseIf([] (const pair<int, int> & kv)
+                                 {
+                                     return kv.second % 2;
+                                 });
+
+    size_t expectedRemoved = 0;
+    for (auto it = expected.begin();  it != expected.end();) {
+        if (it->second % 2) {
+            it = expected.erase(it);
+            ++expectedRemoved;
+        }
+        else ++it;
+    }
+
+    BOOST_CHECK_EQUAL(removed, expectedRemoved);
+    checkSame(map, expected);
+}
+
+BOOST_AUTO_TEST_CASE( test_flat_hash_map_random )
+{
+    testRandomOps<std::hash<int> >();
+}
+
+BOOST_AUTO_TEST_CASE( test_flat_hash_map_collisions )
+{
+    testRandomOps<CollidingHash>();
+}
+
+struct IdPairHash {
+    size_t operator () (const pair<Id, Id> & key) const
+    {
+        return key.first.hash() ^ key.second.hash();
+    }
+};
+
+BOOST_AUTO_TEST_CASE( test_flat_hash_map_pair_keys )
+{
+    FlatHashMap<pair<Id, Id>, int, IdPairHash> map;
+
+    for (unsigned i = 0;  i < 1000;  ++i)
+        map[make_pair(Id(i), Id(i + 1))] = i;
+
+    BOOST_CHECK_EQUAL(map.size(), 1000);
+    for (unsigned i = 0;  i < 1000;  ++i)
+        BOOST_CHECK_EQUAL(map.at(make_pair(Id(i), Id(i + 1))), i);
+    BOOST_CHECK_EQUAL(map.count(make_pair(Id(1), Id(1))), 0);
+}
@@ -63,3 +63,47 @@ BOOST_AUTO_TEST_CASE(test_utf8_round_trip_streaming_ascii)
         BOOST_CHECK_EQUAL(str, str2);
     }
 }
+
+BOOST_AUTO_TEST_CASE(test_json_printing_buffer)
+{
+    // Grows past its initial size and gives the same text as a stringstream
+    std::vector<std::string> strings;
+    for (unsigned i = 0;  i < 200;  ++i)
+        strings.push_back(std::string(i % 13, 'a' + i % 26));
+
+    std::ostringstream expected;
+    {
+        StreamJsonPrintingContext context(expected);
+        context.startArray();
+        for (auto & s: strings) {
+            context.newArrayElement();
+            context.writeString(s);
+        }
+        context.endArray();
+    }
+
+    for (unsigned iter = 0;  iter < 2;  ++iter) {
+        JsonPrintingBuffer stream;
+        StreamJsonPrintingContext context(stream);
+        context.startArray();
+        for (auto & s: strings) {
+            context.newArrayElement();
+            context.writeString(s);
+
+            // A nested use on the same thread doesn't clobber the outer one
+            if (&s == &strings[100]) {
+                JsonPrintingBuffer nested;
+                StreamJsonPrintingContext nestedContext(nested);
+                nestedContext.writeInt(42);
+                BOOST_CHECK_EQUAL(nested.str(), "42");
+            }
+        }
+        context.endArray();
+
+        BOOST_CHECK_EQUAL(stream.str(), expected.str());
+    }
+
+    // The thread's buffer starts out empty every time
+    JsonPrintingBuffer stream;
+    BOOST_CHECK_EQUAL(stream.str(), "");
+}
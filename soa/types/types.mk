@@ -36,7 +36,7 @@ LIBVALUE_DESCRIPTION_SOURCES := \
 	periodic_utils_value_descriptions.cc
 
 LIBVALUE_DESCRIPTION_LINK := \
-	arch types
+	arch types boost_thread
 
 $(eval $(call library,value_description,$(LIBVALUE_DESCRIPTION_SOURCES),$(LIBVALUE_DESCRIPTION_LINK)))
 
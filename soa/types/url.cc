@@ -222,7 +222,8 @@ reconstitute(ML::DB::Store_Reader & store)
     unsigned char version;
     store >> version;
     if (version != 0)
-        store >> original;
+        throw ML::Exception("unknown Url version");
+    store >> original;
     *this = Url(original);
 }
 
@@ -1862,10 +1862,10 @@ std::string jsonEncodeStr(const T & obj,
                           typename std::enable_if<!hasToJson<T>::value>::type * = 0)
 {
     static auto desc = getDefaultDescriptionShared<T>();
-    std::ostringstream stream;
+    JsonPrintingBuffer stream;
     StreamJsonPrintingContext context(stream);
     desc->printJson(&obj, context);
-    return std::move(stream.str());
+    return stream.str();
 }
 
 // jsonEncode implementation for any type which: